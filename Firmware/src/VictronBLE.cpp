@@ -8,8 +8,11 @@
 
 #include "VictronBLE.h"
 #include "config.h"
+#include <stddef.h>
 #include <string.h>
+#include <math.h>
 #include "esp_log.h"
+#include "esp_timer.h"
 
 // Kort diagnostik utan att slå på full Arduino BLE-debug.
 // Full BLE-debug kan generera enorm loggmängd och trigga watchdog.
@@ -20,6 +23,13 @@ static uint32_t s_victronParseFailSeen = 0;
 static uint32_t s_victronParseSuccessSeen = 0;
 static uint32_t s_victronUnknownLogged = 0;
 static uint32_t s_victronParseFailLogged = 0;
+static uint32_t s_victronDecodeCount = 0;
+static uint64_t s_victronDecodeUsTotal = 0;
+static uint32_t s_victronDecodeUsMax = 0;
+
+// Skyddar data som skrivs i BT-tasken och läses från huvudloopen:
+// listan med okända enheter och dekodstatistiken (64-bitars summa).
+static portMUX_TYPE s_storeMux = portMUX_INITIALIZER_UNLOCKED;
 
 static void bytesToHexLower(const uint8_t *data, size_t len, char *out, size_t outLen)
 {
@@ -38,9 +48,12 @@ static void bytesToHexLower(const uint8_t *data, size_t len, char *out, size_t o
 VictronBLE::VictronBLE()
     : deviceCount(0), pBLEScan(nullptr), scanCallbackObj(nullptr),
       callback(nullptr), debugEnabled(false), scanDuration(5),
-      minIntervalMs(1000), initialized(false)
+      minIntervalMs(1000), initialized(false), scanStartMs(0),
+      scanInterval(VICTRON_BLE_SCAN_INTERVAL), scanWindow(VICTRON_BLE_SCAN_WINDOW)
 {
     memset(devices, 0, sizeof(devices));
+    memset(unknown, 0, sizeof(unknown));
+    unknownCount = 0;
 }
 
 bool VictronBLE::begin(uint32_t scanDuration)
@@ -49,6 +62,26 @@ bool VictronBLE::begin(uint32_t scanDuration)
         return true;
     this->scanDuration = scanDuration;
 
+#if VICTRON_BLE_BACKEND_NIMBLE
+    esp_log_level_set("NimBLE", ESP_LOG_WARN);
+    esp_log_level_set("NimBLEScan", ESP_LOG_WARN);
+
+    NimBLEDevice::init("");
+    pBLEScan = NimBLEDevice::getScan();
+    if (!pBLEScan)
+        return false;
+
+    if (!scanCallbackObj)
+        scanCallbackObj = new VictronBLEAdvertisedDeviceCallbacks(this);
+    // wantDuplicates=true av samma skäl som för Bluedroid nedan.
+    pBLEScan->setAdvertisedDeviceCallbacks(scanCallbackObj, true);
+    pBLEScan->setActiveScan(false);
+    pBLEScan->setInterval(scanInterval);
+    pBLEScan->setWindow(scanWindow);
+    // 0 = spara inga resultat, bara callback. Annars växer en vektor med
+    // NimBLEAdvertisedDevice-objekt under hela scanningen.
+    pBLEScan->setMaxResults(0);
+#else
     // Sänk BLE/BT-loggning. Arduino BLE kan annars spamma Serial så hårt
     // att BTC_TASK svälter IDLE task och watchdog startar om ESP32-S3.
     esp_log_level_set("BLEAdvertisedDevice", ESP_LOG_NONE);
@@ -61,7 +94,10 @@ bool VictronBLE::begin(uint32_t scanDuration)
     if (!pBLEScan)
         return false;
 
-    scanCallbackObj = new VictronBLEAdvertisedDeviceCallbacks(this);
+    // Callback-objektet skapas en gång och återanvänds vid ny begin(),
+    // så init/deinit-cykler inte fragmenterar heapen.
+    if (!scanCallbackObj)
+        scanCallbackObj = new VictronBLEAdvertisedDeviceCallbacks(this);
     // false = inga dubbletter under samma scan. Det minskar callback-belastningen
     // kraftigt och räcker för vår periodiska statusläsning.
     pBLEScan->setAdvertisedDeviceCallbacks(scanCallbackObj, true);
@@ -69,8 +105,10 @@ bool VictronBLE::begin(uint32_t scanDuration)
     // Låg duty-cycle scan: mindre CPU/radiobelastning än 99/100.
     // duplicate=true är medvetet: Victron kan sända flera advertising frames
     // från samma adress och den första behöver inte vara e102-data.
-    pBLEScan->setInterval(160);
-    pBLEScan->setWindow(40);
+    pBLEScan->setInterval(scanInterval);
+    pBLEScan->setWindow(scanWindow);
+
+#endif
 
     initialized = true;
     if (debugEnabled)
@@ -79,6 +117,21 @@ bool VictronBLE::begin(uint32_t scanDuration)
 }
 
 
+void VictronBLE::setScanTiming(uint16_t interval, uint16_t window)
+{
+    if (window > interval)
+        window = interval;
+    scanInterval = interval;
+    scanWindow = window;
+
+    // Nya värden används av nästa start() i stacken.
+    if (initialized && pBLEScan)
+    {
+        pBLEScan->setInterval(scanInterval);
+        pBLEScan->setWindow(scanWindow);
+    }
+}
+
 bool VictronBLE::scanOnce(uint32_t scanDurationSeconds)
 {
     if (!initialized)
@@ -108,6 +161,102 @@ bool VictronBLE::scanOnce(uint32_t scanDurationSeconds)
     return true;
 }
 
+// Sätts false av onScanDone() eller scanStop().
+static volatile bool s_scanning = false;
+#if VICTRON_BLE_BACKEND_NIMBLE
+static void onScanDone(NimBLEScanResults results)
+#else
+static void onScanDone(BLEScanResults results)
+#endif
+{
+    s_scanning = false;
+}
+
+bool VictronBLE::scanStart(uint32_t scanDurationSeconds)
+{
+    if (!initialized || !pBLEScan)
+        return false;
+
+    if (scanDurationSeconds == 0)
+        scanDurationSeconds = scanDuration;
+
+    for (size_t i = 0; i < deviceCount; i++)
+    {
+        devices[i].scanSeen = false;
+        devices[i].scanFirstMs = 0;
+    }
+
+    pBLEScan->clearResults();
+    scanStartMs = millis();
+
+    // Overload med callback är icke-blockande; onScanDone körs i BT-tasken
+    // när tiden gått ut.
+    s_scanning = pBLEScan->start(scanDurationSeconds, onScanDone, false);
+
+    if (debugEnabled)
+        Serial.printf("[VictronBLE] Async scan start: %lus ok=%d\n",
+                      (unsigned long)scanDurationSeconds, s_scanning ? 1 : 0);
+
+    return s_scanning;
+}
+
+bool VictronBLE::scanRunning() const
+{
+    return s_scanning;
+}
+
+void VictronBLE::scanStop()
+{
+    if (!pBLEScan)
+        return;
+
+    // Bara stop() om scanningen fortfarande går, annars loggar
+    // BT-stacken "scan not active".
+    if (s_scanning)
+    {
+        pBLEScan->stop();
+        s_scanning = false;
+    }
+
+    pBLEScan->clearResults();
+}
+
+bool VictronBLE::scanAllReported() const
+{
+    if (deviceCount == 0)
+        return false;
+
+    for (size_t i = 0; i < deviceCount; i++)
+    {
+        if (devices[i].active && !devices[i].scanSeen)
+            return false;
+    }
+    return true;
+}
+
+bool VictronBLE::getScanFirstPacketMs(size_t idx, uint32_t &outMs) const
+{
+    if (idx >= deviceCount || !devices[idx].scanSeen)
+        return false;
+
+    outMs = devices[idx].scanFirstMs;
+    return true;
+}
+
+const char *VictronBLE::getDeviceName(size_t idx) const
+{
+    return idx < deviceCount ? devices[idx].device.name : "";
+}
+
+void VictronBLE::markScanSeen(DeviceEntry *entry, uint32_t nowMs)
+{
+    if (entry->scanSeen)
+        return;
+
+    entry->scanFirstMs = nowMs - scanStartMs;
+    entry->scanSeen = true;
+}
+
 void VictronBLE::end()
 {
     if (pBLEScan)
@@ -117,17 +266,18 @@ void VictronBLE::end()
         pBLEScan->clearResults();
     }
 
-    if (scanCallbackObj)
-    {
-        delete scanCallbackObj;
-        scanCallbackObj = nullptr;
-    }
-
     pBLEScan = nullptr;
     initialized = false;
 
-    // Frigör BLE-minne/radioresurser mellan scans.
-    BLEDevice::deinit(true);
+#if VICTRON_BLE_BACKEND_NIMBLE
+    // clearAll=false: callback-objektet ägs av oss och återanvänds.
+    NimBLEDevice::deinit(false);
+#else
+    // Frigör BLE-stackens minne/radio mellan scans. release_memory=false:
+    // med true släpps controllerns minne permanent och BLEDevice::init()
+    // blir en no-op resten av booten.
+    BLEDevice::deinit(false);
+#endif
 }
 
 void VictronBLE::resetScanStats()
@@ -147,6 +297,17 @@ uint32_t VictronBLE::getScanUnknownSeen() const { return s_victronUnknownSeen; }
 uint32_t VictronBLE::getScanParseFailSeen() const { return s_victronParseFailSeen; }
 uint32_t VictronBLE::getScanParseSuccessSeen() const { return s_victronParseSuccessSeen; }
 
+void VictronBLE::getDecodeStats(uint32_t &count, uint32_t &avgUs, uint32_t &maxUs) const
+{
+    portENTER_CRITICAL(&s_storeMux);
+    count = s_victronDecodeCount;
+    const uint64_t totalUs = s_victronDecodeUsTotal;
+    maxUs = s_victronDecodeUsMax;
+    portEXIT_CRITICAL(&s_storeMux);
+
+    avgUs = count ? (uint32_t)(totalUs / count) : 0;
+}
+
 bool VictronBLE::addDevice(const char *name, const char *mac, const char *hexKey,
                            VictronDeviceType type)
 {
@@ -159,9 +320,12 @@ bool VictronBLE::addDevice(const char *name, const char *mac, const char *hexKey
 
     char normalizedMAC[VICTRON_MAC_LEN];
     normalizeMAC(mac, normalizedMAC);
+    uint8_t macBin[6];
+    if (!hexToBytes(normalizedMAC, macBin, sizeof(macBin)))
+        return false;
 
     // Check for duplicate
-    if (findDevice(normalizedMAC))
+    if (findDevice(macBin))
         return false;
 
     DeviceEntry *entry = &devices[deviceCount];
@@ -171,12 +335,22 @@ bool VictronBLE::addDevice(const char *name, const char *mac, const char *hexKey
     strncpy(entry->device.name, name ? name : "", VICTRON_NAME_LEN - 1);
     entry->device.name[VICTRON_NAME_LEN - 1] = '\0';
     memcpy(entry->device.mac, normalizedMAC, VICTRON_MAC_LEN);
+    memcpy(entry->macBin, macBin, sizeof(macBin));
     entry->device.deviceType = type;
     entry->device.rssi = -100;
 
     if (!hexToBytes(hexKey, entry->key, 16))
         return false;
 
+    // Nyckelschemat expanderas en gång här i stället för per paket.
+    // Posten flyttas aldrig, så kontextens interna pekare förblir giltiga.
+    mbedtls_aes_init(&entry->aes);
+    if (mbedtls_aes_setkey_enc(&entry->aes, entry->key, 128) != 0)
+    {
+        mbedtls_aes_free(&entry->aes);
+        return false;
+    }
+
     deviceCount++;
 
     if (debugEnabled)
@@ -184,13 +358,96 @@ bool VictronBLE::addDevice(const char *name, const char *mac, const char *hexKey
     return true;
 }
 
-// Scan complete callback — sets flag so loop() restarts
-static bool s_scanning = false;
-static void onScanDone(BLEScanResults results)
+void VictronBLE::clearDevices()
 {
-    s_scanning = false;
+    for (size_t i = 0; i < deviceCount; i++)
+    {
+        if (devices[i].active)
+            mbedtls_aes_free(&devices[i].aes);
+    }
+    memset(devices, 0, sizeof(devices));
+    deviceCount = 0;
+}
+
+void VictronBLE::noteUnknown(const uint8_t *mac, int rssi, uint8_t recordType, uint32_t nowMs)
+{
+    portENTER_CRITICAL(&s_storeMux);
+
+    UnknownEntry *slot = nullptr;
+    for (size_t i = 0; i < unknownCount; i++)
+    {
+        if (memcmp(unknown[i].mac, mac, 6) == 0)
+        {
+            slot = &unknown[i];
+            break;
+        }
+    }
+
+    if (!slot)
+    {
+        if (unknownCount < VICTRON_MAX_UNKNOWN)
+        {
+            slot = &unknown[unknownCount++];
+        }
+        else
+        {
+            // Full lista: ersätt den som hörts längst sedan.
+            slot = &unknown[0];
+            for (size_t i = 1; i < unknownCount; i++)
+            {
+                if ((int32_t)(unknown[i].lastSeenMs - slot->lastSeenMs) < 0)
+                    slot = &unknown[i];
+            }
+        }
+        memcpy(slot->mac, mac, 6);
+        slot->count = 0;
+    }
+
+    slot->rssi = (int8_t)rssi;
+    slot->recordType = recordType;
+    slot->lastSeenMs = nowMs;
+    slot->count++;
+
+    portEXIT_CRITICAL(&s_storeMux);
+}
+
+size_t VictronBLE::getUnknownCount() const
+{
+    portENTER_CRITICAL(&s_storeMux);
+    const size_t n = unknownCount;
+    portEXIT_CRITICAL(&s_storeMux);
+    return n;
 }
 
+bool VictronBLE::getUnknown(size_t idx, VictronUnknownDevice &out) const
+{
+    // Kopiera posten under låset, formatera utanför.
+    portENTER_CRITICAL(&s_storeMux);
+    const bool valid = idx < unknownCount;
+    UnknownEntry u;
+    if (valid)
+        u = unknown[idx];
+    portEXIT_CRITICAL(&s_storeMux);
+
+    if (!valid)
+        return false;
+
+    bytesToHexLower(u.mac, 6, out.mac, sizeof(out.mac));
+    out.rssi = u.rssi;
+    out.recordType = u.recordType;
+    out.lastSeenMs = u.lastSeenMs;
+    out.count = u.count;
+    return true;
+}
+
+void VictronBLE::clearUnknown()
+{
+    portENTER_CRITICAL(&s_storeMux);
+    unknownCount = 0;
+    portEXIT_CRITICAL(&s_storeMux);
+}
+
+// Kontinuerlig scan: onScanDone() nollställer s_scanning så loop() startar om.
 void VictronBLE::loop()
 {
     if (!initialized)
@@ -203,6 +460,54 @@ void VictronBLE::loop()
 }
 
 // BLE scan callback
+#if VICTRON_BLE_BACKEND_NIMBLE
+void VictronBLEAdvertisedDeviceCallbacks::onResult(NimBLEAdvertisedDevice *advertisedDevice)
+{
+    if (victronBLE && advertisedDevice)
+        victronBLE->processDevice(advertisedDevice);
+}
+
+void VictronBLE::processDevice(NimBLEAdvertisedDevice *advertisedDevice)
+{
+    // Gå igenom AD-strukturerna direkt i NimBLE:s buffert och leta upp
+    // manufacturer data (typ 0xFF). Inga std::string-kopior per paket.
+    const uint8_t *payload = advertisedDevice->getPayload();
+    size_t payloadLen = advertisedDevice->getPayloadLength();
+    const uint8_t *mfg = nullptr;
+    size_t mfgLen = 0;
+
+    size_t pos = 0;
+    while (pos + 1 < payloadLen)
+    {
+        uint8_t fieldLen = payload[pos];
+        if (fieldLen == 0 || pos + 1 + fieldLen > payloadLen)
+            break;
+        if (payload[pos + 1] == 0xFF)
+        {
+            mfg = &payload[pos + 2];
+            mfgLen = fieldLen - 1;
+            break;
+        }
+        pos += 1 + fieldLen;
+    }
+
+    if (!mfg || mfgLen < 10)
+        return;
+
+    // Billig vendor-kontroll innan MAC formateras
+    if ((mfg[0] | (mfg[1] << 8)) != VICTRON_MANUFACTURER_ID)
+        return;
+
+    // NimBLE lagrar adressen LSB först; macBin är MSB först.
+    NimBLEAddress address = advertisedDevice->getAddress();
+    const uint8_t *addr = address.getNative();
+    uint8_t mac[6];
+    for (size_t i = 0; i < 6; i++)
+        mac[i] = addr[5 - i];
+
+    processAdvertisement(mac, advertisedDevice->getRSSI(), mfg, mfgLen);
+}
+#else
 void VictronBLEAdvertisedDeviceCallbacks::onResult(BLEAdvertisedDevice advertisedDevice)
 {
     if (victronBLE)
@@ -223,30 +528,43 @@ void VictronBLE::processDevice(BLEAdvertisedDevice &advertisedDevice)
     if (vendorID != VICTRON_MANUFACTURER_ID)
         return;
 
+    char normalizedMAC[VICTRON_MAC_LEN];
+    normalizeMAC(advertisedDevice.getAddress().toString().c_str(), normalizedMAC);
+    uint8_t mac[6];
+    if (!hexToBytes(normalizedMAC, mac, sizeof(mac)))
+        return;
+
+    processAdvertisement(mac, advertisedDevice.getRSSI(),
+                         reinterpret_cast<const uint8_t *>(raw.data()), raw.length());
+}
+#endif
+
+void VictronBLE::processAdvertisement(const uint8_t *mac, int rssi,
+                                      const uint8_t *raw, size_t rawLen)
+{
     // Parse manufacturer data
     victronManufacturerData mfgData;
     memset(&mfgData, 0, sizeof(mfgData));
-    size_t copyLen = raw.length() > sizeof(mfgData) ? sizeof(mfgData) : raw.length();
-    raw.copy(reinterpret_cast<char *>(&mfgData), copyLen);
-
-    // Normalize MAC and find device
-    char normalizedMAC[VICTRON_MAC_LEN];
-    normalizeMAC(advertisedDevice.getAddress().toString().c_str(), normalizedMAC);
+    size_t copyLen = rawLen > sizeof(mfgData) ? sizeof(mfgData) : rawLen;
+    memcpy(&mfgData, raw, copyLen);
 
     s_victronAdvSeen++;
 
-    DeviceEntry *entry = findDevice(normalizedMAC);
+    DeviceEntry *entry = findDevice(mac);
     if (!entry)
     {
         s_victronUnknownSeen++;
+        noteUnknown(mac, rssi, mfgData.victronRecordType, millis());
         if (VICTRON_BLE_DIAG_VERBOSE && s_victronUnknownLogged < VICTRON_BLE_DIAG_MAX_UNKNOWN_PER_SCAN)
         {
+            char normalizedMAC[VICTRON_MAC_LEN];
+            bytesToHexLower(mac, 6, normalizedMAC, sizeof(normalizedMAC));
             char rawHex[65];
-            bytesToHexLower(reinterpret_cast<const uint8_t *>(raw.data()), raw.length(), rawHex, sizeof(rawHex));
+            bytesToHexLower(raw, rawLen, rawHex, sizeof(rawHex));
             Serial.printf("VICTRON_DIAG: unknown_victron_mac=%s rssi=%d len=%u beacon=0x%02X record=0x%02X keymatch=0x%02X nonce=0x%04X raw=%s seen=%lu\n",
                           normalizedMAC,
-                          advertisedDevice.getRSSI(),
-                          (unsigned)raw.length(),
+                          rssi,
+                          (unsigned)rawLen,
                           mfgData.beaconType,
                           mfgData.victronRecordType,
                           mfgData.encryptKeyMatch,
@@ -260,18 +578,26 @@ void VictronBLE::processDevice(BLEAdvertisedDevice &advertisedDevice)
 
     s_victronKnownSeen++;
 
+    // Krypterad payload = det som faktiskt togs emot efter headern.
+    const size_t headerLen = offsetof(victronManufacturerData, victronEncryptedData);
+    const size_t payloadLen = rawLen > headerLen ? rawLen - headerLen : 0;
+
+    uint32_t now = millis();
+
     // Skip if nonce unchanged (data hasn't changed on the device)
     if (entry->device.dataValid && mfgData.nonceDataCounter == entry->lastNonce)
     {
         // Still update RSSI since we got a packet
-        entry->device.rssi = advertisedDevice.getRSSI();
+        entry->device.rssi = rssi;
+        // Oförändrad nonce = senaste dekodade data gäller fortfarande.
+        markScanSeen(entry, now);
         return;
     }
 
     // Skip if minimum interval hasn't elapsed
-    uint32_t now = millis();
     if (entry->device.dataValid && (now - entry->device.lastUpdate) < minIntervalMs)
     {
+        markScanSeen(entry, now);
         return;
     }
 
@@ -279,12 +605,23 @@ void VictronBLE::processDevice(BLEAdvertisedDevice &advertisedDevice)
         Serial.printf("[VictronBLE] Processing: %s nonce:0x%04X\n",
                       entry->device.name, mfgData.nonceDataCounter);
 
-    if (parseAdvertisement(entry, mfgData))
+    const int64_t t0 = esp_timer_get_time();
+    const bool parsed = parseAdvertisement(entry, mfgData, payloadLen);
+    const uint32_t decodeUs = (uint32_t)(esp_timer_get_time() - t0);
+    portENTER_CRITICAL(&s_storeMux);
+    s_victronDecodeCount++;
+    s_victronDecodeUsTotal += decodeUs;
+    if (decodeUs > s_victronDecodeUsMax)
+        s_victronDecodeUsMax = decodeUs;
+    portEXIT_CRITICAL(&s_storeMux);
+
+    if (parsed)
     {
         s_victronParseSuccessSeen++;
         entry->lastNonce = mfgData.nonceDataCounter;
-        entry->device.rssi = advertisedDevice.getRSSI();
+        entry->device.rssi = rssi;
         entry->device.lastUpdate = now;
+        markScanSeen(entry, now);
     }
     else
     {
@@ -292,12 +629,12 @@ void VictronBLE::processDevice(BLEAdvertisedDevice &advertisedDevice)
         if (VICTRON_BLE_DIAG_VERBOSE && s_victronParseFailLogged < VICTRON_BLE_DIAG_MAX_PARSE_FAIL_PER_SCAN)
         {
         char rawHex[65];
-        bytesToHexLower(reinterpret_cast<const uint8_t *>(raw.data()), raw.length(), rawHex, sizeof(rawHex));
+        bytesToHexLower(raw, rawLen, rawHex, sizeof(rawHex));
         Serial.printf("VICTRON_DIAG: known_parse_fail name=%s mac=%s rssi=%d len=%u beacon=0x%02X record=0x%02X keymatch=0x%02X key0=0x%02X nonce=0x%04X raw=%s known_seen=%lu\n",
                       entry->device.name,
-                      normalizedMAC,
-                      advertisedDevice.getRSSI(),
-                      (unsigned)raw.length(),
+                      entry->device.mac,
+                      rssi,
+                      (unsigned)rawLen,
                       mfgData.beaconType,
                       mfgData.victronRecordType,
                       mfgData.encryptKeyMatch,
@@ -310,8 +647,96 @@ void VictronBLE::processDevice(BLEAdvertisedDevice &advertisedDevice)
     }
 }
 
-bool VictronBLE::parseAdvertisement(DeviceEntry *entry, const victronManufacturerData &mfg)
+// --- Typade vyer ur VictronRecord ---
+
+static uint8_t rawU8(const VictronRecord &rec, VictronField field)
+{
+    int32_t v;
+    return victronRecordRaw(rec, field, v) ? (uint8_t)v : 0xFF;
+}
+
+static void fillSolar(const VictronRecord &rec, VictronSolarData &out)
+{
+    int32_t yield = 0;
+    out.chargeState = rawU8(rec, VictronField::DEVICE_STATE);
+    out.errorCode = rawU8(rec, VictronField::ERROR_CODE);
+    out.batteryVoltage = victronRecordValueOr(rec, VictronField::BATTERY_VOLTAGE, NAN);
+    out.batteryCurrent = victronRecordValueOr(rec, VictronField::BATTERY_CURRENT, NAN);
+    out.panelPower = victronRecordValueOr(rec, VictronField::PV_POWER, NAN);
+    out.yieldToday = victronRecordRaw(rec, VictronField::YIELD_TODAY, yield) ? (uint32_t)yield * 10UL : 0;
+    // NA = ingen last ansluten
+    out.loadCurrent = victronRecordValueOr(rec, VictronField::LOAD_CURRENT, 0.0f);
+}
+
+static void fillBattery(const VictronRecord &rec, VictronBatteryData &out)
+{
+    int32_t alarms = 0;
+    int32_t ttg = 0xFFFF;
+    int32_t auxType = 3;
+    int32_t aux = 0;
+    victronRecordRaw(rec, VictronField::ALARM_REASON, alarms);
+    victronRecordRaw(rec, VictronField::TIME_TO_GO, ttg);
+
+    out.voltage = victronRecordValueOr(rec, VictronField::BATTERY_VOLTAGE, NAN);
+    out.current = victronRecordValueOr(rec, VictronField::BATTERY_CURRENT, NAN);
+    out.remainingMinutes = (uint16_t)ttg;
+    out.consumedAh = victronRecordValueOr(rec, VictronField::CONSUMED_AH, NAN);
+    out.soc = victronRecordValueOr(rec, VictronField::SOC, NAN);
+    out.alarmLowVoltage = (alarms & 0x0001) != 0;
+    out.alarmHighVoltage = (alarms & 0x0002) != 0;
+    out.alarmLowSOC = (alarms & 0x0004) != 0;
+    out.alarmLowTemperature = (alarms & 0x0020) != 0;
+    out.alarmHighTemperature = (alarms & 0x0040) != 0;
+
+    // Aux: 0 = startbatteri (signed), 1 = mittpunkt, 2 = temperatur (0,01 K),
+    // 3 = ingen. SmartLithium/Lynx har egen batteritemperatur.
+    out.auxVoltage = 0;
+    out.temperature = victronRecordValueOr(rec, VictronField::BATTERY_TEMPERATURE, 0.0f);
+    victronRecordRaw(rec, VictronField::AUX_INPUT, auxType);
+    if (victronRecordRaw(rec, VictronField::AUX_VALUE, aux))
+    {
+        if (auxType == 0)
+            out.auxVoltage = (int16_t)aux * 0.01f;
+        else if (auxType == 1)
+            out.auxVoltage = aux * 0.01f;
+        else if (auxType == 2)
+            out.temperature = aux * 0.01f - 273.15f;
+    }
+}
+
+static void fillInverter(const VictronRecord &rec, VictronInverterData &out)
+{
+    int32_t alarms = 0;
+    victronRecordRaw(rec, VictronField::ALARM_REASON, alarms);
+
+    out.state = rawU8(rec, VictronField::DEVICE_STATE);
+    out.batteryVoltage = victronRecordValueOr(rec, VictronField::BATTERY_VOLTAGE, NAN);
+    out.batteryCurrent = victronRecordValueOr(rec, VictronField::BATTERY_CURRENT, NAN);
+    // Inverter (0x03) skickar skenbar effekt, övriga AC-uteffekt.
+    out.acPower = victronRecordValueOr(rec, VictronField::AC_OUT_POWER,
+                                       victronRecordValueOr(rec, VictronField::AC_APPARENT_POWER, NAN));
+    out.alarmLowVoltage = (alarms & 0x0001) != 0;
+    out.alarmHighVoltage = (alarms & 0x0002) != 0;
+    out.alarmHighTemperature = (alarms & 0x0040) != 0;
+    out.alarmOverload = (alarms & 0x0100) != 0;
+}
+
+static void fillDCDC(const VictronRecord &rec, VictronDCDCData &out)
+{
+    out.chargeState = rawU8(rec, VictronField::DEVICE_STATE);
+    out.errorCode = rawU8(rec, VictronField::ERROR_CODE);
+    out.inputVoltage = victronRecordValueOr(rec, VictronField::INPUT_VOLTAGE, NAN);
+    out.outputVoltage = victronRecordValueOr(rec, VictronField::OUTPUT_VOLTAGE, NAN);
+    // Bara Orion XS (0x0F) skickar utström.
+    out.outputCurrent = victronRecordValueOr(rec, VictronField::OUTPUT_CURRENT, NAN);
+}
+
+bool VictronBLE::parseAdvertisement(DeviceEntry *entry, const victronManufacturerData &mfg,
+                                    size_t payloadLen)
 {
+    if (payloadLen > VICTRON_ENCRYPTED_LEN)
+        payloadLen = VICTRON_ENCRYPTED_LEN;
+
     if (debugEnabled)
     {
         Serial.printf("[VictronBLE] Beacon:0x%02X Record:0x%02X Nonce:0x%04X\n",
@@ -339,240 +764,87 @@ bool VictronBLE::parseAdvertisement(DeviceEntry *entry, const victronManufacture
 
     // Decrypt
     uint8_t decrypted[VICTRON_ENCRYPTED_LEN];
-    if (!decryptData(mfg.victronEncryptedData, VICTRON_ENCRYPTED_LEN,
-                     entry->key, iv, decrypted))
+    if (payloadLen == 0 ||
+        !decryptData(mfg.victronEncryptedData, payloadLen,
+                     &entry->aes, iv, decrypted))
     {
         if (debugEnabled)
             Serial.println("[VictronBLE] Decryption failed");
         return false;
     }
 
-    // Parse based on record type (auto-detects device type)
-    bool ok = false;
+    // Tabellstyrd avkodning av alla kända recordtyper, sedan typade vyer.
+    VictronDevice &dev = entry->device;
+    if (!victronRecordDecode(mfg.victronRecordType, decrypted, payloadLen, dev.record))
+    {
+        if (debugEnabled)
+            Serial.printf("[VictronBLE] Unknown type or short record: 0x%02X len=%u\n",
+                          mfg.victronRecordType, (unsigned)payloadLen);
+        return false;
+    }
+    dev.recordType = mfg.victronRecordType;
+
     switch (mfg.victronRecordType)
     {
-    case DEVICE_TYPE_SOLAR_CHARGER:
-        entry->device.deviceType = DEVICE_TYPE_SOLAR_CHARGER;
-        ok = parseSolarCharger(decrypted, VICTRON_ENCRYPTED_LEN, entry->device.solar);
+    case VICTRON_RECORD_SOLAR_CHARGER:
+        dev.deviceType = DEVICE_TYPE_SOLAR_CHARGER;
+        fillSolar(dev.record, dev.solar);
         break;
-    case DEVICE_TYPE_BATTERY_MONITOR:
-        entry->device.deviceType = DEVICE_TYPE_BATTERY_MONITOR;
-        ok = parseBatteryMonitor(decrypted, VICTRON_ENCRYPTED_LEN, entry->device.battery);
+    case VICTRON_RECORD_BATTERY_MONITOR:
+    case VICTRON_RECORD_SMART_LITHIUM:
+    case VICTRON_RECORD_LYNX_SMART_BMS:
+    case VICTRON_RECORD_DC_ENERGY_METER:
+        dev.deviceType = (VictronDeviceType)mfg.victronRecordType;
+        fillBattery(dev.record, dev.battery);
         break;
-    case DEVICE_TYPE_INVERTER:
-    case DEVICE_TYPE_INVERTER_RS:
-    case DEVICE_TYPE_MULTI_RS:
-    case DEVICE_TYPE_VE_BUS:
-        entry->device.deviceType = DEVICE_TYPE_INVERTER;
-        ok = parseInverter(decrypted, VICTRON_ENCRYPTED_LEN, entry->device.inverter);
+    case VICTRON_RECORD_INVERTER:
+    case VICTRON_RECORD_INVERTER_RS:
+    case VICTRON_RECORD_MULTI_RS:
+    case VICTRON_RECORD_VE_BUS:
+        dev.deviceType = DEVICE_TYPE_INVERTER;
+        fillInverter(dev.record, dev.inverter);
         break;
-    case DEVICE_TYPE_DCDC_CONVERTER:
-        entry->device.deviceType = DEVICE_TYPE_DCDC_CONVERTER;
-        ok = parseDCDCConverter(decrypted, VICTRON_ENCRYPTED_LEN, entry->device.dcdc);
+    case VICTRON_RECORD_DCDC_CONVERTER:
+    case VICTRON_RECORD_ORION_XS:
+        dev.deviceType = DEVICE_TYPE_DCDC_CONVERTER;
+        fillDCDC(dev.record, dev.dcdc);
         break;
     default:
-        if (debugEnabled)
-            Serial.printf("[VictronBLE] Unknown type: 0x%02X\n", mfg.victronRecordType);
-        return false;
+        // GX, AC-laddare, Smart BatteryProtect: bara dev.record.
+        dev.deviceType = (VictronDeviceType)mfg.victronRecordType;
+        break;
     }
 
-    if (ok)
-    {
-        entry->device.dataValid = true;
-        if (callback)
-            callback(&entry->device);
-    }
+    if (debugEnabled)
+        Serial.printf("[VictronBLE] %s: %u/%u fields\n",
+                      victronRecordTypeName(dev.recordType),
+                      (unsigned)__builtin_popcount(dev.record.presentMask),
+                      (unsigned)dev.record.spec->fieldCount);
+
+    dev.dataValid = true;
+    if (callback)
+        callback(&dev);
 
-    return ok;
+    return true;
 }
 
 bool VictronBLE::decryptData(const uint8_t *encrypted, size_t len,
-                             const uint8_t *key, const uint8_t *iv,
+                             mbedtls_aes_context *aes, const uint8_t *iv,
                              uint8_t *decrypted)
 {
-    mbedtls_aes_context aes;
-    mbedtls_aes_init(&aes);
-
-    if (mbedtls_aes_setkey_enc(&aes, key, 128) != 0)
-    {
-        mbedtls_aes_free(&aes);
-        return false;
-    }
-
+    // Kontexten är nyckelsatt i addDevice(); CTR-läget använder bara
+    // krypteringsriktningen och ändrar inte nyckelschemat.
     size_t nc_off = 0;
     uint8_t nonce_counter[16];
     uint8_t stream_block[16];
     memcpy(nonce_counter, iv, 16);
     memset(stream_block, 0, 16);
 
-    int ret = mbedtls_aes_crypt_ctr(&aes, len, &nc_off, nonce_counter,
+    int ret = mbedtls_aes_crypt_ctr(aes, len, &nc_off, nonce_counter,
                                     stream_block, encrypted, decrypted);
-    mbedtls_aes_free(&aes);
     return (ret == 0);
 }
 
-bool VictronBLE::parseSolarCharger(const uint8_t *data, size_t len, VictronSolarData &result)
-{
-    if (len < sizeof(victronSolarChargerPayload))
-        return false;
-    const auto *p = reinterpret_cast<const victronSolarChargerPayload *>(data);
-
-    result.chargeState = p->deviceState;
-    result.errorCode = p->errorCode;
-    result.batteryVoltage = p->batteryVoltage * 0.01f;
-    result.batteryCurrent = p->batteryCurrent * 0.01f;
-    result.yieldToday = p->yieldToday * 10;
-    result.panelPower = p->inputPower;
-    result.loadCurrent = (p->loadCurrent != 0xFFFF) ? p->loadCurrent * 0.01f : 0;
-
-    if (debugEnabled)
-    {
-        Serial.printf("[VictronBLE] Solar: %.2fV %.2fA %dW State:%d\n",
-                      result.batteryVoltage, result.batteryCurrent,
-                      (int)result.panelPower, result.chargeState);
-    }
-    return true;
-}
-
-bool VictronBLE::parseBatteryMonitor(const uint8_t *data, size_t len, VictronBatteryData &result)
-{
-    if (len < 15)
-        return false;
-
-    if (debugEnabled)
-    {
-        Serial.print("[VictronBLE] Battery raw decrypted: ");
-        for (size_t i = 0; i < len; i++)
-        {
-            if (data[i] < 16)
-                Serial.print("0");
-            Serial.print(data[i], HEX);
-            Serial.print(" ");
-        }
-        Serial.println();
-    }
-
-    result.remainingMinutes = data[0] | (data[1] << 8);
-    result.voltage = (data[2] | (data[3] << 8)) * 0.01f;
-
-    uint16_t alarmReason = data[4] | (data[5] << 8);
-
-    result.alarmLowVoltage = (alarmReason & 0x0001) != 0;
-    result.alarmHighVoltage = (alarmReason & 0x0002) != 0;
-    result.alarmLowSOC = (alarmReason & 0x0004) != 0;
-    result.alarmLowTemperature = (alarmReason & 0x0020) != 0;
-    result.alarmHighTemperature = (alarmReason & 0x0040) != 0;
-
-    uint16_t auxData = data[6] | (data[7] << 8);
-
-    // Bitfältet börjar vid byte 8.
-    // Layout enligt ESPHome/Victron:
-    // aux_input_type : 2 bit
-    // battery_current : 22 bit signed, 0.001 A
-    // consumed_ah : 20 bit unsigned, 0.1 Ah, visas som negativt
-    // state_of_charge : 10 bit unsigned, 0.1 %
-    uint64_t bits = 0;
-    for (int i = 0; i < 7; i++)
-    {
-        bits |= ((uint64_t)data[8 + i]) << (8 * i);
-    }
-
-    uint8_t auxInputType = bits & 0x03;
-
-    int32_t currentRaw = (bits >> 2) & 0x3FFFFF;
-    if (currentRaw & 0x200000)
-    {
-        currentRaw |= 0xFFC00000;
-    }
-    result.current = currentRaw * 0.001f;
-
-    uint32_t consumedRaw = (bits >> 24) & 0xFFFFF;
-    result.consumedAh = -((float)consumedRaw * 0.1f);
-
-    uint16_t socRaw = (bits >> 44) & 0x03FF;
-    result.soc = socRaw * 0.1f;
-
-    // Aux type:
-    // 0 = starter/aux voltage
-    // 1 = midpoint voltage
-    // 2 = temperature
-    // 3 = none
-    result.auxVoltage = 0;
-    result.temperature = 0;
-
-    if (auxInputType == 0 || auxInputType == 1)
-    {
-        result.auxVoltage = auxData * 0.01f;
-    }
-    else if (auxInputType == 2)
-    {
-        result.temperature = (auxData * 0.01f) - 273.15f;
-    }
-
-    if (debugEnabled)
-    {
-        Serial.printf("[VictronBLE] Battery: %.2fV %.3fA SOC:%.1f%% Consumed:%.2fAh Togo:%umin AuxType:%u\n",
-                      result.voltage,
-                      result.current,
-                      result.soc,
-                      result.consumedAh,
-                      result.remainingMinutes,
-                      auxInputType);
-    }
-
-    return true;
-}
-
-bool VictronBLE::parseInverter(const uint8_t *data, size_t len, VictronInverterData &result)
-{
-    if (len < sizeof(victronInverterPayload))
-        return false;
-    const auto *p = reinterpret_cast<const victronInverterPayload *>(data);
-
-    result.state = p->deviceState;
-    result.batteryVoltage = p->batteryVoltage * 0.01f;
-    result.batteryCurrent = p->batteryCurrent * 0.01f;
-
-    // AC Power (signed 24-bit)
-    int32_t acPower = p->acPowerLow | (p->acPowerMid << 8) | (p->acPowerHigh << 16);
-    if (acPower & 0x800000)
-        acPower |= 0xFF000000; // Sign extend
-    result.acPower = acPower;
-
-    // Alarm bits
-    result.alarmLowVoltage = (p->alarms & 0x01) != 0;
-    result.alarmHighVoltage = (p->alarms & 0x02) != 0;
-    result.alarmHighTemperature = (p->alarms & 0x04) != 0;
-    result.alarmOverload = (p->alarms & 0x08) != 0;
-
-    if (debugEnabled)
-    {
-        Serial.printf("[VictronBLE] Inverter: %.2fV %dW State:%d\n",
-                      result.batteryVoltage, (int)result.acPower, result.state);
-    }
-    return true;
-}
-
-bool VictronBLE::parseDCDCConverter(const uint8_t *data, size_t len, VictronDCDCData &result)
-{
-    if (len < sizeof(victronDCDCConverterPayload))
-        return false;
-    const auto *p = reinterpret_cast<const victronDCDCConverterPayload *>(data);
-
-    result.chargeState = p->chargeState;
-    result.errorCode = p->errorCode;
-    result.inputVoltage = p->inputVoltage * 0.01f;
-    result.outputVoltage = p->outputVoltage * 0.01f;
-    result.outputCurrent = p->outputCurrent * 0.01f;
-
-    if (debugEnabled)
-    {
-        Serial.printf("[VictronBLE] DC-DC: In=%.2fV Out=%.2fV %.2fA\n",
-                      result.inputVoltage, result.outputVoltage, result.outputCurrent);
-    }
-    return true;
-}
-
 // --- Helpers ---
 
 bool VictronBLE::hexToBytes(const char *hex, uint8_t *out, size_t len)
@@ -616,11 +888,13 @@ void VictronBLE::normalizeMAC(const char *input, char *output)
     output[j] = '\0';
 }
 
-VictronBLE::DeviceEntry *VictronBLE::findDevice(const char *normalizedMAC)
+VictronBLE::DeviceEntry *VictronBLE::findDevice(const uint8_t *mac)
 {
+    // Binär jämförelse; de flesta främmande adresser faller redan på
+    // första byten.
     for (size_t i = 0; i < deviceCount; i++)
     {
-        if (devices[i].active && strcmp(devices[i].device.mac, normalizedMAC) == 0)
+        if (devices[i].active && memcmp(devices[i].macBin, mac, 6) == 0)
         {
             return &devices[i];
         }
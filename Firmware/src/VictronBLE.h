@@ -12,32 +12,42 @@
 #define VICTRON_BLE_H
 
 #include <Arduino.h>
+#include "config.h"
+#if VICTRON_BLE_BACKEND_NIMBLE
+#include <NimBLEDevice.h>
+#else
 #include <BLEDevice.h>
 #include <BLEAdvertisedDevice.h>
 #include <BLEScan.h>
+#endif
 #include "mbedtls/aes.h"
+#include "VictronRecords.h"
 
 // --- Constants ---
 static constexpr uint16_t VICTRON_MANUFACTURER_ID = 0x02E1;
 static constexpr int VICTRON_MAX_DEVICES = 8;
 static constexpr int VICTRON_MAC_LEN = 13;     // 12 hex chars + null
 static constexpr int VICTRON_NAME_LEN = 32;
-static constexpr int VICTRON_ENCRYPTED_LEN = 21;
+static constexpr int VICTRON_ENCRYPTED_LEN = VICTRON_RECORD_PAYLOAD_LEN;
+static constexpr int VICTRON_MAX_UNKNOWN = 8;
 
-// --- Device type IDs from Victron protocol ---
+// --- Device type IDs from Victron protocol (= recordtyp) ---
 enum VictronDeviceType {
     DEVICE_TYPE_UNKNOWN = 0x00,
-    DEVICE_TYPE_SOLAR_CHARGER = 0x01,
-    DEVICE_TYPE_BATTERY_MONITOR = 0x02,
-    DEVICE_TYPE_INVERTER = 0x03,
-    DEVICE_TYPE_DCDC_CONVERTER = 0x04,
-    DEVICE_TYPE_SMART_LITHIUM = 0x05,
-    DEVICE_TYPE_INVERTER_RS = 0x06,
-    DEVICE_TYPE_SMART_BATTERY_PROTECT = 0x07,
-    DEVICE_TYPE_LYNX_SMART_BMS = 0x08,
-    DEVICE_TYPE_MULTI_RS = 0x09,
-    DEVICE_TYPE_VE_BUS = 0x0A,
-    DEVICE_TYPE_DC_ENERGY_METER = 0x0B
+    DEVICE_TYPE_SOLAR_CHARGER = VICTRON_RECORD_SOLAR_CHARGER,
+    DEVICE_TYPE_BATTERY_MONITOR = VICTRON_RECORD_BATTERY_MONITOR,
+    DEVICE_TYPE_INVERTER = VICTRON_RECORD_INVERTER,
+    DEVICE_TYPE_DCDC_CONVERTER = VICTRON_RECORD_DCDC_CONVERTER,
+    DEVICE_TYPE_SMART_LITHIUM = VICTRON_RECORD_SMART_LITHIUM,
+    DEVICE_TYPE_INVERTER_RS = VICTRON_RECORD_INVERTER_RS,
+    DEVICE_TYPE_GX_DEVICE = VICTRON_RECORD_GX_DEVICE,
+    DEVICE_TYPE_AC_CHARGER = VICTRON_RECORD_AC_CHARGER,
+    DEVICE_TYPE_SMART_BATTERY_PROTECT = VICTRON_RECORD_SMART_BATTERY_PROTECT,
+    DEVICE_TYPE_LYNX_SMART_BMS = VICTRON_RECORD_LYNX_SMART_BMS,
+    DEVICE_TYPE_MULTI_RS = VICTRON_RECORD_MULTI_RS,
+    DEVICE_TYPE_VE_BUS = VICTRON_RECORD_VE_BUS,
+    DEVICE_TYPE_DC_ENERGY_METER = VICTRON_RECORD_DC_ENERGY_METER,
+    DEVICE_TYPE_ORION_XS = VICTRON_RECORD_ORION_XS
 };
 
 // --- Device state for Solar Charger ---
@@ -69,54 +79,11 @@ struct victronManufacturerData {
     uint8_t victronEncryptedData[VICTRON_ENCRYPTED_LEN];
 } __attribute__((packed));
 
-struct victronSolarChargerPayload {
-    uint8_t deviceState;
-    uint8_t errorCode;
-    int16_t batteryVoltage;            // 10mV units
-    int16_t batteryCurrent;            // 10mA units (signed)
-    uint16_t yieldToday;               // 10Wh units
-    uint16_t inputPower;               // 1W units
-    uint16_t loadCurrent;              // 10mA units (0xFFFF = no load)
-    uint8_t reserved[2];
-} __attribute__((packed));
-
-struct victronBatteryMonitorPayload {
-    uint16_t remainingMins;
-    uint16_t batteryVoltage;           // 10mV units
-    uint8_t alarms;
-    uint16_t auxData;                  // 10mV (voltage) or 0.01K (temperature)
-    uint8_t currentLow;
-    uint8_t currentMid;
-    uint8_t currentHigh_consumedLow;   // Current bits 16-21 (low 6), consumed bits 0-1 (high 2)
-    uint8_t consumedMid;
-    uint8_t consumedHigh;
-    uint16_t soc;                      // 0.1% units (10-bit)
-    uint8_t reserved[2];
-} __attribute__((packed));
-
-struct victronInverterPayload {
-    uint8_t deviceState;
-    uint8_t errorCode;
-    uint16_t batteryVoltage;           // 10mV units
-    int16_t batteryCurrent;            // 10mA units (signed)
-    uint8_t acPowerLow;
-    uint8_t acPowerMid;
-    uint8_t acPowerHigh;               // Signed 24-bit
-    uint8_t alarms;
-    uint8_t reserved[4];
-} __attribute__((packed));
-
-struct victronDCDCConverterPayload {
-    uint8_t chargeState;
-    uint8_t errorCode;
-    uint16_t inputVoltage;             // 10mV units
-    uint16_t outputVoltage;            // 10mV units
-    uint16_t outputCurrent;            // 10mA units
-    uint8_t reserved[6];
-} __attribute__((packed));
-
 // ============================================================
 // Parsed data structures (flat, no inheritance)
+// ------------------------------------------------------------
+// Fylls från VictronRecord. Fält som saknas i recordtypen eller
+// är NA blir NAN (float) resp. 0xFF/0xFFFF (heltal).
 // ============================================================
 
 struct VictronSolarData {
@@ -125,7 +92,7 @@ struct VictronSolarData {
     float batteryVoltage;      // V
     float batteryCurrent;      // A
     float panelPower;          // W
-    uint16_t yieldToday;       // Wh
+    uint32_t yieldToday;       // Wh
     float loadCurrent;         // A
 };
 
@@ -174,12 +141,29 @@ struct VictronDevice {
     int8_t rssi;
     uint32_t lastUpdate;
     bool dataValid;
+    // Typade vyer för de vanliga familjerna (se deviceType):
+    // solar = SOLAR_CHARGER; battery = BATTERY_MONITOR, SMART_LITHIUM,
+    // LYNX_SMART_BMS, DC_ENERGY_METER; inverter = INVERTER (även
+    // Inverter RS, Multi RS, VE.Bus); dcdc = DCDC_CONVERTER (även Orion XS).
     union {
         VictronSolarData solar;
         VictronBatteryData battery;
         VictronInverterData inverter;
         VictronDCDCData dcdc;
     };
+    // Alla fält i senaste recordet, oavsett typ.
+    uint8_t recordType;
+    VictronRecord record;
+};
+
+// Victron-enhet som hörts men inte finns i enhetslistan (discovery).
+// recordType kommer ur den okrypterade headern.
+struct VictronUnknownDevice {
+    char mac[VICTRON_MAC_LEN];
+    int8_t rssi;
+    uint8_t recordType;
+    uint32_t lastSeenMs;
+    uint32_t count;
 };
 
 // ============================================================
@@ -201,12 +185,33 @@ public:
 
     bool begin(uint32_t scanDuration = 5);
 
+    // Scanintervall/-fönster (enheter om 0,625 ms). Gäller direkt om
+    // stacken är initierad, annars från nästa begin().
+    void setScanTiming(uint16_t interval, uint16_t window);
+
     // Kör en blockande scan en gång. Används av campervanlarmet så BLE
     // inte ligger och går kontinuerligt tillsammans med WiFi/MQTT.
     bool scanOnce(uint32_t scanDurationSeconds);
 
-    // Stoppar scan och stänger BLE-stacken helt.
+    // Asynkron scan: startar och returnerar direkt. Scanningen stoppar
+    // själv efter scanDurationSeconds, eller tidigare via scanStop().
+    bool scanStart(uint32_t scanDurationSeconds);
+    bool scanRunning() const;
+    void scanStop();
+
+    // true när varje konfigurerad enhet har hörts med dekodbar data
+    // sedan scanStart().
+    bool scanAllReported() const;
+
+    // Tid från scanStart() till första paket för enhet idx (ms).
+    // false om enheten inte hörts under scanningen.
+    bool getScanFirstPacketMs(size_t idx, uint32_t &outMs) const;
+    const char* getDeviceName(size_t idx) const;
+
+    // Stoppar scan och stänger BLE-stacken helt. Kan initieras igen
+    // med begin(); callback-objektet återanvänds.
     void end();
+    bool isInitialized() const { return initialized; }
 
     // Lätta scanräknare för sammanfattning efter en blockande scan.
     void resetScanStats();
@@ -216,8 +221,20 @@ public:
     uint32_t getScanParseFailSeen() const;
     uint32_t getScanParseSuccessSeen() const;
 
+    // Dekodtid sedan boot (dekryptering, tolkning och callback), mätt
+    // i BT-tasken.
+    void getDecodeStats(uint32_t &count, uint32_t &avgUs, uint32_t &maxUs) const;
+
     bool addDevice(const char* name, const char* mac, const char* hexKey,
                    VictronDeviceType type = DEVICE_TYPE_UNKNOWN);
+    // Tömmer enhetslistan. Får bara anropas när ingen scan pågår.
+    void clearDevices();
+
+    // Okända Victron-adresser som hörts sedan clearUnknown(). Fylls
+    // passivt av vanliga scans; när listan är full ersätts den äldsta.
+    size_t getUnknownCount() const;
+    bool getUnknown(size_t idx, VictronUnknownDevice& out) const;
+    void clearUnknown();
     void setCallback(VictronCallback cb) { callback = cb; }
     void setDebug(bool enable) { debugEnabled = enable; }
     void setMinInterval(uint32_t ms) { minIntervalMs = ms; }
@@ -229,35 +246,74 @@ private:
 
     struct DeviceEntry {
         VictronDevice device;
+        uint8_t macBin[6];              // MSB först, samma ordning som device.mac
         uint8_t key[16];
+        mbedtls_aes_context aes;        // nyckelschema expanderat i addDevice()
         uint16_t lastNonce;
         bool active;
+        volatile bool scanSeen;         // hörd sedan scanStart()
+        volatile uint32_t scanFirstMs;  // ms efter scanStart()
     };
 
     DeviceEntry devices[VICTRON_MAX_DEVICES];
     size_t deviceCount;
+#if VICTRON_BLE_BACKEND_NIMBLE
+    NimBLEScan* pBLEScan;
+#else
     BLEScan* pBLEScan;
+#endif
     VictronBLEAdvertisedDeviceCallbacks* scanCallbackObj;
     VictronCallback callback;
     bool debugEnabled;
     uint32_t scanDuration;
     uint32_t minIntervalMs;
     bool initialized;
+    uint32_t scanStartMs;
+    uint16_t scanInterval;
+    uint16_t scanWindow;
+
+    void markScanSeen(DeviceEntry* entry, uint32_t nowMs);
+    void noteUnknown(const uint8_t* mac, int rssi, uint8_t recordType, uint32_t nowMs);
+
+    struct UnknownEntry {
+        uint8_t mac[6];
+        int8_t rssi;
+        uint8_t recordType;
+        uint32_t lastSeenMs;
+        uint32_t count;
+    };
+    UnknownEntry unknown[VICTRON_MAX_UNKNOWN];
+    size_t unknownCount;
 
     static bool hexToBytes(const char* hex, uint8_t* out, size_t len);
     static void normalizeMAC(const char* input, char* output);
-    DeviceEntry* findDevice(const char* normalizedMAC);
+    DeviceEntry* findDevice(const uint8_t* mac);
     bool decryptData(const uint8_t* encrypted, size_t len,
-                     const uint8_t* key, const uint8_t* iv, uint8_t* decrypted);
+                     mbedtls_aes_context* aes, const uint8_t* iv, uint8_t* decrypted);
+    // Gemensam väg för båda backends. mfg pekar på manufacturer data
+    // (börjar med vendor-id), mac är 6 byte MSB först. Allokerar inget.
+    void processAdvertisement(const uint8_t* mac, int rssi,
+                              const uint8_t* mfg, size_t mfgLen);
+#if VICTRON_BLE_BACKEND_NIMBLE
+    void processDevice(NimBLEAdvertisedDevice* dev);
+#else
     void processDevice(BLEAdvertisedDevice& dev);
-    bool parseAdvertisement(DeviceEntry* entry, const victronManufacturerData& mfg);
-    bool parseSolarCharger(const uint8_t* data, size_t len, VictronSolarData& result);
-    bool parseBatteryMonitor(const uint8_t* data, size_t len, VictronBatteryData& result);
-    bool parseInverter(const uint8_t* data, size_t len, VictronInverterData& result);
-    bool parseDCDCConverter(const uint8_t* data, size_t len, VictronDCDCData& result);
+#endif
+    bool parseAdvertisement(DeviceEntry* entry, const victronManufacturerData& mfg,
+                            size_t payloadLen);
 };
 
 // BLE scan callback (required by ESP32 BLE API)
+#if VICTRON_BLE_BACKEND_NIMBLE
+// NimBLE skickar en pekare: rå advertising-data läses utan kopior.
+class VictronBLEAdvertisedDeviceCallbacks : public NimBLEAdvertisedDeviceCallbacks {
+public:
+    VictronBLEAdvertisedDeviceCallbacks(VictronBLE* parent) : victronBLE(parent) {}
+    void onResult(NimBLEAdvertisedDevice* advertisedDevice) override;
+private:
+    VictronBLE* victronBLE;
+};
+#else
 class VictronBLEAdvertisedDeviceCallbacks : public BLEAdvertisedDeviceCallbacks {
 public:
     VictronBLEAdvertisedDeviceCallbacks(VictronBLE* parent) : victronBLE(parent) {}
@@ -265,6 +321,7 @@ public:
 private:
     VictronBLE* victronBLE;
 };
+#endif
 
 // ============================================================
 // Commented-out features — kept for reference / future use
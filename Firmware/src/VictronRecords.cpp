@@ -0,0 +1,412 @@
+#include "VictronRecords.h"
+
+// ============================================================
+// Fälttabeller per recordtyp
+// ------------------------------------------------------------
+// fieldU/fieldS: skalat fält, NA = alla ettor (unsigned) resp.
+// största positiva värde (signed), som i Victrons dokument.
+// fieldBits: bitfält/flaggor utan NA.
+// ============================================================
+using F = VictronField;
+
+static constexpr uint32_t naUnsigned(uint8_t width)
+{
+    return width >= 32 ? 0xFFFFFFFFUL : ((1UL << width) - 1UL);
+}
+
+static constexpr uint32_t naSigned(uint8_t width)
+{
+    return (1UL << (width - 1)) - 1UL;
+}
+
+static constexpr VictronFieldSpec fieldU(F field, uint8_t offset, uint8_t width,
+                                         float scale = 1.0f, float add = 0.0f)
+{
+    return VictronFieldSpec{field, offset, width, 0, scale, add, naUnsigned(width)};
+}
+
+static constexpr VictronFieldSpec fieldS(F field, uint8_t offset, uint8_t width,
+                                         float scale = 1.0f)
+{
+    return VictronFieldSpec{field, offset, width, VICTRON_FIELD_SIGNED, scale, 0.0f, naSigned(width)};
+}
+
+static constexpr VictronFieldSpec fieldBits(F field, uint8_t offset, uint8_t width,
+                                            uint8_t flags = 0)
+{
+    return VictronFieldSpec{field, offset, width, (uint8_t)(flags | VICTRON_FIELD_NO_NA), 1.0f, 0.0f, 0};
+}
+
+static constexpr VictronFieldSpec SOLAR_CHARGER[] = {
+    fieldU(F::DEVICE_STATE, 0, 8),
+    fieldU(F::ERROR_CODE, 8, 8),
+    fieldS(F::BATTERY_VOLTAGE, 16, 16, 0.01f),
+    fieldS(F::BATTERY_CURRENT, 32, 16, 0.1f),
+    fieldU(F::YIELD_TODAY, 48, 16, 10.0f),
+    fieldU(F::PV_POWER, 64, 16),
+    fieldU(F::LOAD_CURRENT, 80, 9, 0.1f),
+};
+
+static constexpr VictronFieldSpec BATTERY_MONITOR[] = {
+    fieldU(F::TIME_TO_GO, 0, 16),
+    fieldS(F::BATTERY_VOLTAGE, 16, 16, 0.01f),
+    fieldBits(F::ALARM_REASON, 32, 16),
+    fieldU(F::AUX_VALUE, 48, 16),
+    fieldBits(F::AUX_INPUT, 64, 2),
+    fieldS(F::BATTERY_CURRENT, 66, 22, 0.001f),
+    fieldU(F::CONSUMED_AH, 88, 20, -0.1f),
+    fieldU(F::SOC, 108, 10, 0.1f),
+};
+
+static constexpr VictronFieldSpec INVERTER[] = {
+    fieldU(F::DEVICE_STATE, 0, 8),
+    fieldBits(F::ALARM_REASON, 8, 16),
+    fieldS(F::BATTERY_VOLTAGE, 24, 16, 0.01f),
+    fieldU(F::AC_APPARENT_POWER, 40, 16),
+    fieldU(F::AC_VOLTAGE, 56, 15, 0.01f),
+    fieldU(F::AC_CURRENT, 71, 11, 0.1f),
+};
+
+static constexpr VictronFieldSpec DCDC_CONVERTER[] = {
+    fieldU(F::DEVICE_STATE, 0, 8),
+    fieldU(F::ERROR_CODE, 8, 8),
+    fieldU(F::INPUT_VOLTAGE, 16, 16, 0.01f),
+    fieldS(F::OUTPUT_VOLTAGE, 32, 16, 0.01f),
+    fieldBits(F::OFF_REASON, 48, 32),
+};
+
+static constexpr VictronFieldSpec SMART_LITHIUM[] = {
+    fieldBits(F::BMS_FLAGS, 0, 32),
+    fieldBits(F::ERROR_CODE, 32, 16),
+    fieldU(F::CELL_1, 48, 7, 0.01f, 2.60f),
+    fieldU(F::CELL_2, 55, 7, 0.01f, 2.60f),
+    fieldU(F::CELL_3, 62, 7, 0.01f, 2.60f),
+    fieldU(F::CELL_4, 69, 7, 0.01f, 2.60f),
+    fieldU(F::CELL_5, 76, 7, 0.01f, 2.60f),
+    fieldU(F::CELL_6, 83, 7, 0.01f, 2.60f),
+    fieldU(F::CELL_7, 90, 7, 0.01f, 2.60f),
+    fieldU(F::BATTERY_VOLTAGE, 97, 12, 0.01f),
+    fieldU(F::BALANCER_STATUS, 109, 4),
+    fieldU(F::BATTERY_TEMPERATURE, 113, 7, 1.0f, -40.0f),
+};
+
+static constexpr VictronFieldSpec INVERTER_RS[] = {
+    fieldU(F::DEVICE_STATE, 0, 8),
+    fieldU(F::ERROR_CODE, 8, 8),
+    fieldS(F::BATTERY_VOLTAGE, 16, 16, 0.01f),
+    fieldS(F::BATTERY_CURRENT, 32, 16, 0.1f),
+    fieldU(F::PV_POWER, 48, 16),
+    fieldU(F::YIELD_TODAY, 64, 16, 10.0f),
+    fieldS(F::AC_OUT_POWER, 80, 16),
+};
+
+static constexpr VictronFieldSpec GX_DEVICE[] = {
+    fieldU(F::BATTERY_VOLTAGE, 0, 16, 0.01f),
+    fieldU(F::PV_POWER, 16, 20),
+    fieldU(F::SOC, 36, 7),
+    fieldS(F::BATTERY_POWER, 43, 21),
+    fieldS(F::DC_POWER, 64, 21),
+};
+
+static constexpr VictronFieldSpec AC_CHARGER[] = {
+    fieldU(F::DEVICE_STATE, 0, 8),
+    fieldU(F::ERROR_CODE, 8, 8),
+    fieldU(F::BATTERY_VOLTAGE, 16, 13, 0.01f),
+    fieldU(F::BATTERY_CURRENT, 29, 11, 0.1f),
+    fieldU(F::BATTERY_VOLTAGE_2, 40, 13, 0.01f),
+    fieldU(F::BATTERY_CURRENT_2, 53, 11, 0.1f),
+    fieldU(F::BATTERY_VOLTAGE_3, 64, 13, 0.01f),
+    fieldU(F::BATTERY_CURRENT_3, 77, 11, 0.1f),
+    fieldU(F::BATTERY_TEMPERATURE, 88, 7, 1.0f, -40.0f),
+    fieldU(F::AC_CURRENT, 95, 9, 0.1f),
+};
+
+static constexpr VictronFieldSpec SMART_BATTERY_PROTECT[] = {
+    fieldU(F::DEVICE_STATE, 0, 8),
+    fieldU(F::OUTPUT_STATE, 8, 8),
+    fieldU(F::ERROR_CODE, 16, 8),
+    fieldBits(F::ALARM_REASON, 24, 16),
+    fieldBits(F::WARNING_REASON, 40, 16),
+    fieldS(F::INPUT_VOLTAGE, 56, 16, 0.01f),
+    fieldU(F::OUTPUT_VOLTAGE, 72, 16, 0.01f),
+    fieldBits(F::OFF_REASON, 88, 32),
+};
+
+static constexpr VictronFieldSpec LYNX_SMART_BMS[] = {
+    fieldU(F::ERROR_CODE, 0, 8),
+    fieldU(F::TIME_TO_GO, 8, 16),
+    fieldS(F::BATTERY_VOLTAGE, 24, 16, 0.01f),
+    fieldS(F::BATTERY_CURRENT, 40, 16, 0.1f),
+    fieldBits(F::IO_STATUS, 56, 16),
+    fieldBits(F::WARNING_REASON, 72, 18),
+    fieldU(F::SOC, 90, 10, 0.1f),
+    fieldU(F::CONSUMED_AH, 100, 20, -0.1f),
+    fieldU(F::BATTERY_TEMPERATURE, 120, 7, 1.0f, -40.0f),
+};
+
+static constexpr VictronFieldSpec MULTI_RS[] = {
+    fieldU(F::DEVICE_STATE, 0, 8),
+    fieldU(F::ERROR_CODE, 8, 8),
+    fieldS(F::BATTERY_CURRENT, 16, 16, 0.1f),
+    fieldU(F::BATTERY_VOLTAGE, 32, 14, 0.01f),
+    fieldU(F::AC_IN_ACTIVE, 46, 2),
+    fieldS(F::AC_IN_POWER, 48, 16),
+    fieldS(F::AC_OUT_POWER, 64, 16),
+    fieldU(F::PV_POWER, 80, 16),
+    fieldU(F::YIELD_TODAY, 96, 16, 10.0f),
+};
+
+static constexpr VictronFieldSpec VE_BUS[] = {
+    fieldU(F::DEVICE_STATE, 0, 8),
+    fieldU(F::ERROR_CODE, 8, 8),
+    fieldS(F::BATTERY_CURRENT, 16, 16, 0.1f),
+    fieldU(F::BATTERY_VOLTAGE, 32, 14, 0.01f),
+    fieldU(F::AC_IN_ACTIVE, 46, 2),
+    fieldS(F::AC_IN_POWER, 48, 19),
+    fieldS(F::AC_OUT_POWER, 67, 19),
+    fieldBits(F::VEBUS_ALARM, 86, 2),
+    fieldU(F::BATTERY_TEMPERATURE, 88, 7, 1.0f, -40.0f),
+    fieldU(F::SOC, 95, 7),
+};
+
+static constexpr VictronFieldSpec DC_ENERGY_METER[] = {
+    fieldBits(F::MONITOR_MODE, 0, 16, VICTRON_FIELD_SIGNED),
+    fieldBits(F::ALARM_REASON, 16, 16),
+    fieldS(F::BATTERY_VOLTAGE, 32, 16, 0.01f),
+    fieldU(F::AUX_VALUE, 48, 16),
+    fieldBits(F::AUX_INPUT, 64, 2),
+    fieldS(F::BATTERY_CURRENT, 66, 22, 0.001f),
+};
+
+static constexpr VictronFieldSpec ORION_XS[] = {
+    fieldU(F::DEVICE_STATE, 0, 8),
+    fieldU(F::ERROR_CODE, 8, 8),
+    fieldS(F::OUTPUT_VOLTAGE, 16, 16, 0.01f),
+    fieldS(F::OUTPUT_CURRENT, 32, 16, 0.1f),
+    fieldU(F::INPUT_VOLTAGE, 48, 16, 0.01f),
+    fieldU(F::INPUT_CURRENT, 64, 16, 0.1f),
+    fieldBits(F::OFF_REASON, 80, 32),
+};
+
+// Kompileringskontroll: bredd 1..32, stigande bitoffset utan överlapp
+// och sista fältet inom payloaden.
+static constexpr bool fieldsValid(const VictronFieldSpec *f, size_t n)
+{
+    return n == 0 ||
+           (f[0].bitWidth >= 1 && f[0].bitWidth <= 32 &&
+            f[0].bitOffset + f[0].bitWidth <= VICTRON_RECORD_PAYLOAD_LEN * 8 &&
+            (n == 1 || f[0].bitOffset + f[0].bitWidth <= f[1].bitOffset) &&
+            fieldsValid(f + 1, n - 1));
+}
+
+#define VICTRON_RECORD(type, name, table)                                              \
+    static_assert(fieldsValid(table, sizeof(table) / sizeof(table[0])), #table);       \
+    static_assert(sizeof(table) / sizeof(table[0]) <= VICTRON_RECORD_MAX_FIELDS, #table); \
+    static const VictronRecordSpec SPEC_##table = {type, name, table, (uint8_t)(sizeof(table) / sizeof(table[0]))};
+
+VICTRON_RECORD(VICTRON_RECORD_SOLAR_CHARGER, "solar_charger", SOLAR_CHARGER)
+VICTRON_RECORD(VICTRON_RECORD_BATTERY_MONITOR, "battery_monitor", BATTERY_MONITOR)
+VICTRON_RECORD(VICTRON_RECORD_INVERTER, "inverter", INVERTER)
+VICTRON_RECORD(VICTRON_RECORD_DCDC_CONVERTER, "dcdc_converter", DCDC_CONVERTER)
+VICTRON_RECORD(VICTRON_RECORD_SMART_LITHIUM, "smart_lithium", SMART_LITHIUM)
+VICTRON_RECORD(VICTRON_RECORD_INVERTER_RS, "inverter_rs", INVERTER_RS)
+VICTRON_RECORD(VICTRON_RECORD_GX_DEVICE, "gx_device", GX_DEVICE)
+VICTRON_RECORD(VICTRON_RECORD_AC_CHARGER, "ac_charger", AC_CHARGER)
+VICTRON_RECORD(VICTRON_RECORD_SMART_BATTERY_PROTECT, "smart_battery_protect", SMART_BATTERY_PROTECT)
+VICTRON_RECORD(VICTRON_RECORD_LYNX_SMART_BMS, "lynx_smart_bms", LYNX_SMART_BMS)
+VICTRON_RECORD(VICTRON_RECORD_MULTI_RS, "multi_rs", MULTI_RS)
+VICTRON_RECORD(VICTRON_RECORD_VE_BUS, "ve_bus", VE_BUS)
+VICTRON_RECORD(VICTRON_RECORD_DC_ENERGY_METER, "dc_energy_meter", DC_ENERGY_METER)
+VICTRON_RECORD(VICTRON_RECORD_ORION_XS, "orion_xs", ORION_XS)
+
+#undef VICTRON_RECORD
+
+static const VictronRecordSpec *const RECORDS[] = {
+    &SPEC_SOLAR_CHARGER,
+    &SPEC_BATTERY_MONITOR,
+    &SPEC_INVERTER,
+    &SPEC_DCDC_CONVERTER,
+    &SPEC_SMART_LITHIUM,
+    &SPEC_INVERTER_RS,
+    &SPEC_GX_DEVICE,
+    &SPEC_AC_CHARGER,
+    &SPEC_SMART_BATTERY_PROTECT,
+    &SPEC_LYNX_SMART_BMS,
+    &SPEC_MULTI_RS,
+    &SPEC_VE_BUS,
+    &SPEC_DC_ENERGY_METER,
+    &SPEC_ORION_XS,
+};
+
+const VictronRecordSpec *victronRecordSpec(uint8_t recordType)
+{
+    for (const VictronRecordSpec *spec : RECORDS)
+    {
+        if (spec->recordType == recordType)
+            return spec;
+    }
+    return nullptr;
+}
+
+const char *victronRecordTypeName(uint8_t recordType)
+{
+    const VictronRecordSpec *spec = victronRecordSpec(recordType);
+    return spec ? spec->name : "unknown";
+}
+
+const char *victronFieldName(VictronField field)
+{
+    switch (field)
+    {
+    case VictronField::DEVICE_STATE: return "device_state";
+    case VictronField::ERROR_CODE: return "error_code";
+    case VictronField::ALARM_REASON: return "alarm_reason";
+    case VictronField::WARNING_REASON: return "warning_reason";
+    case VictronField::OFF_REASON: return "off_reason";
+    case VictronField::OUTPUT_STATE: return "output_state";
+    case VictronField::BATTERY_VOLTAGE: return "battery_voltage";
+    case VictronField::BATTERY_CURRENT: return "battery_current";
+    case VictronField::BATTERY_POWER: return "battery_power";
+    case VictronField::BATTERY_TEMPERATURE: return "battery_temperature";
+    case VictronField::BATTERY_VOLTAGE_2: return "battery_voltage_2";
+    case VictronField::BATTERY_CURRENT_2: return "battery_current_2";
+    case VictronField::BATTERY_VOLTAGE_3: return "battery_voltage_3";
+    case VictronField::BATTERY_CURRENT_3: return "battery_current_3";
+    case VictronField::INPUT_VOLTAGE: return "input_voltage";
+    case VictronField::INPUT_CURRENT: return "input_current";
+    case VictronField::OUTPUT_VOLTAGE: return "output_voltage";
+    case VictronField::OUTPUT_CURRENT: return "output_current";
+    case VictronField::AUX_VALUE: return "aux_value";
+    case VictronField::AUX_INPUT: return "aux_input";
+    case VictronField::TIME_TO_GO: return "time_to_go";
+    case VictronField::CONSUMED_AH: return "consumed_ah";
+    case VictronField::SOC: return "soc";
+    case VictronField::PV_POWER: return "pv_power";
+    case VictronField::YIELD_TODAY: return "yield_today";
+    case VictronField::LOAD_CURRENT: return "load_current";
+    case VictronField::DC_POWER: return "dc_power";
+    case VictronField::AC_IN_ACTIVE: return "ac_in_active";
+    case VictronField::AC_IN_POWER: return "ac_in_power";
+    case VictronField::AC_OUT_POWER: return "ac_out_power";
+    case VictronField::AC_VOLTAGE: return "ac_voltage";
+    case VictronField::AC_CURRENT: return "ac_current";
+    case VictronField::AC_APPARENT_POWER: return "ac_apparent_power";
+    case VictronField::MONITOR_MODE: return "monitor_mode";
+    case VictronField::BMS_FLAGS: return "bms_flags";
+    case VictronField::IO_STATUS: return "io_status";
+    case VictronField::BALANCER_STATUS: return "balancer_status";
+    case VictronField::CELL_1: return "cell_1";
+    case VictronField::CELL_2: return "cell_2";
+    case VictronField::CELL_3: return "cell_3";
+    case VictronField::CELL_4: return "cell_4";
+    case VictronField::CELL_5: return "cell_5";
+    case VictronField::CELL_6: return "cell_6";
+    case VictronField::CELL_7: return "cell_7";
+    case VictronField::VEBUS_ALARM: return "vebus_alarm";
+    default: return "unknown";
+    }
+}
+
+// Läs width (1..32) bitar från bitoffset, little-endian bitordning.
+// Anroparen har kontrollerat att fältet ryms i len.
+static uint32_t readBits(const uint8_t *data, uint8_t offset, uint8_t width)
+{
+    const size_t first = offset >> 3;
+    const size_t last = (size_t)(offset + width - 1) >> 3;
+
+    uint64_t acc = 0;
+    for (size_t i = first; i <= last; i++)
+        acc |= (uint64_t)data[i] << (8 * (i - first));
+
+    acc >>= (offset & 7);
+    return (uint32_t)(acc & naUnsigned(width));
+}
+
+size_t victronRecordMinLen(const VictronRecordSpec *spec)
+{
+    if (!spec)
+        return 0;
+
+    uint16_t endBit = 0;
+    for (uint8_t i = 0; i < spec->fieldCount; i++)
+    {
+        const VictronFieldSpec &f = spec->fields[i];
+        if (f.bitOffset + f.bitWidth > endBit)
+            endBit = (uint16_t)(f.bitOffset + f.bitWidth);
+    }
+    return (endBit + 7) / 8;
+}
+
+bool victronRecordDecode(uint8_t recordType, const uint8_t *data, size_t len,
+                         VictronRecord &out)
+{
+    out.spec = victronRecordSpec(recordType);
+    out.presentMask = 0;
+    if (!out.spec)
+        return false;
+
+    // Kort payload: läs aldrig förbi mottagna byte.
+    if (len < victronRecordMinLen(out.spec))
+    {
+        out.spec = nullptr;
+        return false;
+    }
+
+    for (uint8_t i = 0; i < out.spec->fieldCount; i++)
+    {
+        const VictronFieldSpec &f = out.spec->fields[i];
+        out.raw[i] = 0;
+
+        uint32_t v = readBits(data, f.bitOffset, f.bitWidth);
+        if (!(f.flags & VICTRON_FIELD_NO_NA) && v == f.na)
+            continue;
+
+        // Teckenutöka signed fält med bredd < 32.
+        if ((f.flags & VICTRON_FIELD_SIGNED) && f.bitWidth < 32 && (v >> (f.bitWidth - 1)) & 1)
+            v |= ~naUnsigned(f.bitWidth);
+
+        out.raw[i] = (int32_t)v;
+        out.presentMask |= (uint16_t)(1U << i);
+    }
+    return true;
+}
+
+static int findField(const VictronRecord &rec, VictronField field)
+{
+    if (!rec.spec)
+        return -1;
+
+    for (uint8_t i = 0; i < rec.spec->fieldCount; i++)
+    {
+        if (rec.spec->fields[i].field == field)
+            return (rec.presentMask & (1U << i)) ? i : -1;
+    }
+    return -1;
+}
+
+bool victronRecordValue(const VictronRecord &rec, VictronField field, float &out)
+{
+    int i = findField(rec, field);
+    if (i < 0)
+        return false;
+
+    const VictronFieldSpec &f = rec.spec->fields[i];
+    out = (float)rec.raw[i] * f.scale + f.offset;
+    return true;
+}
+
+bool victronRecordRaw(const VictronRecord &rec, VictronField field, int32_t &out)
+{
+    int i = findField(rec, field);
+    if (i < 0)
+        return false;
+
+    out = rec.raw[i];
+    return true;
+}
+
+float victronRecordValueOr(const VictronRecord &rec, VictronField field, float fallback)
+{
+    float v;
+    return victronRecordValue(rec, field, v) ? v : fallback;
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ============================================================
+// Victron "extra manufacturer data" - tabellstyrd dekoder
+// ------------------------------------------------------------
+// Varje recordtyp beskrivs av en constexpr-tabell med fält:
+// bitoffset, bredd, skala, offset, signed och NA-värde, enligt
+// Victrons dokument "Extra manufacturer data" (2022-12-14).
+// Bitarna läses little-endian från början av dekrypterad payload.
+// Tabellerna ligger i VictronRecords.cpp och kontrolleras med
+// static_assert (inga överlapp, ryms i payloaden).
+// ============================================================
+
+// Recordtyper (byte 4 i manufacturer data efter beacon-typ).
+enum VictronRecordType : uint8_t {
+    VICTRON_RECORD_TEST = 0x00,
+    VICTRON_RECORD_SOLAR_CHARGER = 0x01,
+    VICTRON_RECORD_BATTERY_MONITOR = 0x02,
+    VICTRON_RECORD_INVERTER = 0x03,
+    VICTRON_RECORD_DCDC_CONVERTER = 0x04,
+    VICTRON_RECORD_SMART_LITHIUM = 0x05,
+    VICTRON_RECORD_INVERTER_RS = 0x06,
+    VICTRON_RECORD_GX_DEVICE = 0x07,
+    VICTRON_RECORD_AC_CHARGER = 0x08,
+    VICTRON_RECORD_SMART_BATTERY_PROTECT = 0x09,
+    VICTRON_RECORD_LYNX_SMART_BMS = 0x0A,
+    VICTRON_RECORD_MULTI_RS = 0x0B,
+    VICTRON_RECORD_VE_BUS = 0x0C,
+    VICTRON_RECORD_DC_ENERGY_METER = 0x0D,
+    VICTRON_RECORD_ORION_XS = 0x0F
+};
+
+// Semantiska fält. Samma fält kan finnas i flera recordtyper med
+// olika bitlayout/skala; värdet är alltid i enheten som anges här.
+enum class VictronField : uint8_t {
+    DEVICE_STATE,        // enum
+    ERROR_CODE,          // enum
+    ALARM_REASON,        // bitfält
+    WARNING_REASON,      // bitfält
+    OFF_REASON,          // bitfält
+    OUTPUT_STATE,        // enum
+    BATTERY_VOLTAGE,     // V
+    BATTERY_CURRENT,     // A
+    BATTERY_POWER,       // W
+    BATTERY_TEMPERATURE, // °C
+    BATTERY_VOLTAGE_2,   // V (AC-laddare utgång 2)
+    BATTERY_CURRENT_2,   // A
+    BATTERY_VOLTAGE_3,   // V (AC-laddare utgång 3)
+    BATTERY_CURRENT_3,   // A
+    INPUT_VOLTAGE,       // V
+    INPUT_CURRENT,       // A
+    OUTPUT_VOLTAGE,      // V
+    OUTPUT_CURRENT,      // A
+    AUX_VALUE,           // rått 0,01-steg, tolkas enligt AUX_INPUT
+    AUX_INPUT,           // 0 start-V, 1 mitt-V, 2 temperatur, 3 ingen
+    TIME_TO_GO,          // min
+    CONSUMED_AH,         // Ah (negativt)
+    SOC,                 // %
+    PV_POWER,            // W
+    YIELD_TODAY,         // Wh
+    LOAD_CURRENT,        // A
+    DC_POWER,            // W
+    AC_IN_ACTIVE,        // 0..2 aktiv AC-ingång, 3 = ingen
+    AC_IN_POWER,         // W
+    AC_OUT_POWER,        // W
+    AC_VOLTAGE,          // V
+    AC_CURRENT,          // A
+    AC_APPARENT_POWER,   // VA
+    MONITOR_MODE,        // enum (DC energy meter)
+    BMS_FLAGS,           // bitfält
+    IO_STATUS,           // bitfält
+    BALANCER_STATUS,     // enum
+    CELL_1,              // V
+    CELL_2,
+    CELL_3,
+    CELL_4,
+    CELL_5,
+    CELL_6,
+    CELL_7,
+    VEBUS_ALARM,         // 0 ok, 1 varning, 2 larm
+    COUNT
+};
+
+// Fältbeskrivning. na = rått värde som betyder "ej tillgängligt".
+static constexpr uint8_t VICTRON_FIELD_SIGNED = 0x01;
+static constexpr uint8_t VICTRON_FIELD_NO_NA = 0x02;
+
+struct VictronFieldSpec {
+    VictronField field;
+    uint8_t bitOffset;
+    uint8_t bitWidth;
+    uint8_t flags;
+    float scale;
+    float offset;
+    uint32_t na;
+};
+
+struct VictronRecordSpec {
+    uint8_t recordType;
+    const char* name;
+    const VictronFieldSpec* fields;
+    uint8_t fieldCount;
+};
+
+static constexpr int VICTRON_RECORD_MAX_FIELDS = 12;
+// Dekrypterad payload efter 8 byte header.
+static constexpr int VICTRON_RECORD_PAYLOAD_LEN = 21;
+
+// Avkodat record: råvärden (teckenutökade) i tabellens fältordning.
+// Skalning görs först vid läsning, så bitfält behåller full precision.
+struct VictronRecord {
+    const VictronRecordSpec* spec;  // nullptr = inget avkodat
+    uint16_t presentMask;           // bit i = raw[i] giltigt (ej NA)
+    int32_t raw[VICTRON_RECORD_MAX_FIELDS];
+};
+
+// Tabell för recordtyp, nullptr om okänd.
+const VictronRecordSpec* victronRecordSpec(uint8_t recordType);
+const char* victronRecordTypeName(uint8_t recordType);
+
+// Kort namn (snake_case) för fältet, används som JSON-nyckel.
+const char* victronFieldName(VictronField field);
+
+// Antal payloadbyte som tabellens fält kräver.
+size_t victronRecordMinLen(const VictronRecordSpec* spec);
+
+// Avkodar dekrypterad payload enligt tabellen. false = okänd
+// recordtyp eller len kortare än victronRecordMinLen().
+bool victronRecordDecode(uint8_t recordType, const uint8_t* data, size_t len,
+                         VictronRecord& out);
+
+// Skalat värde för fältet. false = fältet saknas i recordtypen eller NA.
+bool victronRecordValue(const VictronRecord& rec, VictronField field, float& out);
+
+// Råvärde för bitfält/enum. false = saknas eller NA.
+bool victronRecordRaw(const VictronRecord& rec, VictronField field, int32_t& out);
+
+// Skalat värde eller fallback (t.ex. NAN) om fältet saknas.
+float victronRecordValueOr(const VictronRecord& rec, VictronField field, float fallback);
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+
+// ============================================================
+// Civil time (gregoriansk kalender <-> dagar sedan 1970-01-01)
+// ------------------------------------------------------------
+// Ren heltalsaritmetik enligt H. Hinnants days_from_civil /
+// civil_from_days. Ingen mktime, TZ-miljö eller heap, så den kan
+// användas från vilken task som helst.
+// ============================================================
+
+struct CivilDate
+{
+  int16_t year;
+  uint8_t month; // 1..12
+  uint8_t day;   // 1..31
+};
+
+// Dagar sedan 1970-01-01 för givet datum.
+constexpr int32_t civilDaysFromDate(int y, int m, int d)
+{
+  return (y - (m <= 2 ? 1 : 0)) / 400 * 146097 +
+         ((y - (m <= 2 ? 1 : 0)) % 400) * 365 +
+         ((y - (m <= 2 ? 1 : 0)) % 400) / 4 -
+         ((y - (m <= 2 ? 1 : 0)) % 400) / 100 +
+         (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1 -
+         719468;
+}
+
+// Datum för dagar sedan 1970-01-01 (giltigt för år >= 0).
+inline CivilDate civilDateFromDays(int32_t z)
+{
+  z += 719468;
+  int32_t era = z / 146097;
+  uint32_t doe = (uint32_t)(z - era * 146097);
+  uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  int32_t y = (int32_t)yoe + era * 400;
+  uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  uint32_t mp = (5 * doy + 2) / 153;
+  uint32_t d = doy - (153 * mp + 2) / 5 + 1;
+  uint32_t m = mp < 10 ? mp + 3 : mp - 9;
+
+  CivilDate out{};
+  out.year = (int16_t)(y + (m <= 2 ? 1 : 0));
+  out.month = (uint8_t)m;
+  out.day = (uint8_t)d;
+  return out;
+}
+
+// Veckodag för dagar sedan 1970-01-01, 0 = söndag.
+constexpr uint8_t civilWeekday(int32_t days)
+{
+  return (uint8_t)((days + 4) % 7);
+}
+
+// Datum + klockslag i UTC -> Unix epoch.
+constexpr uint32_t civilToEpochUtc(int y, int m, int d, int hh, int mm, int ss)
+{
+  return (uint32_t)civilDaysFromDate(y, m, d) * 86400UL + (uint32_t)(hh * 3600 + mm * 60 + ss);
+}
+
+static_assert(civilToEpochUtc(2024, 1, 1, 0, 0, 0) == 1704067200UL, "civil time");
+static_assert(civilToEpochUtc(2024, 2, 29, 12, 0, 0) == 1709208000UL, "civil time");
\ No newline at end of file
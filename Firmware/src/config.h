@@ -24,6 +24,17 @@ static const int PIN_GNSS_RX = 18; // ESP32 RX, GNSS TX hit
 static const int PIN_GNSS_TX = 17; // ESP32 TX, GNSS RX hit
 static const uint32_t GNSS_BAUD = 38400;
 
+// 1 = konfigurera mottagaren för binär UBX-NAV-PVT (u-blox M8/M9/M10).
+// NMEA behålls som fallback om mottagaren inte svarar med NAV-PVT.
+#ifndef EXTERNAL_GNSS_UBX
+#define EXTERNAL_GNSS_UBX 1
+#endif
+
+constexpr uint16_t GNSS_NAV_RATE_MS = 1000;         // 1 Hz
+constexpr uint32_t GNSS_UBX_FALLBACK_MS = 5000UL;   // ingen NAV-PVT så länge -> NMEA
+constexpr uint32_t GNSS_STATS_LOG_INTERVAL_MS = 60000UL;
+constexpr uint32_t GNSS_WAKE_SETTLE_MS = 500UL;
+
 // ---------------- PIR (campervan) ---------------------------
 static const int PIN_PIR_FRONT = 9;
 static const int PIN_PIR_BACK = 10;
@@ -41,6 +52,17 @@ static const char SIM_PIN[] = "";
 static const uint32_t NET_REG_TIMEOUT_MS = 120000UL;
 static const uint32_t DATA_ATTACH_TIMEOUT_MS = 60000UL;
 
+// ---------------- Cellinfo (AT+CPSI?) -----------------------
+// Serving-cell läses periodiskt medan SIM-länken är uppe och cachas.
+// Cachen används av recovery och AUTO-länkval för att undvika attach-
+// försök som ändå kommer att timea ut.
+constexpr uint32_t CELL_INFO_POLL_INTERVAL_MS = 60000UL;  // 1 min
+constexpr uint32_t CELL_INFO_MAX_AGE_MS = 15UL * 60UL * 1000UL; // 15 min
+constexpr int CELL_RSRP_POOR_DBM = -115;
+constexpr int CELL_RSRP_GOOD_DBM = -100;
+constexpr int CELL_SINR_POOR_DB = -3;
+constexpr int CELL_SINR_GOOD_DB = 3;
+
 // ============================================================
 // Secrets (MQTT host/user/pass, WiFi SSID/lösen m.m.) – ligger INTE i git
 // ============================================================
@@ -86,6 +108,50 @@ static const char MQTT_TOPIC_VERSION[] = "van/ellie/tele/version";
 #define VICTRON_BLE_ENABLED 1
 #endif
 
+// 1 = BLE-stacken initieras en gång och ligger vilande mellan scans.
+// 0 = init/deinit runt varje scan (frigör ~BLE-heap mellan scans).
+#ifndef VICTRON_BLE_PERSISTENT
+#define VICTRON_BLE_PERSISTENT 1
+#endif
+
+// 1 = NimBLE-stacken (bara observer-roll, passiv scan, rå payload i
+// callbacken). 0 = Arduino Bluedroid, kvar för jämförelse.
+// Byt även lib_deps/build_flags i platformio.ini vid 0.
+#ifndef VICTRON_BLE_BACKEND_NIMBLE
+#define VICTRON_BLE_BACKEND_NIMBLE 1
+#endif
+
+// Scanintervall/-fönster i enheter om 0,625 ms. 160/40 = 100 ms/25 ms,
+// dvs 25 % duty. Schemalagd scan (PARKED) resp. bakgrundsscan i
+// profiler med victronBleBackground (TRAVEL), där WiFi/MQTT är uppe
+// samtidigt och delar radion via ESP32-coexistence.
+#ifndef VICTRON_BLE_SCAN_INTERVAL
+#define VICTRON_BLE_SCAN_INTERVAL 160
+#endif
+#ifndef VICTRON_BLE_SCAN_WINDOW
+#define VICTRON_BLE_SCAN_WINDOW 40
+#endif
+#ifndef VICTRON_BLE_BG_SCAN_INTERVAL
+#define VICTRON_BLE_BG_SCAN_INTERVAL 160
+#endif
+#ifndef VICTRON_BLE_BG_SCAN_WINDOW
+#define VICTRON_BLE_BG_SCAN_WINDOW 40
+#endif
+
+// Bakgrundsscan körs i bitar om så här många sekunder och startas om
+// direkt, så resultat/räknare inte växer obegränsat.
+#ifndef VICTRON_BLE_BG_CHUNK_SECONDS
+#define VICTRON_BLE_BG_CHUNK_SECONDS 30
+#endif
+
+// 1 = prioritera WiFi i coexistence medan bakgrundsscan pågår.
+#ifndef VICTRON_BLE_BG_COEX_PREFER_WIFI
+#define VICTRON_BLE_BG_COEX_PREFER_WIFI 1
+#endif
+
+// Väntetid innan bakgrundsscan försöks igen efter misslyckad start.
+constexpr uint32_t VICTRON_BLE_BG_RETRY_MS = 60000UL;
+
 // ============================================================
 // Victron BLE diagnostik
 // ------------------------------------------------------------
@@ -105,8 +171,89 @@ static const char MQTT_TOPIC_VERSION[] = "van/ellie/tele/version";
 #endif
 
 static const char MQTT_TOPIC_VICTRON_STATE[] = "campervan/victron/state";
+
+// HA publicerar registerändring (add/remove/rekey) här med retain=true.
+// Device kvitterar på ACK-topicen; HA bör vänta på ACK innan nästa
+// ändring eftersom retain bara levererar den senaste.
+static const char MQTT_TOPIC_VICTRON_DEVICES_DESIRED[] = "van/ellie/state/victron_devices";
+static const char MQTT_TOPIC_ACK_VICTRON_DEVICES[] = "van/ellie/ack/victron_devices";
 constexpr uint32_t VICTRON_FRESH_TIMEOUT_MS = 20UL * 60UL * 1000UL;
 
+// Victron-aggregat (min/max/medel/senaste + Ah/Wh) per hink mellan
+// publiceringar. Stängda hinkar ligger i en ringbuffert i PSRAM tills
+// de laddats upp, så historiken klarar missade publiceringar.
+static const char MQTT_TOPIC_VICTRON_AGG[] = "campervan/victron/agg";
+constexpr uint32_t VICTRON_AGG_BUCKET_MIN_MS = 10UL * 60UL * 1000UL; // stäng inte kortare hinkar vid publish
+constexpr uint32_t VICTRON_AGG_BUCKET_MAX_MS = 60UL * 60UL * 1000UL; // stäng alltid efter 1 h
+constexpr uint32_t VICTRON_AGG_MAX_GAP_MS = 20UL * 60UL * 1000UL;    // längre lucka integreras inte
+constexpr uint32_t VICTRON_AGG_BUCKETS_PSRAM = 512;                  // ~60 kB, >3 dygn med 10-min hinkar
+constexpr uint32_t VICTRON_AGG_BUCKETS_HEAP = 24;                    // fallback utan PSRAM
+constexpr uint16_t VICTRON_AGG_BATCH_MAX_BUCKETS = 12;               // ~240 B/hink + kuvert ~3,3 kB < MQTT-bufferten (4096 B)
+
+// ============================================================
+// Batterianpassad schemaläggning
+// ------------------------------------------------------------
+// Profilernas commIntervalMs, victronBleIntervalMs och GNSS-väckningar
+// sträcks ut med en faktor när husbatteriet (SmartShunt SoC, annars
+// spänning) eller PMU-batteriet sjunker. Största faktorn vinner.
+// Kurvor: {nivå, faktor} med fallande nivå, linjärt mellan punkterna,
+// faktor 1 över första och sista faktorn under sista punkten.
+//
+// Profiler med PIR (ARMED/TRIGGERED/ALARM) behåller commIntervalMs
+// och GNSS så larmets heartbeat är oförändrat. PIR-händelser går
+// alltid direkt oavsett faktor.
+// ============================================================
+#ifndef POWER_SCHED_ENABLED
+#define POWER_SCHED_ENABLED 1
+#endif
+
+struct PowerSchedPoint
+{
+  float level;
+  float factor;
+};
+
+// Husbatteriets SoC (%) från SmartShunt.
+static const PowerSchedPoint POWER_SCHED_SOC_CURVE[] = {
+    {50.0f, 1.0f}, {30.0f, 2.0f}, {20.0f, 4.0f}, {10.0f, 8.0f}};
+// Husbatteriets spänning (V) när SoC saknas. 12 V LiFePO4.
+static const PowerSchedPoint POWER_SCHED_VOLT_CURVE[] = {
+    {13.1f, 1.0f}, {13.0f, 2.0f}, {12.9f, 4.0f}, {12.6f, 8.0f}};
+// Kortets eget batteri (%) enligt AXP2101, t.ex. när husbatteriet kopplats från.
+static const PowerSchedPoint POWER_SCHED_PMU_CURVE[] = {
+    {40.0f, 1.0f}, {20.0f, 2.0f}, {10.0f, 4.0f}};
+
+constexpr uint32_t POWER_SCHED_EVAL_MS = 60UL * 1000UL;
+constexpr uint32_t POWER_SCHED_COMM_MAX_MS = 2UL * 60UL * 60UL * 1000UL;    // heartbeat minst var 2:a h
+// Victron-taket måste ligga under VICTRON_AGG_MAX_GAP_MS, annars slutar
+// aggregatet integrera Ah/Wh just när batteriet är lågt.
+constexpr uint32_t POWER_SCHED_VICTRON_MAX_MS = 15UL * 60UL * 1000UL;
+static_assert(POWER_SCHED_VICTRON_MAX_MS < VICTRON_AGG_MAX_GAP_MS,
+              "utsträckt Victron-intervall måste rymmas i aggregatets lucka");
+constexpr uint32_t POWER_SCHED_VICTRON_FRESH_MARGIN_MS = 5UL * 60UL * 1000UL; // scantid + jitter
+constexpr float POWER_SCHED_GNSS_SPARSE_FACTOR = 4.0f;                      // från denna faktor glesas GNSS ut
+constexpr uint32_t POWER_SCHED_GNSS_SPARSE_MS = 6UL * 60UL * 60UL * 1000UL; // då fix högst var 6:e h
+
+// Prognos för återstående drifttid: SoC ned till reserven med
+// medelströmmen (EWMA med tidskonstant POWER_SCHED_CURRENT_TAU_MS).
+constexpr float HOUSE_BATTERY_CAPACITY_AH = 200.0f;
+constexpr float POWER_SCHED_RESERVE_SOC = 10.0f;
+constexpr uint32_t POWER_SCHED_CURRENT_TAU_MS = 6UL * 60UL * 60UL * 1000UL;
+
+// ============================================================
+// PMU-telemetri (AXP2101)
+// ------------------------------------------------------------
+// Batteri, VBUS, VSYS, laddtillstånd och chiptemperatur samplas
+// periodiskt. Trender (per timme) räknas med minsta kvadrat över
+// de senaste PMU_TREND_SAMPLES samplen. Bortfall av VBUS loggas
+// som varning: strömavbrott eller sabotage av matningen.
+// ============================================================
+constexpr uint32_t PMU_SAMPLE_MS = 30UL * 1000UL;
+constexpr uint8_t PMU_TREND_SAMPLES = 20;                       // 10 min vid 30 s
+constexpr uint32_t PMU_TREND_MIN_SPAN_MS = 5UL * 60UL * 1000UL; // kortare fönster ger ingen trend
+constexpr uint32_t PMU_SAMPLE_STALE_MS = 5UL * 60UL * 1000UL;   // äldre sample räknas inte
+constexpr uint16_t PMU_VSYS_LOW_MV = 3300;                      // under detta riskerar modemet brownout
+
 // -------- Network mode / robust uppkoppling -----------------
 // HA publicerar önskat nätläge här med retain=true.
 static const char MQTT_TOPIC_NET_MODE_DESIRED[] = "van/ellie/state/net_mode_desired";
@@ -123,6 +270,9 @@ static const char MQTT_TOPIC_DESIRED_PROFILE[] = "van/ellie/state/desired_profil
 
 #define MQTT_TOPIC_HEALTH "van/ellie/tele/health"
 
+// Journalutdrag efter onormal reset (komprimerade bitar), retain=false.
+static const char MQTT_TOPIC_LOG[] = "van/ellie/tele/log";
+
 // -------- Legacy / framtida kommandotopic -------------------
 // Behålls för migration och ev. framtida engångskommandon.
 // Den ska normalt vara retain=false.
@@ -163,6 +313,58 @@ constexpr uint32_t MQTT_BOOT_PROFILE_SYNC_WINDOW_MS = 4000UL; // 4 s
 constexpr uint32_t GPS_HOT_MAX_AGE_MS = 2UL * 60UL * 60UL * 1000UL;   // 2 h
 constexpr uint32_t GPS_WARM_MAX_AGE_MS = 24UL * 60UL * 60UL * 1000UL; // 24 h
 
+// ============================================================
+// Tid från GNSS
+// ------------------------------------------------------------
+// Med giltig fix sätts systemtiden från RMC/NAV-PVT och kontrolleras
+// var TIME_GNSS_CHECK_INTERVAL_MS. Klockan justeras bara om den drivit
+// mer än TIME_GNSS_MAX_DRIFT_MS. Så länge GNSS-tiden är färsk hoppar
+// nätuppkopplingen över NTP/CCLK.
+//
+// Fixens tid räknas från första byten i epokens utskrift (ext_gnss).
+// Kvar i felbudgeten är främst mottagarens beräkningstid före
+// utskriften (tiotals ms), klart under gränsen på 250 ms.
+// ============================================================
+constexpr uint32_t TIME_GNSS_CHECK_INTERVAL_MS = 10000UL;
+constexpr uint32_t TIME_GNSS_MAX_DRIFT_MS = 250UL;
+constexpr uint32_t TIME_GNSS_MAX_FIX_AGE_MS = 2000UL;
+constexpr uint32_t TIME_GNSS_FRESH_MS = 60UL * 60UL * 1000UL; // 1 h
+
+// ============================================================
+// Tidssynk via nät (NTP/CCLK)
+// ------------------------------------------------------------
+// Synk görs bara när uppskattat fel sedan senaste synk (tid sedan
+// synk × drift) kan ha passerat TIME_SYNC_MAX_ERROR_MS, eller minst
+// en gång per TIME_SYNC_MAX_INTERVAL_MS. Driften mäts mellan två
+// NTP/GNSS-synkar; innan dess används TIME_RTC_DRIFT_PPM_DEFAULT.
+// ============================================================
+constexpr uint32_t TIME_SYNC_MAX_ERROR_MS = 1000UL;
+constexpr uint32_t TIME_SYNC_MAX_INTERVAL_MS = 24UL * 60UL * 60UL * 1000UL; // 24 h
+constexpr float TIME_RTC_DRIFT_PPM_DEFAULT = 50.0f;
+constexpr uint32_t TIME_NTP_PENDING_MAX_MS = 30000UL; // SNTP stoppas och ny start tillåts efter detta
+
+// ============================================================
+// GNSS power management
+// ------------------------------------------------------------
+// I profiler utan keepConnected läggs mottagaren i backup mellan
+// kommunikationsfönstren och väcks i förväg med en ledtid som
+// bygger på förväntad TTFF för hot/warm/cold start.
+// ============================================================
+#ifndef GNSS_POWER_MGMT_ENABLED
+#define GNSS_POWER_MGMT_ENABLED 1
+#endif
+
+// Startvärden för TTFF innan egna mätningar finns.
+constexpr uint32_t GNSS_TTFF_DEFAULT_HOT_MS = 5000UL;
+constexpr uint32_t GNSS_TTFF_DEFAULT_WARM_MS = 30000UL;
+constexpr uint32_t GNSS_TTFF_DEFAULT_COLD_MS = 60000UL;
+
+// Extra marginal ovanpå förväntad TTFF vid väckning.
+constexpr uint32_t GNSS_WAKE_MARGIN_MS = 5000UL;
+
+// Ge upp och gå till standby om ingen fix kommit på så här lång tid.
+constexpr uint32_t GNSS_MAX_ON_MS = 3UL * 60UL * 1000UL; // 3 min
+
 // ============================================================
 // GPS filter / quality gates (anti "62,15"-spökposition)
 // ============================================================
@@ -181,4 +383,78 @@ constexpr double GPS_PLACEHOLDER_LON = 15.0;
 constexpr double GPS_PLACEHOLDER_LAT_TOL = 0.05;
 constexpr double GPS_PLACEHOLDER_LON_TOL = 0.05;
 constexpr uint32_t GPS_DEV_MAX_WAIT_MS = 8000UL; // 8 s
-constexpr bool GPS_DEV_CAP_WAIT = true;
\ No newline at end of file
+constexpr bool GPS_DEV_CAP_WAIT = true;
+
+// Filtrerad fix äldre än så här räknas inte som giltig, och filtret
+// kräver ny stabil bekräftelse efter så här lång tid utan godkänd fix.
+constexpr uint32_t GPS_FILTER_MAX_AGE_MS = 30000UL;
+// Kalman-utjämning: accelerationsbrus (m/s²) och UERE (m per HDOP-enhet).
+constexpr float GPS_KF_ACCEL_STD = 2.0f;
+constexpr float GPS_KF_UERE_M = 4.0f;
+// Så här många hopp i rad efter bekräftelse -> börja om bekräftelsen.
+constexpr uint8_t GPS_JUMP_RESET_COUNT = 3;
+
+// ============================================================
+// GPS track (spårinspelning i PSRAM, batch-uppladdning)
+// ------------------------------------------------------------
+// Filtrerade fixar samplas i TRACK_SAMPLE_INTERVAL_MS och förenklas
+// direkt (opening window): en punkt sparas först när en rak linje
+// från föregående sparade punkt inte längre beskriver mellanliggande
+// prover inom TRACK_SIMPLIFY_TOL_M. Sparade punkter ligger kvar i
+// ringbufferten tills de laddats upp, även över täckningsluckor.
+// ============================================================
+constexpr uint32_t TRACK_SAMPLE_INTERVAL_MS = 1000UL;   // 1 Hz
+constexpr float TRACK_SIMPLIFY_TOL_M = 10.0f;
+constexpr uint32_t TRACK_MAX_POINT_GAP_MS = 120000UL;  // spara minst en punkt var 2:e min
+constexpr uint16_t TRACK_WINDOW_POINTS = 64;           // prover i öppet fönster
+constexpr uint32_t TRACK_BUFFER_POINTS_PSRAM = 16384;  // 256 kB i PSRAM
+constexpr uint32_t TRACK_BUFFER_POINTS_HEAP = 512;     // fallback utan PSRAM
+constexpr uint16_t TRACK_BATCH_MAX_POINTS = 60;        // ~24 B/punkt: ~1,5 kB, väl inom MQTT-bufferten (4096 B)
+constexpr uint32_t TRACK_BATCH_INTERVAL_MS = 5UL * 60UL * 1000UL; // KR-022: var 5 min
+
+// ============================================================
+// Loggning
+// ------------------------------------------------------------
+// Loggposter läggs binärt i en ringbuffert (PSRAM) och formateras
+// och skrivs ut av en lågprioriterad task. Full buffert -> nya
+// poster tappas och räknas, anroparen blockeras aldrig.
+// ============================================================
+constexpr uint32_t LOG_RING_BYTES_PSRAM = 64UL * 1024UL;
+constexpr uint32_t LOG_RING_BYTES_HEAP = 8UL * 1024UL;
+constexpr uint16_t LOG_TEXT_MAX = 512;     // färdig text (logSystem), trunkeras
+constexpr uint16_t LOG_ARGS_MAX = 192;     // binära argument (logSystemf)
+constexpr uint16_t LOG_STR_ARG_MAX = 96;   // per %s-argument
+constexpr uint32_t LOG_TASK_STACK = 4096;
+constexpr uint32_t LOG_TASK_IDLE_MS = 20;
+// Loggnivåer: 1=ERROR 2=WARN 3=INFO 4=DEBUG 5=VERBOSE (se logging.h).
+// Nivåer över LOG_COMPILE_LEVEL kompileras bort helt. Verbose-bygge:
+//   build_flags = -DLOG_COMPILE_LEVEL=5
+// LOG_DEFAULT_LEVEL är nivån per modul vid boot; kan ändras via
+// van/ellie/cmd/downlink ({"log_level":"DEBUG","log_module":"MQTT"}).
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL 3
+#endif
+#ifndef LOG_DEFAULT_LEVEL
+#define LOG_DEFAULT_LEVEL LOG_COMPILE_LEVEL
+#endif
+
+// ============================================================
+// Loggjournal i flash + crash-brödsmulor
+// ------------------------------------------------------------
+// Poster på LOG_JOURNAL_LEVEL eller allvarligare skrivs till två
+// roterande filer i LittleFS (spiffs-partitionen, wear-levelling
+// sköts av LittleFS). Senaste pipeline-steg, modem-state och
+// recovery-orsak hålls i RTC-minne som överlever WDT/panic/brownout.
+// Efter en onormal reset laddas ett utdrag upp komprimerat i
+// bitar på MQTT_TOPIC_LOG.
+// ============================================================
+#define LOG_JOURNAL_LEVEL 2                                  // WARN och ERROR
+constexpr uint32_t JOURNAL_SEGMENT_BYTES = 16UL * 1024UL;    // två segment = 32 kB
+constexpr uint16_t JOURNAL_STAGE_BYTES = 1024;               // RAM-buffert före flash
+constexpr uint32_t JOURNAL_FLUSH_INTERVAL_MS = 30000UL;      // ERROR skrivs direkt
+constexpr uint32_t JOURNAL_UPLOAD_MAX_BYTES = 8UL * 1024UL;  // utdrag efter reboot
+// Okomprimerat per bit. Värsta fall efter LZSS 865 B, som base64 ~1,2 kB:
+// ryms med kuvert i MQTT-bufferten (4096 B). Storleken begränsas i
+// praktiken av LZSS-tabellerna i RAM (2 B per byte i biten).
+constexpr uint16_t JOURNAL_UPLOAD_CHUNK_BYTES = 768;
+constexpr uint8_t JOURNAL_UPLOAD_CHUNKS_PER_CYCLE = 4;
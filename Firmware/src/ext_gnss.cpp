@@ -1,8 +1,13 @@
 #include "ext_gnss.h"
+#include "civil_time.h"
+#include "config.h"
+#include "logging.h"
 #include <Arduino.h>
 #include <string.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <atomic>
+#include <driver/uart.h>
 
 // ============================================================
 // Extern GNSS via UART
@@ -21,42 +26,210 @@
 // - NMEA-checksum valideras innan mening används
 // - enkel plausibility-check för lat/lon
 // - lite robustare radslutshantering
+//
+// UBX-läge (EXTERNAL_GNSS_UBX):
+// - mottagaren konfigureras vid start för UBX-NAV-PVT (1 ram per epok,
+//   ~100 byte) och onödiga NMEA-meningar (GSV/GLL/VTG) stängs av
+// - så fort en giltig NAV-PVT tas emot stängs även RMC/GGA/GSA av
+// - uteblir NAV-PVT slås NMEA på igen och parsern faller tillbaka
+// - UBX och NMEA kan komma blandat på samma UART: UBX-ramar börjar
+//   alltid med 0xB5 0x62 som aldrig förekommer i NMEA-text
 // ============================================================
 
-static HardwareSerial GNSS(2);
+static const uart_port_t GNSS_UART = UART_NUM_2;
+
+// UART-driverns ringbuffert rymmer flera sekunders NMEA vid 38400 baud,
+// så inget förloras även om tasken skulle svältas en stund.
+static const int GNSS_UART_RX_BUF = 8192;
+static const int GNSS_UART_EVENT_QUEUE = 16;
+
+static const uint32_t GNSS_TASK_STACK = 4096;
+static const UBaseType_t GNSS_TASK_PRIORITY = 3;
+static const BaseType_t GNSS_TASK_CORE = 1;
+
+// Tasken vaknar minst så här ofta för fallback-kontroll och statistik.
+static const uint32_t GNSS_TASK_IDLE_MS = 200;
+
+// Tyst UART längre än så här = nästa byte börjar en ny epoks utskrift.
+// Vid 1 Hz och 38400 baud tar en epok några hundra ms, resten är tyst.
+static const uint32_t GNSS_EPOCH_GAP_MS = 100;
+
+static QueueHandle_t g_uartQueue = nullptr;
+static TaskHandle_t g_task = nullptr;
+static volatile bool g_taskStop = false;
+static std::atomic<bool> g_clearRequested(false);
+
+// Strömsparläge. Begärs från huvudloopen, utförs i GNSS-tasken.
+static std::atomic<bool> g_standbyRequested(false);
+static std::atomic<bool> g_wakeRequested(false);
+static volatile bool g_standby = false;
+
+// ------------------------------------------------------------
+// Lock-free "senaste värde"-slot (seqlock)
+// ------------------------------------------------------------
+// En skrivare (GNSS-tasken), godtyckligt många läsare. Skrivaren gör
+// sekvensnumret udda under skrivning; läsaren försöker igen om det var
+// udda eller ändrades under kopieringen.
+// ------------------------------------------------------------
+template <typename T>
+struct LatestSlot
+{
+    std::atomic<uint32_t> seq{0};
+    T value;
+
+    void publish(const T &v)
+    {
+        seq.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        value = v;
+        std::atomic_thread_fence(std::memory_order_release);
+        seq.fetch_add(1, std::memory_order_relaxed);
+    }
 
-// Senaste kända fix
+    void read(T &out) const
+    {
+        for (;;)
+        {
+            uint32_t s1 = seq.load(std::memory_order_acquire);
+            if (s1 & 1u)
+                continue;
+
+            out = value;
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            if (seq.load(std::memory_order_relaxed) == s1)
+                return;
+        }
+    }
+};
+
+// Senaste kända fix (parserns arbetskopia, ägs av GNSS-tasken)
 static ExtGnssFix g_last;
 
+// Publicerad fix för pipeline
+static LatestSlot<ExtGnssFix> g_slot;
+
+static void publishLatest()
+{
+    g_slot.publish(g_last);
+}
+
 // Flaggar om vi fått användbara meningar
 static bool g_haveRmc = false;
 static bool g_haveGga = false;
 static bool g_haveGsa = false;
 
-// Enkel buffert för en NMEA-mening
-static char sbuf[200];
-static int slen = 0;
-
-// ============================================================
-// Helpers
-// ============================================================
+// ------------------------------------------------------------
+// NMEA-radparser (en passage)
+// ------------------------------------------------------------
+// Varje byte behandlas en gång när den kommer:
+// - XOR-checksumman räknas löpande mellan '$' och '*'
+// - fältgränser (kommatecken) sparas som index i radbufferten
+// - meningen tolkas direkt när "*HH" stämmer
+// Fälten läses sedan på plats i radbufferten som (pekare, längd),
+// utan strlen/strchr/split och utan libc-flyttalsparsning.
+// ------------------------------------------------------------
+static const uint8_t NMEA_MAX_LEN = 96; // NMEA 0183: max 82 tecken inkl. $ och CRLF
+static const uint8_t NMEA_MAX_FIELDS = 24;
 
-// Konvertera NMEA-format ddmm.mmmm / dddmm.mmmm till decimalgrader.
-static double nmeaDegMinToDec(const char *dm, char hemi)
+enum class NmeaRxState : uint8_t
 {
-    if (!dm || !dm[0])
-        return 0.0;
+    IDLE = 0,
+    BODY,
+    CK_HI,
+    CK_LO
+};
 
-    double v = atof(dm);
-    int deg = (int)(v / 100.0);
-    double minutes = v - (deg * 100.0);
-    double dec = (double)deg + (minutes / 60.0);
+struct NmeaRx
+{
+    NmeaRxState state = NmeaRxState::IDLE;
+    uint8_t len = 0;
+    uint8_t sum = 0;
+    uint8_t rxSum = 0;
+    uint8_t nFields = 0;
+    uint8_t fieldStart[NMEA_MAX_FIELDS + 1]; // +1: slutmarkör efter sista fältet
+    char buf[NMEA_MAX_LEN];                  // allt mellan '$' och '*'
+};
+
+// Ett fält i radbufferten. Inte nollterminerat.
+struct NmeaField
+{
+    const char *p;
+    uint8_t len;
+};
+
+static NmeaRx g_nmea;
+
+// Aktivt protokoll och statistik
+static ExtGnssProtocol g_protocol = ExtGnssProtocol::NMEA;
+static ExtGnssStats g_stats;
+static uint32_t g_fixSeq = 0;
+static LatestSlot<ExtGnssStats> g_statsSlot;
+static uint32_t g_statsWindowStartMs = 0;
+static uint32_t g_lastPvtMs = 0;
+
+// millis() för första byten i aktuell epoks utskrift. UTC-tiden i
+// fixen räknas från den, inte från när meningen tolkats, så tiden för
+// att sända resten av epoken (100-300 ms) inte hamnar i utcAtMs.
+static uint32_t g_epochStartMs = 0;
+static uint32_t g_lastRxMs = 0;
 
-    if (hemi == 'S' || hemi == 'W')
-        dec = -dec;
+// ------------------------------------------------------------
+// UBX-ramparser
+// ------------------------------------------------------------
+// Ram: B5 62 <class> <id> <len LE16> <payload> <ck_a> <ck_b>
+// Fletcher-checksumman räknas byte för byte medan ramen tas emot,
+// och fälten läses sedan direkt ur payload-bufferten.
+// ------------------------------------------------------------
+static const uint8_t UBX_SYNC1 = 0xB5;
+static const uint8_t UBX_SYNC2 = 0x62;
+
+static const uint8_t UBX_CLASS_NAV = 0x01;
+static const uint8_t UBX_CLASS_RXM = 0x02;
+static const uint8_t UBX_ID_RXM_PMREQ = 0x41;
+static const uint8_t UBX_CLASS_ACK = 0x05;
+static const uint8_t UBX_CLASS_CFG = 0x06;
+static const uint8_t UBX_ID_NAV_PVT = 0x07;
+static const uint8_t UBX_ID_ACK_NAK = 0x00;
+static const uint8_t UBX_ID_ACK_ACK = 0x01;
+static const uint8_t UBX_ID_CFG_MSG = 0x01;
+static const uint8_t UBX_ID_CFG_RATE = 0x08;
+static const uint8_t UBX_ID_CFG_VALSET = 0x8A;
+
+static const uint16_t UBX_NAV_PVT_LEN = 92;
+static const uint16_t UBX_MAX_PAYLOAD = 100;
+
+enum class UbxRxState : uint8_t
+{
+    SYNC1 = 0,
+    SYNC2,
+    CLASS,
+    ID,
+    LEN1,
+    LEN2,
+    PAYLOAD,
+    CK_A,
+    CK_B
+};
+
+struct UbxRx
+{
+    UbxRxState state = UbxRxState::SYNC1;
+    uint8_t cls = 0;
+    uint8_t id = 0;
+    uint16_t len = 0;
+    uint16_t idx = 0;
+    uint8_t ckA = 0;
+    uint8_t ckB = 0;
+    uint8_t rxCkA = 0;
+    uint8_t payload[UBX_MAX_PAYLOAD];
+};
+
+static UbxRx g_ubx;
 
-    return dec;
-}
+// ============================================================
+// Helpers
+// ============================================================
 
 // Enkel plausibility-check av koordinater.
 static bool latLonPlausible(double lat, double lon)
@@ -70,27 +243,7 @@ static bool latLonPlausible(double lat, double lon)
     return true;
 }
 
-// Dela upp en NMEA-mening på kommatecken.
-static int splitCsv(char *s, char **tok, int maxTok)
-{
-    int n = 0;
-
-    for (char *p = s; p && n < maxTok;)
-    {
-        tok[n++] = p;
-
-        char *c = strchr(p, ',');
-        if (!c)
-            break;
-
-        *c = 0;
-        p = c + 1;
-    }
-
-    return n;
-}
-
-// Konvertera en hex-teckenuppsättning till nibble.
+// Konvertera ett hex-tecken till nibble.
 static int hexNibble(char c)
 {
     if (c >= '0' && c <= '9')
@@ -102,72 +255,572 @@ static int hexNibble(char c)
     return -1;
 }
 
-// ------------------------------------------------------------
-// Validera NMEA-checksum.
-//
-// Format:
-//   $.....*HH
-//
-// XOR räknas över alla tecken mellan '$' och '*'.
-// ------------------------------------------------------------
-static bool nmeaChecksumOk(const char *line)
+// Meningstyp packad till ett heltal, t.ex. "RMC" -> 0x524D43.
+static constexpr uint32_t nmeaId(char a, char b, char c)
+{
+    return ((uint32_t)(uint8_t)a << 16) | ((uint32_t)(uint8_t)b << 8) | (uint32_t)(uint8_t)c;
+}
+
+static inline NmeaField nmeaField(uint8_t i)
+{
+    if (i >= g_nmea.nFields)
+        return NmeaField{"", 0};
+
+    uint8_t start = g_nmea.fieldStart[i];
+    uint8_t end = g_nmea.fieldStart[i + 1] - 1; // kommatecknet
+    return NmeaField{g_nmea.buf + start, (uint8_t)(end - start)};
+}
+
+// Heltal utan tecken. Tomt fält eller annat än siffror -> false.
+static bool nmeaParseUInt(const NmeaField &f, uint32_t &out)
 {
-    if (!line || line[0] != '$')
+    if (f.len == 0 || f.len > 9)
         return false;
 
-    const char *star = strchr(line, '*');
-    if (!star)
+    uint32_t v = 0;
+    for (uint8_t i = 0; i < f.len; i++)
+    {
+        char c = f.p[i];
+        if (c < '0' || c > '9')
+            return false;
+        v = v * 10 + (uint32_t)(c - '0');
+    }
+
+    out = v;
+    return true;
+}
+
+// Decimaltal som fixpunkt med 'decimals' decimaler, t.ex. "12.5" med
+// decimals=2 -> 1250. Fler decimaler trunkeras, färre fylls ut.
+static bool nmeaParseFixed(const NmeaField &f, uint8_t decimals, int32_t &out)
+{
+    if (f.len == 0)
         return false;
 
-    // Måste finnas två hextecken efter '*'
-    if (!star[1] || !star[2])
+    uint8_t i = 0;
+    bool neg = false;
+    if (f.p[0] == '-')
+    {
+        neg = true;
+        i = 1;
+    }
+
+    int64_t v = 0;
+    uint8_t digits = 0;
+    int8_t fracLeft = -1; // -1 = före decimalpunkten
+
+    for (; i < f.len; i++)
+    {
+        char c = f.p[i];
+
+        if (c == '.')
+        {
+            if (fracLeft >= 0)
+                return false;
+            fracLeft = (int8_t)decimals;
+            continue;
+        }
+
+        if (c < '0' || c > '9')
+            return false;
+
+        if (fracLeft == 0)
+            continue; // trunkera överskjutande decimaler
+
+        if (++digits > 12)
+            return false;
+
+        v = v * 10 + (c - '0');
+        if (fracLeft > 0)
+            fracLeft--;
+    }
+
+    if (digits == 0)
         return false;
 
-    int hi = hexNibble(star[1]);
-    int lo = hexNibble(star[2]);
-    if (hi < 0 || lo < 0)
+    if (fracLeft < 0)
+        fracLeft = (int8_t)decimals;
+    while (fracLeft-- > 0)
+        v *= 10;
+
+    if (v > INT32_MAX)
         return false;
 
-    uint8_t expected = (uint8_t)((hi << 4) | lo);
+    out = neg ? -(int32_t)v : (int32_t)v;
+    return true;
+}
 
-    uint8_t sum = 0;
-    for (const char *p = line + 1; p < star; ++p)
+// NMEA ddmm.mmmm / dddmm.mmmm + hemisfär -> grader i 1e-7.
+// Minuterna läses som heltal i 1e-7 minuter och delas med 60 en gång,
+// så ingen precision tappas på vägen.
+static bool nmeaParseCoordE7(const NmeaField &f, const NmeaField &hemi, bool isLat, int32_t &outE7)
+{
+    if (f.len < 4 || hemi.len != 1)
+        return false;
+
+    uint32_t whole = 0;  // dddmm
+    uint32_t fracE7 = 0; // minutdecimaler i 1e-7
+    uint8_t fracDigits = 0;
+    uint8_t wholeDigits = 0;
+    bool inFrac = false;
+
+    for (uint8_t i = 0; i < f.len; i++)
+    {
+        char c = f.p[i];
+
+        if (c == '.')
+        {
+            if (inFrac)
+                return false;
+            inFrac = true;
+            continue;
+        }
+
+        if (c < '0' || c > '9')
+            return false;
+
+        if (!inFrac)
+        {
+            if (++wholeDigits > 5)
+                return false;
+            whole = whole * 10 + (uint32_t)(c - '0');
+        }
+        else if (fracDigits < 7)
+        {
+            fracE7 = fracE7 * 10 + (uint32_t)(c - '0');
+            fracDigits++;
+        }
+    }
+
+    if (wholeDigits < 3)
+        return false;
+
+    while (fracDigits < 7)
     {
-        sum ^= (uint8_t)(*p);
+        fracE7 *= 10;
+        fracDigits++;
     }
 
-    return sum == expected;
+    uint32_t deg = whole / 100;
+    uint32_t min = whole % 100;
+    if (min >= 60 || deg > (isLat ? 90U : 180U))
+        return false;
+
+    uint64_t minE7 = (uint64_t)min * 10000000ULL + fracE7;
+    uint64_t degE7 = (uint64_t)deg * 10000000ULL + (minE7 + 30) / 60;
+    if (degE7 > (isLat ? 900000000ULL : 1800000000ULL))
+        return false;
+
+    char h = hemi.p[0];
+    bool negHemi = isLat ? (h == 'S') : (h == 'W');
+    bool posHemi = isLat ? (h == 'N') : (h == 'E');
+    if (!negHemi && !posHemi)
+        return false;
+
+    outE7 = negHemi ? -(int32_t)degE7 : (int32_t)degE7;
+    return true;
 }
 
-// ------------------------------------------------------------
-// Trimma bort CR/LF i slutet av strängen.
-// ------------------------------------------------------------
-static void trimLineEnd(char *s)
+// RMC hhmmss.sss + ddmmyy -> epoch och millisekunder in i sekunden.
+static bool nmeaParseUtc(const NmeaField &tf, const NmeaField &df, uint32_t &outEpoch, uint16_t &outMs)
 {
-    if (!s)
-        return;
+    if (tf.len < 6 || df.len != 6)
+        return false;
 
-    int len = (int)strlen(s);
-    while (len > 0 && (s[len - 1] == '\r' || s[len - 1] == '\n'))
+    int v[6];
+    for (uint8_t i = 0; i < 6; i++)
+    {
+        char a = tf.p[i];
+        char b = df.p[i];
+        if (a < '0' || a > '9' || b < '0' || b > '9')
+            return false;
+    }
+    for (uint8_t i = 0; i < 3; i++)
     {
-        s[len - 1] = 0;
-        --len;
+        v[i] = (tf.p[i * 2] - '0') * 10 + (tf.p[i * 2 + 1] - '0');     // hh mm ss
+        v[i + 3] = (df.p[i * 2] - '0') * 10 + (df.p[i * 2 + 1] - '0'); // dd mm yy
     }
+
+    if (v[0] > 23 || v[1] > 59 || v[2] > 60 || v[3] < 1 || v[3] > 31 || v[4] < 1 || v[4] > 12)
+        return false;
+
+    uint16_t ms = 0;
+    if (tf.len > 7 && tf.p[6] == '.')
+    {
+        uint16_t scale = 100;
+        for (uint8_t i = 7; i < tf.len && scale > 0; i++, scale /= 10)
+        {
+            char c = tf.p[i];
+            if (c < '0' || c > '9')
+                return false;
+            ms += (uint16_t)(c - '0') * scale;
+        }
+    }
+
+    outEpoch = civilToEpochUtc(2000 + v[5], v[4], v[3], v[0], v[1], v[2]);
+    outMs = ms;
+    return true;
 }
 
-// ------------------------------------------------------------
-// För NMEA-hantering vill vi ofta parsa meningen utan checksum-delen,
-// alltså allt före '*'.
-// Denna funktion skriver 0 på '*' om sådan finns.
-// ------------------------------------------------------------
-static void stripChecksumPart(char *s)
+// ============================================================
+// UBX
+// ============================================================
+
+static inline uint16_t ubxU2(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t ubxU4(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline int32_t ubxI4(const uint8_t *p)
+{
+    return (int32_t)ubxU4(p);
+}
+
+// Skicka en UBX-ram. Checksumman räknas över class, id, längd och payload.
+static void ubxSend(uint8_t cls, uint8_t id, const uint8_t *payload, uint16_t len)
+{
+    uint8_t hdr[6] = {UBX_SYNC1, UBX_SYNC2, cls, id, (uint8_t)(len & 0xFF), (uint8_t)(len >> 8)};
+    uint8_t ckA = 0;
+    uint8_t ckB = 0;
+
+    for (int i = 2; i < 6; i++)
+    {
+        ckA += hdr[i];
+        ckB += ckA;
+    }
+
+    for (uint16_t i = 0; i < len; i++)
+    {
+        ckA += payload[i];
+        ckB += ckA;
+    }
+
+    uint8_t ck[2] = {ckA, ckB};
+
+    uart_write_bytes(GNSS_UART, hdr, sizeof(hdr));
+    if (len > 0)
+        uart_write_bytes(GNSS_UART, payload, len);
+    uart_write_bytes(GNSS_UART, ck, sizeof(ck));
+}
+
+// Legacy CFG-MSG (M8): sätt rate för ett meddelande på aktuell port.
+static void ubxCfgMsg(uint8_t msgClass, uint8_t msgId, uint8_t rate)
+{
+    uint8_t p[3] = {msgClass, msgId, rate};
+    ubxSend(UBX_CLASS_CFG, UBX_ID_CFG_MSG, p, sizeof(p));
+}
+
+// NMEA-id:n i klass 0xF0 för CFG-MSG.
+static const uint8_t NMEA_ID_GGA = 0x00;
+static const uint8_t NMEA_ID_GLL = 0x01;
+static const uint8_t NMEA_ID_GSA = 0x02;
+static const uint8_t NMEA_ID_GSV = 0x03;
+static const uint8_t NMEA_ID_RMC = 0x04;
+static const uint8_t NMEA_ID_VTG = 0x05;
+
+// CFG-VALSET-nycklar (M9/M10), UART1, RAM-lagret.
+static const uint32_t KEY_MSGOUT_UBX_NAV_PVT_UART1 = 0x20910007;
+static const uint32_t KEY_MSGOUT_NMEA_GGA_UART1 = 0x209100BB;
+static const uint32_t KEY_MSGOUT_NMEA_GLL_UART1 = 0x209100CA;
+static const uint32_t KEY_MSGOUT_NMEA_GSA_UART1 = 0x209100C0;
+static const uint32_t KEY_MSGOUT_NMEA_GSV_UART1 = 0x209100C5;
+static const uint32_t KEY_MSGOUT_NMEA_RMC_UART1 = 0x209100AC;
+static const uint32_t KEY_MSGOUT_NMEA_VTG_UART1 = 0x209100B1;
+static const uint32_t KEY_RATE_MEAS = 0x30210001;
+
+struct UbxValItem
+{
+    uint32_t key;
+    uint16_t value;
+};
+
+// CFG-VALSET med U1/U2-värden. Storleken på värdet följer nyckelns
+// storleksfält (bit 28-30): 2 = U1, 3 = U2.
+static void ubxValSet(const UbxValItem *items, uint8_t count)
+{
+    uint8_t p[4 + 8 * 6];
+    uint16_t n = 0;
+
+    p[n++] = 0x00; // version
+    p[n++] = 0x01; // layer: RAM
+    p[n++] = 0x00;
+    p[n++] = 0x00;
+
+    for (uint8_t i = 0; i < count && (size_t)n + 6 <= sizeof(p); i++)
+    {
+        uint32_t k = items[i].key;
+        p[n++] = (uint8_t)(k);
+        p[n++] = (uint8_t)(k >> 8);
+        p[n++] = (uint8_t)(k >> 16);
+        p[n++] = (uint8_t)(k >> 24);
+
+        p[n++] = (uint8_t)(items[i].value);
+        if (((k >> 28) & 0x07) == 3)
+            p[n++] = (uint8_t)(items[i].value >> 8);
+    }
+
+    ubxSend(UBX_CLASS_CFG, UBX_ID_CFG_VALSET, p, n);
+}
+
+// Slå på/av RMC/GGA/GSA (de NMEA-meningar vi själva använder).
+static void ubxSetCoreNmea(bool enable)
 {
-    if (!s)
+    uint8_t rate = enable ? 1 : 0;
+
+    const UbxValItem items[] = {
+        {KEY_MSGOUT_NMEA_RMC_UART1, rate},
+        {KEY_MSGOUT_NMEA_GGA_UART1, rate},
+        {KEY_MSGOUT_NMEA_GSA_UART1, rate}};
+    ubxValSet(items, sizeof(items) / sizeof(items[0]));
+
+    ubxCfgMsg(0xF0, NMEA_ID_RMC, rate);
+    ubxCfgMsg(0xF0, NMEA_ID_GGA, rate);
+    ubxCfgMsg(0xF0, NMEA_ID_GSA, rate);
+}
+
+// Startkonfiguration: NAV-PVT på, navigationstakt, onödig NMEA av.
+// Både VALSET (M9/M10) och legacy CFG-MSG/CFG-RATE (M8) skickas;
+// det mottagaren inte känner igen NAK:as och ignoreras.
+static void ubxConfigure()
+{
+    const UbxValItem items[] = {
+        {KEY_MSGOUT_UBX_NAV_PVT_UART1, 1},
+        {KEY_RATE_MEAS, GNSS_NAV_RATE_MS},
+        {KEY_MSGOUT_NMEA_GSV_UART1, 0},
+        {KEY_MSGOUT_NMEA_GLL_UART1, 0},
+        {KEY_MSGOUT_NMEA_VTG_UART1, 0}};
+    ubxValSet(items, sizeof(items) / sizeof(items[0]));
+
+    uint8_t rate[6] = {(uint8_t)(GNSS_NAV_RATE_MS & 0xFF), (uint8_t)(GNSS_NAV_RATE_MS >> 8), 1, 0, 1, 0};
+    ubxSend(UBX_CLASS_CFG, UBX_ID_CFG_RATE, rate, sizeof(rate));
+
+    ubxCfgMsg(UBX_CLASS_NAV, UBX_ID_NAV_PVT, 1);
+    ubxCfgMsg(0xF0, NMEA_ID_GSV, 0);
+    ubxCfgMsg(0xF0, NMEA_ID_GLL, 0);
+    ubxCfgMsg(0xF0, NMEA_ID_VTG, 0);
+
+    logSystem("GNSS: UBX NAV-PVT requested, NMEA kept as fallback");
+}
+
+// Tolka NAV-PVT direkt ur payload-bufferten.
+static void handleNavPvt(const uint8_t *p)
+{
+    uint8_t fixType = p[20];
+    uint8_t flags = p[21];
+    bool gnssFixOk = (flags & 0x01) != 0;
+
+    ExtGnssFix fx;
+    fx.sats = p[23];
+    fx.lon = ubxI4(p + 24) * 1e-7;
+    fx.lat = ubxI4(p + 28) * 1e-7;
+    fx.altM = ubxI4(p + 36) / 1000.0f;
+    fx.speedKmh = ubxI4(p + 60) * 0.0036f;
+
+    // NAV-PVT saknar HDOP; PDOP är närmaste motsvarighet och ligger
+    // alltid >= HDOP, så befintliga gränser blir snarare strängare.
+    fx.hdop = ubxU2(p + 76) * 0.01f;
+
+    fx.fixMode = (fixType >= 3 && fixType <= 4) ? 3 : (fixType == 2 ? 2 : 1);
+    fx.fixQuality = gnssFixOk ? 1 : 0;
+    fx.valid = gnssFixOk &&
+               fixType >= 2 && fixType <= 4 &&
+               latLonPlausible(fx.lat, fx.lon);
+
+    // UTC: valid-flaggor validDate | validTime | fullyResolved.
+    if (fx.valid && (p[11] & 0x07) == 0x07)
+    {
+        int32_t nanoMs = ubxI4(p + 16) / 1000000;
+        fx.utcEpoch = civilToEpochUtc(ubxU2(p + 4), p[6], p[7], p[8], p[9], p[10]);
+        fx.utcAtMs = g_epochStartMs - (uint32_t)nanoMs;
+    }
+
+    fx.seq = ++g_fixSeq;
+    g_last = fx;
+    g_lastPvtMs = millis();
+    g_stats.windowFixes++;
+
+    if (g_protocol != ExtGnssProtocol::UBX)
+    {
+        g_protocol = ExtGnssProtocol::UBX;
+        ubxSetCoreNmea(false);
+        logSystem("GNSS: NAV-PVT received -> UBX mode, core NMEA off");
+    }
+}
+
+static void handleUbxFrame(const UbxRx &f)
+{
+    if (f.cls == UBX_CLASS_NAV && f.id == UBX_ID_NAV_PVT && f.len == UBX_NAV_PVT_LEN)
+    {
+        handleNavPvt(f.payload);
+    }
+    else if (f.cls == UBX_CLASS_ACK)
+    {
+        if (f.id == UBX_ID_ACK_ACK)
+            g_stats.ubxAck++;
+        else if (f.id == UBX_ID_ACK_NAK)
+            g_stats.ubxNak++;
+    }
+}
+
+// Mata in en byte i UBX-parsern.
+// Returnerar true om byten tillhör en UBX-ram och inte ska till NMEA.
+static bool ubxFeed(uint8_t b)
+{
+    UbxRx &r = g_ubx;
+
+    switch (r.state)
+    {
+    case UbxRxState::SYNC1:
+        if (b != UBX_SYNC1)
+            return false;
+        r.state = UbxRxState::SYNC2;
+        return true;
+
+    case UbxRxState::SYNC2:
+        if (b != UBX_SYNC2)
+        {
+            r.state = UbxRxState::SYNC1;
+            return false;
+        }
+        r.state = UbxRxState::CLASS;
+        r.ckA = 0;
+        r.ckB = 0;
+        return true;
+
+    default:
+        break;
+    }
+
+    if (r.state <= UbxRxState::PAYLOAD)
+    {
+        r.ckA += b;
+        r.ckB += r.ckA;
+    }
+
+    switch (r.state)
+    {
+    case UbxRxState::CLASS:
+        r.cls = b;
+        r.state = UbxRxState::ID;
+        break;
+
+    case UbxRxState::ID:
+        r.id = b;
+        r.state = UbxRxState::LEN1;
+        break;
+
+    case UbxRxState::LEN1:
+        r.len = b;
+        r.state = UbxRxState::LEN2;
+        break;
+
+    case UbxRxState::LEN2:
+        r.len |= (uint16_t)b << 8;
+        r.idx = 0;
+        r.state = (r.len > 0) ? UbxRxState::PAYLOAD : UbxRxState::CK_A;
+        break;
+
+    case UbxRxState::PAYLOAD:
+        // Ramar större än bufferten läses förbi men sparas inte.
+        if (r.idx < UBX_MAX_PAYLOAD)
+            r.payload[r.idx] = b;
+        r.idx++;
+        if (r.idx >= r.len)
+            r.state = UbxRxState::CK_A;
+        break;
+
+    case UbxRxState::CK_A:
+        r.rxCkA = b;
+        r.state = UbxRxState::CK_B;
+        break;
+
+    case UbxRxState::CK_B:
+        r.state = UbxRxState::SYNC1;
+        if (r.rxCkA != r.ckA || b != r.ckB)
+        {
+            g_stats.ubxChecksumErrors++;
+            break;
+        }
+        if (r.len <= UBX_MAX_PAYLOAD)
+            handleUbxFrame(r);
+        break;
+
+    default:
+        r.state = UbxRxState::SYNC1;
+        break;
+    }
+
+    return true;
+}
+
+// Faller tillbaka till NMEA om NAV-PVT uteblivit.
+static void ubxCheckFallback(uint32_t nowMs)
+{
+    if (g_protocol != ExtGnssProtocol::UBX || g_standby)
+        return;
+
+    if ((uint32_t)(nowMs - g_lastPvtMs) < GNSS_UBX_FALLBACK_MS)
+        return;
+
+    g_protocol = ExtGnssProtocol::NMEA;
+    g_last.valid = false;
+    g_haveRmc = false;
+    g_haveGga = false;
+    g_haveGsa = false;
+
+    publishLatest();
+    ubxSetCoreNmea(true);
+    logSystemf("GNSS: no NAV-PVT for %lu ms -> NMEA fallback",
+               (unsigned long)(nowMs - g_lastPvtMs));
+}
+
+// Periodisk jämförelse: UART-bytes/s och CPU-tid per fix för aktivt protokoll.
+static void logStatsIfDue(uint32_t nowMs)
+{
+    uint32_t windowMs = nowMs - g_statsWindowStartMs;
+    if (windowMs < GNSS_STATS_LOG_INTERVAL_MS)
         return;
 
-    char *star = strchr(s, '*');
-    if (star)
-        *star = 0;
+    uint32_t bps = (uint32_t)((uint64_t)g_stats.windowBytes * 1000ULL / windowMs);
+    uint32_t usPerFix = g_stats.windowFixes ? g_stats.windowParseUs / g_stats.windowFixes : 0;
+
+    logSystemf("GNSS: proto=%s rx_Bps=%lu fixes=%lu us_per_fix=%lu ck_err_nmea=%lu ck_err_ubx=%lu ack=%lu nak=%lu",
+               extGnssProtocolName(g_protocol),
+               (unsigned long)bps,
+               (unsigned long)g_stats.windowFixes,
+               (unsigned long)usPerFix,
+               (unsigned long)g_stats.nmeaChecksumErrors,
+               (unsigned long)g_stats.ubxChecksumErrors,
+               (unsigned long)g_stats.ubxAck,
+               (unsigned long)g_stats.ubxNak);
+
+    logSystemf("GNSS: rx_total=%lu dropped_bytes=%lu overflow_events=%lu dropped_sentences=%lu",
+               (unsigned long)g_stats.rxBytes,
+               (unsigned long)g_stats.droppedBytes,
+               (unsigned long)g_stats.overflowEvents,
+               (unsigned long)g_stats.droppedSentences);
+
+    // NMEA-genomströmning och hur mycket av task-stacken som aldrig använts.
+    uint32_t nmeaPerSec = (uint32_t)((uint64_t)g_stats.windowSentences * 1000ULL / windowMs);
+    uint32_t stackFree = g_task ? (uint32_t)uxTaskGetStackHighWaterMark(g_task) : 0;
+    logSystemf("GNSS: nmea_per_s=%lu stack_free_min=%lu/%lu",
+               (unsigned long)nmeaPerSec,
+               (unsigned long)stackFree,
+               (unsigned long)GNSS_TASK_STACK);
+
+    g_stats.windowMs = windowMs;
+    g_statsSlot.publish(g_stats);
+
+    g_stats.windowBytes = 0;
+    g_stats.windowFixes = 0;
+    g_stats.windowParseUs = 0;
+    g_stats.windowSentences = 0;
+    g_statsWindowStartMs = nowMs;
 }
 
 // ------------------------------------------------------------
@@ -175,9 +828,10 @@ static void stripChecksumPart(char *s)
 // Bra vid wake/start av ny burst så vi inte råkar använda
 // gammal data som om den vore ny.
 // ------------------------------------------------------------
-void extGnssClearLatest()
+static void resetParser()
 {
-    slen = 0;
+    g_nmea.state = NmeaRxState::IDLE;
+    g_ubx.state = UbxRxState::SYNC1;
     g_last = ExtGnssFix{};
     g_haveRmc = false;
     g_haveGga = false;
@@ -189,63 +843,77 @@ void extGnssClearLatest()
 // ============================================================
 
 // Hantera RMC-mening.
-static void handleRmc(char *s)
+// $--RMC,tid,status,lat,N/S,lon,E/W,fart_kn,kurs,datum,...
+static void handleRmc()
 {
-    char *tok[20] = {0};
-    int n = splitCsv(s, tok, 20);
-
-    if (n < 8)
+    if (g_nmea.nFields < 8)
         return;
 
-    const char *status = tok[2];
-
-    if (!status || status[0] != 'A')
+    NmeaField status = nmeaField(2);
+    if (status.len != 1 || status.p[0] != 'A')
     {
         g_haveRmc = false;
         g_last.valid = false;
         return;
     }
 
-    double lat = nmeaDegMinToDec(tok[3], tok[4] ? tok[4][0] : 'N');
-    double lon = nmeaDegMinToDec(tok[5], tok[6] ? tok[6][0] : 'E');
-
-    if (!latLonPlausible(lat, lon))
+    int32_t latE7 = 0;
+    int32_t lonE7 = 0;
+    if (!nmeaParseCoordE7(nmeaField(3), nmeaField(4), true, latE7) ||
+        !nmeaParseCoordE7(nmeaField(5), nmeaField(6), false, lonE7))
     {
         g_haveRmc = false;
         g_last.valid = false;
         return;
     }
 
-    float sogKn = tok[7] ? atof(tok[7]) : 0.0f;
-    float kmh = sogKn * 1.852f;
+    int32_t sogMilliKn = 0;
+    nmeaParseFixed(nmeaField(7), 3, sogMilliKn);
 
-    g_last.lat = lat;
-    g_last.lon = lon;
-    g_last.speedKmh = kmh;
+    g_last.lat = latE7 * 1e-7;
+    g_last.lon = lonE7 * 1e-7;
+    g_last.speedKmh = sogMilliKn * (1.852f / 1000.0f);
+
+    // UTC från samma mening. Tiden är bara pålitlig med giltig fix
+    // (status A), annars kan den komma från mottagarens egen RTC.
+    uint32_t utcEpoch = 0;
+    uint16_t utcMs = 0;
+    if (nmeaParseUtc(nmeaField(1), nmeaField(9), utcEpoch, utcMs))
+    {
+        g_last.utcEpoch = utcEpoch;
+        g_last.utcAtMs = g_epochStartMs - utcMs;
+    }
+    else
+    {
+        g_last.utcEpoch = 0;
+    }
 
     g_haveRmc = true;
 }
 
 // Hantera GGA-mening.
-static void handleGga(char *s)
+// $--GGA,tid,lat,N/S,lon,E/W,kvalitet,sats,hdop,höjd,M,...
+static void handleGga()
 {
-    char *tok[20] = {0};
-    int n = splitCsv(s, tok, 20);
-
-    if (n < 10)
+    if (g_nmea.nFields < 10)
         return;
 
-    int fixQuality = tok[6] ? atoi(tok[6]) : 0;
-    int sats = tok[7] ? atoi(tok[7]) : 0;
-    float hdop = tok[8] ? atof(tok[8]) : 99.0f;
-    float alt = tok[9] ? atof(tok[9]) : 0.0f;
+    uint32_t fixQuality = 0;
+    uint32_t sats = 0;
+    int32_t hdopX100 = 9900;
+    int32_t altDm = 0;
+
+    nmeaParseUInt(nmeaField(6), fixQuality);
+    nmeaParseUInt(nmeaField(7), sats);
+    nmeaParseFixed(nmeaField(8), 2, hdopX100);
+    nmeaParseFixed(nmeaField(9), 1, altDm);
 
     g_last.fixQuality = (uint8_t)fixQuality;
-    g_last.sats = sats;
-    g_last.hdop = hdop;
-    g_last.altM = alt;
+    g_last.sats = (int)sats;
+    g_last.hdop = hdopX100 * 0.01f;
+    g_last.altM = altDm * 0.1f;
 
-    if (fixQuality <= 0)
+    if (fixQuality == 0)
     {
         g_haveGga = false;
         g_last.valid = false;
@@ -256,15 +924,14 @@ static void handleGga(char *s)
 }
 
 // Hantera GSA-mening.
-static void handleGsa(char *s)
+// $--GSA,läge,fix-mode,...
+static void handleGsa()
 {
-    char *tok[20] = {0};
-    int n = splitCsv(s, tok, 20);
-
-    if (n < 3)
+    if (g_nmea.nFields < 3)
         return;
 
-    int fixMode = tok[2] ? atoi(tok[2]) : 0;
+    uint32_t fixMode = 0;
+    nmeaParseUInt(nmeaField(2), fixMode);
     g_last.fixMode = (uint8_t)fixMode;
 
     if (fixMode >= 2)
@@ -278,40 +945,40 @@ static void handleGsa(char *s)
     }
 }
 
-// Hantera komplett NMEA-mening.
-// Viktigt:
-// - checksum måste vara korrekt
-// - sedan strippar vi "*HH" innan CSV-split
-static void handleSentence(char *line)
+// Hantera en komplett mening med korrekt checksumma.
+static void handleSentence()
 {
-    if (!line || line[0] != '$')
+    g_stats.windowSentences++;
+
+    // I UBX-läge kommer fixen från NAV-PVT. Ev. kvarvarande NMEA
+    // ignoreras så de två källorna inte blandas i samma fix.
+    if (g_protocol == ExtGnssProtocol::UBX)
         return;
 
-    trimLineEnd(line);
+    // Adressfältet är talker (2 tecken) + typ (3 tecken).
+    // Talker-oberoende: $GPRMC, $GNRMC, $GARMC ... -> "RMC"
+    NmeaField addr = nmeaField(0);
+    if (addr.len != 5)
+        return;
 
-    if (!nmeaChecksumOk(line))
+    switch (nmeaId(addr.p[2], addr.p[3], addr.p[4]))
     {
-        return;
-    }
+    case nmeaId('R', 'M', 'C'):
+        handleRmc();
+        g_stats.windowFixes++;
+        break;
 
-    stripChecksumPart(line);
+    case nmeaId('G', 'G', 'A'):
+        handleGga();
+        g_last.seq = ++g_fixSeq;
+        break;
 
-    if (strlen(line) < 6)
-        return;
+    case nmeaId('G', 'S', 'A'):
+        handleGsa();
+        break;
 
-    // Vi använder talker-oberoende matchning på suffix:
-    // $GPRMC, $GNRMC, $GARMC ... -> "RMC"
-    if (strncmp(line + 3, "RMC", 3) == 0)
-    {
-        handleRmc(line);
-    }
-    else if (strncmp(line + 3, "GGA", 3) == 0)
-    {
-        handleGga(line);
-    }
-    else if (strncmp(line + 3, "GSA", 3) == 0)
-    {
-        handleGsa(line);
+    default:
+        return;
     }
 
     // valid sätts bara om:
@@ -322,77 +989,412 @@ static void handleSentence(char *line)
     g_last.valid = (g_haveRmc && g_haveGga && gsaOk);
 }
 
+// Mata en byte i NMEA-radparsern.
+static void nmeaFeed(char ch)
+{
+    if (ch == '$')
+    {
+        // Ny mening mitt i en påbörjad: den gamla är trasig.
+        if (g_nmea.state != NmeaRxState::IDLE)
+            g_stats.nmeaChecksumErrors++;
+
+        g_nmea.state = NmeaRxState::BODY;
+        g_nmea.len = 0;
+        g_nmea.sum = 0;
+        g_nmea.nFields = 1;
+        g_nmea.fieldStart[0] = 0;
+        return;
+    }
+
+    switch (g_nmea.state)
+    {
+    case NmeaRxState::IDLE:
+        return;
+
+    case NmeaRxState::BODY:
+        if (ch == '*')
+        {
+            g_nmea.fieldStart[g_nmea.nFields] = g_nmea.len + 1;
+            g_nmea.state = NmeaRxState::CK_HI;
+            return;
+        }
+
+        if (ch == '\r' || ch == '\n')
+        {
+            // Radslut utan checksumma godtas inte.
+            g_stats.nmeaChecksumErrors++;
+            g_nmea.state = NmeaRxState::IDLE;
+            return;
+        }
+
+        if (g_nmea.len >= NMEA_MAX_LEN)
+        {
+            // Overflow: kasta aktuell rad och vänta på nästa '$'.
+            g_stats.droppedSentences++;
+            g_nmea.state = NmeaRxState::IDLE;
+            return;
+        }
+
+        if (ch == ',')
+        {
+            if (g_nmea.nFields >= NMEA_MAX_FIELDS)
+            {
+                g_stats.droppedSentences++;
+                g_nmea.state = NmeaRxState::IDLE;
+                return;
+            }
+            g_nmea.fieldStart[g_nmea.nFields++] = g_nmea.len + 1;
+        }
+
+        g_nmea.sum ^= (uint8_t)ch;
+        g_nmea.buf[g_nmea.len++] = ch;
+        return;
+
+    case NmeaRxState::CK_HI:
+    {
+        int hi = hexNibble(ch);
+        if (hi < 0)
+        {
+            g_stats.nmeaChecksumErrors++;
+            g_nmea.state = NmeaRxState::IDLE;
+            return;
+        }
+        g_nmea.rxSum = (uint8_t)(hi << 4);
+        g_nmea.state = NmeaRxState::CK_LO;
+        return;
+    }
+
+    case NmeaRxState::CK_LO:
+    {
+        int lo = hexNibble(ch);
+        g_nmea.state = NmeaRxState::IDLE;
+
+        if (lo < 0 || (uint8_t)(g_nmea.rxSum | lo) != g_nmea.sum)
+        {
+            g_stats.nmeaChecksumErrors++;
+            return;
+        }
+
+        handleSentence();
+        return;
+    }
+    }
+}
+
 // ============================================================
-// Public API
+// Byte-inmatning (körs i GNSS-tasken)
 // ============================================================
 
-bool extGnssBegin(int rxPin, int txPin, uint32_t baud)
+// Mata in en byte från UART i UBX- eller NMEA-parsern.
+static void feedByte(char ch)
 {
-    GNSS.begin(baud, SERIAL_8N1, rxPin, txPin);
+    if (ubxFeed((uint8_t)ch))
+        return;
 
-    extGnssClearLatest();
+    nmeaFeed(ch);
+}
 
-    return true;
+// Läs allt som finns i driverns ringbuffert och mata parsern.
+static void drainUart(TickType_t firstWait)
+{
+    uint8_t chunk[128];
+    uint32_t startUs = micros();
+    uint32_t bytes = 0;
+    TickType_t wait = firstWait;
+
+    // Skatta när första buffrade byten kom (10 bitar per byte). Kom den
+    // efter en tyst period är det början på en ny epok.
+    size_t buffered = 0;
+    uart_get_buffered_data_len(GNSS_UART, &buffered);
+    if (buffered > 0)
+    {
+        const uint32_t nowMs = millis();
+        const uint32_t firstByteMs = nowMs - (uint32_t)((uint64_t)buffered * 10000ULL / GNSS_BAUD);
+        if ((int32_t)(firstByteMs - g_lastRxMs) >= (int32_t)GNSS_EPOCH_GAP_MS)
+            g_epochStartMs = firstByteMs;
+        g_lastRxMs = nowMs;
+    }
+
+    for (;;)
+    {
+        int n = uart_read_bytes(GNSS_UART, chunk, sizeof(chunk), wait);
+        if (n <= 0)
+            break;
+
+        wait = 0;
+        bytes += (uint32_t)n;
+
+        for (int i = 0; i < n; i++)
+        {
+            feedByte((char)chunk[i]);
+        }
+    }
+
+    if (bytes > 0)
+    {
+        g_stats.rxBytes += bytes;
+        g_stats.windowBytes += bytes;
+        g_stats.windowParseUs += micros() - startUs;
+        publishLatest();
+    }
 }
 
-void extGnssEnd()
+// ------------------------------------------------------------
+// Backup-läge (UBX-RXM-PMREQ)
+// ------------------------------------------------------------
+// Mottagaren behåller efemerider/almanacka i backup-RAM så nästa start
+// blir varm/het. Den väcks av aktivitet på sin RX-linje.
+// ------------------------------------------------------------
+static void enterStandby()
 {
-    GNSS.end();
+    uint8_t p[16] = {0};
+    // version 0, duration 0 = tills väckning
+    p[8] = 0x02;  // flags: backup
+    p[12] = 0x08; // wakeupSources: uartrx
+    ubxSend(UBX_CLASS_RXM, UBX_ID_RXM_PMREQ, p, sizeof(p));
+
+    g_standby = true;
+    g_last.valid = false;
+    g_haveRmc = false;
+    g_haveGga = false;
+    g_haveGsa = false;
+    publishLatest();
+
+    logSystem("GNSS: standby (RXM-PMREQ backup)");
 }
 
-void extGnssPoll()
+static void leaveStandby()
+{
+    // Några dummy-bytes väcker mottagaren. Första bytes efter väckning
+    // kan tappas, så vänta en stund innan konfigurationen skickas igen.
+    uint8_t wake[16];
+    memset(wake, 0xFF, sizeof(wake));
+    uart_write_bytes(GNSS_UART, wake, sizeof(wake));
+    vTaskDelay(pdMS_TO_TICKS(GNSS_WAKE_SETTLE_MS));
+
+#if EXTERNAL_GNSS_UBX
+    ubxConfigure();
+#endif
+
+    g_standby = false;
+    g_lastPvtMs = millis();
+
+    logSystem("GNSS: woken from standby");
+}
+
+// Periodiskt underhåll: clear-begäran, UBX-fallback och statistik.
+static void housekeeping()
 {
-    while (GNSS.available())
+    if (g_clearRequested.exchange(false))
     {
-        char ch = (char)GNSS.read();
+        resetParser();
+        publishLatest();
+    }
 
-        // Om en ny '$' kommer mitt i en redan påbörjad buffert, så försöker vi
-        // avsluta den gamla som "best effort" och börjar sedan om med den nya.
-        if (ch == '$' && slen > 0)
-        {
-            sbuf[slen] = 0;
+    if (g_standbyRequested.exchange(false) && !g_standby)
+    {
+        enterStandby();
+    }
+
+    if (g_wakeRequested.exchange(false) && g_standby)
+    {
+        leaveStandby();
+    }
+
+    uint32_t nowMs = millis();
 
-            char *p = strchr(sbuf, '$');
-            if (!p)
-                p = sbuf;
+#if EXTERNAL_GNSS_UBX
+    ubxCheckFallback(nowMs);
+#endif
 
-            if (p[0] == '$')
+    logStatsIfDue(nowMs);
+}
+
+// ------------------------------------------------------------
+// GNSS-task
+// ------------------------------------------------------------
+// Väntar på UART-driverns händelsekö. Driverns ringbuffert tar emot
+// data även när huvudloopen blockerar i modem/MQTT/BLE, och tasken
+// tömmer den så fort det finns något. Overflow-händelser räknas.
+// ------------------------------------------------------------
+static void gnssTask(void *)
+{
+    uart_event_t ev;
+
+    while (!g_taskStop)
+    {
+        if (xQueueReceive(g_uartQueue, &ev, pdMS_TO_TICKS(GNSS_TASK_IDLE_MS)) == pdTRUE)
+        {
+            switch (ev.type)
+            {
+            case UART_DATA:
+                drainUart(0);
+                break;
+
+            case UART_FIFO_OVF:
+            case UART_BUFFER_FULL:
             {
-                handleSentence(p);
+                // Hårdvaran har redan tappat data. Ta vara på det som finns
+                // (trasiga meningar fångas av checksumman), räkna det som
+                // ändå måste slängas och börja om parsningen från ren rad.
+                g_stats.overflowEvents++;
+                drainUart(0);
+
+                size_t left = 0;
+                uart_get_buffered_data_len(GNSS_UART, &left);
+                uart_flush_input(GNSS_UART);
+                xQueueReset(g_uartQueue);
+
+                g_stats.droppedBytes += (uint32_t)left;
+                g_nmea.state = NmeaRxState::IDLE;
+                g_ubx.state = UbxRxState::SYNC1;
+                break;
             }
 
-            slen = 0;
+            default:
+                break;
+            }
         }
 
-        if (slen < (int)sizeof(sbuf) - 1)
-        {
-            sbuf[slen++] = ch;
-        }
-        else
+        housekeeping();
+    }
+
+    g_task = nullptr;
+    vTaskDelete(nullptr);
+}
+
+// ============================================================
+// Public API
+// ============================================================
+
+bool extGnssBegin(int rxPin, int txPin, uint32_t baud)
+{
+    uart_config_t cfg = {};
+    cfg.baud_rate = (int)baud;
+    cfg.data_bits = UART_DATA_8_BITS;
+    cfg.parity = UART_PARITY_DISABLE;
+    cfg.stop_bits = UART_STOP_BITS_1;
+    cfg.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+    cfg.source_clk = UART_SCLK_DEFAULT;
+
+    if (uart_driver_install(GNSS_UART, GNSS_UART_RX_BUF, 0, GNSS_UART_EVENT_QUEUE, &g_uartQueue, 0) != ESP_OK)
+    {
+        logSystem("GNSS: uart_driver_install failed");
+        return false;
+    }
+
+    uart_param_config(GNSS_UART, &cfg);
+    uart_set_pin(GNSS_UART, txPin, rxPin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+
+    resetParser();
+    publishLatest();
+
+    g_protocol = ExtGnssProtocol::NMEA;
+    g_statsWindowStartMs = millis();
+
+#if EXTERNAL_GNSS_UBX
+    ubxConfigure();
+#endif
+
+    g_taskStop = false;
+    if (xTaskCreatePinnedToCore(gnssTask, "gnss", GNSS_TASK_STACK, nullptr,
+                                GNSS_TASK_PRIORITY, &g_task, GNSS_TASK_CORE) != pdPASS)
+    {
+        // Utan task faller vi tillbaka till polling från extGnssPoll().
+        g_task = nullptr;
+        logSystem("GNSS: task create failed, polling from pipeline");
+    }
+
+    return true;
+}
+
+void extGnssEnd()
+{
+    if (g_task)
+    {
+        g_taskStop = true;
+
+        uint32_t start = millis();
+        while (g_task && millis() - start < 500)
         {
-            // Overflow: kasta aktuell rad och börja om.
-            slen = 0;
+            delay(10);
         }
+    }
 
-        // NMEA-rad komplett när LF kommer.
-        if (ch == '\n')
-        {
-            sbuf[slen] = 0;
+    uart_driver_delete(GNSS_UART);
+    g_uartQueue = nullptr;
+}
 
-            char *p = strchr(sbuf, '$');
-            if (p && p[0] == '$')
-            {
-                trimLineEnd(p);
-                handleSentence(p);
-            }
+void extGnssPoll()
+{
+    // Normalt sköter GNSS-tasken allt. Polling används bara om tasken
+    // inte kunde skapas.
+    if (g_task || !g_uartQueue)
+        return;
 
-            slen = 0;
-        }
+    drainUart(0);
+    housekeeping();
+}
+
+void extGnssClearLatest()
+{
+    // Parsern ägs av GNSS-tasken, så själva rensningen görs där
+    // inom GNSS_TASK_IDLE_MS.
+    g_clearRequested = true;
+
+    if (!g_task)
+    {
+        g_clearRequested = false;
+        resetParser();
+        publishLatest();
     }
 }
 
+void extGnssStandby()
+{
+    g_wakeRequested = false;
+    g_standbyRequested = true;
+
+    if (!g_task)
+        housekeeping();
+}
+
+void extGnssWake()
+{
+    g_standbyRequested = false;
+    g_wakeRequested = true;
+
+    if (!g_task)
+        housekeeping();
+}
+
+bool extGnssIsStandby()
+{
+    return g_standby;
+}
+
 bool extGnssGetLatest(ExtGnssFix &out)
 {
-    out = g_last;
+    g_slot.read(out);
     return out.valid;
+}
+
+bool extGnssGetStats(ExtGnssStats &out)
+{
+    g_statsSlot.read(out);
+    out.protocol = g_protocol;
+    return out.windowMs > 0;
+}
+
+const char *extGnssProtocolName(ExtGnssProtocol p)
+{
+    switch (p)
+    {
+    case ExtGnssProtocol::NMEA:
+        return "NMEA";
+    case ExtGnssProtocol::UBX:
+        return "UBX";
+    default:
+        return "UNKNOWN";
+    }
 }
\ No newline at end of file
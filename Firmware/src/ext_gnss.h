@@ -14,10 +14,60 @@ struct ExtGnssFix
     uint8_t fixMode = 0;
     int sats = 0;
     bool valid = false;
+    uint32_t seq = 0; // ökar för varje ny epok (NAV-PVT eller GGA)
+
+    // UTC-tid för epoken från RMC/NAV-PVT (0 = okänd) och millis()
+    // som motsvarar början av den sekunden, räknat från första byten i
+    // epokens utskrift. Sätts bara med giltig fix.
+    uint32_t utcEpoch = 0;
+    uint32_t utcAtMs = 0;
+};
+
+// Vilket protokoll som just nu levererar fixar.
+enum class ExtGnssProtocol : uint8_t
+{
+    NMEA = 0,
+    UBX
 };
 
+// Räknare för jämförelse NMEA/UBX. Fönstervärdena (window*) nollställs
+// vid varje statistiklogg, övriga räknas sedan boot.
+struct ExtGnssStats
+{
+    ExtGnssProtocol protocol = ExtGnssProtocol::NMEA;
+    uint32_t windowMs = 0;
+    uint32_t windowBytes = 0;
+    uint32_t windowFixes = 0;
+    uint32_t windowParseUs = 0;
+    uint32_t windowSentences = 0; // NMEA-meningar med korrekt checksumma
+    uint32_t nmeaChecksumErrors = 0;
+    uint32_t ubxChecksumErrors = 0;
+    uint32_t ubxAck = 0;
+    uint32_t ubxNak = 0;
+
+    // Förlustbevakning för UART-tasken.
+    uint32_t rxBytes = 0;          // totalt mottaget
+    uint32_t droppedBytes = 0;     // förlorat vid UART-overflow
+    uint32_t overflowEvents = 0;   // FIFO/ringbuffert full
+    uint32_t droppedSentences = 0; // NMEA-rad längre än radbufferten
+};
+
+// Startar UART-driver och GNSS-task. Mottagning och parsning sker
+// i tasken; pipeline läser senaste fix via extGnssGetLatest().
 bool extGnssBegin(int rxPin, int txPin, uint32_t baud);
 void extGnssEnd();
+
+// Behövs bara om GNSS-tasken inte kunde startas (då pollas UART här).
 void extGnssPoll();
 bool extGnssGetLatest(ExtGnssFix &out);
-void extGnssClearLatest();
\ No newline at end of file
+void extGnssClearLatest();
+
+// Strömspar: lägg mottagaren i backup-läge respektive väck den.
+// Utförs asynkront i GNSS-tasken. Mottagare som inte förstår UBX
+// ignorerar begäran och fortsätter leverera fixar.
+void extGnssStandby();
+void extGnssWake();
+bool extGnssIsStandby();
+
+bool extGnssGetStats(ExtGnssStats &out);
+const char *extGnssProtocolName(ExtGnssProtocol p);
\ No newline at end of file
@@ -0,0 +1,281 @@
+#include "gnss_power.h"
+#include "config.h"
+#include "ext_gnss.h"
+#include "logging.h"
+
+// ============================================================
+// GNSS power manager
+// ============================================================
+
+enum class GnssPowerState : uint8_t
+{
+    ON = 0,   // mottagaren går, fix finns eller väntas
+    STANDBY   // backup-läge, väntar på väckning
+};
+
+struct TtffStats
+{
+    uint32_t count = 0;
+    uint32_t lastMs = 0;
+    uint32_t avgMs = 0; // glidande medel, startar på default
+};
+
+static GnssPowerState g_state = GnssPowerState::ON;
+
+// Start/väckning som väntar på första fix.
+static bool g_waitingFirstFix = true;
+static GnssStartType g_startType = GnssStartType::COLD;
+static uint32_t g_onSinceMs = 0;
+
+// Senaste giltiga fix (millis), 0 = aldrig.
+static uint32_t g_lastFixMs = 0;
+static bool g_haveEverFix = false;
+
+// Fix använd sedan senaste väckning.
+static bool g_fixUsed = false;
+
+static TtffStats g_ttff[(uint8_t)GnssStartType::COUNT];
+
+// On-tid sedan boot
+static uint32_t g_onTotalMs = 0;
+static uint32_t g_onAccountedMs = 0;
+
+static bool g_initDone = false;
+
+// ============================================================
+// Helpers
+// ============================================================
+
+static inline bool timeReached(uint32_t nowMs, uint32_t targetMs)
+{
+    return (int32_t)(nowMs - targetMs) >= 0;
+}
+
+static uint32_t defaultTtffMs(GnssStartType t)
+{
+    switch (t)
+    {
+    case GnssStartType::HOT:
+        return GNSS_TTFF_DEFAULT_HOT_MS;
+    case GnssStartType::WARM:
+        return GNSS_TTFF_DEFAULT_WARM_MS;
+    default:
+        return GNSS_TTFF_DEFAULT_COLD_MS;
+    }
+}
+
+static GnssStartType startTypeFor(uint32_t nowMs)
+{
+    if (!g_haveEverFix)
+        return GnssStartType::COLD;
+
+    uint32_t age = nowMs - g_lastFixMs;
+    if (age <= GPS_HOT_MAX_AGE_MS)
+        return GnssStartType::HOT;
+    if (age <= GPS_WARM_MAX_AGE_MS)
+        return GnssStartType::WARM;
+    return GnssStartType::COLD;
+}
+
+static uint32_t predictedTtffMs(GnssStartType t)
+{
+    const TtffStats &st = g_ttff[(uint8_t)t];
+    return st.count > 0 ? st.avgMs : defaultTtffMs(t);
+}
+
+// Ledtid före behov: förväntad TTFF + halva igen som osäkerhet + marginal.
+static uint32_t wakeLeadMs(uint32_t nowMs)
+{
+    uint32_t ttff = predictedTtffMs(startTypeFor(nowMs));
+    return ttff + ttff / 2 + GNSS_WAKE_MARGIN_MS;
+}
+
+static void recordTtff(GnssStartType t, uint32_t ttffMs)
+{
+    TtffStats &st = g_ttff[(uint8_t)t];
+
+    st.lastMs = ttffMs;
+    if (st.count == 0)
+        st.avgMs = ttffMs;
+    else
+        st.avgMs = (st.avgMs * 3 + ttffMs) / 4;
+    st.count++;
+
+    logSystemf("GNSSPWR: TTFF %s = %lu ms (avg %lu ms, n=%lu)",
+               gnssStartTypeName(t),
+               (unsigned long)ttffMs,
+               (unsigned long)st.avgMs,
+               (unsigned long)st.count);
+}
+
+static void accountOnTime(uint32_t nowMs)
+{
+    if (g_state == GnssPowerState::ON)
+        g_onTotalMs += nowMs - g_onAccountedMs;
+    g_onAccountedMs = nowMs;
+}
+
+static void goOn(uint32_t nowMs, const char *why)
+{
+    accountOnTime(nowMs);
+
+    g_startType = startTypeFor(nowMs);
+    g_state = GnssPowerState::ON;
+    g_onSinceMs = nowMs;
+    g_waitingFirstFix = true;
+    g_fixUsed = false;
+
+    extGnssWake();
+
+    logSystemf("GNSSPWR: wake (%s) start=%s predicted_ttff=%lu ms",
+               why,
+               gnssStartTypeName(g_startType),
+               (unsigned long)predictedTtffMs(g_startType));
+}
+
+static void goStandby(uint32_t nowMs, const char *why)
+{
+    accountOnTime(nowMs);
+
+    g_state = GnssPowerState::STANDBY;
+    extGnssStandby();
+
+    logSystemf("GNSSPWR: standby (%s) after %lu ms on",
+               why,
+               (unsigned long)(nowMs - g_onSinceMs));
+}
+
+// ============================================================
+// Public API
+// ============================================================
+
+void gnssPowerTick(uint32_t nowMs, bool keepOn, uint32_t nextNeedAtMs)
+{
+    if (!g_initDone)
+    {
+        // Mottagaren startar påslagen vid boot (kallstart).
+        g_initDone = true;
+        g_onSinceMs = nowMs;
+        g_onAccountedMs = nowMs;
+        g_startType = GnssStartType::COLD;
+    }
+
+    accountOnTime(nowMs);
+
+    ExtGnssFix fx;
+    bool haveFix = extGnssGetLatest(fx);
+
+    if (haveFix)
+    {
+        g_lastFixMs = nowMs;
+        g_haveEverFix = true;
+
+        if (g_state == GnssPowerState::ON && g_waitingFirstFix)
+        {
+            g_waitingFirstFix = false;
+            recordTtff(g_startType, nowMs - g_onSinceMs);
+        }
+    }
+
+#if GNSS_POWER_MGMT_ENABLED
+    if (keepOn)
+    {
+        if (g_state == GnssPowerState::STANDBY)
+            goOn(nowMs, "keep_on");
+        return;
+    }
+
+    if (g_state == GnssPowerState::ON)
+    {
+        if (g_fixUsed)
+        {
+            goStandby(nowMs, "fix used");
+        }
+        else if ((uint32_t)(nowMs - g_onSinceMs) >= GNSS_MAX_ON_MS)
+        {
+            // Ingen fix alls inom rimlig tid (t.ex. inomhus). Spara ström
+            // och försök igen inför nästa fönster.
+            goStandby(nowMs, g_waitingFirstFix ? "no fix" : "max on");
+        }
+        return;
+    }
+
+    // STANDBY: väck i tid före nästa behov.
+    uint32_t lead = wakeLeadMs(nowMs);
+    if (timeReached(nowMs, nextNeedAtMs - lead))
+        goOn(nowMs, "scheduled");
+#else
+    (void)keepOn;
+    (void)nextNeedAtMs;
+#endif
+}
+
+void gnssPowerNotifyFixUsed(uint32_t nowMs)
+{
+    (void)nowMs;
+
+    // Bara en riktig fix räknas; utan fix fortsätter vi leta till max on-tid.
+    if (g_state == GnssPowerState::ON && !g_waitingFirstFix)
+        g_fixUsed = true;
+}
+
+void gnssPowerWakeNow(uint32_t nowMs, const char *why)
+{
+    if (g_state == GnssPowerState::STANDBY)
+        goOn(nowMs, why);
+}
+
+bool gnssPowerIsOn()
+{
+    return g_state == GnssPowerState::ON;
+}
+
+const char *gnssStartTypeName(GnssStartType t)
+{
+    switch (t)
+    {
+    case GnssStartType::HOT:
+        return "HOT";
+    case GnssStartType::WARM:
+        return "WARM";
+    case GnssStartType::COLD:
+        return "COLD";
+    default:
+        return "UNKNOWN";
+    }
+}
+
+String gnssPowerStatsJson(uint32_t nowMs)
+{
+    accountOnTime(nowMs);
+
+    // Genomsnittlig on-tid per timme sedan boot.
+    uint32_t onSecPerHour = nowMs > 0
+                                ? (uint32_t)((uint64_t)g_onTotalMs * 3600ULL / nowMs)
+                                : 0;
+
+    String json = "{";
+    json += "\"state\":\"" + String(g_state == GnssPowerState::ON ? "ON" : "STANDBY") + "\",";
+    json += "\"on_s_per_h\":" + String(onSecPerHour) + ",";
+    json += "\"ttff\":{";
+
+    bool first = true;
+    for (uint8_t i = 0; i < (uint8_t)GnssStartType::COUNT; i++)
+    {
+        const TtffStats &st = g_ttff[i];
+        if (st.count == 0)
+            continue;
+
+        if (!first)
+            json += ",";
+        first = false;
+
+        json += "\"" + String(gnssStartTypeName((GnssStartType)i)) + "\":{";
+        json += "\"n\":" + String(st.count) + ",";
+        json += "\"last_ms\":" + String(st.lastMs) + ",";
+        json += "\"avg_ms\":" + String(st.avgMs) + "}";
+    }
+
+    json += "}}";
+    return json;
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <Arduino.h>
+
+// ============================================================
+// GNSS power manager
+// ------------------------------------------------------------
+// Håller extern GNSS igång bara när en fix behövs:
+// - keepConnected-profiler: alltid på
+// - övriga: standby efter att fixen använts, väckning före nästa
+//   kommunikationsfönster med ledtid = förväntad TTFF + marginal
+//
+// Starttyp (hot/warm/cold) bestäms av hur gammal senaste fix är
+// enligt GPS_HOT_MAX_AGE_MS / GPS_WARM_MAX_AGE_MS. TTFF mäts per
+// starttyp och används för nästa prognos.
+// ============================================================
+
+enum class GnssStartType : uint8_t
+{
+    HOT = 0,
+    WARM,
+    COLD,
+    COUNT
+};
+
+// Anropas varje tick.
+// keepOn: profilen kräver kontinuerlig GNSS.
+// nextNeedAtMs: när nästa fix behövs (nästa kommunikationsfönster).
+void gnssPowerTick(uint32_t nowMs, bool keepOn, uint32_t nextNeedAtMs);
+
+// Meddela att en fix har använts (publicerats). Tillåter standby.
+void gnssPowerNotifyFixUsed(uint32_t nowMs);
+
+// Väck direkt, t.ex. vid profilbyte eller PIR.
+void gnssPowerWakeNow(uint32_t nowMs, const char *why);
+
+bool gnssPowerIsOn();
+
+const char *gnssStartTypeName(GnssStartType t);
+
+// JSON för health: state, on-tid per timme och TTFF per starttyp.
+String gnssPowerStatsJson(uint32_t nowMs);
\ No newline at end of file
@@ -0,0 +1,378 @@
+#include "gps_filter.h"
+#include "logging.h"
+
+#include <math.h>
+
+// ============================================================
+// GPS filter
+// ------------------------------------------------------------
+// Ordning per epok:
+// 1. grindar på själva fixen (fix, HDOP, satelliter, höjd, fart,
+//    "62,15"-platshållaren)
+// 2. hoppspärr mot senaste godkända fix (efter bekräftelse)
+// 3. stabil bekräftelse: GPS_STABLE_SAMPLES godkända prover i rad
+//    inom GPS_STABLE_DIST_M_STOPPED/MOVING från varandra
+// 4. Kalman-utjämning i ett lokalt plan (meter) kring första fixen
+// ============================================================
+
+static constexpr double kEarthRadiusM = 6371000.0;
+static constexpr double kDegToRad = M_PI / 180.0;
+
+// Under denna fart räknas fordonet som stillastående.
+static constexpr float kStoppedKmh = 5.0f;
+
+// En axel i Kalman-filtret: position (m) och hastighet (m/s).
+struct KfAxis
+{
+    double p = 0.0;
+    double v = 0.0;
+    double P00 = 0.0;
+    double P01 = 0.0;
+    double P11 = 0.0;
+};
+
+struct GpsFilterState
+{
+    // Bekräftelse
+    bool confirmed = false;
+    uint8_t stableCount = 0;
+    double candLat = 0.0;
+    double candLon = 0.0;
+    uint8_t jumpCount = 0;
+
+    // Senaste godkända prov (rå position, för hoppspärr)
+    double lastLat = 0.0;
+    double lastLon = 0.0;
+    uint32_t lastAcceptMs = 0;
+
+    // Kalman
+    bool kfInit = false;
+    double refLat = 0.0;
+    double refLon = 0.0;
+    double cosRefLat = 1.0;
+    KfAxis x;
+    KfAxis y;
+
+    // Utdata
+    ExtGnssFix out;
+    bool haveOut = false;
+
+    GpsRejectReason lastReject = GpsRejectReason::NONE;
+};
+
+static GpsFilterState g_f;
+
+// Statistik sedan boot
+static uint32_t g_accepted = 0;
+static uint32_t g_rejects[(uint8_t)GpsRejectReason::COUNT] = {0};
+static uint32_t g_feedCount = 0;
+static uint32_t g_feedUsTotal = 0;
+
+// ============================================================
+// Helpers
+// ============================================================
+
+// Avstånd i meter (ekvirektangulär approximation, räcker för korta avstånd).
+static float distanceM(double lat1, double lon1, double lat2, double lon2)
+{
+    double x = (lon2 - lon1) * kDegToRad * cos((lat1 + lat2) * 0.5 * kDegToRad);
+    double y = (lat2 - lat1) * kDegToRad;
+    return (float)(sqrt(x * x + y * y) * kEarthRadiusM);
+}
+
+static bool isPlaceholder(double lat, double lon)
+{
+    return fabs(lat - GPS_PLACEHOLDER_LAT) <= GPS_PLACEHOLDER_LAT_TOL &&
+           fabs(lon - GPS_PLACEHOLDER_LON) <= GPS_PLACEHOLDER_LON_TOL;
+}
+
+static GpsRejectReason checkGates(const ExtGnssFix &fx)
+{
+    if (!fx.valid)
+        return GpsRejectReason::NO_FIX;
+
+    if (fx.hdop >= GPS_HDOP_REJECT_GE)
+        return GpsRejectReason::HDOP_REJECT;
+
+    if (fx.hdop < GPS_HDOP_MIN || fx.hdop > GPS_HDOP_MAX)
+        return GpsRejectReason::HDOP_RANGE;
+
+    if (fx.sats < GPS_SATS_MIN)
+        return GpsRejectReason::SATS;
+
+    if (fx.altM < GPS_ALT_MIN_M || fx.altM > GPS_ALT_MAX_M)
+        return GpsRejectReason::ALTITUDE;
+
+    if (fx.speedKmh > GPS_SPEED_MAX_KMH)
+        return GpsRejectReason::SPEED;
+
+    if (isPlaceholder(fx.lat, fx.lon))
+        return GpsRejectReason::PLACEHOLDER;
+
+    return GpsRejectReason::NONE;
+}
+
+static float stableDistFor(const ExtGnssFix &fx)
+{
+    return fx.speedKmh < kStoppedKmh ? GPS_STABLE_DIST_M_STOPPED : GPS_STABLE_DIST_M_MOVING;
+}
+
+// ------------------------------------------------------------
+// Kalman (konstant hastighet, en axel)
+// ------------------------------------------------------------
+static void kfPredict(KfAxis &a, float dt, float q)
+{
+    float dt2 = dt * dt;
+
+    a.p += a.v * dt;
+    a.P00 += dt * (2.0 * a.P01 + dt * a.P11) + q * dt2 * dt2 * 0.25;
+    a.P01 += dt * a.P11 + q * dt2 * dt * 0.5;
+    a.P11 += q * dt2;
+}
+
+static void kfUpdate(KfAxis &a, double z, double r)
+{
+    double s = a.P00 + r;
+    double k0 = a.P00 / s;
+    double k1 = a.P01 / s;
+    double innov = z - a.p;
+
+    a.p += k0 * innov;
+    a.v += k1 * innov;
+
+    double p00 = a.P00;
+    double p01 = a.P01;
+    a.P00 = (1.0 - k0) * p00;
+    a.P01 = (1.0 - k0) * p01;
+    a.P11 -= k1 * p01;
+}
+
+static void kfReset(const ExtGnssFix &fx, double r)
+{
+    g_f.kfInit = true;
+    g_f.refLat = fx.lat;
+    g_f.refLon = fx.lon;
+    g_f.cosRefLat = cos(fx.lat * kDegToRad);
+
+    g_f.x = KfAxis{};
+    g_f.y = KfAxis{};
+    g_f.x.P00 = r;
+    g_f.y.P00 = r;
+    g_f.x.P11 = 25.0;
+    g_f.y.P11 = 25.0;
+}
+
+static void kfStep(const ExtGnssFix &fx, float dt, ExtGnssFix &out)
+{
+    float uere = GPS_KF_UERE_M * fx.hdop;
+    double r = (double)uere * uere;
+    if (r < 1.0)
+        r = 1.0;
+
+    if (!g_f.kfInit || dt <= 0.0f || dt > GPS_FILTER_MAX_AGE_MS / 1000.0f)
+    {
+        kfReset(fx, r);
+    }
+    else
+    {
+        float q = GPS_KF_ACCEL_STD * GPS_KF_ACCEL_STD;
+        kfPredict(g_f.x, dt, q);
+        kfPredict(g_f.y, dt, q);
+
+        double zx = (fx.lon - g_f.refLon) * kDegToRad * g_f.cosRefLat * kEarthRadiusM;
+        double zy = (fx.lat - g_f.refLat) * kDegToRad * kEarthRadiusM;
+        kfUpdate(g_f.x, zx, r);
+        kfUpdate(g_f.y, zy, r);
+    }
+
+    out = fx;
+    out.lat = g_f.refLat + (g_f.y.p / kEarthRadiusM) / kDegToRad;
+    out.lon = g_f.refLon + (g_f.x.p / (kEarthRadiusM * g_f.cosRefLat)) / kDegToRad;
+}
+
+static void reject(GpsRejectReason r)
+{
+    g_f.lastReject = r;
+    g_rejects[(uint8_t)r]++;
+}
+
+// ============================================================
+// Public API
+// ============================================================
+
+void gpsFilterReset()
+{
+    g_f = GpsFilterState{};
+}
+
+bool gpsFilterFeed(const ExtGnssFix &raw, uint32_t nowMs)
+{
+    uint32_t startUs = micros();
+    bool accepted = false;
+
+    // För länge sedan senaste godkända prov: kräv ny bekräftelse.
+    if (g_f.confirmed && (uint32_t)(nowMs - g_f.lastAcceptMs) > GPS_FILTER_MAX_AGE_MS)
+    {
+        logSystem("GPSF: no accepted fix for too long -> reconfirm");
+        gpsFilterReset();
+    }
+
+    GpsRejectReason gate = checkGates(raw);
+
+    if (gate != GpsRejectReason::NONE)
+    {
+        reject(gate);
+    }
+    else if (g_f.confirmed)
+    {
+        float dt = (nowMs - g_f.lastAcceptMs) / 1000.0f;
+        float maxMoveM = (GPS_SPEED_MAX_KMH / 3.6f) * dt + GPS_STABLE_DIST_M_MOVING;
+        float moved = distanceM(g_f.lastLat, g_f.lastLon, raw.lat, raw.lon);
+
+        if (moved > maxMoveM)
+        {
+            reject(GpsRejectReason::JUMP);
+
+            if (++g_f.jumpCount >= GPS_JUMP_RESET_COUNT)
+            {
+                // Flera hopp i rad: troligen har vi faktiskt flyttats
+                // (t.ex. medan GNSS var av). Börja om bekräftelsen.
+                logSystemf("GPSF: %u jumps in a row -> reconfirm", (unsigned)g_f.jumpCount);
+                gpsFilterReset();
+            }
+        }
+        else
+        {
+            g_f.jumpCount = 0;
+            kfStep(raw, dt, g_f.out);
+            accepted = true;
+        }
+    }
+    else
+    {
+        // Bekräftelse: prover i rad nära varandra.
+        if (g_f.stableCount > 0 &&
+            distanceM(g_f.candLat, g_f.candLon, raw.lat, raw.lon) <= stableDistFor(raw))
+        {
+            g_f.stableCount++;
+        }
+        else
+        {
+            g_f.stableCount = 1;
+        }
+
+        g_f.candLat = raw.lat;
+        g_f.candLon = raw.lon;
+
+        if (g_f.stableCount >= GPS_STABLE_SAMPLES)
+        {
+            g_f.confirmed = true;
+            g_f.kfInit = false;
+            kfStep(raw, 0.0f, g_f.out);
+            accepted = true;
+            logSystemf("GPSF: position confirmed after %u stable samples", (unsigned)g_f.stableCount);
+        }
+        else
+        {
+            reject(GpsRejectReason::UNSTABLE);
+        }
+    }
+
+    if (accepted)
+    {
+        g_f.lastLat = raw.lat;
+        g_f.lastLon = raw.lon;
+        g_f.lastAcceptMs = nowMs;
+        g_f.haveOut = true;
+        g_f.lastReject = GpsRejectReason::NONE;
+        g_accepted++;
+    }
+
+    g_feedCount++;
+    g_feedUsTotal += micros() - startUs;
+
+    return accepted;
+}
+
+bool gpsFilterGetLatest(ExtGnssFix &out, uint32_t nowMs, uint32_t maxAgeMs)
+{
+    out = g_f.out;
+
+    if (!g_f.haveOut || !g_f.confirmed)
+    {
+        out.valid = false;
+        return false;
+    }
+
+    if ((uint32_t)(nowMs - g_f.lastAcceptMs) > maxAgeMs)
+    {
+        out.valid = false;
+        return false;
+    }
+
+    return out.valid;
+}
+
+bool gpsFilterIsConfirming()
+{
+    return !g_f.confirmed && g_f.stableCount > 0;
+}
+
+GpsRejectReason gpsFilterLastReject()
+{
+    return g_f.lastReject;
+}
+
+const char *gpsRejectReasonName(GpsRejectReason r)
+{
+    switch (r)
+    {
+    case GpsRejectReason::NONE:
+        return "NONE";
+    case GpsRejectReason::NO_FIX:
+        return "NO_FIX";
+    case GpsRejectReason::HDOP_REJECT:
+        return "HDOP_REJECT";
+    case GpsRejectReason::HDOP_RANGE:
+        return "HDOP_RANGE";
+    case GpsRejectReason::SATS:
+        return "SATS";
+    case GpsRejectReason::ALTITUDE:
+        return "ALTITUDE";
+    case GpsRejectReason::SPEED:
+        return "SPEED";
+    case GpsRejectReason::PLACEHOLDER:
+        return "PLACEHOLDER";
+    case GpsRejectReason::JUMP:
+        return "JUMP";
+    case GpsRejectReason::UNSTABLE:
+        return "UNSTABLE";
+    default:
+        return "UNKNOWN";
+    }
+}
+
+String gpsFilterStatsJson()
+{
+    String json = "{";
+    json += "\"ok\":" + String(g_accepted) + ",";
+    json += "\"confirmed\":" + String(g_f.confirmed ? "true" : "false") + ",";
+    json += "\"us_per_fix\":" + String(g_feedCount ? g_feedUsTotal / g_feedCount : 0) + ",";
+    json += "\"rej\":{";
+
+    bool first = true;
+    for (uint8_t i = 1; i < (uint8_t)GpsRejectReason::COUNT; i++)
+    {
+        if (g_rejects[i] == 0)
+            continue;
+
+        if (!first)
+            json += ",";
+        first = false;
+
+        json += "\"" + String(gpsRejectReasonName((GpsRejectReason)i)) + "\":" + String(g_rejects[i]);
+    }
+
+    json += "}}";
+    return json;
+}
\ No newline at end of file
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <Arduino.h>
+#include "config.h"
+#include "ext_gnss.h"
+
+// ============================================================
+// GPS filter
+// ------------------------------------------------------------
+// Strömmande filter mellan ext_gnss och publicering:
+// - kvalitetsgrindar enligt GPS_* i config.h
+// - stabil bekräftelse (GPS_STABLE_SAMPLES i rad nära varandra)
+// - hoppspärr mot orimlig förflyttning sedan senaste godkända fix
+// - enkel Kalman-utjämning (konstant hastighet) av lat/lon
+//
+// Konstant minne: bara senaste tillstånd och en histogram-räknare
+// per avvisningsorsak.
+// ============================================================
+
+enum class GpsRejectReason : uint8_t
+{
+    NONE = 0,
+    NO_FIX,
+    HDOP_REJECT,
+    HDOP_RANGE,
+    SATS,
+    ALTITUDE,
+    SPEED,
+    PLACEHOLDER,
+    JUMP,
+    UNSTABLE,
+    COUNT
+};
+
+// Nollställ filtret (t.ex. efter att GNSS varit avslagen).
+void gpsFilterReset();
+
+// Mata in en ny rå epok. Returnerar true om den godkändes och
+// den filtrerade fixen uppdaterades.
+bool gpsFilterFeed(const ExtGnssFix &raw, uint32_t nowMs);
+
+// Senaste filtrerade fix. Returnerar false om ingen bekräftad fix
+// finns eller om den är äldre än maxAgeMs.
+bool gpsFilterGetLatest(ExtGnssFix &out, uint32_t nowMs, uint32_t maxAgeMs = GPS_FILTER_MAX_AGE_MS);
+
+// true när filtret fått godkända prover men ännu inte bekräftat stabil position.
+bool gpsFilterIsConfirming();
+
+GpsRejectReason gpsFilterLastReject();
+const char *gpsRejectReasonName(GpsRejectReason r);
+
+// Kompakt JSON för health: godkända, histogram och CPU-tid per fix.
+String gpsFilterStatsJson();
\ No newline at end of file
@@ -0,0 +1,448 @@
+#include "gps_track.h"
+#include "gps_filter.h"
+#include "logging.h"
+#include "time_manager.h"
+
+#include <math.h>
+
+// ============================================================
+// GPS track
+// ------------------------------------------------------------
+// Förenkling (opening window):
+// - ankare = senast sparade punkt
+// - nya prover läggs i ett öppet fönster
+// - när linjen ankare -> nytt prov inte längre ligger inom
+//   TRACK_SIMPLIFY_TOL_M från alla prover i fönstret sparas
+//   fönstrets sista prov och blir nytt ankare
+// Rakt körande ger alltså få punkter, kurvor och stopp fler.
+//
+// Lagring: 16 byte per punkt, lat/lon som heltal i 1e-7 grader.
+// ============================================================
+
+static constexpr double kEarthRadiusM = 6371000.0;
+static constexpr double kDegToRad = M_PI / 180.0;
+
+struct TrackPoint
+{
+    uint32_t ms;
+    int32_t latE7;
+    int32_t lonE7;
+    uint16_t speedDkmh; // 0.1 km/h
+    uint16_t reserved;
+};
+
+// Ringbuffert (PSRAM om det finns)
+static TrackPoint *g_buf = nullptr;
+static uint32_t g_cap = 0;
+static uint32_t g_head = 0; // nästa skrivposition
+static uint32_t g_count = 0;
+static bool g_allocTried = false;
+static bool g_inPsram = false;
+
+// Öppet fönster (internt RAM, litet)
+static TrackPoint g_win[TRACK_WINDOW_POINTS];
+static uint16_t g_winN = 0;
+static TrackPoint g_anchor;
+static bool g_haveAnchor = false;
+
+static bool g_enabled = false;
+static uint32_t g_lastSampleMs = 0;
+static uint32_t g_lastSampleSeq = 0;
+
+// Statistik sedan boot
+static uint32_t g_samples = 0;
+static uint32_t g_stored = 0;
+static uint32_t g_dropped = 0;
+static uint32_t g_uploaded = 0;
+static uint32_t g_batches = 0;
+static uint32_t g_bytesUp = 0;
+static double g_distStoredM = 0.0;
+static double g_distUploadedM = 0.0;
+static TrackPoint g_lastStored;
+static TrackPoint g_lastUploaded;
+static bool g_haveLastUploaded = false;
+
+// Senaste byggda batch tog med fönstrets sista prov (tid g_batchTailMs).
+// Fönstret stängs först i gpsTrackCommitBatch(), så ett misslyckat
+// publish inte kortar förenklingen.
+static bool g_batchHasTail = false;
+static uint32_t g_batchTailMs = 0;
+
+// ============================================================
+// Helpers
+// ============================================================
+
+static inline uint32_t ringIndex(uint32_t i)
+{
+    // i = 0 är äldsta punkten
+    return (g_head + g_cap - g_count + i) % g_cap;
+}
+
+static bool ensureBuffer()
+{
+    if (g_buf)
+        return true;
+    if (g_allocTried)
+        return false;
+
+    g_allocTried = true;
+
+    if (psramFound())
+    {
+        g_buf = (TrackPoint *)ps_malloc(TRACK_BUFFER_POINTS_PSRAM * sizeof(TrackPoint));
+        if (g_buf)
+        {
+            g_cap = TRACK_BUFFER_POINTS_PSRAM;
+            g_inPsram = true;
+        }
+    }
+
+    if (!g_buf)
+    {
+        g_buf = (TrackPoint *)malloc(TRACK_BUFFER_POINTS_HEAP * sizeof(TrackPoint));
+        if (g_buf)
+            g_cap = TRACK_BUFFER_POINTS_HEAP;
+    }
+
+    if (!g_buf)
+    {
+        logSystem("TRACK: buffer alloc FAILED -> track disabled");
+        return false;
+    }
+
+    logSystemf("TRACK: buffer %lu points (%lu bytes) in %s",
+               (unsigned long)g_cap,
+               (unsigned long)(g_cap * sizeof(TrackPoint)),
+               g_inPsram ? "PSRAM" : "heap");
+    return true;
+}
+
+static double pointDistanceM(const TrackPoint &a, const TrackPoint &b)
+{
+    double latA = a.latE7 * 1e-7;
+    double latB = b.latE7 * 1e-7;
+    double x = (b.lonE7 - a.lonE7) * 1e-7 * kDegToRad * cos((latA + latB) * 0.5 * kDegToRad);
+    double y = (latB - latA) * kDegToRad;
+    return sqrt(x * x + y * y) * kEarthRadiusM;
+}
+
+// Avstånd (m) från p till sträckan anchor -> c, i ett lokalt plan kring ankaret.
+static float segmentDistanceM(const TrackPoint &anchor, const TrackPoint &c, const TrackPoint &p)
+{
+    double k = kDegToRad * kEarthRadiusM * 1e-7;
+    double cosLat = cos(anchor.latE7 * 1e-7 * kDegToRad);
+
+    double cx = (c.lonE7 - anchor.lonE7) * k * cosLat;
+    double cy = (c.latE7 - anchor.latE7) * k;
+    double px = (p.lonE7 - anchor.lonE7) * k * cosLat;
+    double py = (p.latE7 - anchor.latE7) * k;
+
+    double len2 = cx * cx + cy * cy;
+    double t = 0.0;
+    if (len2 > 1e-6)
+    {
+        t = (px * cx + py * cy) / len2;
+        if (t < 0.0)
+            t = 0.0;
+        else if (t > 1.0)
+            t = 1.0;
+    }
+
+    double dx = px - t * cx;
+    double dy = py - t * cy;
+    return (float)sqrt(dx * dx + dy * dy);
+}
+
+static void storePoint(const TrackPoint &p)
+{
+    if (g_count == g_cap)
+    {
+        // Full buffert: äldsta punkten får ge plats.
+        g_count--;
+        g_dropped++;
+    }
+
+    g_buf[g_head] = p;
+    g_head = (g_head + 1) % g_cap;
+    g_count++;
+
+    if (g_stored > 0)
+        g_distStoredM += pointDistanceM(g_lastStored, p);
+
+    g_lastStored = p;
+    g_stored++;
+}
+
+// Spara fönstrets sista prov så att senaste position kommer med.
+static void flushWindow()
+{
+    if (g_winN == 0)
+        return;
+
+    g_anchor = g_win[g_winN - 1];
+    storePoint(g_anchor);
+    g_winN = 0;
+}
+
+static void addSample(const TrackPoint &c)
+{
+    g_samples++;
+
+    if (!g_haveAnchor)
+    {
+        storePoint(c);
+        g_anchor = c;
+        g_haveAnchor = true;
+        g_winN = 0;
+        return;
+    }
+
+    bool commit = g_winN >= TRACK_WINDOW_POINTS ||
+                  (uint32_t)(c.ms - g_anchor.ms) >= TRACK_MAX_POINT_GAP_MS;
+
+    for (uint16_t i = 0; !commit && i < g_winN; i++)
+    {
+        if (segmentDistanceM(g_anchor, c, g_win[i]) > TRACK_SIMPLIFY_TOL_M)
+            commit = true;
+    }
+
+    if (!commit)
+    {
+        g_win[g_winN++] = c;
+        return;
+    }
+
+    if (g_winN == 0)
+    {
+        // Inget i fönstret (t.ex. lång lucka): spara provet direkt.
+        storePoint(c);
+        g_anchor = c;
+        return;
+    }
+
+    flushWindow();
+    g_win[g_winN++] = c;
+}
+
+// ============================================================
+// Public API
+// ============================================================
+
+void gpsTrackTick(uint32_t nowMs, bool enabled)
+{
+    if (!enabled)
+    {
+        if (g_enabled)
+        {
+            // Inspelningen stängs av: spara senaste position och börja
+            // om med nytt ankare nästa gång.
+            flushWindow();
+            g_haveAnchor = false;
+            g_enabled = false;
+            logSystemf("TRACK: stopped, %lu points pending", (unsigned long)g_count);
+        }
+        return;
+    }
+
+    if (!ensureBuffer())
+        return;
+
+    if (!g_enabled)
+    {
+        g_enabled = true;
+        g_haveAnchor = false;
+        g_winN = 0;
+        logSystem("TRACK: recording");
+    }
+
+    if ((uint32_t)(nowMs - g_lastSampleMs) < TRACK_SAMPLE_INTERVAL_MS)
+        return;
+
+    ExtGnssFix fx;
+    if (!gpsFilterGetLatest(fx, nowMs))
+        return;
+
+    // Samma epok som förra provet: ingen ny information.
+    if (fx.seq != 0 && fx.seq == g_lastSampleSeq)
+        return;
+
+    g_lastSampleMs = nowMs;
+    g_lastSampleSeq = fx.seq;
+
+    TrackPoint p;
+    p.ms = nowMs;
+    p.latE7 = (int32_t)lround(fx.lat * 1e7);
+    p.lonE7 = (int32_t)lround(fx.lon * 1e7);
+    p.speedDkmh = (uint16_t)constrain(lroundf(fx.speedKmh * 10.0f), 0L, 65535L);
+    p.reserved = 0;
+
+    addSample(p);
+}
+
+bool gpsTrackBatchDue(uint32_t nowMs)
+{
+    if (!g_buf)
+        return false;
+
+    uint32_t pending = g_count + (g_winN > 0 ? 1 : 0);
+    if (pending == 0)
+        return false;
+
+    if (!g_enabled)
+        return true;
+
+    if (g_count >= TRACK_BATCH_MAX_POINTS)
+        return true;
+
+    uint32_t oldestMs = g_count > 0 ? g_buf[ringIndex(0)].ms : g_win[0].ms;
+    return (uint32_t)(nowMs - oldestMs) >= TRACK_BATCH_INTERVAL_MS;
+}
+
+uint32_t gpsTrackPendingCount()
+{
+    return g_count;
+}
+
+// Punkt i i batchen: först ringbufferten, sist ev. fönstrets sista prov.
+static const TrackPoint &batchPoint(uint16_t i, uint16_t ringN)
+{
+    return i < ringN ? g_buf[ringIndex(i)] : g_win[g_winN - 1];
+}
+
+String gpsTrackBuildBatchJson(uint32_t nowMs, uint16_t &outCount)
+{
+    outCount = 0;
+    g_batchHasTail = false;
+
+    if (!g_buf)
+        return "";
+
+    // Senaste position kommer med som fönstrets sista prov när alla
+    // sparade punkter ryms; fönstret lämnas orört.
+    const uint16_t ringN = (uint16_t)(g_count < TRACK_BATCH_MAX_POINTS ? g_count : TRACK_BATCH_MAX_POINTS);
+    const bool withTail = g_winN > 0 && ringN < TRACK_BATCH_MAX_POINTS;
+    const uint16_t n = (uint16_t)(ringN + (withTail ? 1 : 0));
+
+    if (n == 0)
+        return "";
+
+    const TrackPoint &first = batchPoint(0, ringN);
+
+    // Absolut starttid om klockan är giltig, annars 0.
+    uint32_t t0 = 0;
+    if (timeIsValid())
+        t0 = timeEpochUtc() - (nowMs - first.ms) / 1000UL;
+
+    // Delta i 1e-6 grader (~0,1 m) från föregående punkt, tid i hela sekunder.
+    int32_t prevLat = (int32_t)lround(first.latE7 / 10.0);
+    int32_t prevLon = (int32_t)lround(first.lonE7 / 10.0);
+    uint32_t prevS = 0;
+
+    String json;
+    json.reserve(96 + n * 24);
+
+    json += "\"mode\":\"batch\",";
+    json += "\"fmt\":\"delta_e6\",";
+    json += "\"t0\":" + String(t0) + ",";
+    json += "\"lat0\":" + String(prevLat) + ",";
+    json += "\"lon0\":" + String(prevLon) + ",";
+    json += "\"n\":" + String(n) + ",";
+    json += "\"pts\":[";
+
+    for (uint16_t i = 0; i < n; i++)
+    {
+        const TrackPoint &p = batchPoint(i, ringN);
+
+        int32_t lat = (int32_t)lround(p.latE7 / 10.0);
+        int32_t lon = (int32_t)lround(p.lonE7 / 10.0);
+        uint32_t s = (p.ms - first.ms + 500UL) / 1000UL;
+
+        if (i > 0)
+            json += ",";
+
+        json += "[" + String(s - prevS) + "," +
+                String(lat - prevLat) + "," +
+                String(lon - prevLon) + "," +
+                String((p.speedDkmh + 5) / 10) + "]";
+
+        prevLat = lat;
+        prevLon = lon;
+        prevS = s;
+    }
+
+    json += "]";
+
+    g_batchHasTail = withTail;
+    g_batchTailMs = withTail ? g_win[g_winN - 1].ms : 0;
+    outCount = n;
+    return json;
+}
+
+void gpsTrackCommitBatch(uint16_t count, uint32_t payloadBytes)
+{
+    if (!g_buf || count == 0)
+        return;
+
+    // Fönstrets sista prov publicerades: stäng fönstret nu så provet
+    // blir sparad punkt (och nytt ankare) och kvitteras med resten.
+    // Har fönstret fått nya prov sedan dess kvitteras bara ringpunkterna.
+    uint16_t ringCount = count;
+    if (g_batchHasTail)
+    {
+        if (g_winN > 0 && g_win[g_winN - 1].ms == g_batchTailMs)
+            flushWindow();
+        else
+            ringCount--;
+        g_batchHasTail = false;
+    }
+
+    if (ringCount > g_count)
+        ringCount = (uint16_t)g_count;
+
+    for (uint16_t i = 0; i < ringCount; i++)
+    {
+        const TrackPoint &p = g_buf[ringIndex(i)];
+        if (g_haveLastUploaded)
+            g_distUploadedM += pointDistanceM(g_lastUploaded, p);
+        g_lastUploaded = p;
+        g_haveLastUploaded = true;
+    }
+
+    g_count -= ringCount;
+    g_uploaded += count;
+    g_batches++;
+    g_bytesUp += payloadBytes;
+
+    logSystemf("TRACK: batch #%lu committed, %u points, %lu bytes, %lu pending",
+               (unsigned long)g_batches,
+               (unsigned)count,
+               (unsigned long)payloadBytes,
+               (unsigned long)g_count);
+}
+
+String gpsTrackStatsJson()
+{
+    // Förenkling: prover per sparad punkt.
+    float ratio = g_stored > 0 ? (float)g_samples / (float)g_stored : 0.0f;
+
+    // Uppladdade byte per kilometer uppladdat spår.
+    uint32_t bytesPerKm = g_distUploadedM > 1.0
+                              ? (uint32_t)((double)g_bytesUp * 1000.0 / g_distUploadedM)
+                              : 0;
+
+    String json = "{";
+    json += "\"rec\":" + String(g_enabled ? "true" : "false") + ",";
+    json += "\"cap\":" + String(g_cap) + ",";
+    json += "\"psram\":" + String(g_inPsram ? "true" : "false") + ",";
+    json += "\"pending\":" + String(g_count) + ",";
+    json += "\"samples\":" + String(g_samples) + ",";
+    json += "\"stored\":" + String(g_stored) + ",";
+    json += "\"dropped\":" + String(g_dropped) + ",";
+    json += "\"uploaded\":" + String(g_uploaded) + ",";
+    json += "\"batches\":" + String(g_batches) + ",";
+    json += "\"ratio\":" + String(ratio, 1) + ",";
+    json += "\"km\":" + String(g_distStoredM / 1000.0, 2) + ",";
+    json += "\"bytes_per_km\":" + String(bytesPerKm);
+    json += "}";
+    return json;
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <Arduino.h>
+#include "config.h"
+
+// ============================================================
+// GPS track
+// ------------------------------------------------------------
+// Spårinspelning för TRAVEL:
+// - samplar filtrerad fix i TRACK_SAMPLE_INTERVAL_MS
+// - förenklar strömmande (opening window, tolerans i meter)
+// - lagrar sparade punkter i en ringbuffert i PSRAM
+// - bygger delta-kodade batchar för van/ellie/tele/gps
+//
+// Punkter tas bort ur bufferten först när batchen publicerats,
+// så inget försvinner vid täckningsluckor (men vid reboot).
+// ============================================================
+
+// Anropas varje tick. enabled = profilen spelar in spår.
+void gpsTrackTick(uint32_t nowMs, bool enabled);
+
+// true när en batch bör skickas: full batch, äldsta punkt väntat
+// TRACK_BATCH_INTERVAL_MS, eller kvarvarande punkter efter att
+// inspelningen stängts av.
+bool gpsTrackBatchDue(uint32_t nowMs);
+
+// Antal sparade punkter som väntar på uppladdning.
+uint32_t gpsTrackPendingCount();
+
+// Bygger batch-fälten (utan kuvert) för de äldsta punkterna, plus
+// senaste prov i det öppna fönstret om allt ryms. Ändrar inte spåret.
+// outCount sätts till antal punkter i batchen (0 = inget att skicka).
+String gpsTrackBuildBatchJson(uint32_t nowMs, uint16_t &outCount);
+
+// Kvittera att count punkter publicerats med payloadBytes byte.
+void gpsTrackCommitBatch(uint16_t count, uint32_t payloadBytes);
+
+// JSON för health: buffert, kompression och byte per km.
+String gpsTrackStatsJson();
\ No newline at end of file
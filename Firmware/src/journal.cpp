@@ -0,0 +1,626 @@
+#include "journal.h"
+#include "logging.h"
+#include "time_manager.h"
+
+#include <LittleFS.h>
+#include <esp_system.h>
+#include <mbedtls/base64.h>
+
+// ============================================================
+// Journal
+// ------------------------------------------------------------
+// Filer: JOURNAL_FILE (aktuellt segment) och JOURNAL_FILE_OLD.
+// När aktuellt segment nått JOURNAL_SEGMENT_BYTES ersätter det
+// det gamla. Rader samlas i RAM och skrivs i block, så flash
+// skrivs sällan; ERROR skrivs direkt. Blockbufferten ligger i
+// RTC-minne och skrivs ut vid nästa boot om en krasch/watchdog
+// hann före flush, så WARN-rader strax före kraschen finns kvar.
+//
+// Uppladdning: slutet av journalen (JOURNAL_UPLOAD_MAX_BYTES) läses
+// in vid boot, innan nya rader skrivs, och skickas i bitar om
+// JOURNAL_UPLOAD_CHUNK_BYTES. Varje bit komprimeras för sig (LZSS,
+// se docs/mqtt_payload_spec.md) och base64-kodas.
+// ============================================================
+
+static const char JOURNAL_FILE[] = "/journal.log";
+static const char JOURNAL_FILE_OLD[] = "/journal.old";
+
+static const uint32_t CRUMBS_MAGIC = 0x4A524E31UL; // "JRN1"
+static const uint32_t STAGE_MAGIC = 0x4A53544BUL;  // "JSTK"
+
+struct Breadcrumbs
+{
+    uint32_t magic;
+    uint32_t bootCount;
+    uint32_t uptimeMs;
+    uint32_t epoch;
+    char step[24];
+    char modem[24];
+    char recovery[24];
+    uint32_t checksum;
+};
+
+// Överlever allt utom strömavbrott. Läses i journalInit() innan
+// något skrivs över.
+static RTC_NOINIT_ATTR Breadcrumbs g_crumbs;
+static Breadcrumbs g_prevCrumbs;
+static bool g_prevCrumbsValid = false;
+static bool g_crumbsReady = false;
+static const char *g_lastStep = nullptr;
+
+static esp_reset_reason_t g_resetReason = ESP_RST_UNKNOWN;
+
+// Flash
+static bool g_mounted = false;
+static volatile bool g_ready = false;
+
+// Rader som ännu inte skrivits till flash. len/lenInv skrivs efter
+// datat, så en krasch mitt i en append lämnar föregående längd giltig.
+struct JournalStage
+{
+    uint32_t magic;
+    uint16_t len;
+    uint16_t lenInv;
+    char data[JOURNAL_STAGE_BYTES];
+};
+
+static RTC_NOINIT_ATTR JournalStage g_stage;
+static uint32_t g_lastFlushMs = 0;
+static uint32_t g_fileBytes = 0;
+
+// Uppladdning
+static uint8_t *g_excerpt = nullptr;
+static uint32_t g_excerptLen = 0;
+static uint32_t g_uploadPos = 0;
+static uint16_t g_chunkIndex = 0;
+static uint16_t g_chunkCount = 0;
+static uint16_t g_lastChunkRaw = 0;
+static bool g_uploadPending = false;
+
+// Statistik sedan boot
+static uint32_t g_flushes = 0;
+static uint32_t g_linesWritten = 0;
+static uint32_t g_bytesWritten = 0;
+static uint32_t g_writeErrors = 0;
+static uint32_t g_rotations = 0;
+static uint32_t g_chunksSent = 0;
+static uint32_t g_bytesUp = 0;
+
+// ============================================================
+// Brödsmulor
+// ============================================================
+
+static uint32_t crumbsChecksum(const Breadcrumbs &c)
+{
+    // FNV-1a över allt utom checksumman
+    const uint8_t *p = (const uint8_t *)&c;
+    uint32_t h = 2166136261UL;
+    for (size_t i = 0; i < offsetof(Breadcrumbs, checksum); i++)
+    {
+        h ^= p[i];
+        h *= 16777619UL;
+    }
+    return h;
+}
+
+static void crumbsSeal()
+{
+    g_crumbs.checksum = crumbsChecksum(g_crumbs);
+}
+
+static void copyName(char *dst, size_t cap, const char *src)
+{
+    if (!src)
+        src = "";
+    strncpy(dst, src, cap - 1);
+    dst[cap - 1] = 0;
+}
+
+void journalBreadcrumbStep(const char *step, uint32_t nowMs)
+{
+    if (!g_crumbsReady)
+        return;
+
+    g_crumbs.uptimeMs = nowMs;
+
+    if (step != g_lastStep)
+    {
+        g_lastStep = step;
+        copyName(g_crumbs.step, sizeof(g_crumbs.step), step);
+        g_crumbs.epoch = timeEpochUtc();
+    }
+
+    crumbsSeal();
+}
+
+void journalBreadcrumbModem(const char *state)
+{
+    if (!g_crumbsReady)
+        return;
+
+    copyName(g_crumbs.modem, sizeof(g_crumbs.modem), state);
+    crumbsSeal();
+}
+
+void journalBreadcrumbRecovery(const char *reason)
+{
+    if (!g_crumbsReady)
+        return;
+
+    copyName(g_crumbs.recovery, sizeof(g_crumbs.recovery), reason);
+    g_crumbs.epoch = timeEpochUtc();
+    crumbsSeal();
+}
+
+static const char *resetReasonName(esp_reset_reason_t r)
+{
+    switch (r)
+    {
+    case ESP_RST_POWERON:
+        return "POWERON";
+    case ESP_RST_EXT:
+        return "EXT";
+    case ESP_RST_SW:
+        return "SW";
+    case ESP_RST_PANIC:
+        return "PANIC";
+    case ESP_RST_INT_WDT:
+        return "INT_WDT";
+    case ESP_RST_TASK_WDT:
+        return "TASK_WDT";
+    case ESP_RST_WDT:
+        return "WDT";
+    case ESP_RST_DEEPSLEEP:
+        return "DEEPSLEEP";
+    case ESP_RST_BROWNOUT:
+        return "BROWNOUT";
+    case ESP_RST_SDIO:
+        return "SDIO";
+    default:
+        return "UNKNOWN";
+    }
+}
+
+static bool resetIsAbnormal(esp_reset_reason_t r)
+{
+    return r == ESP_RST_PANIC ||
+           r == ESP_RST_INT_WDT ||
+           r == ESP_RST_TASK_WDT ||
+           r == ESP_RST_WDT ||
+           r == ESP_RST_BROWNOUT;
+}
+
+const char *journalResetReasonName()
+{
+    return resetReasonName(g_resetReason);
+}
+
+// ============================================================
+// Flash
+// ============================================================
+
+static uint32_t fileSize(const char *path)
+{
+    if (!LittleFS.exists(path))
+        return 0;
+
+    File f = LittleFS.open(path, FILE_READ);
+    if (!f)
+        return 0;
+
+    uint32_t n = f.size();
+    f.close();
+    return n;
+}
+
+static void rotateIfFull()
+{
+    if (g_fileBytes < JOURNAL_SEGMENT_BYTES)
+        return;
+
+    LittleFS.remove(JOURNAL_FILE_OLD);
+    LittleFS.rename(JOURNAL_FILE, JOURNAL_FILE_OLD);
+    g_fileBytes = 0;
+    g_rotations++;
+}
+
+static void stageSetLen(uint16_t len)
+{
+    g_stage.len = len;
+    g_stage.lenInv = (uint16_t)~len;
+}
+
+static void flushStage(uint32_t nowMs)
+{
+    g_lastFlushMs = nowMs;
+
+    if (g_stage.len == 0)
+        return;
+
+    File f = LittleFS.open(JOURNAL_FILE, FILE_APPEND);
+    size_t written = f ? f.write((const uint8_t *)g_stage.data, g_stage.len) : 0;
+    if (f)
+        f.close();
+
+    if (written != g_stage.len)
+        g_writeErrors++;
+
+    g_fileBytes += written;
+    g_bytesWritten += written;
+    g_flushes++;
+    stageSetLen(0);
+
+    rotateIfFull();
+}
+
+// Rader som låg kvar i RTC-bufferten när förra boot dog. Skrivs till
+// aktuellt segment före utdraget läses in. RTC-minnet är skräp efter
+// strömavbrott, därför krävs magic och giltig längd.
+static void recoverStage()
+{
+    const bool valid = g_resetReason != ESP_RST_POWERON &&
+                       g_stage.magic == STAGE_MAGIC &&
+                       g_stage.lenInv == (uint16_t)~g_stage.len &&
+                       g_stage.len <= sizeof(g_stage.data);
+
+    if (valid && g_stage.len > 0)
+    {
+        const uint16_t len = g_stage.len;
+        flushStage(millis());
+        logSystemf("JOURNAL: recovered %u staged bytes from previous boot", (unsigned)len);
+    }
+
+    g_stage.magic = STAGE_MAGIC;
+    stageSetLen(0);
+}
+
+void journalAppend(const char *line, size_t len, bool flushNow)
+{
+    if (!g_ready)
+        return;
+
+    // Plats för radbrytning
+    if (len > sizeof(g_stage.data) - 1)
+        len = sizeof(g_stage.data) - 1;
+
+    if (g_stage.len + len + 1 > sizeof(g_stage.data))
+        flushStage(millis());
+
+    memcpy(g_stage.data + g_stage.len, line, len);
+    g_stage.data[g_stage.len + len] = '\n';
+    stageSetLen((uint16_t)(g_stage.len + len + 1));
+    g_linesWritten++;
+
+    if (flushNow)
+        flushStage(millis());
+}
+
+void journalFlushIfDue(uint32_t nowMs)
+{
+    if (!g_ready || g_stage.len == 0)
+        return;
+
+    if ((uint32_t)(nowMs - g_lastFlushMs) >= JOURNAL_FLUSH_INTERVAL_MS)
+        flushStage(nowMs);
+}
+
+// Läs slutet av journalen (gammalt + aktuellt segment) till g_excerpt.
+static void loadExcerpt()
+{
+    uint32_t oldLen = fileSize(JOURNAL_FILE_OLD);
+    uint32_t curLen = g_fileBytes;
+    uint32_t total = oldLen + curLen;
+    if (total == 0)
+        return;
+
+    uint32_t skip = total > JOURNAL_UPLOAD_MAX_BYTES ? total - JOURNAL_UPLOAD_MAX_BYTES : 0;
+    uint32_t want = total - skip;
+
+    g_excerpt = psramFound() ? (uint8_t *)ps_malloc(want) : nullptr;
+    if (!g_excerpt)
+        g_excerpt = (uint8_t *)malloc(want);
+    if (!g_excerpt)
+    {
+        logSystem("JOURNAL: excerpt alloc FAILED");
+        return;
+    }
+
+    uint32_t n = 0;
+    const char *paths[2] = {JOURNAL_FILE_OLD, JOURNAL_FILE};
+    uint32_t lens[2] = {oldLen, curLen};
+
+    for (int i = 0; i < 2; i++)
+    {
+        if (skip >= lens[i])
+        {
+            skip -= lens[i];
+            continue;
+        }
+
+        File f = LittleFS.open(paths[i], FILE_READ);
+        if (!f)
+            continue;
+
+        f.seek(skip);
+        n += f.read(g_excerpt + n, want - n);
+        f.close();
+        skip = 0;
+    }
+
+    // Börja på en hel rad om utdraget klipptes.
+    uint32_t start = 0;
+    if (total > JOURNAL_UPLOAD_MAX_BYTES)
+    {
+        while (start < n && g_excerpt[start] != '\n')
+            start++;
+        if (start < n)
+            start++;
+    }
+
+    g_uploadPos = start;
+    g_excerptLen = n;
+}
+
+// ============================================================
+// Komprimering
+// ------------------------------------------------------------
+// LZSS: flaggbyte följt av 8 poster, bit i (LSB först) = 1 betyder
+// referens (2 byte: offset 12 bit, längd-3 4 bit), 0 betyder literal.
+// Referensen pekar offset byte bakåt i den avkodade biten.
+// ============================================================
+
+static const uint16_t LZ_HASH_SIZE = 1024;
+static const uint8_t LZ_MIN_MATCH = 3;
+static const uint8_t LZ_MAX_MATCH = 18;
+static const uint8_t LZ_MAX_CHAIN = 32;
+
+static inline uint16_t lzHash(const uint8_t *p)
+{
+    return (uint16_t)(((p[0] << 6) ^ (p[1] << 3) ^ p[2]) & (LZ_HASH_SIZE - 1));
+}
+
+static size_t lzssCompress(const uint8_t *in, size_t n, uint8_t *out)
+{
+    static int16_t head[LZ_HASH_SIZE];
+    static int16_t prev[JOURNAL_UPLOAD_CHUNK_BYTES];
+
+    for (uint16_t i = 0; i < LZ_HASH_SIZE; i++)
+        head[i] = -1;
+
+    size_t o = 0;
+    size_t i = 0;
+
+    while (i < n)
+    {
+        size_t flagPos = o++;
+        uint8_t flags = 0;
+
+        for (uint8_t bit = 0; bit < 8 && i < n; bit++)
+        {
+            size_t bestLen = 0;
+            size_t bestOff = 0;
+
+            if (i + LZ_MIN_MATCH <= n)
+            {
+                size_t maxLen = n - i < LZ_MAX_MATCH ? n - i : LZ_MAX_MATCH;
+                uint8_t chain = LZ_MAX_CHAIN;
+
+                for (int16_t j = head[lzHash(in + i)]; j >= 0 && chain > 0; j = prev[j], chain--)
+                {
+                    size_t len = 0;
+                    while (len < maxLen && in[j + len] == in[i + len])
+                        len++;
+
+                    if (len > bestLen)
+                    {
+                        bestLen = len;
+                        bestOff = i - (size_t)j;
+                        if (len == maxLen)
+                            break;
+                    }
+                }
+            }
+
+            size_t step = 1;
+            if (bestLen >= LZ_MIN_MATCH)
+            {
+                flags |= (uint8_t)(1U << bit);
+                out[o++] = (uint8_t)(bestOff & 0xFF);
+                out[o++] = (uint8_t)(((bestOff >> 8) << 4) | (bestLen - LZ_MIN_MATCH));
+                step = bestLen;
+            }
+            else
+            {
+                out[o++] = in[i];
+            }
+
+            for (size_t k = 0; k < step; k++, i++)
+            {
+                if (i + LZ_MIN_MATCH <= n)
+                {
+                    uint16_t h = lzHash(in + i);
+                    prev[i] = head[h];
+                    head[h] = (int16_t)i;
+                }
+            }
+        }
+
+        out[flagPos] = flags;
+    }
+
+    return o;
+}
+
+// ============================================================
+// Public API
+// ============================================================
+
+void journalInit()
+{
+    g_resetReason = esp_reset_reason();
+
+    if (g_crumbs.magic == CRUMBS_MAGIC && g_crumbs.checksum == crumbsChecksum(g_crumbs))
+    {
+        g_prevCrumbs = g_crumbs;
+        g_prevCrumbsValid = true;
+    }
+
+    memset(&g_crumbs, 0, sizeof(g_crumbs));
+    g_crumbs.magic = CRUMBS_MAGIC;
+    g_crumbs.bootCount = g_prevCrumbsValid ? g_prevCrumbs.bootCount + 1 : 1;
+    crumbsSeal();
+    g_crumbsReady = true;
+
+    bool abnormal = resetIsAbnormal(g_resetReason);
+
+    if (abnormal && g_prevCrumbsValid)
+    {
+        LOG_ERROR(LogModule::SYS, "BOOT: reset %s after step=%s modem=%s recovery=%s uptime_s=%lu",
+                  resetReasonName(g_resetReason),
+                  g_prevCrumbs.step,
+                  g_prevCrumbs.modem,
+                  g_prevCrumbs.recovery,
+                  (unsigned long)(g_prevCrumbs.uptimeMs / 1000UL));
+    }
+    else
+    {
+        logSystemf("BOOT: reset reason %s boot=%lu",
+                   resetReasonName(g_resetReason),
+                   (unsigned long)g_crumbs.bootCount);
+    }
+
+    if (!LittleFS.begin(true))
+    {
+        logSystem("JOURNAL: LittleFS mount FAILED -> journal disabled");
+        return;
+    }
+
+    g_mounted = true;
+    g_fileBytes = fileSize(JOURNAL_FILE);
+    recoverStage();
+
+    if (abnormal)
+    {
+        loadExcerpt();
+
+        uint32_t bytes = g_excerptLen - g_uploadPos;
+        g_chunkCount = (uint16_t)((bytes + JOURNAL_UPLOAD_CHUNK_BYTES - 1) / JOURNAL_UPLOAD_CHUNK_BYTES);
+        if (g_chunkCount == 0)
+            g_chunkCount = 1; // brödsmulorna skickas ändå
+        g_uploadPending = true;
+
+        logSystemf("JOURNAL: excerpt %lu bytes in %u chunks queued for upload",
+                   (unsigned long)bytes,
+                   (unsigned)g_chunkCount);
+    }
+
+    g_lastFlushMs = millis();
+    g_ready = true;
+
+    logSystemf("JOURNAL: ready file=%lu bytes old=%lu bytes fs_used=%lu/%lu",
+               (unsigned long)g_fileBytes,
+               (unsigned long)fileSize(JOURNAL_FILE_OLD),
+               (unsigned long)LittleFS.usedBytes(),
+               (unsigned long)LittleFS.totalBytes());
+}
+
+bool journalUploadPending()
+{
+    return g_uploadPending;
+}
+
+bool journalBuildChunkJson(String &out)
+{
+    if (!g_uploadPending)
+        return false;
+
+    static uint8_t comp[JOURNAL_UPLOAD_CHUNK_BYTES + JOURNAL_UPLOAD_CHUNK_BYTES / 8 + 1];
+    static unsigned char b64[((sizeof(comp) + 2) / 3) * 4 + 1];
+
+    uint32_t left = g_excerptLen > g_uploadPos ? g_excerptLen - g_uploadPos : 0;
+    uint16_t raw = left < JOURNAL_UPLOAD_CHUNK_BYTES ? (uint16_t)left : JOURNAL_UPLOAD_CHUNK_BYTES;
+
+    size_t compLen = raw > 0 ? lzssCompress(g_excerpt + g_uploadPos, raw, comp) : 0;
+
+    size_t b64Len = 0;
+    mbedtls_base64_encode(b64, sizeof(b64), &b64Len, comp, compLen);
+    b64[b64Len] = 0;
+
+    g_lastChunkRaw = raw;
+
+    out = "";
+    out.reserve(b64Len + 320);
+
+    if (g_chunkIndex == 0)
+    {
+        out += "\"reset_reason\":\"" + String(resetReasonName(g_resetReason)) + "\",";
+        out += "\"boot\":" + String(g_crumbs.bootCount) + ",";
+
+        if (g_prevCrumbsValid)
+        {
+            out += "\"crumbs\":{";
+            out += "\"step\":\"" + String(g_prevCrumbs.step) + "\",";
+            out += "\"modem\":\"" + String(g_prevCrumbs.modem) + "\",";
+            out += "\"recovery\":\"" + String(g_prevCrumbs.recovery) + "\",";
+            out += "\"uptime_s\":" + String(g_prevCrumbs.uptimeMs / 1000UL) + ",";
+            out += "\"epoch_utc\":" + String(g_prevCrumbs.epoch);
+            out += "},";
+        }
+        else
+        {
+            out += "\"crumbs\":null,";
+        }
+    }
+
+    out += "\"chunk\":" + String(g_chunkIndex) + ",";
+    out += "\"chunks\":" + String(g_chunkCount) + ",";
+    out += "\"enc\":\"lzss_b64\",";
+    out += "\"raw_len\":" + String(raw) + ",";
+    out += "\"data\":\"";
+    out += (const char *)b64;
+    out += "\"";
+
+    return true;
+}
+
+void journalCommitChunk()
+{
+    if (!g_uploadPending)
+        return;
+
+    g_uploadPos += g_lastChunkRaw;
+    g_bytesUp += g_lastChunkRaw;
+    g_chunkIndex++;
+    g_chunksSent++;
+
+    if (g_chunkIndex >= g_chunkCount || g_uploadPos >= g_excerptLen)
+    {
+        g_uploadPending = false;
+        free(g_excerpt);
+        g_excerpt = nullptr;
+        g_excerptLen = 0;
+        g_uploadPos = 0;
+
+        logSystemf("JOURNAL: upload done chunks=%u bytes=%lu",
+                   (unsigned)g_chunkIndex,
+                   (unsigned long)g_bytesUp);
+    }
+}
+
+String journalStatsJson()
+{
+    String json = "{";
+    json += "\"fs\":" + String(g_mounted ? "true" : "false") + ",";
+    json += "\"boot\":" + String(g_crumbs.bootCount) + ",";
+    json += "\"reset\":\"" + String(resetReasonName(g_resetReason)) + "\",";
+    json += "\"file\":" + String(g_fileBytes) + ",";
+    json += "\"lines\":" + String(g_linesWritten) + ",";
+    json += "\"bytes\":" + String(g_bytesWritten) + ",";
+    json += "\"flushes\":" + String(g_flushes) + ",";
+    json += "\"rot\":" + String(g_rotations) + ",";
+    json += "\"err\":" + String(g_writeErrors) + ",";
+    json += "\"up_pending\":" + String(g_uploadPending ? "true" : "false") + ",";
+    json += "\"up_chunks\":" + String(g_chunksSent);
+    json += "}";
+    return json;
+}
\ No newline at end of file
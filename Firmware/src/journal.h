@@ -0,0 +1,48 @@
+#pragma once
+
+#include <Arduino.h>
+#include "config.h"
+
+// ============================================================
+// Loggjournal och crash-brödsmulor
+// ------------------------------------------------------------
+// - WARN/ERROR-rader sparas i flash (LittleFS) och överlever reboot
+// - brödsmulor (pipeline-steg, modem-state, recovery-orsak) hålls
+//   i RTC-minne och uppdateras löpande, så de finns kvar även efter
+//   watchdog-, panic- eller brownout-reset
+// - efter onormal reset laddas slutet av journalen upp i
+//   komprimerade bitar efter nästa MQTT-connect
+// ============================================================
+
+// Monterar filsystemet, läser brödsmulor från förra boot och
+// förbereder uppladdning om föregående reset var onormal.
+// Anropas efter loggingInit().
+void journalInit();
+
+// Lägg en färdigformaterad rad i journalen. Anropas bara från
+// loggtasken. flushNow = skriv till flash direkt (ERROR).
+void journalAppend(const char *line, size_t len, bool flushNow);
+
+// Skriv buffrade rader till flash om intervallet gått. Loggtasken.
+void journalFlushIfDue(uint32_t nowMs);
+
+// Brödsmulor. Strängarna ska vara konstanta namn (kopieras).
+void journalBreadcrumbStep(const char *step, uint32_t nowMs);
+void journalBreadcrumbModem(const char *state);
+void journalBreadcrumbRecovery(const char *reason);
+
+// Namn på föregående resetorsak, t.ex. "TASK_WDT".
+const char *journalResetReasonName();
+
+// true när ett utdrag väntar på uppladdning.
+bool journalUploadPending();
+
+// Bygger nästa bit (utan kuvert): chunk, chunks, enc, raw_len, data
+// och för första biten även reset/brödsmulor. false = inget kvar.
+bool journalBuildChunkJson(String &out);
+
+// Kvittera att senaste biten publicerats.
+void journalCommitChunk();
+
+// JSON för health: journalstorlek, skrivningar och uppladdning.
+String journalStatsJson();
\ No newline at end of file
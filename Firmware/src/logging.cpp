@@ -1,41 +1,846 @@
 #include "logging.h"
+#include "config.h"
+#include "journal.h"
+#include "time_manager.h"
 
 #include <Arduino.h>
 #include <stdarg.h>
+#include <stddef.h>
 
-static String makePrefix()
+// ============================================================
+// Loggning
+// ------------------------------------------------------------
+// Anropet på den varma vägen gör bara:
+// - läser millis()
+// - kopierar formatsträngens adress och argumenten binärt
+//   (eller färdig text) in i en ringbuffert i PSRAM
+// Formatering, tidsstämpel och Serial-utskrift görs av en
+// lågprioriterad task. Inga String- eller heap-allokeringar i anropet.
+//
+// Filtrering per modul och nivå görs i anropet, före kopieringen.
+//
+// Post i ringen (4-byte-justerad):
+//   LogRecHdr | argumentbytes
+// fmt == nullptr: argumentbytes är färdig, nollterminerad text.
+// Argument lagras i den ordning formatsträngen anger: heltal 4 byte
+// (ll 8 byte), flyttal 8 byte (double), %s som nollterminerad kopia.
+// ============================================================
+
+struct LogRecHdr
+{
+  uint16_t len;   // hela posten inkl. header, LOG_WRAP = fortsätt från början
+  uint8_t level;  // LogLevel
+  uint8_t module; // LogModule
+  uint32_t ms;
+  const char *fmt;
+};
+
+static const uint16_t LOG_WRAP = 0xFFFF;
+static const size_t LOG_REC_MAX = sizeof(LogRecHdr) + LOG_TEXT_MAX + 4;
+
+// Ringbuffert
+static uint8_t *g_ring = nullptr;
+static uint32_t g_ringSize = 0;
+static uint32_t g_head = 0; // skrivposition
+static uint32_t g_tail = 0; // läsposition
+static uint32_t g_used = 0;
+static bool g_inPsram = false;
+static portMUX_TYPE g_ringMux = portMUX_INITIALIZER_UNLOCKED;
+
+static TaskHandle_t g_task = nullptr;
+
+// Nivå per modul i drift
+static uint8_t g_moduleLevel[(size_t)LogModule::COUNT] = {
+    LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL,
+    LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL};
+static_assert((size_t)LogModule::COUNT == 8, "g_moduleLevel init");
+
+// Statistik
+static uint32_t g_records = 0;
+static uint32_t g_dropped = 0;
+static uint32_t g_droppedReported = 0;
+static uint32_t g_highWater = 0;
+static uint32_t g_enqueueUsTotal = 0;
+
+// ============================================================
+// Nivåer och moduler
+// ============================================================
+
+struct ModulePrefix
+{
+  const char *prefix; // inkl. ':'
+  LogModule module;
+};
+
+// Prefix som används i befintliga meddelanden -> modul.
+static const ModulePrefix MODULE_PREFIXES[] = {
+    {"MODEM:", LogModule::MODEM},
+    {"MQTT:", LogModule::MQTT},
+    {"PIPELINE:", LogModule::PIPELINE},
+    {"VICTRON:", LogModule::VICTRON},
+    {"TIME:", LogModule::TIME},
+    {"GNSS:", LogModule::GNSS},
+    {"RECOVERY:", LogModule::MODEM},
+    {"PMU:", LogModule::POWER},
+    {"SCHED:", LogModule::POWER},
+    {"PIR:", LogModule::PIPELINE},
+    {"TRACK:", LogModule::GNSS},
+    {"WIFI:", LogModule::MODEM},
+    {"GPSF:", LogModule::GNSS},
+    {"GNSSPWR:", LogModule::GNSS},
+    {"PROFILE:", LogModule::PIPELINE},
+    {"NET_CONNECT:", LogModule::MODEM},
+    {"GPS:", LogModule::GNSS},
+};
+
+static LogModule moduleFromText(const char *s)
+{
+  for (const ModulePrefix &mp : MODULE_PREFIXES)
+  {
+    const char *a = mp.prefix;
+    const char *b = s;
+    while (*a && *a == *b)
+    {
+      a++;
+      b++;
+    }
+    if (*a == 0)
+      return mp.module;
+  }
+  return LogModule::SYS;
+}
+
+static char levelLetter(uint8_t level)
+{
+  static const char letters[] = "-EWIDV";
+  return level < sizeof(letters) - 1 ? letters[level] : '?';
+}
+
+const char *logLevelName(LogLevel level)
+{
+  switch (level)
+  {
+  case LogLevel::NONE:
+    return "NONE";
+  case LogLevel::ERROR:
+    return "ERROR";
+  case LogLevel::WARN:
+    return "WARN";
+  case LogLevel::INFO:
+    return "INFO";
+  case LogLevel::DEBUG:
+    return "DEBUG";
+  case LogLevel::VERBOSE:
+    return "VERBOSE";
+  }
+  return "UNKNOWN";
+}
+
+const char *logModuleName(LogModule module)
+{
+  switch (module)
+  {
+  case LogModule::SYS:
+    return "SYS";
+  case LogModule::MODEM:
+    return "MODEM";
+  case LogModule::MQTT:
+    return "MQTT";
+  case LogModule::PIPELINE:
+    return "PIPELINE";
+  case LogModule::GNSS:
+    return "GNSS";
+  case LogModule::TIME:
+    return "TIME";
+  case LogModule::POWER:
+    return "POWER";
+  case LogModule::VICTRON:
+    return "VICTRON";
+  case LogModule::COUNT:
+    break;
+  }
+  return "UNKNOWN";
+}
+
+bool logLevelFromString(const String &s, LogLevel &out)
+{
+  for (uint8_t i = LOG_LEVEL_NONE; i <= LOG_LEVEL_VERBOSE; i++)
+  {
+    if (s.equalsIgnoreCase(logLevelName((LogLevel)i)))
+    {
+      out = (LogLevel)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool logModuleFromString(const String &s, LogModule &out)
+{
+  for (uint8_t i = 0; i < (uint8_t)LogModule::COUNT; i++)
+  {
+    if (s.equalsIgnoreCase(logModuleName((LogModule)i)))
+    {
+      out = (LogModule)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+void logSetLevel(LogModule module, LogLevel level)
+{
+  if (module >= LogModule::COUNT)
+    return;
+
+  uint8_t l = (uint8_t)level;
+  if (l > LOG_COMPILE_LEVEL)
+    l = LOG_COMPILE_LEVEL;
+  g_moduleLevel[(size_t)module] = l;
+}
+
+void logSetLevelAll(LogLevel level)
+{
+  for (uint8_t i = 0; i < (uint8_t)LogModule::COUNT; i++)
+    logSetLevel((LogModule)i, level);
+}
+
+LogLevel logGetLevel(LogModule module)
+{
+  if (module >= LogModule::COUNT)
+    return LogLevel::NONE;
+  return (LogLevel)g_moduleLevel[(size_t)module];
+}
+
+bool logEnabled(LogModule module, LogLevel level)
+{
+  return module < LogModule::COUNT && (uint8_t)level <= g_moduleLevel[(size_t)module];
+}
+
+// ============================================================
+// Formatspecifikationer
+// ============================================================
+
+enum class ArgKind : uint8_t
+{
+  NONE = 0, // %%
+  INT32,
+  INT64,
+  DOUBLE,
+  STR,
+  BAD // stöds inte uppskjutet (t.ex. '*' eller %n)
+};
+
+// p pekar på tecknet efter '%'. Returnerar pekare efter konverteringstecknet.
+static const char *parseSpec(const char *p, ArgKind &kind)
+{
+  while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0')
+    p++;
+
+  if (*p == '*')
+  {
+    kind = ArgKind::BAD;
+    return p + 1;
+  }
+  while (*p >= '0' && *p <= '9')
+    p++;
+
+  if (*p == '.')
+  {
+    p++;
+    if (*p == '*')
+    {
+      kind = ArgKind::BAD;
+      return p + 1;
+    }
+    while (*p >= '0' && *p <= '9')
+      p++;
+  }
+
+  // Storlek på heltalsargumentet enligt längdmodifierare. 0 = int/long
+  // (styrs av longs). z/t är 4 byte på ESP32, j alltid 8.
+  uint8_t longs = 0;
+  size_t modSize = 0;
+  for (;; p++)
+  {
+    if (*p == 'l')
+      longs++;
+    else if (*p == 'h' || *p == 'L')
+      continue;
+    else if (*p == 'j')
+      modSize = sizeof(intmax_t);
+    else if (*p == 'z')
+      modSize = sizeof(size_t);
+    else if (*p == 't')
+      modSize = sizeof(ptrdiff_t);
+    else
+      break;
+  }
+
+  char c = *p;
+  if (c == 0)
+  {
+    kind = ArgKind::BAD;
+    return p;
+  }
+
+  switch (c)
+  {
+  case '%':
+    kind = ArgKind::NONE;
+    break;
+
+  case 'd':
+  case 'i':
+  case 'u':
+  case 'x':
+  case 'X':
+  case 'o':
+  case 'c':
+    if (longs >= 2 || modSize == 8 || (longs == 1 && sizeof(long) == 8))
+      kind = ArgKind::INT64;
+    else
+      kind = ArgKind::INT32;
+    break;
+
+  case 'p':
+    kind = sizeof(void *) == 8 ? ArgKind::INT64 : ArgKind::INT32;
+    break;
+
+  case 'f':
+  case 'F':
+  case 'e':
+  case 'E':
+  case 'g':
+  case 'G':
+  case 'a':
+  case 'A':
+    kind = ArgKind::DOUBLE;
+    break;
+
+  case 's':
+    kind = ArgKind::STR;
+    break;
+
+  default:
+    kind = ArgKind::BAD;
+    break;
+  }
+
+  return p + 1;
+}
+
+// Plocka argumenten enligt fmt till out. Returnerar antal byte, eller
+// -1 om formatet inte kan skjutas upp eller argumenten inte ryms.
+static int captureArgs(uint8_t *out, size_t cap, const char *fmt, va_list args)
+{
+  size_t n = 0;
+
+  for (const char *p = fmt; *p;)
+  {
+    if (*p++ != '%')
+      continue;
+
+    ArgKind kind;
+    p = parseSpec(p, kind);
+
+    switch (kind)
+    {
+    case ArgKind::NONE:
+      break;
+
+    case ArgKind::INT32:
+    {
+      if (n + 4 > cap)
+        return -1;
+      uint32_t v = va_arg(args, uint32_t);
+      memcpy(out + n, &v, 4);
+      n += 4;
+      break;
+    }
+
+    case ArgKind::INT64:
+    {
+      if (n + 8 > cap)
+        return -1;
+      uint64_t v = va_arg(args, uint64_t);
+      memcpy(out + n, &v, 8);
+      n += 8;
+      break;
+    }
+
+    case ArgKind::DOUBLE:
+    {
+      if (n + 8 > cap)
+        return -1;
+      double v = va_arg(args, double);
+      memcpy(out + n, &v, 8);
+      n += 8;
+      break;
+    }
+
+    case ArgKind::STR:
+    {
+      const char *s = va_arg(args, const char *);
+      if (!s)
+        s = "(null)";
+
+      size_t len = strnlen(s, LOG_STR_ARG_MAX - 1);
+      if (n + len + 1 > cap)
+        return -1;
+      memcpy(out + n, s, len);
+      out[n + len] = 0;
+      n += len + 1;
+      break;
+    }
+
+    default:
+      return -1;
+    }
+  }
+
+  return (int)n;
+}
+
+// Formatera en uppskjuten post. Returnerar antal tecken i out.
+static size_t formatArgs(char *out, size_t cap, const char *fmt, const uint8_t *args, size_t argLen)
+{
+  size_t pos = 0;
+  size_t a = 0;
+  char spec[24];
+
+  for (const char *p = fmt; *p && pos + 1 < cap;)
+  {
+    if (*p != '%')
+    {
+      out[pos++] = *p++;
+      continue;
+    }
+
+    const char *start = p;
+    ArgKind kind;
+    p = parseSpec(p + 1, kind);
+
+    size_t specLen = (size_t)(p - start);
+    if (specLen >= sizeof(spec))
+      specLen = sizeof(spec) - 1;
+    memcpy(spec, start, specLen);
+    spec[specLen] = 0;
+
+    int w = 0;
+    switch (kind)
+    {
+    case ArgKind::NONE:
+      out[pos++] = '%';
+      break;
+
+    case ArgKind::INT32:
+    {
+      uint32_t v = 0;
+      if (a + 4 <= argLen)
+        memcpy(&v, args + a, 4);
+      a += 4;
+      w = snprintf(out + pos, cap - pos, spec, v);
+      break;
+    }
+
+    case ArgKind::INT64:
+    {
+      uint64_t v = 0;
+      if (a + 8 <= argLen)
+        memcpy(&v, args + a, 8);
+      a += 8;
+      w = snprintf(out + pos, cap - pos, spec, v);
+      break;
+    }
+
+    case ArgKind::DOUBLE:
+    {
+      double v = 0.0;
+      if (a + 8 <= argLen)
+        memcpy(&v, args + a, 8);
+      a += 8;
+      w = snprintf(out + pos, cap - pos, spec, v);
+      break;
+    }
+
+    case ArgKind::STR:
+    {
+      const char *s = a < argLen ? (const char *)(args + a) : "";
+      a += strnlen(s, argLen - (a < argLen ? a : argLen)) + 1;
+      w = snprintf(out + pos, cap - pos, spec, s);
+      break;
+    }
+
+    default:
+      break;
+    }
+
+    if (w > 0)
+      pos += (size_t)w < cap - pos ? (size_t)w : cap - pos - 1;
+  }
+
+  out[pos] = 0;
+  return pos;
+}
+
+// ============================================================
+// Utskrift
+// ============================================================
+
+// Formatera och skriv ut en post. journal = raden får sparas i flash
+// (bara från loggtasken).
+static void printRecord(const LogRecHdr &h, const uint8_t *data, size_t dataLen, bool journal)
+{
+  char line[LOG_TEXT_MAX + 48];
+  size_t pos = 0;
+
+  // Väggtid för posten: nuvarande tid minus postens ålder.
+  uint32_t ageMs = millis() - h.ms;
+  TimeStamp ts;
+  timeFormatStamp(timeEpochUtc() - ageMs / 1000UL, ts);
+
+  if (ts.valid)
+  {
+    memcpy(line, ts.dateLocal, 10);
+    line[10] = ' ';
+    memcpy(line + 11, ts.clockLocal, 8);
+    pos = 19;
+  }
+  else
+  {
+    // Fallback innan systemtid har synkats
+    memcpy(line, "---- -- -- --:--:--", 19);
+    pos = 19;
+  }
+
+  pos += snprintf(line + pos, sizeof(line) - pos, " | %lus | %c %-8s | ",
+                  (unsigned long)(h.ms / 1000UL),
+                  levelLetter(h.level),
+                  logModuleName((LogModule)h.module));
+
+  if (h.fmt)
+  {
+    pos += formatArgs(line + pos, sizeof(line) - pos, h.fmt, data, dataLen);
+  }
+  else
+  {
+    size_t n = strnlen((const char *)data, dataLen);
+    if (n > sizeof(line) - pos - 1)
+      n = sizeof(line) - pos - 1;
+    memcpy(line + pos, data, n);
+    pos += n;
+  }
+
+  Serial.write((const uint8_t *)line, pos);
+  Serial.write((const uint8_t *)"\r\n", 2);
+
+  if (journal && h.level <= LOG_JOURNAL_LEVEL)
+    journalAppend(line, pos, h.level <= LOG_LEVEL_ERROR);
+}
+
+// ============================================================
+// Ringbuffert
+// ============================================================
+
+static inline uint32_t align4(uint32_t n)
+{
+  return (n + 3U) & ~3U;
+}
+
+// Lägg en post i ringen: header + data + ev. nollterminator.
+// Returnerar false om den inte fick plats.
+static bool ringPush(const LogRecHdr &hdr, const void *data, uint32_t dataLen, bool terminate)
+{
+  uint32_t total = align4(sizeof(LogRecHdr) + dataLen + (terminate ? 1 : 0));
+  bool ok = false;
+
+  portENTER_CRITICAL(&g_ringMux);
+
+  uint32_t free = g_ringSize - g_used;
+  uint32_t toEnd = g_ringSize - g_head;
+
+  // Får inte posten plats före slutet markeras resten som hopp.
+  uint32_t need = toEnd < total ? toEnd + total : total;
+
+  if (need <= free)
+  {
+    if (toEnd < total)
+    {
+      uint16_t wrap = LOG_WRAP;
+      memcpy(g_ring + g_head, &wrap, sizeof(wrap));
+      g_used += toEnd;
+      g_head = 0;
+    }
+
+    LogRecHdr h = hdr;
+    h.len = (uint16_t)total;
+    memcpy(g_ring + g_head, &h, sizeof(h));
+    memcpy(g_ring + g_head + sizeof(h), data, dataLen);
+    if (terminate)
+      g_ring[g_head + sizeof(h) + dataLen] = 0;
+
+    g_head += total;
+    if (g_head == g_ringSize)
+      g_head = 0;
+    g_used += total;
+
+    if (g_used > g_highWater)
+      g_highWater = g_used;
+    g_records++;
+    ok = true;
+  }
+  else
+  {
+    g_dropped++;
+  }
+
+  portEXIT_CRITICAL(&g_ringMux);
+  return ok;
+}
+
+// Hämta äldsta posten till out. Returnerar postens längd, 0 om tom.
+static uint32_t ringPop(uint8_t *out, uint32_t cap)
+{
+  uint32_t len = 0;
+
+  portENTER_CRITICAL(&g_ringMux);
+
+  if (g_used > 0)
+  {
+    uint16_t l;
+    memcpy(&l, g_ring + g_tail, sizeof(l));
+
+    if (l == LOG_WRAP)
+    {
+      g_used -= g_ringSize - g_tail;
+      g_tail = 0;
+      memcpy(&l, g_ring, sizeof(l));
+    }
+
+    len = l <= cap ? l : cap;
+    memcpy(out, g_ring + g_tail, len);
+
+    g_tail += l;
+    if (g_tail == g_ringSize)
+      g_tail = 0;
+    g_used -= l;
+  }
+
+  portEXIT_CRITICAL(&g_ringMux);
+  return len;
+}
+
+static void logTask(void *)
 {
-  tm timeInfo{};
+  static uint8_t rec[LOG_REC_MAX];
+
+  for (;;)
+  {
+    uint32_t len = ringPop(rec, sizeof(rec));
+    if (len == 0)
+    {
+      if (g_dropped != g_droppedReported)
+      {
+        uint32_t d = g_dropped;
+        Serial.printf("LOG: %lu records dropped (ring full)\r\n", (unsigned long)(d - g_droppedReported));
+        g_droppedReported = d;
+      }
+
+      journalFlushIfDue(millis());
 
-  if (getLocalTime(&timeInfo, 0))
+      vTaskDelay(pdMS_TO_TICKS(LOG_TASK_IDLE_MS));
+      continue;
+    }
+
+    LogRecHdr h;
+    memcpy(&h, rec, sizeof(h));
+    printRecord(h, rec + sizeof(h), len - sizeof(h), true);
+  }
+}
+
+// Skriv posten direkt (före init eller om ringen saknas).
+static void emitNow(const LogRecHdr &h, const void *data, uint32_t dataLen, bool terminate)
+{
+  if (!terminate)
   {
-    char buf[32];
-    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &timeInfo);
-    return String(buf) + " | " + String(millis() / 1000) + "s | ";
+    printRecord(h, (const uint8_t *)data, dataLen, false);
+    return;
   }
 
-  // Fallback innan systemtid har synkats
-  return String("---- -- -- --:--:-- | ") + String(millis() / 1000) + "s | ";
+  char buf[LOG_TEXT_MAX];
+  uint32_t n = dataLen < sizeof(buf) - 1 ? dataLen : sizeof(buf) - 1;
+  memcpy(buf, data, n);
+  buf[n] = 0;
+  printRecord(h, (const uint8_t *)buf, n + 1, false);
 }
 
+static void enqueue(const LogRecHdr &h, const void *data, uint32_t dataLen, bool terminate)
+{
+  if (!g_task)
+  {
+    emitNow(h, data, dataLen, terminate);
+    return;
+  }
+
+  uint32_t startUs = micros();
+  ringPush(h, data, dataLen, terminate);
+  g_enqueueUsTotal += micros() - startUs;
+}
+
+// Format som inte kan skjutas upp formateras direkt till text.
+// Egen funktion så att textbufferten inte belastar anroparens stack
+// i det vanliga fallet.
+static void __attribute__((noinline)) enqueueFormatted(LogRecHdr &h, const char *fmt, va_list args)
+{
+  char buf[LOG_TEXT_MAX];
+  vsnprintf(buf, sizeof(buf), fmt, args);
+
+  h.fmt = nullptr;
+  enqueue(h, buf, (uint32_t)strnlen(buf, sizeof(buf) - 1), true);
+}
+
+// ============================================================
+// Public API
+// ============================================================
+
 void loggingInit()
 {
-  Serial.println("LOG: Serial-only logging");
+  if (g_task)
+    return;
+
+  if (psramFound())
+  {
+    g_ring = (uint8_t *)ps_malloc(LOG_RING_BYTES_PSRAM);
+    if (g_ring)
+    {
+      g_ringSize = LOG_RING_BYTES_PSRAM;
+      g_inPsram = true;
+    }
+  }
+
+  if (!g_ring)
+  {
+    g_ring = (uint8_t *)malloc(LOG_RING_BYTES_HEAP);
+    if (g_ring)
+      g_ringSize = LOG_RING_BYTES_HEAP;
+  }
+
+  if (!g_ring)
+  {
+    Serial.println("LOG: ring alloc FAILED -> synchronous logging");
+    return;
+  }
+
+  // Låg prioritet på core 0: huvudloopen och GNSS-tasken ligger på core 1.
+  BaseType_t ok = xTaskCreatePinnedToCore(logTask, "log", LOG_TASK_STACK, nullptr, 1, &g_task, 0);
+  if (ok != pdPASS)
+  {
+    g_task = nullptr;
+    Serial.println("LOG: task create FAILED -> synchronous logging");
+    return;
+  }
+
+  Serial.printf("LOG: deferred logging, ring %lu bytes in %s\r\n",
+                (unsigned long)g_ringSize,
+                g_inPsram ? "PSRAM" : "heap");
+}
+
+static void logText(LogModule module, LogLevel level, const char *msg)
+{
+  LogRecHdr h{};
+  h.ms = millis();
+  h.level = (uint8_t)level;
+  h.module = (uint8_t)module;
+  h.fmt = nullptr;
+
+  enqueue(h, msg, (uint32_t)strnlen(msg, LOG_TEXT_MAX - 1), true);
+}
+
+static void logVWrite(LogModule module, LogLevel level, const char *fmt, va_list ap)
+{
+  LogRecHdr h{};
+  h.ms = millis();
+  h.level = (uint8_t)level;
+  h.module = (uint8_t)module;
+  h.fmt = fmt;
+
+  uint8_t args[LOG_ARGS_MAX];
+
+  va_list ap2;
+  va_copy(ap2, ap);
+
+  int n = captureArgs(args, sizeof(args), fmt, ap);
+
+  if (n >= 0)
+    enqueue(h, args, (uint32_t)n, false);
+  else
+    enqueueFormatted(h, fmt, ap2);
+
+  va_end(ap2);
+}
+
+void logSystem(const char *msg)
+{
+  LogModule module = moduleFromText(msg);
+  if (!logEnabled(module, LogLevel::INFO))
+    return;
+
+  logText(module, LogLevel::INFO, msg);
 }
 
 void logSystem(const String &msg)
 {
-  Serial.println(makePrefix() + msg);
+  logSystem(msg.c_str());
 }
 
 void logSystemf(const char *fmt, ...)
 {
-  char buf[160];
+  LogModule module = moduleFromText(fmt);
+  if (!logEnabled(module, LogLevel::INFO))
+    return;
 
-  va_list args;
-  va_start(args, fmt);
-  vsnprintf(buf, sizeof(buf), fmt, args);
-  va_end(args);
+  va_list ap;
+  va_start(ap, fmt);
+  logVWrite(module, LogLevel::INFO, fmt, ap);
+  va_end(ap);
+}
+
+void logWrite(LogModule module, LogLevel level, const char *fmt, ...)
+{
+  va_list ap;
+  va_start(ap, fmt);
+  logVWrite(module, level, fmt, ap);
+  va_end(ap);
+}
+
+void logWrite(LogModule module, LogLevel level, const String &msg)
+{
+  logText(module, level, msg.c_str());
+}
+
+String loggingStatsJson()
+{
+  uint32_t avgUs = g_records ? g_enqueueUsTotal / g_records : 0;
+
+  String json = "{";
+  json += "\"recs\":" + String(g_records) + ",";
+  json += "\"dropped\":" + String(g_dropped) + ",";
+  json += "\"ring\":" + String(g_ringSize) + ",";
+  json += "\"hwm\":" + String(g_highWater) + ",";
+  json += "\"enq_us\":" + String(avgUs) + ",";
+  json += "\"compile_level\":" + String(LOG_COMPILE_LEVEL) + ",";
+
+  json += "\"levels\":{";
+  for (uint8_t i = 0; i < (uint8_t)LogModule::COUNT; i++)
+  {
+    if (i > 0)
+      json += ",";
+    json += "\"" + String(logModuleName((LogModule)i)) + "\":\"" +
+            logLevelName((LogLevel)g_moduleLevel[i]) + "\"";
+  }
+  json += "}";
 
-  logSystem(String(buf));
+  json += "}";
+  return json;
 }
\ No newline at end of file
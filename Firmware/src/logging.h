@@ -1,13 +1,121 @@
 #pragma once
 
 #include <Arduino.h>
+#include "config.h"
 
-// Initierar loggsystemet.
+// ============================================================
+// Loggnivåer och moduler
+// ------------------------------------------------------------
+// Nivåer över LOG_COMPILE_LEVEL (config.h) kompileras bort helt:
+// LOG_DEBUG(...) blir en tom sats och argumenten beräknas aldrig,
+// så inga String-objekt byggs i produktionsbygget.
+// Nivå per modul kan dessutom sänkas/höjas i drift via MQTT.
+// ============================================================
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+#define LOG_LEVEL_VERBOSE 5
+
+enum class LogLevel : uint8_t
+{
+    NONE = LOG_LEVEL_NONE,
+    ERROR = LOG_LEVEL_ERROR,
+    WARN = LOG_LEVEL_WARN,
+    INFO = LOG_LEVEL_INFO,
+    DEBUG = LOG_LEVEL_DEBUG,
+    VERBOSE = LOG_LEVEL_VERBOSE
+};
+
+enum class LogModule : uint8_t
+{
+    SYS = 0,  // BOOT och övrigt
+    MODEM,    // MODEM, RECOVERY, NET_CONNECT, WIFI
+    MQTT,
+    PIPELINE, // PIPELINE, PIR, PROFILE
+    GNSS,     // GNSS, GPS, GPSF, GNSSPWR, TRACK
+    TIME,
+    POWER,    // PMU, SCHED
+    VICTRON,
+    COUNT
+};
+
+const char *logLevelName(LogLevel level);
+const char *logModuleName(LogModule module);
+
+// Tolkar namn från MQTT ("DEBUG", "MQTT", ...). Skiftlägesokänsligt.
+bool logLevelFromString(const String &s, LogLevel &out);
+bool logModuleFromString(const String &s, LogModule &out);
+
+// Nivå per modul i drift. Kan inte höjas över LOG_COMPILE_LEVEL.
+void logSetLevel(LogModule module, LogLevel level);
+void logSetLevelAll(LogLevel level);
+LogLevel logGetLevel(LogModule module);
+bool logEnabled(LogModule module, LogLevel level);
+
+// Initierar loggsystemet: ringbuffert och utskriftstask.
+// Poster före init skrivs ut direkt.
 void loggingInit();
 
-// Loggar ett vanligt textmeddelande.
+// Loggar ett vanligt textmeddelande på INFO-nivå.
+// Modulen tas från meddelandets prefix ("MODEM: ...", "MQTT: ...").
+// Texten kopieras in i ringbufferten (max LOG_TEXT_MAX tecken).
 void logSystem(const String &msg);
+void logSystem(const char *msg);
 
-// printf-liknande loggfunktion.
+// printf-liknande loggfunktion på INFO-nivå, modul enligt prefix.
 // Exempel: logSystemf("CSQ=%d", csq);
-void logSystemf(const char *fmt, ...);
\ No newline at end of file
+// Formatsträngen måste vara en konstant (literal): bara adressen och
+// argumenten sparas, formateringen görs senare i loggtasken.
+void logSystemf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+// Loggning med explicit modul och nivå. Används via makrona nedan.
+void logWrite(LogModule module, LogLevel level, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+void logWrite(LogModule module, LogLevel level, const String &msg);
+
+#define LOG_AT(level, module, ...)                   \
+    do                                               \
+    {                                                \
+        if (logEnabled((module), (level)))           \
+            logWrite((module), (level), __VA_ARGS__); \
+    } while (0)
+
+#define LOG_NOP(...) \
+    do               \
+    {                \
+    } while (0)
+
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(module, ...) LOG_AT(LogLevel::ERROR, module, __VA_ARGS__)
+#else
+#define LOG_ERROR(module, ...) LOG_NOP()
+#endif
+
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(module, ...) LOG_AT(LogLevel::WARN, module, __VA_ARGS__)
+#else
+#define LOG_WARN(module, ...) LOG_NOP()
+#endif
+
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(module, ...) LOG_AT(LogLevel::INFO, module, __VA_ARGS__)
+#else
+#define LOG_INFO(module, ...) LOG_NOP()
+#endif
+
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(module, ...) LOG_AT(LogLevel::DEBUG, module, __VA_ARGS__)
+#else
+#define LOG_DEBUG(module, ...) LOG_NOP()
+#endif
+
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_VERBOSE
+#define LOG_VERBOSE(module, ...) LOG_AT(LogLevel::VERBOSE, module, __VA_ARGS__)
+#else
+#define LOG_VERBOSE(module, ...) LOG_NOP()
+#endif
+
+// Kompakt JSON för health: poster, tappade poster, buffertnivå och
+// aktuell nivå per modul.
+String loggingStatsJson();
\ No newline at end of file
@@ -8,6 +8,7 @@
 #include "profiles.h"
 #include "time_manager.h"
 #include "logging.h"
+#include "journal.h"
 #include "pipeline.h"
 
 void setup()
@@ -21,7 +22,10 @@ void setup()
 
   // Initiera loggsystemet tidigt så att resten av uppstarten kan loggas
   loggingInit();
-  logSystem("BOOT: terminal logging only");
+
+  // Journal i flash och brödsmulor från förra boot. Före pipelineInit
+  // så att brödsmulorna inte skrivs över innan de lästs.
+  journalInit();
 
   // Initiera tidshantering och defaultprofil
   timeInit();
@@ -30,7 +34,7 @@ void setup()
   // Initiera PMU och nödvändig matning
   if (!powerInit())
   {
-    logSystem("BOOT: powerInit FAILED");
+    LOG_ERROR(LogModule::SYS, "BOOT: powerInit FAILED");
   }
 
   // Initiera modemets UART/GPIO och MQTT-lagret
@@ -1,6 +1,8 @@
 #include "modem.h"
 #include "config.h"
+#include "journal.h"
 #include "logging.h"
+#include "power.h"
 
 #include <TinyGsmClient.h>
 
@@ -20,6 +22,25 @@ static const uint32_t MODEM_RF_SETTLE_NORMAL_MS = 1500UL;
 static const uint32_t MODEM_RF_SETTLE_FALLBACK_MS = 2500UL;
 static const uint32_t MODEM_RF_RESTART_PAUSE_MS = 1200UL;
 
+// Reset/recovery
+static const uint32_t MODEM_PWRKEY_OFF_PULSE_MS = 1500UL;
+static const uint32_t MODEM_PWRKEY_ON_PULSE_MS = 1200UL;
+static const uint32_t MODEM_PDP_SETTLE_MS = 1000UL;
+static const uint32_t MODEM_RAIL_ON_SETTLE_MS = 500UL;
+// Efter CFUN=1,1 / PWRKEY svarar modemet ibland en kort stund innan det
+// faktiskt startat om. Vänta därför innan vi börjar polla AT.
+static const uint32_t MODEM_BOOT_QUIET_MS = 2000UL;
+// CPSI-läsning och statuslogg under väntan på nätregistrering.
+static const uint32_t MODEM_WAIT_NET_CELLINFO_MS = 10000UL;
+// AT under reset skickas asynkront; dessa är svarens deadlines.
+static const uint32_t MODEM_RESET_PDP_TIMEOUT_MS = 5000UL;
+static const uint32_t MODEM_RESET_SOFT_TIMEOUT_MS = 10000UL;
+static const uint32_t MODEM_RESET_RF_OFF_TIMEOUT_MS = 5000UL;
+static const uint32_t MODEM_RESET_AT_TIMEOUT_MS = 500UL;
+static const uint32_t MODEM_RESET_AT_POLL_MS = 1000UL;
+// modemRfOff() skickar CFUN=0 asynkront; svaret kan dröja några sekunder.
+static const uint32_t MODEM_RF_OFF_TIMEOUT_MS = 5000UL;
+
 // ============================================================
 // INTERN CONNECT-STATE
 // ============================================================
@@ -40,11 +61,105 @@ struct ModemConnectContext
     bool fallbackUsed = false;
     bool success = false;
 
+    // Senaste CPSI-läsning medan vi väntar på registrering.
+    uint32_t lastCellInfoMs = 0;
+
     NetResult result;
 };
 
 static ModemConnectContext g_conn;
 
+// ============================================================
+// INTERN STATE FÖR ASYNKRONT AT-KOMMANDO
+// ------------------------------------------------------------
+// Ett kommando i taget. Används för korta frågor (t.ex. CCLK) som
+// inte får ligga i den kritiska vägen.
+// ============================================================
+
+struct ModemAsyncAtContext
+{
+    bool busy = false;
+    char cmd[24] = {0};
+    char prefix[12] = {0};
+    char line[96] = {0};
+    uint8_t lineLen = 0;
+    char payload[96] = {0};
+    uint32_t startedAtMs = 0;
+    uint32_t timeoutMs = 0;
+    bool quiet = false;
+    ModemAtCallback cb = nullptr;
+};
+
+static ModemAsyncAtContext g_async;
+
+// true medan CFUN=0 från modemRfOff() väntar på svar. Connect och reset
+// låter det bli klart i stället för att avbryta det, annars kan OK:et
+// tolkas som svar på nästa kommando.
+static bool g_rfOffAsync = false;
+static bool rfOffDraining(uint32_t nowMs);
+
+static void asyncAtBegin(const char *cmd, const char *respPrefix, uint32_t timeoutMs,
+                         ModemAtCallback cb, bool quiet);
+
+// ============================================================
+// CELLINFO-CACHE
+// ============================================================
+
+static ModemCellInfo g_cell;
+static uint32_t g_cellLastPollMs = 0;
+static bool g_cellPolled = false;
+
+static String cellInfoShort();
+
+// ============================================================
+// INTERN RESET-STATE
+// ------------------------------------------------------------
+// Samma modell som connect: ett litet steg per tick, inga långa delay().
+// AT-kommandon under reset skickas via den asynkrona AT-vägen och
+// svaret väntas in i ett *_WAIT-state med deadline.
+// ============================================================
+
+enum class ModemResetState
+{
+    IDLE = 0,
+    PDP_DEACTIVATE,
+    PDP_DEACTIVATE_WAIT,
+    PDP_SETTLE,
+    SOFT_RESET_SEND,
+    SOFT_RESET_WAIT,
+    RF_OFF_WAIT,
+    PWRKEY_OFF_PULSE,
+    PWRKEY_OFF_WAIT,
+    RAIL_OFF_WAIT,
+    RAIL_ON_SETTLE,
+    PWRKEY_ON_PULSE,
+    BOOT_WAIT,
+    DONE_OK,
+    DONE_FAIL
+};
+
+struct ModemResetContext
+{
+    bool busy = false;
+    ModemResetKind kind = ModemResetKind::NONE;
+    ModemResetState state = ModemResetState::IDLE;
+
+    uint32_t offMs = 0;
+    uint32_t bootMs = 0;
+
+    uint32_t startedAtMs = 0;
+    uint32_t stateStartedAtMs = 0;
+    uint32_t stateDeadlineMs = 0;
+
+    // Pågående AT-kommando som reset äger (se resetSendAt).
+    bool atPending = false;
+    bool atDone = false;
+    bool atOk = false;
+    uint32_t atLastSentMs = 0;
+};
+
+static ModemResetContext g_reset;
+
 // ============================================================
 // INTERNA HJÄLPFUNKTIONER
 // ============================================================
@@ -96,6 +211,7 @@ static void connectEnterState(ModemConnectState newState, uint32_t nowMs, uint32
     ModemConnectState old = g_conn.state;
     g_conn.state = newState;
     g_conn.stateStartedAtMs = nowMs;
+    journalBreadcrumbModem(connectStateName(newState));
     g_conn.stateDeadlineMs = (timeoutMs > 0) ? (nowMs + timeoutMs) : 0;
 
     if (timeoutMs > 0)
@@ -121,20 +237,105 @@ static bool connectStateTimedOut(uint32_t nowMs)
     return timeReached(nowMs, g_conn.stateDeadlineMs);
 }
 
-// ------------------------------------------------------------
-// Skicka en PWRKEY-puls till modemet.
-// ------------------------------------------------------------
-static void modemPwrKeyPulse(uint32_t pulseHighMs)
+static const char *resetStateName(ModemResetState s)
 {
-    pinMode(BOARD_MODEM_PWR_PIN, OUTPUT);
+    switch (s)
+    {
+    case ModemResetState::IDLE:
+        return "IDLE";
+    case ModemResetState::PDP_DEACTIVATE:
+        return "PDP_DEACTIVATE";
+    case ModemResetState::PDP_DEACTIVATE_WAIT:
+        return "PDP_DEACTIVATE_WAIT";
+    case ModemResetState::PDP_SETTLE:
+        return "PDP_SETTLE";
+    case ModemResetState::SOFT_RESET_SEND:
+        return "SOFT_RESET_SEND";
+    case ModemResetState::SOFT_RESET_WAIT:
+        return "SOFT_RESET_WAIT";
+    case ModemResetState::RF_OFF_WAIT:
+        return "RF_OFF_WAIT";
+    case ModemResetState::PWRKEY_OFF_PULSE:
+        return "PWRKEY_OFF_PULSE";
+    case ModemResetState::PWRKEY_OFF_WAIT:
+        return "PWRKEY_OFF_WAIT";
+    case ModemResetState::RAIL_OFF_WAIT:
+        return "RAIL_OFF_WAIT";
+    case ModemResetState::RAIL_ON_SETTLE:
+        return "RAIL_ON_SETTLE";
+    case ModemResetState::PWRKEY_ON_PULSE:
+        return "PWRKEY_ON_PULSE";
+    case ModemResetState::BOOT_WAIT:
+        return "BOOT_WAIT";
+    case ModemResetState::DONE_OK:
+        return "DONE_OK";
+    case ModemResetState::DONE_FAIL:
+        return "DONE_FAIL";
+    default:
+        return "UNKNOWN";
+    }
+}
 
-    digitalWrite(BOARD_MODEM_PWR_PIN, LOW);
-    delay(100);
+static void resetEnterState(ModemResetState newState, uint32_t nowMs, uint32_t timeoutMs)
+{
+    ModemResetState old = g_reset.state;
+    g_reset.state = newState;
+    g_reset.stateStartedAtMs = nowMs;
+    g_reset.stateDeadlineMs = (timeoutMs > 0) ? (nowMs + timeoutMs) : 0;
+
+    logSystemf("MODEM: reset state %s -> %s timeout=%lu ms",
+               resetStateName(old),
+               resetStateName(newState),
+               (unsigned long)timeoutMs);
+}
 
-    digitalWrite(BOARD_MODEM_PWR_PIN, HIGH);
-    delay(pulseHighMs);
+static bool resetStateTimedOut(uint32_t nowMs)
+{
+    if (g_reset.stateDeadlineMs == 0)
+        return false;
 
-    digitalWrite(BOARD_MODEM_PWR_PIN, LOW);
+    return timeReached(nowMs, g_reset.stateDeadlineMs);
+}
+
+static void resetAtDone(bool ok, const char *payload)
+{
+    (void)payload;
+    g_reset.atDone = true;
+    g_reset.atOk = ok;
+}
+
+// Skicka ett AT-kommando som reset väntar på. Blockerar inte; svaret
+// hämtas med resetPollAt() på senare ticks.
+static void resetSendAt(const char *cmd, uint32_t timeoutMs, bool quiet)
+{
+    g_reset.atPending = true;
+    g_reset.atDone = false;
+    g_reset.atOk = false;
+    g_reset.atLastSentMs = millis();
+    asyncAtBegin(cmd, "", timeoutMs, resetAtDone, quiet);
+}
+
+// true när svaret (eller timeout) kommit. ok = OK från modemet.
+static bool resetPollAt(uint32_t nowMs, bool &ok)
+{
+    if (!g_reset.atPending)
+        return false;
+
+    modemTickAsyncAt(nowMs);
+    if (!g_reset.atDone)
+        return false;
+
+    ok = g_reset.atOk;
+    g_reset.atPending = false;
+    g_reset.atDone = false;
+    return true;
+}
+
+// Sätt PWRKEY-pinnen. Pulslängden styrs av reset-state machine.
+static void modemPwrKeySet(bool high)
+{
+    pinMode(BOARD_MODEM_PWR_PIN, OUTPUT);
+    digitalWrite(BOARD_MODEM_PWR_PIN, high ? HIGH : LOW);
 }
 
 // ------------------------------------------------------------
@@ -182,6 +383,14 @@ static void modemConfigureRadioAndApn(const char *apn)
     {
         logSystem("MODEM: CNCFG failed");
     }
+
+    // Låt nätet (NITZ) ställa modemets RTC, så CCLK ger riktig tid
+    // direkt efter registrering.
+    modem.sendAT("+CLTS=1");
+    if (modem.waitResponse(2000UL) != 1)
+    {
+        logSystem("MODEM: CLTS=1 failed");
+    }
 }
 
 // ------------------------------------------------------------
@@ -275,6 +484,11 @@ void modemStartConnectData(const char *apn,
 {
     uint32_t nowMs = millis();
 
+    if (!g_rfOffAsync)
+    {
+        modemAbortAsyncAt();
+    }
+
     g_conn.result.connectMs = 0;
     g_conn = ModemConnectContext{};
     g_conn.busy = true;
@@ -324,6 +538,11 @@ bool modemTickConnectData(NetResult &out, bool &success)
     switch (g_conn.state)
     {
     case ModemConnectState::WAIT_AT:
+        if (rfOffDraining(nowMs))
+        {
+            break;
+        }
+
         if (modemTestATOnce())
         {
             logSystem("MODEM: AT OK");
@@ -372,23 +591,28 @@ bool modemTickConnectData(NetResult &out, bool &success)
 
             logSystem("MODEM: wait for network registration (first try)");
             connectEnterState(ModemConnectState::WAIT_NET_FIRST, nowMs, firstTryTimeoutMs);
+            g_conn.lastCellInfoMs = nowMs;
         }
         break;
 
     case ModemConnectState::WAIT_NET_FIRST:
         if (modem.isNetworkConnected())
         {
-            int csq = modem.getSignalQuality();
-            logSystem("MODEM: network registered (CSQ=" + String(csq) + ")");
+            modemReadCellInfo();
+            logSystem("MODEM: network registered (" + cellInfoShort() + ")");
             connectEnterState(ModemConnectState::ACTIVATE_DATA, nowMs, 0);
             break;
         }
 
-        if (((nowMs - g_conn.stateStartedAtMs) % 10000UL) < 200UL)
+        if ((uint32_t)(nowMs - g_conn.lastCellInfoMs) >= MODEM_WAIT_NET_CELLINFO_MS)
         {
-            int csq = modem.getSignalQuality();
+            g_conn.lastCellInfoMs = nowMs;
+
+            // CPSI ger både RAT, band och RSRP i ett svar. Cachen visar
+            // sedan för recovery varför registreringen inte gick.
+            modemReadCellInfo();
             logSystem("MODEM: still waiting net reg... t=" + String((nowMs - g_conn.stateStartedAtMs) / 1000) +
-                      "s CSQ=" + String(csq));
+                      "s " + cellInfoShort());
         }
 
         if (connectStateTimedOut(nowMs))
@@ -428,23 +652,25 @@ bool modemTickConnectData(NetResult &out, bool &success)
         {
             logSystem("MODEM: wait for network registration (fallback)");
             connectEnterState(ModemConnectState::WAIT_NET_FALLBACK, nowMs, g_conn.netRegTimeoutMs);
+            g_conn.lastCellInfoMs = nowMs;
         }
         break;
 
     case ModemConnectState::WAIT_NET_FALLBACK:
         if (modem.isNetworkConnected())
         {
-            int csq = modem.getSignalQuality();
-            logSystem("MODEM: network registered after fallback (CSQ=" + String(csq) + ")");
+            modemReadCellInfo();
+            logSystem("MODEM: network registered after fallback (" + cellInfoShort() + ")");
             connectEnterState(ModemConnectState::ACTIVATE_DATA, nowMs, 0);
             break;
         }
 
-        if (((nowMs - g_conn.stateStartedAtMs) % 10000UL) < 200UL)
+        if ((uint32_t)(nowMs - g_conn.lastCellInfoMs) >= MODEM_WAIT_NET_CELLINFO_MS)
         {
-            int csq = modem.getSignalQuality();
+            g_conn.lastCellInfoMs = nowMs;
+            modemReadCellInfo();
             logSystem("MODEM: fallback waiting net reg... t=" + String((nowMs - g_conn.stateStartedAtMs) / 1000) +
-                      "s CSQ=" + String(csq));
+                      "s " + cellInfoShort());
         }
 
         if (connectStateTimedOut(nowMs))
@@ -483,6 +709,13 @@ bool modemTickConnectData(NetResult &out, bool &success)
         logSystem("MODEM: Local IP: " + g_conn.result.ip);
         logSystem("MODEM: CSQ: " + String(g_conn.result.csq));
 
+        if (modemReadCellInfo())
+        {
+            g_cellPolled = true;
+            g_cellLastPollMs = nowMs;
+            logSystem("MODEM: " + cellInfoShort());
+        }
+
         connectFinishSuccess(nowMs);
 
         out = g_conn.result;
@@ -531,6 +764,290 @@ ModemConnectState modemGetConnectState()
     return g_conn.state;
 }
 
+const char *modemResetKindName(ModemResetKind kind)
+{
+    switch (kind)
+    {
+    case ModemResetKind::NONE:
+        return "NONE";
+    case ModemResetKind::PDP_REACTIVATE:
+        return "PDP_REACTIVATE";
+    case ModemResetKind::SOFT_RESET:
+        return "SOFT_RESET";
+    case ModemResetKind::PWRKEY_CYCLE:
+        return "PWRKEY_CYCLE";
+    case ModemResetKind::RAIL_CYCLE:
+        return "RAIL_CYCLE";
+    default:
+        return "UNKNOWN";
+    }
+}
+
+void modemStartReset(ModemResetKind kind, uint32_t offMs, uint32_t bootMs)
+{
+    uint32_t nowMs = millis();
+
+    // Reset och connect delar UART/modem, kör aldrig båda samtidigt.
+    // PDP/soft reset väntar in ett pågående RF OFF i sitt första steg.
+    modemAbortConnectData();
+    if (!g_rfOffAsync || (kind != ModemResetKind::PDP_REACTIVATE && kind != ModemResetKind::SOFT_RESET))
+    {
+        modemAbortAsyncAt();
+    }
+
+    g_reset = ModemResetContext{};
+    g_reset.busy = true;
+    g_reset.kind = kind;
+    g_reset.offMs = offMs;
+    g_reset.bootMs = bootMs;
+    g_reset.startedAtMs = nowMs;
+    g_reset.stateStartedAtMs = nowMs;
+
+    logSystemf("MODEM: start reset kind=%s", modemResetKindName(kind));
+
+    switch (kind)
+    {
+    case ModemResetKind::PDP_REACTIVATE:
+        resetEnterState(ModemResetState::PDP_DEACTIVATE, nowMs, 0);
+        break;
+
+    case ModemResetKind::SOFT_RESET:
+        resetEnterState(ModemResetState::SOFT_RESET_SEND, nowMs, 0);
+        break;
+
+    case ModemResetKind::PWRKEY_CYCLE:
+        // Snällt RF OFF först om modemet fortfarande svarar. Svarar det
+        // inte går vi vidare till PWRKEY när kommandot timear ut.
+        resetSendAt("+CFUN=0", MODEM_RESET_RF_OFF_TIMEOUT_MS, false);
+        resetEnterState(ModemResetState::RF_OFF_WAIT, nowMs, MODEM_RESET_RF_OFF_TIMEOUT_MS);
+        break;
+
+    case ModemResetKind::RAIL_CYCLE:
+        modemPwrKeySet(false);
+        if (!powerModemRailOff())
+        {
+            // Utan PMU kan vi inte bryta matningen. Gör PWRKEY-cykel i stället.
+            logSystem("MODEM: rail cycle unavailable -> PWRKEY cycle");
+            g_reset.kind = ModemResetKind::PWRKEY_CYCLE;
+            modemPwrKeySet(true);
+            resetEnterState(ModemResetState::PWRKEY_OFF_PULSE, nowMs, MODEM_PWRKEY_OFF_PULSE_MS);
+            break;
+        }
+        resetEnterState(ModemResetState::RAIL_OFF_WAIT, nowMs, offMs);
+        break;
+
+    default:
+        g_reset.busy = false;
+        resetEnterState(ModemResetState::DONE_FAIL, nowMs, 0);
+        break;
+    }
+}
+
+bool modemTickReset(bool &success)
+{
+    uint32_t nowMs = millis();
+    success = false;
+
+    if (!g_reset.busy)
+    {
+        if (g_reset.state == ModemResetState::DONE_OK ||
+            g_reset.state == ModemResetState::DONE_FAIL)
+        {
+            success = (g_reset.state == ModemResetState::DONE_OK);
+            g_reset.state = ModemResetState::IDLE;
+            return true;
+        }
+
+        return false;
+    }
+
+    switch (g_reset.state)
+    {
+    case ModemResetState::PDP_DEACTIVATE:
+    {
+        if (rfOffDraining(nowMs))
+            break;
+
+        logSystem("MODEM: deactivate data bearer (+CNACT=0,0)");
+        resetSendAt("+CNACT=0,0", MODEM_RESET_PDP_TIMEOUT_MS, false);
+        resetEnterState(ModemResetState::PDP_DEACTIVATE_WAIT, nowMs, MODEM_RESET_PDP_TIMEOUT_MS);
+        break;
+    }
+
+    case ModemResetState::PDP_DEACTIVATE_WAIT:
+    {
+        bool ok = false;
+        if (!resetPollAt(nowMs, ok))
+            break;
+
+        if (!ok)
+        {
+            // Bäraren kan redan vara nere, det är inte ett fel i sig.
+            logSystem("MODEM: CNACT=0,0 not confirmed");
+        }
+        resetEnterState(ModemResetState::PDP_SETTLE, nowMs, MODEM_PDP_SETTLE_MS);
+        break;
+    }
+
+    case ModemResetState::PDP_SETTLE:
+        if (resetStateTimedOut(nowMs))
+        {
+            g_reset.busy = false;
+            resetEnterState(ModemResetState::DONE_OK, nowMs, 0);
+        }
+        break;
+
+    case ModemResetState::SOFT_RESET_SEND:
+    {
+        if (rfOffDraining(nowMs))
+            break;
+
+        logSystem("MODEM: soft reset (+CFUN=1,1)");
+        resetSendAt("+CFUN=1,1", MODEM_RESET_SOFT_TIMEOUT_MS, false);
+        resetEnterState(ModemResetState::SOFT_RESET_WAIT, nowMs, MODEM_RESET_SOFT_TIMEOUT_MS);
+        break;
+    }
+
+    case ModemResetState::SOFT_RESET_WAIT:
+    {
+        bool ok = false;
+        if (!resetPollAt(nowMs, ok))
+            break;
+
+        if (!ok)
+        {
+            logSystem("MODEM: CFUN=1,1 not confirmed");
+        }
+        resetEnterState(ModemResetState::BOOT_WAIT, nowMs, g_reset.bootMs);
+        break;
+    }
+
+    case ModemResetState::RF_OFF_WAIT:
+    {
+        bool ok = false;
+        if (!resetPollAt(nowMs, ok))
+            break;
+
+        logSystemf("MODEM: RF off before PWRKEY %s", ok ? "OK" : "not confirmed");
+        modemPwrKeySet(true);
+        resetEnterState(ModemResetState::PWRKEY_OFF_PULSE, nowMs, MODEM_PWRKEY_OFF_PULSE_MS);
+        break;
+    }
+
+    case ModemResetState::PWRKEY_OFF_PULSE:
+        if (resetStateTimedOut(nowMs))
+        {
+            modemPwrKeySet(false);
+            resetEnterState(ModemResetState::PWRKEY_OFF_WAIT, nowMs, g_reset.offMs);
+        }
+        break;
+
+    case ModemResetState::PWRKEY_OFF_WAIT:
+        if (resetStateTimedOut(nowMs))
+        {
+            modemPwrKeySet(true);
+            resetEnterState(ModemResetState::PWRKEY_ON_PULSE, nowMs, MODEM_PWRKEY_ON_PULSE_MS);
+        }
+        break;
+
+    case ModemResetState::RAIL_OFF_WAIT:
+        if (resetStateTimedOut(nowMs))
+        {
+            powerModemRailOn();
+            resetEnterState(ModemResetState::RAIL_ON_SETTLE, nowMs, MODEM_RAIL_ON_SETTLE_MS);
+        }
+        break;
+
+    case ModemResetState::RAIL_ON_SETTLE:
+        if (resetStateTimedOut(nowMs))
+        {
+            modemPwrKeySet(true);
+            resetEnterState(ModemResetState::PWRKEY_ON_PULSE, nowMs, MODEM_PWRKEY_ON_PULSE_MS);
+        }
+        break;
+
+    case ModemResetState::PWRKEY_ON_PULSE:
+        if (resetStateTimedOut(nowMs))
+        {
+            modemPwrKeySet(false);
+            resetEnterState(ModemResetState::BOOT_WAIT, nowMs, g_reset.bootMs);
+        }
+        break;
+
+    case ModemResetState::BOOT_WAIT:
+    {
+        // Efter tyst period: fråga med "AT" och vänta in svaret på
+        // senare ticks. Nytt försök högst var MODEM_RESET_AT_POLL_MS.
+        bool atOk = false;
+        if (g_reset.atPending)
+        {
+            resetPollAt(nowMs, atOk);
+        }
+        else if ((uint32_t)(nowMs - g_reset.stateStartedAtMs) >= MODEM_BOOT_QUIET_MS &&
+                 (uint32_t)(nowMs - g_reset.atLastSentMs) >= MODEM_RESET_AT_POLL_MS)
+        {
+            resetSendAt("", MODEM_RESET_AT_TIMEOUT_MS, true);
+        }
+
+        if (atOk)
+        {
+            logSystemf("MODEM: reset %s done, AT OK after %lu ms",
+                       modemResetKindName(g_reset.kind),
+                       (unsigned long)(nowMs - g_reset.startedAtMs));
+            g_reset.busy = false;
+            resetEnterState(ModemResetState::DONE_OK, nowMs, 0);
+            break;
+        }
+
+        if (resetStateTimedOut(nowMs))
+        {
+            logSystemf("MODEM: reset %s done, no AT after %lu ms",
+                       modemResetKindName(g_reset.kind),
+                       (unsigned long)(nowMs - g_reset.startedAtMs));
+            modemAbortAsyncAt();
+            g_reset.busy = false;
+            resetEnterState(ModemResetState::DONE_FAIL, nowMs, 0);
+        }
+        break;
+    }
+
+    case ModemResetState::DONE_OK:
+    case ModemResetState::DONE_FAIL:
+    case ModemResetState::IDLE:
+    default:
+        break;
+    }
+
+    return false;
+}
+
+void modemAbortReset()
+{
+    if (g_reset.busy)
+    {
+        logSystemf("MODEM: abort reset kind=%s", modemResetKindName(g_reset.kind));
+
+        // Lämna aldrig PWRKEY hög eller modemet strömlöst.
+        modemPwrKeySet(false);
+        if (g_reset.state == ModemResetState::RAIL_OFF_WAIT)
+        {
+            powerModemRailOn();
+        }
+
+        if (g_reset.atPending)
+        {
+            modemAbortAsyncAt();
+        }
+    }
+
+    g_reset = ModemResetContext{};
+}
+
+bool modemIsResetBusy()
+{
+    return g_reset.busy;
+}
+
 // ------------------------------------------------------------
 // Gammal blockerande funktion.
 // Behålls tills pipeline bytts över.
@@ -579,84 +1096,494 @@ int modemGetSignalQuality()
     return csq;
 }
 
-bool modemGetCclk(String &outCclk, uint32_t timeoutMs)
+// ------------------------------------------------------------
+// CPSI-tolkning
+// ------------------------------------------------------------
+// LTE (CAT-M1/NB-IoT):
+//   +CPSI: <sys>,<op>,<mcc>-<mnc>,<tac>,<scellid>,<pcellid>,<band>,<earfcn>,
+//          <dlbw>,<ulbw>,<rsrq>,<rsrp>,<rssi>,<rssnr>
+// GSM:
+//   +CPSI: GSM,<op>,<mcc>-<mnc>,<lac>,<cellid>,<arfcn>,<rxlev>,...
+// Ingen täckning:
+//   +CPSI: NO SERVICE,Online
+// ------------------------------------------------------------
+static const uint8_t CPSI_MAX_FIELDS = 16;
+
+static uint8_t splitCsv(const String &s, String *fields, uint8_t maxFields)
 {
-    outCclk = "";
+    uint8_t n = 0;
+    int start = 0;
 
-    while (SerialAT.available())
+    while (n < maxFields)
     {
-        SerialAT.read();
+        int comma = s.indexOf(',', start);
+        if (comma < 0)
+        {
+            fields[n++] = s.substring(start);
+            break;
+        }
+
+        fields[n++] = s.substring(start, comma);
+        start = comma + 1;
     }
 
-    SerialAT.println("AT+CCLK?");
+    for (uint8_t i = 0; i < n; i++)
+    {
+        fields[i].trim();
+    }
 
-    uint32_t start = millis();
-    String line;
-    String payload;
+    return n;
+}
 
-    while (millis() - start < timeoutMs)
+// "EUTRAN-BAND20" -> 20
+static int parseBand(const String &s)
+{
+    int idx = s.indexOf("BAND");
+    if (idx < 0)
     {
-        while (SerialAT.available())
+        return -1;
+    }
+
+    return (int)s.substring(idx + 4).toInt();
+}
+
+static bool parseCpsi(const String &line, ModemCellInfo &out)
+{
+    String body = line;
+    if (body.startsWith("+CPSI:"))
+    {
+        body = body.substring(6);
+    }
+    body.trim();
+
+    String f[CPSI_MAX_FIELDS];
+    uint8_t n = splitCsv(body, f, CPSI_MAX_FIELDS);
+    if (n < 2)
+    {
+        return false;
+    }
+
+    ModemCellInfo c;
+    c.valid = true;
+    c.rat = f[0];
+    c.online = f[1].equalsIgnoreCase("Online");
+
+    if (c.rat.startsWith("LTE") || c.rat.startsWith("NB"))
+    {
+        if (n < 14)
         {
-            char c = (char)SerialAT.read();
+            return false;
+        }
 
-            if (c == '\r')
-            {
-                continue;
-            }
+        c.oper = f[2];
+        c.tac = strtoul(f[3].c_str(), nullptr, 16);
+        c.cellId = strtoul(f[4].c_str(), nullptr, 10);
+        c.band = parseBand(f[6]);
+        c.earfcn = (int)f[7].toInt();
+        c.rsrq = (int)f[10].toInt();
+        c.rsrp = (int)f[11].toInt();
+        c.rssi = (int)f[12].toInt();
+        c.sinr = (int)f[13].toInt();
+        c.hasLte = true;
+    }
+    else if (c.rat.startsWith("GSM"))
+    {
+        if (n >= 6)
+        {
+            c.oper = f[2];
+            c.tac = strtoul(f[3].c_str(), nullptr, 16);
+            c.cellId = strtoul(f[4].c_str(), nullptr, 10);
+            c.earfcn = (int)f[5].toInt();
+        }
+    }
 
-            if (c == '\n')
-            {
-                line.trim();
-
-                if (line.length() > 0)
-                {
-                    if (line.startsWith("+CCLK:"))
-                    {
-                        payload = line;
-                    }
-                    else if (line == "OK")
-                    {
-                        start = 0;
-                        timeoutMs = 0;
-                        break;
-                    }
-                }
-
-                line = "";
-            }
-            else
-            {
-                line += c;
-            }
+    out = c;
+    return true;
+}
+
+static String cellInfoShort()
+{
+    if (!g_cell.valid)
+    {
+        return "cell=?";
+    }
+
+    if (!g_cell.hasLte)
+    {
+        return "cell=" + g_cell.rat;
+    }
+
+    return "cell=" + g_cell.rat + " band=" + String(g_cell.band) +
+           " rsrp=" + String(g_cell.rsrp) + " sinr=" + String(g_cell.sinr);
+}
+
+bool modemReadCellInfo(uint32_t timeoutMs)
+{
+    modem.sendAT("+CPSI?");
+    if (modem.waitResponse(timeoutMs, GF("+CPSI:")) != 1)
+    {
+        return false;
+    }
+
+    String line = modem.stream.readStringUntil('\n');
+    modem.waitResponse();
+
+    ModemCellInfo parsed;
+    if (!parseCpsi(line, parsed))
+    {
+        logSystem("MODEM: CPSI parse failed: " + line);
+        return false;
+    }
+
+    parsed.readAtMs = millis();
+    g_cell = parsed;
+    return true;
+}
+
+void modemTickCellInfo(uint32_t nowMs)
+{
+    // CPSI läses blockerande och skulle äta upp svaret på ett asynkront kommando.
+    if (g_async.busy)
+    {
+        return;
+    }
+
+    if (g_cellPolled && (uint32_t)(nowMs - g_cellLastPollMs) < CELL_INFO_POLL_INTERVAL_MS)
+    {
+        return;
+    }
+
+    g_cellPolled = true;
+    g_cellLastPollMs = nowMs;
+
+    if (modemReadCellInfo())
+    {
+        logSystem("MODEM: " + cellInfoShort() + " q=" +
+                  modemCellQualityName(modemGetCellQuality(nowMs)));
+    }
+}
+
+const ModemCellInfo &modemGetCellInfo()
+{
+    return g_cell;
+}
+
+ModemCellQuality modemGetCellQuality(uint32_t nowMs, uint32_t maxAgeMs)
+{
+    if (!g_cell.valid || (uint32_t)(nowMs - g_cell.readAtMs) > maxAgeMs)
+    {
+        return ModemCellQuality::UNKNOWN;
+    }
+
+    if (!g_cell.online || g_cell.rat.startsWith("NO SERVICE"))
+    {
+        return ModemCellQuality::NO_SERVICE;
+    }
+
+    if (!g_cell.hasLte)
+    {
+        return ModemCellQuality::FAIR;
+    }
+
+    if (g_cell.rsrp <= CELL_RSRP_POOR_DBM || g_cell.sinr <= CELL_SINR_POOR_DB)
+    {
+        return ModemCellQuality::POOR;
+    }
+
+    if (g_cell.rsrp >= CELL_RSRP_GOOD_DBM && g_cell.sinr >= CELL_SINR_GOOD_DB)
+    {
+        return ModemCellQuality::GOOD;
+    }
+
+    return ModemCellQuality::FAIR;
+}
+
+const char *modemCellQualityName(ModemCellQuality q)
+{
+    switch (q)
+    {
+    case ModemCellQuality::UNKNOWN:
+        return "UNKNOWN";
+    case ModemCellQuality::NO_SERVICE:
+        return "NO_SERVICE";
+    case ModemCellQuality::POOR:
+        return "POOR";
+    case ModemCellQuality::FAIR:
+        return "FAIR";
+    case ModemCellQuality::GOOD:
+        return "GOOD";
+    default:
+        return "UNKNOWN";
+    }
+}
+
+String modemCellInfoJson(uint32_t nowMs)
+{
+    if (!g_cell.valid)
+    {
+        return "null";
+    }
+
+    String json = "{";
+    json += "\"rat\":\"" + g_cell.rat + "\",";
+    json += "\"q\":\"" + String(modemCellQualityName(modemGetCellQuality(nowMs))) + "\",";
+
+    if (g_cell.hasLte)
+    {
+        json += "\"rsrp\":" + String(g_cell.rsrp) + ",";
+        json += "\"rsrq\":" + String(g_cell.rsrq) + ",";
+        json += "\"sinr\":" + String(g_cell.sinr) + ",";
+        json += "\"band\":" + String(g_cell.band) + ",";
+    }
+
+    if (g_cell.oper.length() > 0)
+    {
+        json += "\"oper\":\"" + g_cell.oper + "\",";
+        json += "\"earfcn\":" + String(g_cell.earfcn) + ",";
+        json += "\"cid\":" + String(g_cell.cellId) + ",";
+        json += "\"tac\":" + String(g_cell.tac) + ",";
+    }
+
+    json += "\"age_s\":" + String((uint32_t)(nowMs - g_cell.readAtMs) / 1000UL);
+    json += "}";
+    return json;
+}
+
+// ------------------------------------------------------------
+// Asynkront AT-kommando
+// ------------------------------------------------------------
+// Skickas via TinyGSM och svaret samlas in utan att blockera: varje
+// tick läser bara de bytes som redan finns i UART-bufferten till en
+// fast radbuffert. Kommandot avslutas på OK/ERROR eller timeout.
+// ------------------------------------------------------------
+void modemAbortAsyncAt()
+{
+    if (g_async.busy)
+    {
+        logSystem(String("MODEM: abort async AT") + g_async.cmd);
+    }
+
+    g_async = ModemAsyncAtContext{};
+    g_rfOffAsync = false;
+}
+
+bool modemStartAsyncAt(const char *cmd,
+                       const char *respPrefix,
+                       uint32_t timeoutMs,
+                       ModemAtCallback cb)
+{
+    if (g_async.busy || g_conn.busy || g_reset.busy)
+    {
+        return false;
+    }
+
+    asyncAtBegin(cmd, respPrefix, timeoutMs, cb, false);
+    return true;
+}
+
+// Gemensam start för extern och intern (reset) användning. Anroparen
+// ansvarar för att UART:en inte används av något annat.
+static void asyncAtBegin(const char *cmd, const char *respPrefix, uint32_t timeoutMs,
+                         ModemAtCallback cb, bool quiet)
+{
+    g_async = ModemAsyncAtContext{};
+    g_async.busy = true;
+    g_async.cb = cb;
+    g_async.quiet = quiet;
+    g_async.startedAtMs = millis();
+    g_async.timeoutMs = timeoutMs;
+    strlcpy(g_async.cmd, cmd ? cmd : "", sizeof(g_async.cmd));
+    strlcpy(g_async.prefix, respPrefix ? respPrefix : "", sizeof(g_async.prefix));
+
+    modem.sendAT(g_async.cmd);
+}
+
+static void asyncAtFinish(bool ok)
+{
+    ModemAtCallback cb = g_async.cb;
+    char payload[sizeof(g_async.payload)];
+    strlcpy(payload, g_async.payload, sizeof(payload));
+
+    uint32_t tookMs = millis() - g_async.startedAtMs;
+    if (!ok && !g_async.quiet)
+    {
+        logSystemf("MODEM: async AT%s failed after %lu ms", g_async.cmd, (unsigned long)tookMs);
+    }
+
+    // Nollställ före callback så callbacken kan starta nästa kommando.
+    g_async = ModemAsyncAtContext{};
+
+    if (cb)
+    {
+        cb(ok, payload);
+    }
+}
+
+static void asyncAtHandleLine(const char *line)
+{
+    if (line[0] == '\0')
+    {
+        return;
+    }
+
+    if (g_async.prefix[0] != '\0' &&
+        strncmp(line, g_async.prefix, strlen(g_async.prefix)) == 0)
+    {
+        strlcpy(g_async.payload, line, sizeof(g_async.payload));
+        return;
+    }
+
+    if (strcmp(line, "OK") == 0)
+    {
+        asyncAtFinish(g_async.prefix[0] == '\0' || g_async.payload[0] != '\0');
+        return;
+    }
+
+    if (strcmp(line, "ERROR") == 0 || strncmp(line, "+CME ERROR", 10) == 0)
+    {
+        asyncAtFinish(false);
+    }
+}
+
+void modemTickAsyncAt(uint32_t nowMs)
+{
+    if (!g_async.busy)
+    {
+        return;
+    }
+
+    while (g_async.busy && modem.stream.available())
+    {
+        char c = (char)modem.stream.read();
+
+        if (c == '\r')
+        {
+            continue;
         }
 
-        delay(10);
+        if (c == '\n')
+        {
+            g_async.line[g_async.lineLen] = '\0';
+            g_async.lineLen = 0;
+            asyncAtHandleLine(g_async.line);
+            continue;
+        }
+
+        // För långa rader kapas, vi behöver bara början.
+        if (g_async.lineLen < sizeof(g_async.line) - 1)
+        {
+            g_async.line[g_async.lineLen++] = c;
+        }
     }
 
-    if (!payload.startsWith("+CCLK:"))
+    if (g_async.busy && (uint32_t)(nowMs - g_async.startedAtMs) >= g_async.timeoutMs)
+    {
+        asyncAtFinish(false);
+    }
+}
+
+bool modemIsAsyncAtBusy()
+{
+    return g_async.busy;
+}
+
+// ------------------------------------------------------------
+// Modemklocka (AT+CCLK?)
+// ------------------------------------------------------------
+// Svaret har formen +CCLK: "yy/MM/dd,hh:mm:ss±zz". Callbacken får
+// bara strängen inom citattecken.
+// ------------------------------------------------------------
+static ModemClockCallback g_clockCb = nullptr;
+
+static bool extractCclk(const char *payload, char *out, size_t outLen)
+{
+    const char *q1 = strchr(payload, '"');
+    const char *q2 = q1 ? strchr(q1 + 1, '"') : nullptr;
+
+    if (!q1 || !q2)
+    {
+        return false;
+    }
+
+    size_t n = (size_t)(q2 - q1 - 1);
+    if (n < 17 || n >= outLen)
     {
         return false;
     }
 
-    int q1 = payload.indexOf('"');
-    int q2 = payload.lastIndexOf('"');
+    memcpy(out, q1 + 1, n);
+    out[n] = '\0';
+    return true;
+}
+
+static void onCclkResponse(bool ok, const char *payload)
+{
+    ModemClockCallback cb = g_clockCb;
+    g_clockCb = nullptr;
+
+    char cclk[32] = {0};
+    bool parsed = ok && extractCclk(payload, cclk, sizeof(cclk));
 
-    if (q1 < 0 || q2 <= q1)
+    if (cb)
+    {
+        cb(parsed, cclk);
+    }
+}
+
+bool modemRequestClock(ModemClockCallback cb, uint32_t timeoutMs)
+{
+    if (!modemStartAsyncAt("+CCLK?", "+CCLK:", timeoutMs, onCclkResponse))
     {
         return false;
     }
 
-    outCclk = payload.substring(q1 + 1, q2);
-    outCclk.trim();
+    g_clockCb = cb;
+    return true;
+}
+
+static void onRfOffResponse(bool ok, const char *payload)
+{
+    (void)payload;
+    g_rfOffAsync = false;
+
+    if (!ok)
+    {
+        logSystem("MODEM: RF OFF not confirmed");
+    }
+}
+
+// true medan ett RF OFF från modemRfOff() fortfarande väntar på svar.
+static bool rfOffDraining(uint32_t nowMs)
+{
+    if (!g_rfOffAsync)
+    {
+        return false;
+    }
 
-    return outCclk.length() >= 17;
+    modemTickAsyncAt(nowMs);
+    return g_rfOffAsync;
 }
 
 bool modemRfOff()
 {
+    if (g_conn.busy || g_reset.busy)
+    {
+        logSystem("MODEM: RF OFF skipped, modem busy");
+        return false;
+    }
+
+    if (g_rfOffAsync)
+    {
+        return true;
+    }
+
+    // En kort fråga (t.ex. CCLK) får ge vika för RF OFF.
+    modemAbortAsyncAt();
+
     logSystem("MODEM: RF OFF (CFUN=0)");
-    return modemSetCfun(0, 5000UL);
+    asyncAtBegin("+CFUN=0", "", MODEM_RF_OFF_TIMEOUT_MS, onRfOffResponse, false);
+    g_rfOffAsync = true;
+    return true;
 }
 
 bool modemRfOn()
@@ -665,21 +1592,21 @@ bool modemRfOn()
     return modemSetCfun(1, 5000UL);
 }
 
+// ------------------------------------------------------------
+// Gammal blockerande power-cycle.
+// Pipeline använder modemStartReset()/modemTickReset() direkt.
+// ------------------------------------------------------------
 void modemPowerCycle(uint32_t offMs, uint32_t bootMs)
 {
     logSystem("MODEM: power cycle start");
 
-    modemSetCfun(0, 5000UL);
-
-    logSystem("MODEM: PWRKEY long pulse (power toggle OFF)");
-    modemPwrKeyPulse(1500);
-
-    delay(offMs);
-
-    logSystem("MODEM: PWRKEY pulse (power ON)");
-    modemPwrKeyPulse(1200);
+    bool success = false;
+    modemStartReset(ModemResetKind::PWRKEY_CYCLE, offMs, bootMs);
 
-    delay(bootMs);
+    while (!modemTickReset(success))
+    {
+        delay(50);
+    }
 
-    logSystem("MODEM: power cycle done");
+    logSystem(String("MODEM: power cycle done ") + (success ? "OK" : "no AT"));
 }
\ No newline at end of file
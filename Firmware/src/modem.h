@@ -2,6 +2,7 @@
 
 #include <Arduino.h>
 #include <Client.h>
+#include "config.h"
 
 // Resultat från nät/data-uppkoppling.
 struct NetResult
@@ -57,6 +58,41 @@ bool modemIsConnectBusy();
 // Valfritt: läs nuvarande state för logg/debug.
 ModemConnectState modemGetConnectState();
 
+// ------------------------------------------------------------
+// Icke-blockerande återhämtning (recovery-stegen)
+// ------------------------------------------------------------
+// Ordnade från billigast till dyrast:
+// PDP_REACTIVATE : stäng databäraren (CNACT=0,0) så nästa attach aktiverar om den
+// SOFT_RESET     : AT+CFUN=1,1, modemet startar om sin firmware
+// PWRKEY_CYCLE   : av/på via PWRKEY
+// RAIL_CYCLE     : bryt DC3-matningen via PMU och starta med PWRKEY
+// ------------------------------------------------------------
+enum class ModemResetKind
+{
+    NONE = 0,
+    PDP_REACTIVATE,
+    SOFT_RESET,
+    PWRKEY_CYCLE,
+    RAIL_CYCLE
+};
+
+// Starta en reset-åtgärd. Ett ev. pågående connect-försök avbryts.
+void modemStartReset(ModemResetKind kind, uint32_t offMs = 3000, uint32_t bootMs = 8000);
+
+// Ticka pågående reset.
+// Returnerar true när åtgärden är färdig. success = true om modemet
+// svarade på AT efteråt (eller PDP stängdes).
+bool modemTickReset(bool &success);
+
+// Avbryt pågående reset och återgå till IDLE.
+void modemAbortReset();
+
+// Returnerar true om en reset-åtgärd pågår.
+bool modemIsResetBusy();
+
+// Namn för loggar.
+const char *modemResetKindName(ModemResetKind kind);
+
 // ------------------------------------------------------------
 // Gammal blockerande funktion
 // Behålls tills pipeline är ombyggd.
@@ -73,14 +109,96 @@ Client &modemGetClient();
 // Returnerar -1 om värdet inte kunde läsas.
 int modemGetSignalQuality();
 
-// Läser modemets klocka via AT+CCLK?
-bool modemGetCclk(String &outCclk, uint32_t timeoutMs = 1500);
+// ------------------------------------------------------------
+// Serving-cell (AT+CPSI?)
+// ------------------------------------------------------------
+// Alla värden kommer från ett enda CPSI-svar och cachas. Läsningen
+// görs periodiskt via modemTickCellInfo() och under attach.
+// ------------------------------------------------------------
+enum class ModemCellQuality
+{
+    UNKNOWN = 0,
+    NO_SERVICE,
+    POOR,
+    FAIR,
+    GOOD
+};
+
+struct ModemCellInfo
+{
+    bool valid = false;      // minst ett CPSI-svar har tolkats
+    uint32_t readAtMs = 0;   // millis() vid senaste lyckade läsning
+    String rat;              // t.ex. "LTE CAT-M1", "LTE NB-IOT", "GSM", "NO SERVICE"
+    bool online = false;     // operation mode "Online"
+    String oper;             // MCC-MNC
+    uint32_t tac = 0;        // Tracking/Location area code
+    uint32_t cellId = 0;
+    int band = -1;           // t.ex. 20 för EUTRAN-BAND20
+    int earfcn = -1;
+    bool hasLte = false;     // rsrp/rsrq/sinr/rssi är giltiga
+    int rsrp = 0;            // dBm
+    int rsrq = 0;            // dB
+    int rssi = 0;            // dBm
+    int sinr = 0;            // dB
+};
+
+// Läser AT+CPSI? och uppdaterar cachen. Returnerar true om svaret tolkades.
+bool modemReadCellInfo(uint32_t timeoutMs = 1500);
+
+// Läser om cachen när CELL_INFO_POLL_INTERVAL_MS passerat.
+// Anropas bara när modemet är igång och inte upptaget.
+void modemTickCellInfo(uint32_t nowMs);
+
+// Senast cachade cellinfo.
+const ModemCellInfo &modemGetCellInfo();
+
+// Kvalitet enligt cachen. UNKNOWN om cachen saknas eller är äldre än maxAgeMs.
+ModemCellQuality modemGetCellQuality(uint32_t nowMs, uint32_t maxAgeMs = CELL_INFO_MAX_AGE_MS);
+
+const char *modemCellQualityName(ModemCellQuality q);
+
+// Kompakt JSON-sammanfattning för van/ellie/tele/net, "null" om cache saknas.
+String modemCellInfoJson(uint32_t nowMs);
+
+// ------------------------------------------------------------
+// Asynkrona AT-kommandon
+// ------------------------------------------------------------
+// Ett kommando i taget. Svaret samlas in av modemTickAsyncAt() utan
+// att blockera och callbacken anropas när OK/ERROR eller timeout nåtts.
+// Startas bara när varken connect eller reset pågår.
+// ------------------------------------------------------------
+typedef void (*ModemAtCallback)(bool ok, const char *payload);
+
+// Skicka "AT<cmd>". respPrefix (t.ex. "+CCLK:") anger vilken rad som
+// lämnas till callbacken. Returnerar false om modemet är upptaget.
+bool modemStartAsyncAt(const char *cmd,
+                       const char *respPrefix,
+                       uint32_t timeoutMs,
+                       ModemAtCallback cb);
+
+// Ticka pågående kommando. Billig att anropa varje loop.
+void modemTickAsyncAt(uint32_t nowMs);
+
+bool modemIsAsyncAtBusy();
+
+// Avbryt pågående kommando utan att anropa callbacken.
+void modemAbortAsyncAt();
+
+// Callback med CCLK-strängen "yy/MM/dd,hh:mm:ss±zz" (tom vid fel).
+typedef void (*ModemClockCallback)(bool ok, const char *cclk);
+
+// Begär modemets klocka asynkront via AT+CCLK?.
+// Modemets RTC ställs av nätet (AT+CLTS=1 sätts vid radiokonfiguration).
+bool modemRequestClock(ModemClockCallback cb, uint32_t timeoutMs = 1500);
 
 // Slår på radiofunktionen (CFUN=1).
 bool modemRfOn();
 
-// Slår av radiofunktionen (CFUN=0).
+// Slår av radiofunktionen (CFUN=0). Blockerar inte: kommandot skickas
+// och svaret samlas in av modemTickAsyncAt(). false om connect eller
+// reset äger modemet.
 bool modemRfOff();
 
 // Gör en full power-cycle av modemet via PWRKEY.
+// Blockerande omslag runt modemStartReset(PWRKEY_CYCLE).
 void modemPowerCycle(uint32_t offMs = 3000, uint32_t bootMs = 8000);
\ No newline at end of file
@@ -2,9 +2,16 @@
 #include "config.h"
 #include "logging.h"
 #include "ext_gnss.h"
+#include "gnss_power.h"
+#include "gps_filter.h"
+#include "gps_track.h"
+#include "journal.h"
 #include "modem.h"
+#include "power.h"
+#include "power_sched.h"
 #include "profiles.h"
 #include "time_manager.h"
+#include "victron_agg.h"
 #include "victron_manager.h"
 
 #include <PubSubClient.h>
@@ -199,6 +206,8 @@ static const char *mqttTimeSourceText()
     return "MODEM";
   case TimeSource::NTP:
     return "NTP";
+  case TimeSource::GNSS:
+    return "GNSS";
   default:
     return "NONE";
   }
@@ -216,13 +225,19 @@ static String mqttBuildCommonJsonFields(const char *msgType, bool includeMsgId)
     payload += "\"msg_id\":\"" + String(++msgCounter) + "\",";
   }
 
+  const TimeStamp &ts = timeNowStamp();
+
   payload += "\"type\":\"" + String(msgType) + "\",";
-  payload += "\"timestamp\":\"" + timeIsoUtc() + "\",";
-  payload += "\"epoch_utc\":" + String(timeEpochUtc()) + ",";
-  payload += "\"time_valid\":" + String(timeIsValid() ? "true" : "false") + ",";
+  payload += "\"timestamp\":\"";
+  payload += ts.isoUtc;
+  payload += "\",\"epoch_utc\":" + String(ts.epoch) + ",";
+  payload += "\"time_valid\":" + String(ts.valid ? "true" : "false") + ",";
   payload += "\"time_source\":\"" + String(mqttTimeSourceText()) + "\",";
-  payload += "\"date_local\":\"" + timeDateLocal() + "\",";
-  payload += "\"time_local\":\"" + timeClockLocal() + "\",";
+  payload += "\"date_local\":\"";
+  payload += ts.dateLocal;
+  payload += "\",\"time_local\":\"";
+  payload += ts.clockLocal;
+  payload += "\",";
   payload += "\"profile\":\"" + String(currentProfile().name) + "\"";
 
   return payload;
@@ -254,7 +269,8 @@ static bool mqttPublishAck(uint32_t profileChangeId, const char *status, const c
   payload += "}";
 
   bool ok = mqttClient->publish(MQTT_TOPIC_ACK, payload.c_str(), false);
-  logSystem(String("MQTT: ACK publish ") + (ok ? "OK" : "FAILED") + " payload=" + payload);
+  logSystem(String("MQTT: ACK publish ") + (ok ? "OK" : "FAILED") + " bytes=" + String(payload.length()));
+  LOG_DEBUG(LogModule::MQTT, "MQTT: ACK payload=" + payload);
   return ok;
 }
 
@@ -342,7 +358,8 @@ static bool mqttPublishNetModeAck(uint32_t changeId,
 
   bool ok = mqttClient->publish(MQTT_TOPIC_ACK_NET_MODE, payload.c_str(), false);
   logSystem(String("MQTT: net_mode ACK publish ") + (ok ? "OK" : "FAILED") +
-            " payload=" + payload);
+            " bytes=" + String(payload.length()));
+  LOG_DEBUG(LogModule::MQTT, "MQTT: net_mode ACK payload=" + payload);
   return ok;
 }
 
@@ -411,6 +428,61 @@ static void mqttHandleDesiredNetModeMessage(const String &msg)
   mqttPublishNetStatus();
 }
 
+static bool mqttPublishVictronDevicesAck(uint32_t changeId,
+                                         VictronRegistryStatus status,
+                                         const String &op,
+                                         const String &mac)
+{
+  if (!mqttClient || !mqttClient->connected())
+    return false;
+
+  const bool accepted = status == VictronRegistryStatus::OK ||
+                        status == VictronRegistryStatus::DUPLICATE_IGNORED;
+
+  String payload = "{";
+  payload += "\"device_id\":\"" + String(DEVICE_ID) + "\",";
+  payload += "\"type\":\"VICTRON_DEVICES_ACK\",";
+  payload += "\"accepted\":" + String(accepted ? "true" : "false") + ",";
+  payload += "\"victron_change_id\":" + String(changeId) + ",";
+  payload += "\"change_id\":" + String(changeId) + ",";
+  payload += "\"status\":\"" + String(victronRegistryStatusName(status)) + "\",";
+  payload += "\"op\":\"" + op + "\",";
+  payload += "\"mac\":\"" + mac + "\",";
+  payload += "\"devices\":" + victronRegistryJson() + ",";
+  payload += "\"epoch_utc\":" + String(timeEpochUtc());
+  payload += "}";
+
+  bool ok = mqttClient->publish(MQTT_TOPIC_ACK_VICTRON_DEVICES, payload.c_str(), false);
+  logSystem(String("MQTT: victron_devices ACK publish ") + (ok ? "OK" : "FAILED") +
+            " status=" + victronRegistryStatusName(status));
+  LOG_DEBUG(LogModule::MQTT, "MQTT: victron_devices ACK payload=" + payload);
+  return ok;
+}
+
+// Registerändring för Victron-enheter. Nyckeln loggas aldrig.
+static void mqttHandleVictronDevicesMessage(const String &msg)
+{
+  uint32_t changeId = jsonGetUInt(msg, "victron_change_id");
+  if (changeId == 0)
+  {
+    changeId = jsonGetUInt(msg, "change_id");
+  }
+
+  const String op = jsonGetString(msg, "op");
+  const String mac = jsonGetString(msg, "mac");
+
+  VictronRegistryStatus status = victronRegistryApply(changeId,
+                                                      op,
+                                                      jsonGetString(msg, "name"),
+                                                      mac,
+                                                      jsonGetString(msg, "key"));
+
+  logSystem("MQTT: victron_devices op=" + op + " mac=" + mac +
+            " change_id=" + String(changeId) +
+            " status=" + victronRegistryStatusName(status));
+  mqttPublishVictronDevicesAck(changeId, status, op, mac);
+}
+
 // Hantera desired-profile payload.
 //
 // fromLegacyDownlink:
@@ -482,6 +554,45 @@ static void mqttHandleDesiredProfileMessage(const String &msg, bool fromLegacyDo
   setProfile(pid);
 }
 
+// Hantera loggnivå-kommando på cmd/downlink.
+// {"log_level":"DEBUG","log_module":"MQTT"}; utan log_module gäller alla.
+// Returnerar false om payloaden inte är ett loggnivå-kommando.
+static bool mqttHandleLogLevelMessage(const String &msg)
+{
+  String levelText = jsonGetString(msg, "log_level");
+  if (levelText.length() == 0)
+  {
+    return false;
+  }
+
+  LogLevel level;
+  if (!logLevelFromString(levelText, level))
+  {
+    logSystem("MQTT: log_level unknown level=" + levelText);
+    return true;
+  }
+
+  String moduleText = jsonGetString(msg, "log_module");
+  if (moduleText.length() == 0 || moduleText.equalsIgnoreCase("ALL"))
+  {
+    logSetLevelAll(level);
+    logSystemf("MQTT: log_level ALL=%s (compile level %d)", logLevelName(level), LOG_COMPILE_LEVEL);
+    return true;
+  }
+
+  LogModule module;
+  if (!logModuleFromString(moduleText, module))
+  {
+    logSystem("MQTT: log_level unknown module=" + moduleText);
+    return true;
+  }
+
+  logSetLevel(module, level);
+  logSystemf("MQTT: log_level %s=%s (compile level %d)",
+             logModuleName(module), logLevelName(logGetLevel(module)), LOG_COMPILE_LEVEL);
+  return true;
+}
+
 // ============================================================
 // MQTT callback
 // ============================================================
@@ -503,7 +614,13 @@ static void mqttCallback(char *topic, uint8_t *payload, unsigned int length)
     return;
   }
 
-  logSystem("MQTT: RX topic=" + t + " payload=" + msg);
+  logSystem("MQTT: RX topic=" + t + " bytes=" + String(msg.length()));
+  // Enhetsregistret innehåller AES-nycklar; de får inte hamna i
+  // journalen (som persisteras och laddas upp).
+  if (t == MQTT_TOPIC_VICTRON_DEVICES_DESIRED)
+    LOG_DEBUG(LogModule::MQTT, "MQTT: RX payload=<redacted>");
+  else
+    LOG_DEBUG(LogModule::MQTT, "MQTT: RX payload=" + msg);
 
   // ----------------------------------------------------------
   // Topic: MQTT_TOPIC_CMD_ACK
@@ -539,6 +656,15 @@ static void mqttCallback(char *topic, uint8_t *payload, unsigned int length)
     return;
   }
 
+  // ----------------------------------------------------------
+  // Topic: MQTT_TOPIC_VICTRON_DEVICES_DESIRED
+  // ----------------------------------------------------------
+  if (t == MQTT_TOPIC_VICTRON_DEVICES_DESIRED)
+  {
+    mqttHandleVictronDevicesMessage(msg);
+    return;
+  }
+
   // ----------------------------------------------------------
   // Topic: MQTT_TOPIC_DESIRED_PROFILE
   // ----------------------------------------------------------
@@ -569,6 +695,11 @@ static void mqttCallback(char *topic, uint8_t *payload, unsigned int length)
       return;
     }
 
+    if (mqttHandleLogLevelMessage(msg))
+    {
+      return;
+    }
+
     logSystem("MQTT: cmd/downlink received but no supported command found");
     return;
   }
@@ -643,8 +774,9 @@ void mqttSetup()
     mqttClient->setServer(MQTT_BROKER_HOST, MQTT_BROKER_PORT);
     mqttClient->setCallback(mqttCallback);
 
-    // GPS + JSON kräver lite större buffer.
-    mqttClient->setBufferSize(2048);
+    // GPS + JSON kräver lite större buffer. Health och Victron-state
+    // har vuxit (register, okända enheter, agg, sched) förbi 2048 B.
+    mqttClient->setBufferSize(4096);
 
     // Keepalive och socket-timeout
     mqttClient->setKeepAlive(30);
@@ -679,7 +811,7 @@ bool mqttConnect()
   {
     g_mqttOk = false;
     g_lastNetFailReason = "MQTT_CONNECT_FAILED";
-    logSystem("MQTT: connect FAILED, rc=" + String(mqttClient->state()));
+    LOG_WARN(LogModule::MQTT, "MQTT: connect FAILED, rc=%d", mqttClient->state());
     return false;
   }
 
@@ -707,7 +839,11 @@ bool mqttConnect()
   logSystem(String("MQTT: subscribe ") + MQTT_TOPIC_NET_MODE_DESIRED + " " +
             (subNetMode ? "OK" : "FAILED"));
 
-  bool subsOk = subDesiredProfile && subDownlink && subCmdAck && subNetMode;
+  bool subVictronDevices = mqttClient->subscribe(MQTT_TOPIC_VICTRON_DEVICES_DESIRED);
+  logSystem(String("MQTT: subscribe ") + MQTT_TOPIC_VICTRON_DEVICES_DESIRED + " " +
+            (subVictronDevices ? "OK" : "FAILED"));
+
+  bool subsOk = subDesiredProfile && subDownlink && subCmdAck && subNetMode && subVictronDevices;
 
   if (!subsOk)
   {
@@ -734,8 +870,8 @@ bool mqttPublishAlive()
   payload += "\"uptime_s\":" + String(millis() / 1000);
   payload += "}";
 
-  logSystem("MQTT: publishing alive to " + String(MQTT_TOPIC_ALIVE) + " payload=" + payload);
-  logSystem("MQTT: alive payload bytes=" + String(payload.length()));
+  LOG_DEBUG(LogModule::MQTT, "MQTT: publishing alive to " + String(MQTT_TOPIC_ALIVE) + " payload=" + payload);
+  LOG_DEBUG(LogModule::MQTT, "MQTT: alive payload bytes=%u", (unsigned)payload.length());
 
   bool ok = mqttClient->publish(MQTT_TOPIC_ALIVE, payload.c_str());
 
@@ -751,9 +887,14 @@ bool mqttPublishAlive()
 
 bool mqttPublishHealth(uint32_t recoveryCountBoot,
                        const char *lastRecoveryReason,
+                       const char *lastRecoveryAction,
+                       const char *lastFailureClass,
+                       const String &recoveryRungsJson,
                        uint32_t netConnectCountBoot,
                        uint32_t mqttConnectCountBoot,
                        uint32_t lastNetConnectMs,
+                       uint32_t lastAttachToPublishMs,
+                       uint32_t lastPublishCycleMs,
                        bool pendingProfileAck,
                        bool pirPending)
 {
@@ -768,16 +909,29 @@ bool mqttPublishHealth(uint32_t recoveryCountBoot,
   payload += "\"uptime_s\":" + String(millis() / 1000) + ",";
   payload += "\"recovery_count_boot\":" + String(recoveryCountBoot) + ",";
   payload += "\"last_recovery_reason\":\"" + String(lastRecoveryReason) + "\",";
+  payload += "\"last_recovery_action\":\"" + String(lastRecoveryAction) + "\",";
+  payload += "\"last_failure_class\":\"" + String(lastFailureClass) + "\",";
+  payload += "\"recovery_rungs\":" + recoveryRungsJson + ",";
+  payload += "\"gps_filter\":" + gpsFilterStatsJson() + ",";
+  payload += "\"gnss_power\":" + gnssPowerStatsJson(millis()) + ",";
+  payload += "\"track\":" + gpsTrackStatsJson() + ",";
+  payload += "\"sched\":" + powerSchedStatsJson() + ",";
+  payload += "\"pmu\":" + powerStatsJson(millis()) + ",";
+  payload += "\"time\":" + timeStatusJson(millis()) + ",";
+  payload += "\"log\":" + loggingStatsJson() + ",";
+  payload += "\"journal\":" + journalStatsJson() + ",";
   payload += "\"net_connect_count_boot\":" + String(netConnectCountBoot) + ",";
   payload += "\"mqtt_connect_count_boot\":" + String(mqttConnectCountBoot) + ",";
   payload += "\"last_net_connect_ms\":" + String(lastNetConnectMs) + ",";
+  payload += "\"attach_to_pub_ms\":" + String(lastAttachToPublishMs) + ",";
+  payload += "\"publish_cycle_ms\":" + String(lastPublishCycleMs) + ",";
   payload += "\"mqtt_connected\":true,";
   payload += "\"pending_profile_ack\":" + String(pendingProfileAck ? "true" : "false") + ",";
   payload += "\"pir_pending\":" + String(pirPending ? "true" : "false");
   payload += "}";
 
-  logSystem("MQTT: publishing health to " + String(MQTT_TOPIC_HEALTH) + " payload=" + payload);
-  logSystem("MQTT: health payload bytes=" + String(payload.length()));
+  LOG_DEBUG(LogModule::MQTT, "MQTT: publishing health to " + String(MQTT_TOPIC_HEALTH) + " payload=" + payload);
+  LOG_DEBUG(LogModule::MQTT, "MQTT: health payload bytes=%u", (unsigned)payload.length());
 
   bool ok = mqttClient->publish(MQTT_TOPIC_HEALTH, payload.c_str());
 
@@ -855,8 +1009,8 @@ bool mqttPublishGpsSingle(const ExtGnssFix &fx, bool fixOk)
 
   payload += "}";
 
-  logSystem("MQTT: publishing gps(single) to " + String(MQTT_TOPIC_GPS_SINGLE) + " payload=" + payload);
-  logSystem("MQTT: gps(single) payload bytes=" + String(payload.length()));
+  LOG_DEBUG(LogModule::MQTT, "MQTT: publishing gps(single) to " + String(MQTT_TOPIC_GPS_SINGLE) + " payload=" + payload);
+  LOG_DEBUG(LogModule::MQTT, "MQTT: gps(single) payload bytes=%u", (unsigned)payload.length());
 
   bool ok = mqttClient->publish(MQTT_TOPIC_GPS_SINGLE, payload.c_str());
 
@@ -870,6 +1024,80 @@ bool mqttPublishGpsSingle(const ExtGnssFix &fx, bool fixOk)
   return true;
 }
 
+bool mqttPublishGpsBatch()
+{
+  uint16_t count = 0;
+  String batch = gpsTrackBuildBatchJson(millis(), count);
+
+  if (count == 0)
+  {
+    return true;
+  }
+
+  if (!mqttClient || !mqttClient->connected())
+  {
+    logSystem("MQTT: cannot publish gps(batch), not connected");
+    return false;
+  }
+
+  String payload = "{";
+  payload += mqttBuildCommonJsonFields("GPS", true) + ",";
+  payload += batch;
+  payload += "}";
+
+  logSystem("MQTT: publishing gps(batch) to " + String(MQTT_TOPIC_GPS_SINGLE) +
+            " points=" + String(count) +
+            " bytes=" + String(payload.length()));
+
+  bool ok = mqttClient->publish(MQTT_TOPIC_GPS_SINGLE, payload.c_str());
+
+  if (!ok)
+  {
+    // Punkterna ligger kvar och skickas vid nästa tillfälle.
+    logSystem("MQTT: gps(batch) publish FAILED");
+    return false;
+  }
+
+  gpsTrackCommitBatch(count, payload.length());
+  return true;
+}
+
+bool mqttPublishJournalIfPending()
+{
+  if (!journalUploadPending())
+  {
+    return true;
+  }
+
+  if (!mqttClient || !mqttClient->connected())
+  {
+    return false;
+  }
+
+  String chunk;
+  for (uint8_t i = 0; i < JOURNAL_UPLOAD_CHUNKS_PER_CYCLE && journalBuildChunkJson(chunk); i++)
+  {
+    String payload = "{";
+    payload += mqttBuildCommonJsonFields("LOG", false) + ",";
+    payload += chunk;
+    payload += "}";
+
+    bool ok = mqttClient->publish(MQTT_TOPIC_LOG, payload.c_str(), false);
+
+    logSystem(String("MQTT: journal chunk publish ") + (ok ? "OK" : "FAILED") +
+              " bytes=" + String(payload.length()));
+
+    if (!ok)
+    {
+      return false;
+    }
+
+    journalCommitChunk();
+  }
+
+  return true;
+}
+
 bool mqttPublishVictronStateIfPending()
 {
   if (!victronManagerPublishPending())
@@ -884,7 +1112,13 @@ bool mqttPublishVictronStateIfPending()
   }
 
   String payload = victronManagerBuildStateJson();
-  bool ok = mqttClient->publish(MQTT_TOPIC_VICTRON_STATE, payload.c_str(), true);
+
+  // Med "devices" (alla record per enhet) kan payloaden bli större än
+  // MQTT-bufferten; strömma den i stället för publish().
+  const size_t len = payload.length();
+  bool ok = mqttClient->beginPublish(MQTT_TOPIC_VICTRON_STATE, len, true) &&
+            mqttClient->write((const uint8_t *)payload.c_str(), len) == len &&
+            mqttClient->endPublish();
 
   logSystem(String("MQTT: Victron state publish ") + (ok ? "OK" : "FAILED") +
             " topic=" + String(MQTT_TOPIC_VICTRON_STATE) +
@@ -898,6 +1132,43 @@ bool mqttPublishVictronStateIfPending()
   return ok;
 }
 
+bool mqttPublishVictronAggBatch()
+{
+  uint16_t count = 0;
+  String batch = victronAggBuildBatchJson(millis(), count);
+
+  if (count == 0)
+  {
+    return true;
+  }
+
+  if (!mqttClient || !mqttClient->connected())
+  {
+    logSystem("MQTT: cannot publish Victron agg, not connected");
+    return false;
+  }
+
+  String payload = "{";
+  payload += mqttBuildCommonJsonFields("VICTRON_AGG", true) + ",";
+  payload += batch;
+  payload += "}";
+
+  bool ok = mqttClient->publish(MQTT_TOPIC_VICTRON_AGG, payload.c_str());
+
+  logSystem(String("MQTT: Victron agg publish ") + (ok ? "OK" : "FAILED") +
+            " buckets=" + String(count) +
+            " bytes=" + String(payload.length()));
+
+  if (!ok)
+  {
+    // Hinkarna ligger kvar och skickas vid nästa tillfälle.
+    return false;
+  }
+
+  victronAggCommitBatch(count, payload.length());
+  return true;
+}
+
 bool mqttPublishNetStatus()
 {
   mqttLoadNetModeFromNvs();
@@ -946,13 +1217,17 @@ bool mqttPublishNetStatus()
     payload += "\"modem_rssi\":null,";
   }
 
+  // Serving-cell enligt senaste CPSI-läsning (cachad i modem-modulen).
+  payload += "\"cell\":" + modemCellInfoJson(millis()) + ",";
+
   payload += "\"last_fail_reason\":\"" + g_lastNetFailReason + "\"";
   payload += "}";
 
   bool ok = mqttClient->publish(MQTT_TOPIC_NET_STATUS, payload.c_str(), false);
 
   logSystem(String("MQTT: net status publish ") + (ok ? "OK" : "FAILED") +
-            " payload=" + payload);
+            " bytes=" + String(payload.length()));
+  LOG_DEBUG(LogModule::MQTT, "MQTT: net status payload=" + payload);
 
   return ok;
 }
@@ -54,11 +54,17 @@ const char *mqttGetActiveLink();
 bool mqttPublishAlive();
 
 // Publicerar health-meddelande med info om senaste recovery, connect och publish.
+// recoveryRungsJson är ett färdigt JSON-objekt med statistik per recovery-steg.
 bool mqttPublishHealth(uint32_t recoveryCountBoot,
                        const char *lastRecoveryReason,
+                       const char *lastRecoveryAction,
+                       const char *lastFailureClass,
+                       const String &recoveryRungsJson,
                        uint32_t netConnectCountBoot,
                        uint32_t mqttConnectCountBoot,
                        uint32_t lastNetConnectMs,
+                       uint32_t lastAttachToPublishMs,
+                       uint32_t lastPublishCycleMs,
                        bool pendingProfileAck,
                        bool pirPending);
 
@@ -66,6 +72,15 @@ bool mqttPublishHealth(uint32_t recoveryCountBoot,
 // fixOk anger om giltig position finns eller inte.
 bool mqttPublishGpsSingle(const ExtGnssFix &fx, bool fixOk);
 
+// Publicerar nästa GPS-batch ur spårbufferten ("batch", delta-kodad).
+// Punkterna tas bort ur bufferten först när publiceringen lyckats.
+// Returnerar true om inget behövde skickas eller om publiceringen lyckades.
+bool mqttPublishGpsBatch();
+
+// Publicerar väntande journalutdrag (högst JOURNAL_UPLOAD_CHUNKS_PER_CYCLE
+// bitar per anrop). true om inget väntar eller allt gick ut.
+bool mqttPublishJournalIfPending();
+
 // Publicerar ett PIR-event.
 bool mqttPublishPirEvent(uint32_t eventId,
                          uint16_t count,
@@ -89,6 +104,10 @@ bool mqttPublishNetStatus();
 // Returnerar true om inget behövde publiceras eller om publiceringen lyckades.
 bool mqttPublishVictronStateIfPending();
 
+// Publicerar äldsta Victron-aggregathinkarna (min/max/medel, Ah/Wh).
+// Returnerar true om inget fanns att skicka eller om publiceringen lyckades.
+bool mqttPublishVictronAggBatch();
+
 // Returnerar önskat nätläge som senast mottagits från HA.
 // Värdet läses även från NVS vid boot så enheten kan välja WiFi/SIM
 // innan den hunnit få retained MQTT-state.
@@ -2,11 +2,18 @@
 
 #include "config.h"
 #include "ext_gnss.h"
+#include "gnss_power.h"
+#include "gps_filter.h"
+#include "gps_track.h"
+#include "journal.h"
 #include "logging.h"
 #include "modem.h"
 #include "mqtt.h"
+#include "power.h"
+#include "power_sched.h"
 #include "profiles.h"
 #include "time_manager.h"
+#include "victron_agg.h"
 #include "victron_manager.h"
 
 #include <WiFi.h>
@@ -131,15 +138,25 @@ enum class Step
 static Step g_step = Step::STEP_DECIDE;
 static uint32_t g_deadlineMs = 0;
 
+// STEP_VICTRON_BLE_SCAN: scan startad i detta steg.
+static bool g_victronScanStarted = false;
+
 // ============================================================
-// Enkel recovery-manager
+// Recovery-manager med stege
 // ------------------------------------------------------------
-// Första steget här är medvetet enkelt:
-// - vid enstaka fel: prova om senare
-// - vid flera fel i rad: stäng MQTT / RF och börja om
-// - vid ännu fler fel: power-cycle modemet
+// Felet klassas först (ingen AT / ingen registrering / ingen data /
+// bara MQTT / WiFi). Varje klass har en egen stege av åtgärder,
+// ordnad från billigast till dyrast:
+//
+//   RETRY_LATER -> RESTART_LINK -> PDP_REACTIVATE -> SOFT_RESET
+//   -> PWRKEY_CYCLE -> RAIL_CYCLE
 //
-// Detta är inte hela målbilden, men ett tydligt steg upp i robusthet.
+// Antal fel i rad avgör hur högt upp på stegen vi går. Tid till
+// återhämtning mäts per steg. Ett steg som upprepade gånger inte
+// lett till friskt läge hoppas över, så nästa billiga steg provas.
+// Ett senare steg med klart lägre förväntad tid till återhämtning
+// (medeltid / andel lyckade) väljs direkt i stället för att eskalera.
+// Modem-stegen körs icke-blockerande via modemStartReset().
 // ============================================================
 enum class RecoveryReason
 {
@@ -157,19 +174,122 @@ enum class RecoveryAction
     NONE = 0,
     RETRY_LATER,
     RESTART_LINK,
-    POWER_CYCLE_MODEM
+    PDP_REACTIVATE,
+    SOFT_RESET,
+    PWRKEY_CYCLE,
+    RAIL_CYCLE
+};
+
+static const uint8_t RECOVERY_ACTION_COUNT = 7;
+
+// Klassning av felet. Styr vilken stege som används.
+enum class FailureClass
+{
+    NONE = 0,
+    NO_AT,           // modemet svarar inte på AT
+    NO_REGISTRATION, // ingen nätregistrering
+    NO_DATA,         // registrerad men ingen databärare
+    NO_COVERAGE,     // ingen registrering och CPSI visar ingen täckning
+    MQTT_ONLY,       // länken uppe men MQTT/publish fallerar
+    WIFI_LINK,       // fel på WiFi-länken, modemåtgärder hjälper inte
+    OTHER
 };
 
 struct RecoveryState
 {
     RecoveryReason reason = RecoveryReason::NONE;
     RecoveryAction action = RecoveryAction::NONE;
+    FailureClass failureClass = FailureClass::NONE;
     uint8_t consecutiveFailures = 0;
     uint32_t executeAtMs = 0;
+
+    // true medan ett modem-reset-steg körs i RECOVERY_WAIT.
+    bool modemResetRunning = false;
+
+    // Senast utförda steg som väntar på att bevisa sig (friskt läge).
+    RecoveryAction evalAction = RecoveryAction::NONE;
+    uint32_t evalStartedMs = 0;
+
+    // true för steg som bara väntar in nästa försök (RETRY_LATER,
+    // RESTART_LINK). Mätningen börjar då när försöket faktiskt startar,
+    // inte när steget valdes, så väntetiden inte räknas som återhämtning.
+    bool evalAwaitRetry = false;
+
+    // Lägsta index på stegen för nästa val i samma felperiod, så ett
+    // steg som rankats upp inte följs av ett billigare eller samma steg.
+    FailureClass ladderClass = FailureClass::NONE;
+    uint8_t ladderNext = 0;
 };
 
 static RecoveryState g_recovery;
 
+// Statistik per stegtyp: antal försök, antal som ledde till friskt
+// läge och tid från att steget verkar (aktiva steg: start, väntande
+// steg: nästa uppkopplingsförsök) till första lyckade publish-cykel.
+struct RecoveryRungStats
+{
+    uint32_t attempts = 0;
+    uint32_t successes = 0;
+    uint32_t lastRecoverMs = 0;
+    uint32_t totalRecoverMs = 0;
+};
+
+static RecoveryRungStats g_rungStats[RECOVERY_ACTION_COUNT];
+
+// Ett steg som provats minst så här många gånger utan en enda
+// återhämtning hoppas över till förmån för nästa steg på stegen.
+static const uint32_t RECOVERY_RUNG_USELESS_AFTER = 4;
+
+// Steg med minst så många försök rankas efter förväntad tid till
+// återhämtning. Ett senare steg väljs i förväg bara om det är klart
+// bättre (faktor RECOVERY_RUNG_RANK_MARGIN) än det stegen säger.
+static const uint32_t RECOVERY_RUNG_RANK_MIN_ATTEMPTS = 3;
+static const float RECOVERY_RUNG_RANK_MARGIN = 1.5f;
+
+// Övre gräns för hur länge ett modem-reset-steg får köra.
+static const uint32_t RECOVERY_MODEM_RESET_GUARD_MS = 60000UL;
+
+static const RecoveryAction kLadderNoAt[] = {
+    RecoveryAction::PWRKEY_CYCLE,
+    RecoveryAction::RAIL_CYCLE};
+
+static const RecoveryAction kLadderNoRegistration[] = {
+    RecoveryAction::RESTART_LINK,
+    RecoveryAction::SOFT_RESET,
+    RecoveryAction::PWRKEY_CYCLE,
+    RecoveryAction::RAIL_CYCLE};
+
+static const RecoveryAction kLadderNoData[] = {
+    RecoveryAction::PDP_REACTIVATE,
+    RecoveryAction::SOFT_RESET,
+    RecoveryAction::PWRKEY_CYCLE,
+    RecoveryAction::RAIL_CYCLE};
+
+// Utan täckning hjälper inga modem-resets. Vänta ut det och prova
+// en mjuk reset först efter flera missar ifall modemet har fastnat.
+static const RecoveryAction kLadderNoCoverage[] = {
+    RecoveryAction::RETRY_LATER,
+    RecoveryAction::RETRY_LATER,
+    RecoveryAction::RETRY_LATER,
+    RecoveryAction::SOFT_RESET};
+
+static const RecoveryAction kLadderMqttOnly[] = {
+    RecoveryAction::RETRY_LATER,
+    RecoveryAction::PDP_REACTIVATE,
+    RecoveryAction::SOFT_RESET,
+    RecoveryAction::PWRKEY_CYCLE};
+
+static const RecoveryAction kLadderWifi[] = {
+    RecoveryAction::RETRY_LATER,
+    RecoveryAction::RESTART_LINK};
+
+static const RecoveryAction kLadderOther[] = {
+    RecoveryAction::RETRY_LATER,
+    RecoveryAction::RESTART_LINK,
+    RecoveryAction::SOFT_RESET,
+    RecoveryAction::PWRKEY_CYCLE,
+    RecoveryAction::RAIL_CYCLE};
+
 // ============================================================
 // Health / driftövervakning
 // ------------------------------------------------------------
@@ -180,7 +300,16 @@ static uint32_t g_recoveryCountBoot = 0;
 static uint32_t g_netConnectCountBoot = 0;
 static uint32_t g_mqttConnectCountBoot = 0;
 static uint32_t g_lastNetConnectMs = 0;
+
+// Från lyckad nätuppkoppling till första publicering (ms).
+static uint32_t g_netAttachedAtMs = 0;
+static uint32_t g_lastAttachToPublishMs = 0;
+
+// Tid för senaste publish-cykel (ms), inkl. loggning av payloads.
+static uint32_t g_lastPublishCycleMs = 0;
 static RecoveryReason g_lastRecoveryReason = RecoveryReason::NONE;
+static RecoveryAction g_lastRecoveryAction = RecoveryAction::NONE;
+static FailureClass g_lastFailureClass = FailureClass::NONE;
 
 // ============================================================
 // Network link selection – steg 3
@@ -193,7 +322,10 @@ static RecoveryReason g_lastRecoveryReason = RecoveryReason::NONE;
 // SIM_ONLY     -> endast SIM
 // WIFI_PRIMARY -> WiFi först, SIM som backup
 // SIM_PRIMARY  -> SIM först, WiFi som backup
-// AUTO         -> WiFi först, SIM som backup tills vidare.
+// AUTO         -> WiFi först, SIM som backup. Cachad cellinfo (CPSI)
+//                 styr: SIM hoppas över när senaste läsningen visar
+//                 ingen täckning, och SIM provas först när WiFi senast
+//                 misslyckades och cellen är bra.
 // ============================================================
 enum class NetAttemptLink
 {
@@ -209,6 +341,19 @@ static uint32_t g_netAttemptStartedMs = 0;
 static bool g_netFallbackTried = false;
 static String g_lastFallbackReason = "NONE";
 
+// AUTO: sätts när senaste WiFi-försöket misslyckades.
+static bool g_autoWifiFailedLast = false;
+
+static bool modeIsAuto(const char *mode)
+{
+    if (!mode)
+        return false;
+
+    String m(mode);
+    m.toUpperCase();
+    return m == "AUTO";
+}
+
 static bool modeWantsWifiFirst(const char *mode)
 {
     if (!mode)
@@ -229,6 +374,13 @@ static NetAttemptLink primaryLinkForMode(const char *mode)
     String m(mode);
     m.toUpperCase();
 
+    if (m == "AUTO" && g_autoWifiFailedLast &&
+        modemGetCellQuality(millis()) == ModemCellQuality::GOOD)
+    {
+        logSystem("PIPELINE: AUTO wifi failed last time and cell is GOOD -> SIM first");
+        return NetAttemptLink::SIM;
+    }
+
     if (m == "WIFI_ONLY" || m == "WIFI_PRIMARY" || m == "AUTO")
         return NetAttemptLink::WIFI;
 
@@ -243,9 +395,20 @@ static NetAttemptLink fallbackLinkForMode(const char *mode, NetAttemptLink faile
     String m(mode);
     m.toUpperCase();
 
+    if (m == "AUTO" && failedLink == NetAttemptLink::WIFI &&
+        modemGetCellQuality(millis()) == ModemCellQuality::NO_SERVICE)
+    {
+        // Attach skulle bara timea ut. Gå direkt till recovery i stället.
+        logSystem("PIPELINE: AUTO skip SIM fallback, cached cell info says NO_SERVICE");
+        return NetAttemptLink::NONE;
+    }
+
     if ((m == "WIFI_PRIMARY" || m == "AUTO") && failedLink == NetAttemptLink::WIFI)
         return NetAttemptLink::SIM;
 
+    if (m == "AUTO" && failedLink == NetAttemptLink::SIM)
+        return NetAttemptLink::WIFI;
+
     if (m == "SIM_PRIMARY" && failedLink == NetAttemptLink::SIM)
         return NetAttemptLink::WIFI;
 
@@ -330,8 +493,9 @@ static bool tickWifiConnect(uint32_t nowMs, bool &ok)
 }
 
 
-static void requestRecovery(RecoveryReason reason, uint32_t nowMs);
+static void requestRecovery(RecoveryReason reason, uint32_t nowMs, const char *failReason = nullptr);
 static void stepEnter(Step s, uint32_t nowMs);
+static bool stepTimedOut(uint32_t nowMs);
 
 static void cleanupNetAttemptLink(NetAttemptLink link)
 {
@@ -342,12 +506,18 @@ static void cleanupNetAttemptLink(NetAttemptLink link)
     else if (link == NetAttemptLink::SIM)
     {
         modemAbortConnectData();
+        modemAbortAsyncAt();
         modemRfOff();
     }
 }
 
 static bool tryFallbackOrRecovery(RecoveryReason reason, const char *failReason, uint32_t nowMs)
 {
+    if (g_netAttemptLink == NetAttemptLink::WIFI && modeIsAuto(mqttGetDesiredNetMode()))
+    {
+        g_autoWifiFailedLast = true;
+    }
+
     NetAttemptLink fallback = fallbackLinkForMode(mqttGetDesiredNetMode(), g_netAttemptLink);
 
     if (!g_netFallbackTried && fallback != NetAttemptLink::NONE)
@@ -372,7 +542,7 @@ static bool tryFallbackOrRecovery(RecoveryReason reason, const char *failReason,
         return true;
     }
 
-    requestRecovery(reason, nowMs);
+    requestRecovery(reason, nowMs, failReason);
     return false;
 }
 
@@ -516,8 +686,39 @@ static const char *recoveryActionName(RecoveryAction a)
         return "RETRY_LATER";
     case RecoveryAction::RESTART_LINK:
         return "RESTART_LINK";
-    case RecoveryAction::POWER_CYCLE_MODEM:
-        return "POWER_CYCLE_MODEM";
+    case RecoveryAction::PDP_REACTIVATE:
+        return "PDP_REACTIVATE";
+    case RecoveryAction::SOFT_RESET:
+        return "SOFT_RESET";
+    case RecoveryAction::PWRKEY_CYCLE:
+        return "PWRKEY_CYCLE";
+    case RecoveryAction::RAIL_CYCLE:
+        return "RAIL_CYCLE";
+    default:
+        return "UNKNOWN";
+    }
+}
+
+static const char *failureClassName(FailureClass c)
+{
+    switch (c)
+    {
+    case FailureClass::NONE:
+        return "NONE";
+    case FailureClass::NO_AT:
+        return "NO_AT";
+    case FailureClass::NO_REGISTRATION:
+        return "NO_REGISTRATION";
+    case FailureClass::NO_DATA:
+        return "NO_DATA";
+    case FailureClass::NO_COVERAGE:
+        return "NO_COVERAGE";
+    case FailureClass::MQTT_ONLY:
+        return "MQTT_ONLY";
+    case FailureClass::WIFI_LINK:
+        return "WIFI_LINK";
+    case FailureClass::OTHER:
+        return "OTHER";
     default:
         return "UNKNOWN";
     }
@@ -537,17 +738,208 @@ static uint32_t recoveryBackoffMs(uint8_t failures)
     return 120000UL;
 }
 
-// Bestäm recovery-nivå utifrån antal fel i rad.
-// Första fel: prova om senare.
-// Sedan: starta om länk.
-// Till sist: power-cycle modem.
-static RecoveryAction chooseRecoveryAction(uint8_t consecutiveFailures)
+// Klassa felet utifrån recovery-orsak, länk och modemets felkod.
+static FailureClass classifyFailureRaw(RecoveryReason reason, const char *failReason)
+{
+    bool onWifi = (g_netAttemptLink == NetAttemptLink::WIFI) ||
+                  (g_netAttemptLink == NetAttemptLink::NONE && String(mqttGetActiveLink()) == "WIFI");
+
+    if (onWifi)
+        return FailureClass::WIFI_LINK;
+
+    switch (reason)
+    {
+    case RecoveryReason::NET_ATTACH_FAILED:
+        if (failReason && strcmp(failReason, "no_at") == 0)
+            return FailureClass::NO_AT;
+        if (failReason && strcmp(failReason, "net_timeout") == 0)
+            return FailureClass::NO_REGISTRATION;
+        if (failReason && strcmp(failReason, "data_attach_failed") == 0)
+            return FailureClass::NO_DATA;
+
+        // Pipeline-timeout: läs av var modemets state machine fastnade.
+        switch (modemGetConnectState())
+        {
+        case ModemConnectState::WAIT_AT:
+            return FailureClass::NO_AT;
+        case ModemConnectState::ACTIVATE_DATA:
+        case ModemConnectState::READ_STATUS:
+            return FailureClass::NO_DATA;
+        default:
+            return FailureClass::NO_REGISTRATION;
+        }
+
+    case RecoveryReason::MQTT_CONNECT_TIMEOUT:
+    case RecoveryReason::MQTT_DROPPED:
+    case RecoveryReason::PUBLISH_FAILED:
+    case RecoveryReason::NO_PROGRESS:
+        return FailureClass::MQTT_ONLY;
+
+    default:
+        return FailureClass::OTHER;
+    }
+}
+
+// Slutlig klassning. Måste anropas innan pågående connect-försök avbryts,
+// eftersom modemets connect-state används vid pipeline-timeout.
+static FailureClass classifyFailure(RecoveryReason reason, const char *failReason)
+{
+    FailureClass cls = classifyFailureRaw(reason, failReason);
+
+    // Registreringsfel utan täckning enligt cachad CPSI: resets hjälper inte.
+    if (cls == FailureClass::NO_REGISTRATION &&
+        modemGetCellQuality(millis()) == ModemCellQuality::NO_SERVICE)
+        return FailureClass::NO_COVERAGE;
+
+    return cls;
+}
+
+static const RecoveryAction *ladderForClass(FailureClass c, uint8_t &count)
+{
+    switch (c)
+    {
+    case FailureClass::NO_AT:
+        count = sizeof(kLadderNoAt) / sizeof(kLadderNoAt[0]);
+        return kLadderNoAt;
+    case FailureClass::NO_REGISTRATION:
+        count = sizeof(kLadderNoRegistration) / sizeof(kLadderNoRegistration[0]);
+        return kLadderNoRegistration;
+    case FailureClass::NO_DATA:
+        count = sizeof(kLadderNoData) / sizeof(kLadderNoData[0]);
+        return kLadderNoData;
+    case FailureClass::NO_COVERAGE:
+        count = sizeof(kLadderNoCoverage) / sizeof(kLadderNoCoverage[0]);
+        return kLadderNoCoverage;
+    case FailureClass::MQTT_ONLY:
+        count = sizeof(kLadderMqttOnly) / sizeof(kLadderMqttOnly[0]);
+        return kLadderMqttOnly;
+    case FailureClass::WIFI_LINK:
+        count = sizeof(kLadderWifi) / sizeof(kLadderWifi[0]);
+        return kLadderWifi;
+    default:
+        count = sizeof(kLadderOther) / sizeof(kLadderOther[0]);
+        return kLadderOther;
+    }
+}
+
+static bool rungLooksUseless(RecoveryAction a)
+{
+    const RecoveryRungStats &st = g_rungStats[(uint8_t)a];
+    return st.attempts >= RECOVERY_RUNG_USELESS_AFTER && st.successes == 0;
+}
+
+// Förväntad tid (ms) till friskt läge om steget väljs: medeltid vid
+// lyckat försök delat med andelen lyckade (Laplace-utjämnad).
+// Negativt = för lite data för att ranka.
+static float rungExpectedRecoverMs(RecoveryAction a)
+{
+    const RecoveryRungStats &st = g_rungStats[(uint8_t)a];
+    if (st.attempts < RECOVERY_RUNG_RANK_MIN_ATTEMPTS || st.successes == 0)
+        return -1.0f;
+
+    const float p = (float)(st.successes + 1) / (float)(st.attempts + 2);
+    const float avgMs = (float)st.totalRecoverMs / (float)st.successes;
+    return avgMs / p;
+}
+
+// Välj steg på stegen för felklassen utifrån antal fel i rad.
+// Steg som bevisat inte hjälper hoppas över (men aldrig det sista).
+// Bland återstående steg med tillräcklig statistik väljs ett senare
+// steg direkt om det har klart lägre förväntad tid till återhämtning.
+static RecoveryAction chooseRecoveryAction(FailureClass c, uint8_t consecutiveFailures)
+{
+    uint8_t count = 0;
+    const RecoveryAction *ladder = ladderForClass(c, count);
+
+    uint8_t idx = consecutiveFailures > 0 ? (uint8_t)(consecutiveFailures - 1) : 0;
+    if (c == g_recovery.ladderClass && g_recovery.ladderNext > idx)
+        idx = g_recovery.ladderNext;
+    if (idx >= count)
+        idx = count - 1;
+
+    while (idx + 1 < count && rungLooksUseless(ladder[idx]))
+    {
+        logSystemf("RECOVERY: skip %s (no recoveries in %lu attempts)",
+                   recoveryActionName(ladder[idx]),
+                   (unsigned long)g_rungStats[(uint8_t)ladder[idx]].attempts);
+        idx++;
+    }
+
+    const float baseMs = rungExpectedRecoverMs(ladder[idx]);
+    if (baseMs > 0.0f)
+    {
+        uint8_t best = idx;
+        float bestMs = baseMs;
+        for (uint8_t i = idx + 1; i < count; i++)
+        {
+            const float ms = rungExpectedRecoverMs(ladder[i]);
+            if (ms > 0.0f && ms * RECOVERY_RUNG_RANK_MARGIN < bestMs)
+            {
+                best = i;
+                bestMs = ms;
+            }
+        }
+
+        if (best != idx)
+        {
+            logSystemf("RECOVERY: rank %s (exp %lu ms) over %s (exp %lu ms)",
+                       recoveryActionName(ladder[best]), (unsigned long)bestMs,
+                       recoveryActionName(ladder[idx]), (unsigned long)baseMs);
+            idx = best;
+        }
+    }
+
+    g_recovery.ladderClass = c;
+    g_recovery.ladderNext = (uint8_t)(idx + 1);
+    return ladder[idx];
+}
+
+// Räkna upp försök för ett steg och börja mäta tid till återhämtning.
+static void recoveryRungStarted(RecoveryAction a, uint32_t nowMs)
+{
+    g_rungStats[(uint8_t)a].attempts++;
+    g_recovery.evalAction = a;
+    g_recovery.evalStartedMs = nowMs;
+    g_recovery.evalAwaitRetry = (a == RecoveryAction::RETRY_LATER || a == RecoveryAction::RESTART_LINK);
+    g_lastRecoveryAction = a;
+}
+
+// Väntande steg börjar mätas när uppkopplingen faktiskt provas igen.
+static void recoveryRetryStarted(uint32_t nowMs)
+{
+    if (g_recovery.evalAction == RecoveryAction::NONE || !g_recovery.evalAwaitRetry)
+        return;
+
+    g_recovery.evalStartedMs = nowMs;
+    g_recovery.evalAwaitRetry = false;
+}
+
+// Kompakt JSON med statistik per steg för health-payload.
+// Bara steg som faktiskt provats tas med.
+static String recoveryRungsJson()
 {
-    if (consecutiveFailures <= 1)
-        return RecoveryAction::RETRY_LATER;
-    if (consecutiveFailures <= 3)
-        return RecoveryAction::RESTART_LINK;
-    return RecoveryAction::POWER_CYCLE_MODEM;
+    String json = "{";
+    bool first = true;
+
+    for (uint8_t i = 1; i < RECOVERY_ACTION_COUNT; i++)
+    {
+        const RecoveryRungStats &st = g_rungStats[i];
+        if (st.attempts == 0)
+            continue;
+
+        if (!first)
+            json += ",";
+        first = false;
+
+        json += "\"" + String(recoveryActionName((RecoveryAction)i)) + "\":{";
+        json += "\"n\":" + String(st.attempts) + ",";
+        json += "\"ok\":" + String(st.successes) + ",";
+        json += "\"last_ms\":" + String(st.lastRecoverMs) + ",";
+        json += "\"avg_ms\":" + String(st.successes ? st.totalRecoverMs / st.successes : 0) + "}";
+    }
+
+    json += "}";
+    return json;
 }
 
 // Markera att systemet gjort verkligt framsteg.
@@ -560,10 +952,34 @@ static void markProgress(uint32_t nowMs, const char *reason)
 // Markera att systemet är friskt igen.
 static void markHealthy(uint32_t nowMs, const char *reason)
 {
+    // Stänger mätningen av tid till återhämtning för senaste steg.
+    if (g_recovery.evalAction != RecoveryAction::NONE)
+    {
+        RecoveryRungStats &st = g_rungStats[(uint8_t)g_recovery.evalAction];
+        uint32_t recoverMs = nowMs - g_recovery.evalStartedMs;
+
+        st.successes++;
+        st.lastRecoverMs = recoverMs;
+        st.totalRecoverMs += recoverMs;
+
+        logSystemf("RECOVERY: %s recovered in %lu ms (ok=%lu/%lu)",
+                   recoveryActionName(g_recovery.evalAction),
+                   (unsigned long)recoverMs,
+                   (unsigned long)st.successes,
+                   (unsigned long)st.attempts);
+
+        g_recovery.evalAction = RecoveryAction::NONE;
+        g_recovery.evalStartedMs = 0;
+        g_recovery.evalAwaitRetry = false;
+    }
+
     g_recovery.reason = RecoveryReason::NONE;
     g_recovery.action = RecoveryAction::NONE;
+    g_recovery.failureClass = FailureClass::NONE;
     g_recovery.consecutiveFailures = 0;
     g_recovery.executeAtMs = 0;
+    g_recovery.ladderClass = FailureClass::NONE;
+    g_recovery.ladderNext = 0;
 
     markProgress(nowMs, reason);
 }
@@ -645,39 +1061,102 @@ static void pirMarkPublishedAndLockout(uint32_t nowMs)
     }
 }
 
-// Bygg en ExtGnssFix från senaste externa GNSS-fix.
-// Returnerar true om giltig extern fix fanns.
+// Senast filtrerade GNSS-epok.
+static uint32_t g_gpsLastSeq = 0;
+
+// När PUBLISH började vänta på GPS-bekräftelse (0 = ingen väntan).
+static uint32_t g_gpsWaitStartMs = 0;
+
+// Mata GPS-filtret med varje ny epok från extern GNSS.
+static void feedGpsFilter(uint32_t nowMs)
+{
+#if EXTERNAL_GNSS_ENABLED
+    ExtGnssFix raw;
+    extGnssGetLatest(raw);
+
+    if (raw.seq == 0 || raw.seq == g_gpsLastSeq)
+        return;
+
+    g_gpsLastSeq = raw.seq;
+    gpsFilterFeed(raw, nowMs);
+#else
+    (void)nowMs;
+#endif
+}
+
+// Ska PUBLISH vänta en stund på att GPS-filtret bekräftar positionen?
+// Väntar bara medan bekräftelse faktiskt pågår, högst GPS_DEV_MAX_WAIT_MS
+// (eller till stegets deadline om GPS_DEV_CAP_WAIT är av).
+static bool gpsShouldWaitForConfirm(uint32_t nowMs)
+{
+    if (!gpsFilterIsConfirming())
+        return false;
+
+    if (g_gpsWaitStartMs == 0)
+    {
+        g_gpsWaitStartMs = nowMs;
+        logSystem("PIPELINE: waiting for GPS confirmation before publish");
+    }
+
+    if (GPS_DEV_CAP_WAIT && (uint32_t)(nowMs - g_gpsWaitStartMs) >= GPS_DEV_MAX_WAIT_MS)
+        return false;
+
+    return !stepTimedOut(nowMs);
+}
+
+// Bygg en ExtGnssFix från senaste filtrerade GNSS-fix.
+// Returnerar true om bekräftad och tillräckligt färsk fix fanns.
 static bool buildGpsFromExternal(ExtGnssFix &out)
 {
     out = ExtGnssFix{};
 
 #if EXTERNAL_GNSS_ENABLED
-    return extGnssGetLatest(out);
+    return gpsFilterGetLatest(out, millis());
 #else
     return false;
 #endif
 }
 
 // Begär recovery och gå till RECOVERY_WAIT.
-static void requestRecovery(RecoveryReason reason, uint32_t nowMs)
+// failReason är länkens felkod (t.ex. modemets "no_at") om sådan finns.
+static void requestRecovery(RecoveryReason reason, uint32_t nowMs, const char *failReason)
 {
+    FailureClass cls = classifyFailure(reason, failReason);
+
     modemAbortConnectData();
+    modemAbortReset();
+    modemAbortAsyncAt();
     g_netAttemptStarted = false;
     g_netAttemptLink = NetAttemptLink::NONE;
 
+    // Föregående steg ledde inte till friskt läge.
+    if (g_recovery.evalAction != RecoveryAction::NONE)
+    {
+        LOG_WARN(LogModule::MODEM, "RECOVERY: %s did not recover", recoveryActionName(g_recovery.evalAction));
+        g_recovery.evalAction = RecoveryAction::NONE;
+        g_recovery.evalStartedMs = 0;
+        g_recovery.evalAwaitRetry = false;
+    }
+
     g_recovery.reason = reason;
+    g_recovery.failureClass = cls;
+    g_recovery.modemResetRunning = false;
     g_recovery.consecutiveFailures++;
-    g_recovery.action = chooseRecoveryAction(g_recovery.consecutiveFailures);
+    g_recovery.action = chooseRecoveryAction(cls, g_recovery.consecutiveFailures);
     g_recovery.executeAtMs = nowMs + recoveryBackoffMs(g_recovery.consecutiveFailures);
 
     g_recoveryCountBoot++;
     g_lastRecoveryReason = reason;
+    g_lastFailureClass = cls;
 
-    logSystemf("RECOVERY: requested reason=%s action=%s failures=%u backoff_ms=%lu",
-               recoveryReasonName(g_recovery.reason),
-               recoveryActionName(g_recovery.action),
-               (unsigned)g_recovery.consecutiveFailures,
-               (unsigned long)recoveryBackoffMs(g_recovery.consecutiveFailures));
+    journalBreadcrumbRecovery(recoveryReasonName(reason));
+
+    LOG_WARN(LogModule::MODEM, "RECOVERY: requested reason=%s class=%s action=%s failures=%u backoff_ms=%lu",
+             recoveryReasonName(g_recovery.reason),
+             failureClassName(cls),
+             recoveryActionName(g_recovery.action),
+             (unsigned)g_recovery.consecutiveFailures,
+             (unsigned long)recoveryBackoffMs(g_recovery.consecutiveFailures));
 
     g_bootProfileSyncActive = false;
     g_profileChangePublishPending = false;
@@ -685,17 +1164,73 @@ static void requestRecovery(RecoveryReason reason, uint32_t nowMs)
     g_step = Step::STEP_RECOVERY_WAIT;
 }
 
+// Översätt recovery-steg till modemets reset-åtgärd.
+static ModemResetKind modemResetForAction(RecoveryAction a)
+{
+    switch (a)
+    {
+    case RecoveryAction::PDP_REACTIVATE:
+        return ModemResetKind::PDP_REACTIVATE;
+    case RecoveryAction::SOFT_RESET:
+        return ModemResetKind::SOFT_RESET;
+    case RecoveryAction::PWRKEY_CYCLE:
+        return ModemResetKind::PWRKEY_CYCLE;
+    case RecoveryAction::RAIL_CYCLE:
+        return ModemResetKind::RAIL_CYCLE;
+    default:
+        return ModemResetKind::NONE;
+    }
+}
+
+// Ticka pågående modem-reset. När den är klar går vi tillbaka till DECIDE,
+// och nästa publish-cykel avgör om steget räknas som lyckat.
+static void tickRecoveryModemReset(uint32_t nowMs)
+{
+    bool ok = false;
+
+    if (modemTickReset(ok))
+    {
+        g_recovery.modemResetRunning = false;
+
+        logSystemf("RECOVERY: %s finished modem_ok=%d",
+                   recoveryActionName(g_recovery.action),
+                   ok ? 1 : 0);
+
+        g_nextCommAtMs = nowMs + 2000UL;
+        stepEnter(Step::STEP_DECIDE, nowMs);
+        return;
+    }
+
+    if (stepTimedOut(nowMs))
+    {
+        logSystemf("RECOVERY: %s guard timeout", recoveryActionName(g_recovery.action));
+        modemAbortReset();
+        g_recovery.modemResetRunning = false;
+        g_nextCommAtMs = nowMs + 2000UL;
+        stepEnter(Step::STEP_DECIDE, nowMs);
+    }
+}
+
 // Utför recovery-åtgärd när backoff gått ut.
 static void performRecovery(uint32_t nowMs)
 {
+    if (g_recovery.modemResetRunning)
+    {
+        tickRecoveryModemReset(nowMs);
+        return;
+    }
+
     if (!timeReached(nowMs, g_recovery.executeAtMs))
         return;
 
-    logSystemf("RECOVERY: execute reason=%s action=%s failures=%u",
+    logSystemf("RECOVERY: execute reason=%s class=%s action=%s failures=%u",
                recoveryReasonName(g_recovery.reason),
+               failureClassName(g_recovery.failureClass),
                recoveryActionName(g_recovery.action),
                (unsigned)g_recovery.consecutiveFailures);
 
+    recoveryRungStarted(g_recovery.action, nowMs);
+
     // Städa alltid först.
     modemAbortConnectData();
     mqttDisconnect();
@@ -713,7 +1248,7 @@ static void performRecovery(uint32_t nowMs)
         {
             modemRfOff();
         }
-        g_nextCommAtMs = nowMs + currentProfile().commIntervalMs;
+        g_nextCommAtMs = nowMs + powerSchedCommIntervalMs(currentProfile());
         g_step = Step::STEP_DECIDE;
         g_deadlineMs = 0;
         break;
@@ -726,12 +1261,15 @@ static void performRecovery(uint32_t nowMs)
         g_deadlineMs = 0;
         break;
 
-    case RecoveryAction::POWER_CYCLE_MODEM:
-        // Tyngsta åtgärden som finns tillgänglig i nuvarande gränssnitt.
-        modemPowerCycle();
-        g_nextCommAtMs = nowMs + 3000UL;
-        g_step = Step::STEP_DECIDE;
-        g_deadlineMs = 0;
+    case RecoveryAction::PDP_REACTIVATE:
+    case RecoveryAction::SOFT_RESET:
+    case RecoveryAction::PWRKEY_CYCLE:
+    case RecoveryAction::RAIL_CYCLE:
+        // Modem-steg körs icke-blockerande. Vi ligger kvar i RECOVERY_WAIT
+        // och tickar modemet tills det är klart eller guard-tiden gått.
+        modemStartReset(modemResetForAction(g_recovery.action));
+        g_recovery.modemResetRunning = true;
+        g_deadlineMs = nowMs + RECOVERY_MODEM_RESET_GUARD_MS;
         break;
 
     default:
@@ -752,6 +1290,12 @@ static void stepEnter(Step s, uint32_t nowMs)
         modemAbortConnectData();
     }
 
+    // Lämnar vi scansteget i förtid ska BLE stängas.
+    if (old == Step::STEP_VICTRON_BLE_SCAN && s != Step::STEP_VICTRON_BLE_SCAN)
+    {
+        victronManagerScanAbort(nowMs);
+    }
+
     g_step = s;
 
     switch (s)
@@ -762,6 +1306,7 @@ static void stepEnter(Step s, uint32_t nowMs)
 
     case Step::STEP_NET_ATTACH:
         g_netAttemptStarted = false;
+        recoveryRetryStarted(nowMs);
 
         if (g_forcedNextNetAttemptLink != NetAttemptLink::NONE)
         {
@@ -804,6 +1349,7 @@ static void stepEnter(Step s, uint32_t nowMs)
         // Så fort vi ska publicera är boot-sync-fönstret över.
         g_bootProfileSyncActive = false;
         g_deadlineMs = nowMs + 8000UL;
+        g_gpsWaitStartMs = 0;
         break;
 
     case Step::STEP_RX_DOWNLINK:
@@ -841,7 +1387,9 @@ static void stepEnter(Step s, uint32_t nowMs)
 
     case Step::STEP_VICTRON_BLE_SCAN:
         g_bootProfileSyncActive = false;
-        // Scan körs blockande direkt i tick och går sedan tillbaka till DECIDE.
+        // Scan startas i första tick och tickas asynkront tills alla enheter
+        // hörts eller scantiden gått ut. Deadline är bara ett skyddsnät.
+        g_victronScanStarted = false;
         g_deadlineMs = nowMs + (currentProfile().victronBleScanSeconds * 1000UL) + 5000UL;
         break;
 
@@ -978,6 +1526,11 @@ static void pirIngestIsr(uint32_t nowMs)
     g_pir.last_ms = nowMs;
     g_pir.src_mask |= acceptedMask;
 
+#if EXTERNAL_GNSS_ENABLED
+    // PIR-händelsen publiceras strax; värm upp GNSS redan nu.
+    gnssPowerWakeNow(nowMs, "pir");
+#endif
+
     if (p.id == ProfileId::ARMED)
     {
         logSystem("PIR: auto profile change ARMED -> TRIGGERED");
@@ -1040,7 +1593,13 @@ void pipelineOnProfileChanged(ProfileId newProfile)
     // Planera om nästa ordinarie kommunikationsfönster enligt
     // nya profilen.
     // --------------------------------------------------------
-    g_nextCommAtMs = nowMs + currentProfile().commIntervalMs;
+    g_nextCommAtMs = nowMs + powerSchedCommIntervalMs(currentProfile());
+
+#if EXTERNAL_GNSS_ENABLED
+    // Profilbytet publiceras snart med position; väck GNSS direkt
+    // i stället för att vänta på nästa schemalagda väckning.
+    gnssPowerWakeNow(nowMs, "profile");
+#endif
 
     // --------------------------------------------------------
     // Om vi redan är MQTT-anslutna när profil ändras ska vi ge
@@ -1143,14 +1702,45 @@ void pipelineInit()
 // ============================================================
 void pipelineTick(uint32_t nowMs)
 {
+    // Brödsmula i RTC-minne: senaste steg och upptid.
+    journalBreadcrumbStep(stepName(g_step), nowMs);
+
 #if EXTERNAL_GNSS_ENABLED
-    // Poll extern GNSS kontinuerligt så senaste fix hålls uppdaterad
+    // Extern GNSS tas emot i egen task. Poll behövs bara om tasken
+    // inte kunde startas.
     extGnssPoll();
+    feedGpsFilter(nowMs);
+
+    // Standby/väckning av GNSS kring nästa kommunikationsfönster
+    // (glesare vid låg batterinivå, se power_sched).
+    gnssPowerTick(nowMs, currentProfile().keepConnected,
+                  powerSchedGnssNeedAtMs(g_nextCommAtMs, currentProfile()));
+
+    // Spårinspelning (TRAVEL), 1 Hz ur filtrerad fix.
+    gpsTrackTick(nowMs, currentProfile().gpsTrackEnabled);
+
+    // Systemtid från GNSS när fix finns.
+    timeTickGnss(nowMs);
 #endif
 
+    // Stoppa SNTP efter synk/timeout.
+    timeTickNtp(nowMs);
+
     // Hämta in PIR-data från ISR varje tick
     pirIngestIsr(nowMs);
 
+    // Samla in svar på ev. asynkront modemkommando (t.ex. CCLK).
+    modemTickAsyncAt(nowMs);
+
+    // Victron bakgrundsscan i profiler som har den (TRAVEL).
+    victronManagerBackgroundTick(nowMs, currentProfile());
+
+    // PMU-telemetri (batteri, VBUS, VSYS, temperatur).
+    powerSampleTick(nowMs);
+
+    // Batterianpassade intervall (SmartShunt/PMU).
+    powerSchedTick(nowMs);
+
     // Automatisk TRIGGERED -> ARMED när timeout går ut
     if (currentProfile().id == ProfileId::TRIGGERED &&
         currentProfile().autoReturnMs > 0 &&
@@ -1176,6 +1766,16 @@ void pipelineTick(uint32_t nowMs)
         }
     }
 
+    // Cellinfo hålls färsk medan SIM-länken är uppe och modemet är ledigt.
+    if (mqttIsConnected() &&
+        String(mqttGetActiveLink()) == "SIM" &&
+        !modemIsConnectBusy() &&
+        !modemIsResetBusy() &&
+        !modemIsAsyncAtBusy())
+    {
+        modemTickCellInfo(nowMs);
+    }
+
     switch (g_step)
     {
     case Step::STEP_DECIDE:
@@ -1197,7 +1797,8 @@ void pipelineTick(uint32_t nowMs)
         }
 
         // Victron BLE får lägst prioritet: aldrig före PIR/profil/ordinarie kommunikation.
-        // Första versionen är tänkt för PARKED med kommunikation avstängd.
+        // Schemalagd scan är tänkt för PARKED med kommunikation avstängd;
+        // bakgrundsscan (TRAVEL) sköts av victronManagerBackgroundTick().
         if (victronManagerDue(nowMs, currentProfile()))
         {
             if (currentProfile().victronBleRequiresCommsOff && mqttIsConnected())
@@ -1245,11 +1846,19 @@ void pipelineTick(uint32_t nowMs)
                 {
                     g_netConnectCountBoot++;
                     g_lastNetConnectMs = nowMs - g_netAttemptStartedMs;
+                    g_autoWifiFailedLast = false;
 
                     markProgress(nowMs, "wifi connect ok");
 
+                    g_netAttachedAtMs = nowMs;
+
                     // Vid WiFi kan NTP fungera direkt. Modemklocka hoppar vi över.
-                    timeSyncFromNtp(8000);
+                    // SNTP körs i bakgrunden och bara när klockan kan ha drivit
+                    // för mycket (eller GNSS-tiden inte är färsk).
+                    if (timeNeedsSync(nowMs))
+                    {
+                        timeStartNtp();
+                    }
 
                     stepEnter(Step::STEP_MQTT_CONNECT, nowMs);
                     break;
@@ -1293,8 +1902,16 @@ void pipelineTick(uint32_t nowMs)
 
                 markProgress(nowMs, "net attach ok");
 
-                timeSyncFromModem();
-                timeSyncFromNtp(8000);
+                // Modemklockan läses asynkront och sätter systemtiden via
+                // callback. NTP körs inte här: ESP32:s lwIP har ingen väg ut
+                // över modemets AT-sockets, så det skulle bara vänta ut timeout.
+                // Synk behövs bara när klockan kan ha drivit för mycket.
+                g_netAttachedAtMs = nowMs;
+
+                if (timeNeedsSync(nowMs))
+                {
+                    timeRequestSyncFromModem();
+                }
 
                 stepEnter(Step::STEP_MQTT_CONNECT, nowMs);
                 break;
@@ -1328,6 +1945,14 @@ void pipelineTick(uint32_t nowMs)
     }
 
     case Step::STEP_MQTT_CONNECT:
+        // Asynkron modemfråga (t.ex. CCLK) delar UART med MQTT över SIM.
+        // Svaret brukar komma inom några tiotal ms, så vi släpper bara
+        // loopen tills det är klart i stället för att blockera.
+        if (modemIsAsyncAtBusy())
+        {
+            break;
+        }
+
         if (mqttConnect())
         {
             g_lastSuccessfulMqttConnectMs = nowMs;
@@ -1394,12 +2019,43 @@ void pipelineTick(uint32_t nowMs)
             break;
         }
 
+        // Ge GPS-filtret en kort chans att bekräfta positionen, men bara om
+        // det redan har godkända prover på gång. PIR går alltid direkt.
+        if (!g_pir.pending && gpsShouldWaitForConfirm(nowMs))
+        {
+            break;
+        }
+
+        uint32_t cycleStartMs = millis();
+
         bool ackOk = mqttPublishPendingProfileAck();
 
         ExtGnssFix fx;
         bool fixOk = buildGpsFromExternal(fx);
         bool gpsOk = mqttPublishGpsSingle(fx, fixOk);
+
+        if (g_netAttachedAtMs != 0)
+        {
+            g_lastAttachToPublishMs = nowMs - g_netAttachedAtMs;
+            g_netAttachedAtMs = 0;
+            logSystemf("PIPELINE: attach->publish %lu ms", (unsigned long)g_lastAttachToPublishMs);
+        }
+
+#if EXTERNAL_GNSS_ENABLED
+        if (gpsOk && fixOk)
+        {
+            gnssPowerNotifyFixUsed(nowMs);
+            powerSchedNoteGnssFix(nowMs);
+        }
+#else
         (void)gpsOk;
+#endif
+
+        // Spårbatch när den är mogen. Misslyckas den ligger punkterna kvar.
+        if (gpsTrackBatchDue(nowMs))
+        {
+            mqttPublishGpsBatch();
+        }
 
         bool pirOk = true;
         if (g_pir.pending)
@@ -1435,9 +2091,14 @@ void pipelineTick(uint32_t nowMs)
         bool healthOk = mqttPublishHealth(
             g_recoveryCountBoot,
             recoveryReasonName(g_lastRecoveryReason),
+            recoveryActionName(g_lastRecoveryAction),
+            failureClassName(g_lastFailureClass),
+            recoveryRungsJson(),
             g_netConnectCountBoot,
             g_mqttConnectCountBoot,
             g_lastNetConnectMs,
+            g_lastAttachToPublishMs,
+            g_lastPublishCycleMs,
             mqttHasPendingProfileAck(),
             g_pir.pending);
 
@@ -1449,6 +2110,21 @@ void pipelineTick(uint32_t nowMs)
             logSystem("MQTT: Victron publish failed/deferred");
         }
 
+        // Aggregathinkar. Misslyckas den ligger hinkarna kvar i PSRAM.
+        if (victronAggBatchDue(nowMs))
+        {
+            mqttPublishVictronAggBatch();
+        }
+
+        // Journalutdrag efter onormal reset. Också extra, påverkar inte cykeln.
+        mqttPublishJournalIfPending();
+
+        g_lastPublishCycleMs = millis() - cycleStartMs;
+        if (currentProfile().keepConnected)
+            victronManagerNotePublishCycle(g_lastPublishCycleMs);
+        logSystemf("PIPELINE: publish cycle %lu ms (log compile level %d)",
+                   (unsigned long)g_lastPublishCycleMs, LOG_COMPILE_LEVEL);
+
         // Treata detta som lyckad publish-cykel om ALIVE gick igenom,
         // nätstatus gick igenom och eventuell profile-ACK också gick igenom.
         bool cycleHealthy = aliveOk && ackOk && netStatusOk && healthOk;
@@ -1460,13 +2136,13 @@ void pipelineTick(uint32_t nowMs)
         }
         else
         {
-            logSystemf("PIPELINE: publish cycle degraded ack_ok=%d alive_ok=%d health_ok=%d net_ok=%d pir_ok=%d gps_ok=%d",
-                       ackOk ? 1 : 0,
-                       aliveOk ? 1 : 0,
-                       healthOk ? 1 : 0,
-                       netStatusOk ? 1 : 0,
-                       pirOk ? 1 : 0,
-                       gpsOk ? 1 : 0);
+            LOG_WARN(LogModule::PIPELINE, "PIPELINE: publish cycle degraded ack_ok=%d alive_ok=%d health_ok=%d net_ok=%d pir_ok=%d gps_ok=%d",
+                     ackOk ? 1 : 0,
+                     aliveOk ? 1 : 0,
+                     healthOk ? 1 : 0,
+                     netStatusOk ? 1 : 0,
+                     pirOk ? 1 : 0,
+                     gpsOk ? 1 : 0);
 
             // Om central publish inte går igenom vill vi inte ligga kvar
             // i ett halvanslutet läge och hoppas för länge.
@@ -1491,7 +2167,7 @@ void pipelineTick(uint32_t nowMs)
         }
 
         // Planera nästa ordinarie kommunikation
-        g_nextCommAtMs = nowMs + currentProfile().commIntervalMs;
+        g_nextCommAtMs = nowMs + powerSchedCommIntervalMs(currentProfile());
 
         if (shouldKeepConnectedNow() || shouldHoldConnectionForProfilePublish())
         {
@@ -1628,26 +2304,48 @@ void pipelineTick(uint32_t nowMs)
 
     case Step::STEP_VICTRON_BLE_SCAN:
     {
-        // Extra skydd: om något kritiskt hann komma in innan scan startar, avbryt BLE.
-        if (g_pir.pending || timeReached(nowMs, g_nextCommAtMs))
+        if (!g_victronScanStarted)
         {
-            logSystem("VICTRON: scan skipped, communication/PIR became due");
-            stepEnter(Step::STEP_DECIDE, nowMs);
+            // Extra skydd: om något kritiskt hann komma in innan scan startar, avbryt BLE.
+            if (g_pir.pending || timeReached(nowMs, g_nextCommAtMs))
+            {
+                logSystem("VICTRON: scan skipped, communication/PIR became due");
+                stepEnter(Step::STEP_DECIDE, nowMs);
+                break;
+            }
+
+            if (currentProfile().victronBleRequiresCommsOff)
+            {
+                mqttDisconnect();
+                wifiPowerOff();
+                modemAbortConnectData();
+                // Modemet är normalt redan RF_OFF efter föregående kommunikationsfönster.
+                // Kör inte CFUN=0 här igen; det kan blockera ~5 s och ge
+                // "CFUN=0 failed" precis före BLE-scan.
+            }
+
+            g_victronScanStarted = true;
+            if (!victronManagerScanStart(nowMs, currentProfile().victronBleScanSeconds))
+            {
+                stepEnter(Step::STEP_DECIDE, millis());
+            }
             break;
         }
 
-        if (currentProfile().victronBleRequiresCommsOff)
+        // PIR ska inte vänta på att scanningen går klart.
+        if (g_pir.pending || stepTimedOut(nowMs))
         {
-            mqttDisconnect();
-            wifiPowerOff();
-            modemAbortConnectData();
-            // Modemet är normalt redan RF_OFF efter föregående kommunikationsfönster.
-            // Kör inte CFUN=0 här igen; det kan blockera ~5 s och ge
-            // "CFUN=0 failed" precis före BLE-scan.
+            logSystem(g_pir.pending ? "VICTRON: scan aborted, PIR pending"
+                                    : "VICTRON: scan aborted, step timeout");
+            victronManagerScanAbort(nowMs);
+            stepEnter(Step::STEP_DECIDE, millis());
+            break;
         }
 
-        victronManagerRunScanOnce(nowMs, currentProfile().victronBleScanSeconds);
-        stepEnter(Step::STEP_DECIDE, millis());
+        if (victronManagerScanTick(nowMs))
+        {
+            stepEnter(Step::STEP_DECIDE, millis());
+        }
         break;
     }
 
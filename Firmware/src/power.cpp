@@ -3,6 +3,7 @@
 #include "logging.h"
 
 #include <Wire.h>
+#include <math.h>
 
 #define XPOWERS_CHIP_AXP2101
 #include "XPowersLib.h"
@@ -11,6 +12,9 @@
 // Används för att styra spänningsutgångar på T-SIM7080G-S3-kortet.
 static XPowersPMU PMU;
 
+// Sätts när powerInit() lyckats. Rail-styrning kräver initierad PMU.
+static bool g_pmuOk = false;
+
 bool powerInit()
 {
   // Logga att vi startar initiering av PMU
@@ -65,8 +69,331 @@ bool powerInit()
   //
   PMU.disableTSPinMeasure();
 
+  // =========================================================
+  // BATTERINIVÅ
+  // =========================================================
+  //
+  // Batteridetektering och bränslemätare behövs för att läsa
+  // PMU-batteriets nivå (används av batterianpassad schemaläggning).
+  //
+  PMU.enableBattDetection();
+  PMU.enableBattVoltageMeasure();
+  PMU.enableGauge();
+
+  // =========================================================
+  // TELEMETRI
+  // =========================================================
+  //
+  // VBUS, VSYS och chiptemperatur samplas av powerSampleTick().
+  //
+  PMU.enableVbusVoltageMeasure();
+  PMU.enableSystemVoltageMeasure();
+  PMU.enableTemperatureMeasure();
+
   // Logga att nödvändiga matningar nu är igång
   logSystem("PMU: modem power rail ON (DC3), unused rails OFF");
 
+  g_pmuOk = true;
+  return true;
+}
+
+// =========================================================
+// MODEMMATNING – RECOVERY
+// =========================================================
+//
+// Att bryta DC3 är det tyngsta recovery-steget: modemet blir helt
+// strömlöst och måste sedan startas med PWRKEY. Sekvensering och
+// väntetider sköts av modem.cpp, här görs bara själva registerskrivningen.
+//
+bool powerModemRailOff()
+{
+  if (!g_pmuOk)
+  {
+    logSystem("PMU: modem rail OFF skipped, PMU not initialized");
+    return false;
+  }
+
+  PMU.disableDC3();
+  logSystem("PMU: modem power rail OFF (DC3)");
+  return true;
+}
+
+bool powerModemRailOn()
+{
+  if (!g_pmuOk)
+  {
+    logSystem("PMU: modem rail ON skipped, PMU not initialized");
+    return false;
+  }
+
+  PMU.setDC3Voltage(3000);
+  PMU.enableDC3();
+  logSystem("PMU: modem power rail ON (DC3)");
+  return true;
+}
+
+// =========================================================
+// PMU-TELEMETRI
+// =========================================================
+//
+// Drivrutinens getters läser ett eller två register per anrop och
+// flera av dem läser STATUS1/2 igen. Här läses i stället tre block
+// direkt: STATUS1..2, ADC-resultaten 0x34..0x3D och bränslemätaren.
+// Avkodningen följer XPowersAXP2101.tpp.
+//
+
+struct PmuSample
+{
+  uint32_t ms;
+  uint16_t battMv;   // 0 = inget batteri
+  uint16_t vbusMv;   // 0 = ingen VBUS
+  uint16_t vsysMv;
+  int8_t battPct;    // -1 = okänt
+  float tempC;
+  bool battPresent;
+  bool vbusIn;
+  bool charging;
+  bool thermalReg;
+  PmuChargeState chg;
+};
+
+// Ringbuffer för trender. g_histCount <= PMU_TREND_SAMPLES.
+static PmuSample g_hist[PMU_TREND_SAMPLES];
+static uint8_t g_histHead = 0;
+static uint8_t g_histCount = 0;
+
+static PmuSample g_last;
+static bool g_haveSample = false;
+static uint32_t g_lastSampleAttemptMs = 0;
+static bool g_sampleAttempted = false;
+static uint32_t g_readErrors = 0;
+
+static uint16_t g_vsysMinMv = 0xFFFF;
+static uint32_t g_vsysLowCount = 0;
+static uint32_t g_vbusLossCount = 0;
+static uint32_t g_vbusChangeMs = 0;
+static bool g_vbusChangeSeen = false;
+
+const char *pmuChargeStateName(PmuChargeState s)
+{
+  switch (s)
+  {
+  case PmuChargeState::TRICKLE:
+    return "TRICKLE";
+  case PmuChargeState::PRE:
+    return "PRE";
+  case PmuChargeState::CC:
+    return "CC";
+  case PmuChargeState::CV:
+    return "CV";
+  case PmuChargeState::DONE:
+    return "DONE";
+  default:
+    return "STOP";
+  }
+}
+
+static bool readSample(uint32_t nowMs, PmuSample &out)
+{
+  uint8_t status[2];
+  uint8_t adc[10];
+  uint8_t pct = 0;
+
+  if (PMU.readRegister(XPOWERS_AXP2101_STATUS1, status, sizeof(status)) != 0 ||
+      PMU.readRegister(XPOWERS_AXP2101_ADC_DATA_RELUST0, adc, sizeof(adc)) != 0 ||
+      PMU.readRegister(XPOWERS_AXP2101_BAT_PERCENT_DATA, &pct, 1) != 0)
+  {
+    return false;
+  }
+
+  out.ms = nowMs;
+  out.battPresent = (status[0] & 0x08) != 0;
+  out.thermalReg = (status[0] & 0x02) != 0;
+  // VBUS räknas som ansluten när den är "good" och inte för låg.
+  out.vbusIn = (status[0] & 0x20) != 0 && (status[1] & 0x08) == 0;
+  out.charging = (status[1] >> 5) == 0x01;
+  const uint8_t chg = status[1] & 0x07;
+  out.chg = chg <= (uint8_t)PmuChargeState::STOP ? (PmuChargeState)chg : PmuChargeState::STOP;
+
+  out.battMv = out.battPresent ? (uint16_t)(((adc[0] & 0x1F) << 8) | adc[1]) : 0;
+  out.vbusMv = out.vbusIn ? (uint16_t)(((adc[4] & 0x3F) << 8) | adc[5]) : 0;
+  out.vsysMv = (uint16_t)(((adc[6] & 0x3F) << 8) | adc[7]);
+  const uint16_t tempRaw = (uint16_t)(((adc[8] & 0x3F) << 8) | adc[9]);
+  out.tempC = XPOWERS_AXP2101_CONVERSION(tempRaw);
+  out.battPct = out.battPresent && pct <= 100 ? (int8_t)pct : -1;
+  return true;
+}
+
+static void noteSample(const PmuSample &s)
+{
+  // VBUS-övergångar: bortfall är det intressanta (avbrott/sabotage).
+  if (g_haveSample && s.vbusIn != g_last.vbusIn)
+  {
+    g_vbusChangeMs = s.ms;
+    g_vbusChangeSeen = true;
+    if (!s.vbusIn)
+    {
+      g_vbusLossCount++;
+      LOG_WARN(LogModule::POWER, "PMU: VBUS lost (vsys=%u mV batt=%u mV %d%%)",
+               s.vsysMv, s.battMv, s.battPct);
+    }
+    else
+    {
+      LOG_INFO(LogModule::POWER, "PMU: VBUS restored (%u mV)", s.vbusMv);
+    }
+  }
+
+  if (s.vsysMv > 0 && s.vsysMv < g_vsysMinMv)
+    g_vsysMinMv = s.vsysMv;
+
+  // Räkna varje lågt sample men logga bara övergången.
+  const bool vsysLow = s.vsysMv > 0 && s.vsysMv < PMU_VSYS_LOW_MV;
+  if (vsysLow)
+  {
+    g_vsysLowCount++;
+    if (!g_haveSample || g_last.vsysMv >= PMU_VSYS_LOW_MV)
+    {
+      LOG_WARN(LogModule::POWER, "PMU: VSYS low %u mV (vbus=%u mV batt=%u mV)",
+               s.vsysMv, s.vbusMv, s.battMv);
+    }
+  }
+
+  g_hist[g_histHead] = s;
+  g_histHead = (uint8_t)((g_histHead + 1) % PMU_TREND_SAMPLES);
+  if (g_histCount < PMU_TREND_SAMPLES)
+    g_histCount++;
+
+  g_last = s;
+  g_haveSample = true;
+}
+
+void powerSampleTick(uint32_t nowMs)
+{
+  if (!g_pmuOk)
+    return;
+
+  if (g_sampleAttempted && (uint32_t)(nowMs - g_lastSampleAttemptMs) < PMU_SAMPLE_MS)
+    return;
+
+  g_sampleAttempted = true;
+  g_lastSampleAttemptMs = nowMs;
+
+  PmuSample s;
+  if (!readSample(nowMs, s))
+  {
+    g_readErrors++;
+    LOG_WARN(LogModule::POWER, "PMU: sample read failed (errors=%lu)", (unsigned long)g_readErrors);
+    return;
+  }
+
+  if (!g_haveSample)
+  {
+    logSystemf("PMU: first sample batt=%u mV %d%% vbus=%u mV vsys=%u mV chg=%s temp=%.1f C",
+               s.battMv, s.battPct, s.vbusMv, s.vsysMv, pmuChargeStateName(s.chg), s.tempC);
+  }
+
+  noteSample(s);
+}
+
+static bool sampleFresh(uint32_t nowMs)
+{
+  return g_haveSample && (uint32_t)(nowMs - g_last.ms) < PMU_SAMPLE_STALE_MS;
+}
+
+// Lutning per timme (minsta kvadrat) för ett fält i historiken.
+// NAN om fönstret är för kort eller ett sample saknar värdet.
+template <typename Getter>
+static float trendPerHour(Getter get)
+{
+  if (g_histCount < 2)
+    return NAN;
+
+  const uint8_t oldest = (uint8_t)((g_histHead + PMU_TREND_SAMPLES - g_histCount) % PMU_TREND_SAMPLES);
+  const uint32_t t0 = g_hist[oldest].ms;
+  const uint32_t newestMs = g_last.ms;
+  if ((uint32_t)(newestMs - t0) < PMU_TREND_MIN_SPAN_MS)
+    return NAN;
+
+  float sumT = 0, sumY = 0, sumTT = 0, sumTY = 0;
+  for (uint8_t i = 0; i < g_histCount; i++)
+  {
+    const PmuSample &s = g_hist[(oldest + i) % PMU_TREND_SAMPLES];
+    const float y = get(s);
+    if (isnan(y))
+      return NAN;
+
+    // Timmar relativt äldsta sample håller talen små.
+    const float t = (float)(uint32_t)(s.ms - t0) / 3600000.0f;
+    sumT += t;
+    sumY += y;
+    sumTT += t * t;
+    sumTY += t * y;
+  }
+
+  const float n = (float)g_histCount;
+  const float den = n * sumTT - sumT * sumT;
+  if (den <= 0.0f)
+    return NAN;
+
+  return (n * sumTY - sumT * sumY) / den;
+}
+
+static float battMvOf(const PmuSample &s) { return s.battPresent ? (float)s.battMv : NAN; }
+static float battPctOf(const PmuSample &s) { return s.battPct >= 0 ? (float)s.battPct : NAN; }
+static float vsysMvOf(const PmuSample &s) { return (float)s.vsysMv; }
+static float tempCOf(const PmuSample &s) { return s.tempC; }
+
+bool powerBatteryPercent(int &pct)
+{
+  if (!g_pmuOk || !sampleFresh(millis()) || g_last.battPct < 0)
+    return false;
+
+  pct = g_last.battPct;
   return true;
-}
\ No newline at end of file
+}
+
+bool powerVbusPresent()
+{
+  return g_pmuOk && sampleFresh(millis()) && g_last.vbusIn;
+}
+
+static String jsonFloatOrNull(float v, unsigned int decimals)
+{
+  return isnan(v) ? String("null") : String(v, decimals);
+}
+
+String powerStatsJson(uint32_t nowMs)
+{
+  String json = "{";
+  json += "\"ok\":" + String(g_pmuOk ? "true" : "false") + ",";
+  json += "\"read_errors\":" + String(g_readErrors);
+
+  if (!g_haveSample)
+  {
+    json += "}";
+    return json;
+  }
+
+  const PmuSample &s = g_last;
+  json += ",\"age_s\":" + String((uint32_t)(nowMs - s.ms) / 1000UL) + ",";
+  json += "\"batt\":" + String(s.battPresent ? "true" : "false") + ",";
+  json += "\"batt_mv\":" + (s.battPresent ? String(s.battMv) : String("null")) + ",";
+  json += "\"batt_pct\":" + (s.battPct >= 0 ? String(s.battPct) : String("null")) + ",";
+  json += "\"vbus\":" + String(s.vbusIn ? "true" : "false") + ",";
+  json += "\"vbus_mv\":" + String(s.vbusMv) + ",";
+  json += "\"vsys_mv\":" + String(s.vsysMv) + ",";
+  json += "\"vsys_min_mv\":" + String(g_vsysMinMv) + ",";
+  json += "\"vsys_low_count\":" + String(g_vsysLowCount) + ",";
+  json += "\"chg\":\"" + String(pmuChargeStateName(s.chg)) + "\",";
+  json += "\"charging\":" + String(s.charging ? "true" : "false") + ",";
+  json += "\"temp_c\":" + String(s.tempC, 1) + ",";
+  json += "\"thermal_reg\":" + String(s.thermalReg ? "true" : "false") + ",";
+  json += "\"batt_mv_per_h\":" + jsonFloatOrNull(trendPerHour(battMvOf), 0) + ",";
+  json += "\"batt_pct_per_h\":" + jsonFloatOrNull(trendPerHour(battPctOf), 1) + ",";
+  json += "\"vsys_mv_per_h\":" + jsonFloatOrNull(trendPerHour(vsysMvOf), 0) + ",";
+  json += "\"temp_c_per_h\":" + jsonFloatOrNull(trendPerHour(tempCOf), 1) + ",";
+  json += "\"vbus_loss_count\":" + String(g_vbusLossCount) + ",";
+  json += "\"vbus_change_age_s\":" + (g_vbusChangeSeen ? String((uint32_t)(nowMs - g_vbusChangeMs) / 1000UL) : String("null"));
+  json += "}";
+  return json;
+}
@@ -1,5 +1,50 @@
 #pragma once
 
+#include <Arduino.h>
+
 // Initierar PMU (AXP2101) och slår på den matning som behövs för modemet.
 // Returnerar true om init lyckades, annars false.
-bool powerInit();
\ No newline at end of file
+bool powerInit();
+
+// Bryter modemets matning (DC3). Används som sista recovery-steg.
+// Returnerar false om PMU inte är initierad.
+bool powerModemRailOff();
+
+// Slår på modemets matning (DC3) igen.
+bool powerModemRailOn();
+
+// PMU-batteriets nivå (%) enligt AXP2101:s bränslemätare (senaste sample).
+// false = PMU inte initierad, inget färskt sample eller inget batteri anslutet.
+bool powerBatteryPercent(int &pct);
+
+// ============================================================
+// PMU-telemetri
+// ------------------------------------------------------------
+// powerSampleTick läser AXP2101:s status-, ADC- och bränslemätar-
+// register i block (en I2C-läsning per registerblock) var
+// PMU_SAMPLE_MS och håller trender över senaste PMU_TREND_SAMPLES.
+// Övriga power*-funktioner läser bara cachen.
+// ============================================================
+
+// Laddarens tillstånd enligt STATUS2[2:0].
+enum class PmuChargeState : uint8_t
+{
+  TRICKLE,
+  PRE,
+  CC,
+  CV,
+  DONE,
+  STOP
+};
+
+const char *pmuChargeStateName(PmuChargeState s);
+
+// Anropas varje tick.
+void powerSampleTick(uint32_t nowMs);
+
+// Finns extern matning (VBUS) enligt senaste sample?
+// false även om PMU saknas eller inget sample tagits.
+bool powerVbusPresent();
+
+// JSON för health: senaste värden, trender och VBUS-händelser.
+String powerStatsJson(uint32_t nowMs);
@@ -0,0 +1,262 @@
+#include "power_sched.h"
+
+#include "config.h"
+#include "logging.h"
+#include "power.h"
+#include "victron_manager.h"
+
+#include <math.h>
+
+// ============================================================
+// Batterianpassad schemaläggning
+// ------------------------------------------------------------
+// Källor i prioritetsordning för husbatteriet: SoC, sedan spänning.
+// PMU-batteriet utvärderas alltid och kan bara höja faktorn. Saknas
+// alla källor är faktorn 1, så en trasig shunt aldrig gör enheten
+// tystare.
+// ============================================================
+
+enum class PowerSchedSource : uint8_t
+{
+  NONE,
+  SOC,
+  VOLTAGE,
+  PMU
+};
+
+static const char *sourceName(PowerSchedSource s)
+{
+  switch (s)
+  {
+  case PowerSchedSource::SOC:
+    return "SOC";
+  case PowerSchedSource::VOLTAGE:
+    return "VOLTAGE";
+  case PowerSchedSource::PMU:
+    return "PMU";
+  default:
+    return "NONE";
+  }
+}
+
+static float g_factor = 1.0f;
+static PowerSchedSource g_source = PowerSchedSource::NONE;
+static uint32_t g_lastEvalMs = 0;
+static bool g_evaluated = false;
+
+static float g_socPct = NAN;
+static float g_voltageV = NAN;
+static uint16_t g_ttgMin = 0xFFFF;
+static int g_pmuPct = -1;
+
+// Medelström (EWMA) för drifttidsprognosen.
+static float g_currentAvgA = NAN;
+static uint32_t g_currentLastSeenMs = 0;
+
+static uint32_t g_lastGnssFixMs = 0;
+static bool g_haveGnssFix = false;
+
+template <size_t N>
+static float curveFactor(const PowerSchedPoint (&curve)[N], float level)
+{
+  if (level >= curve[0].level)
+    return curve[0].factor;
+
+  for (size_t i = 1; i < N; i++)
+  {
+    if (level >= curve[i].level)
+    {
+      const PowerSchedPoint &hi = curve[i - 1];
+      const PowerSchedPoint &lo = curve[i];
+      const float t = (hi.level - level) / (hi.level - lo.level);
+      return hi.factor + t * (lo.factor - hi.factor);
+    }
+  }
+
+  return curve[N - 1].factor;
+}
+
+static bool isPirProfile(const ProfileConfig &profile)
+{
+  return profile.pirFront || profile.pirBack;
+}
+
+static uint32_t stretch(uint32_t baseMs, uint32_t capMs)
+{
+  if (g_factor <= 1.0f || baseMs == 0)
+    return baseMs;
+
+  // Taket gäller bara utsträckningen; ett längre profilintervall
+  // förkortas aldrig.
+  const float ms = (float)baseMs * g_factor;
+  const uint32_t limit = baseMs > capMs ? baseMs : capMs;
+  return ms >= (float)limit ? limit : (uint32_t)ms;
+}
+
+static void updateCurrentAverage(float currentA, uint32_t lastSeenMs)
+{
+  if (isnan(currentA) || lastSeenMs == g_currentLastSeenMs)
+    return;
+
+  if (isnan(g_currentAvgA) || g_currentLastSeenMs == 0)
+  {
+    g_currentAvgA = currentA;
+  }
+  else
+  {
+    const float dt = (float)(uint32_t)(lastSeenMs - g_currentLastSeenMs);
+    const float alpha = 1.0f - expf(-dt / (float)POWER_SCHED_CURRENT_TAU_MS);
+    g_currentAvgA += alpha * (currentA - g_currentAvgA);
+  }
+  g_currentLastSeenMs = lastSeenMs;
+}
+
+// Shuntdata räknas som färsk ett helt (utsträckt) scanintervall plus
+// marginal. Annars blir data från en utsträckt scan inaktuell innan
+// nästa scan och faktorn pendlar mellan 1 och det utsträckta värdet.
+static uint32_t batteryMaxAgeMs()
+{
+  const uint32_t scanMs = powerSchedVictronIntervalMs(currentProfile()) + POWER_SCHED_VICTRON_FRESH_MARGIN_MS;
+  return scanMs > VICTRON_FRESH_TIMEOUT_MS ? scanMs : VICTRON_FRESH_TIMEOUT_MS;
+}
+
+static void evaluate(uint32_t nowMs)
+{
+  float soc = NAN, voltage = NAN, current = NAN;
+  uint16_t ttg = 0xFFFF;
+  uint32_t lastSeenMs = 0;
+
+  if (victronManagerBattery(soc, voltage, current, ttg, lastSeenMs, batteryMaxAgeMs()))
+  {
+    updateCurrentAverage(current, lastSeenMs);
+  }
+  else
+  {
+    soc = NAN;
+    voltage = NAN;
+    ttg = 0xFFFF;
+  }
+
+  g_socPct = soc;
+  g_voltageV = voltage;
+  g_ttgMin = ttg;
+
+  int pmuPct = -1;
+  if (!powerBatteryPercent(pmuPct))
+    pmuPct = -1;
+  g_pmuPct = pmuPct;
+
+  float factor = 1.0f;
+  PowerSchedSource source = PowerSchedSource::NONE;
+
+  if (!isnan(soc))
+  {
+    factor = curveFactor(POWER_SCHED_SOC_CURVE, soc);
+    source = PowerSchedSource::SOC;
+  }
+  else if (!isnan(voltage))
+  {
+    factor = curveFactor(POWER_SCHED_VOLT_CURVE, voltage);
+    source = PowerSchedSource::VOLTAGE;
+  }
+
+  if (pmuPct >= 0)
+  {
+    const float pmuFactor = curveFactor(POWER_SCHED_PMU_CURVE, (float)pmuPct);
+    if (pmuFactor > factor)
+    {
+      factor = pmuFactor;
+      source = PowerSchedSource::PMU;
+    }
+  }
+
+#if !POWER_SCHED_ENABLED
+  factor = 1.0f;
+#endif
+
+  // Logga bara märkbara ändringar, inte varje decimal.
+  if (!g_evaluated || fabsf(factor - g_factor) >= 0.5f || source != g_source)
+  {
+    logSystemf("SCHED: factor %.1f -> %.1f src=%s soc=%.1f v=%.2f pmu=%d",
+               g_factor, factor, sourceName(source), soc, voltage, pmuPct);
+  }
+
+  g_factor = factor;
+  g_source = source;
+  g_evaluated = true;
+  g_lastEvalMs = nowMs;
+}
+
+void powerSchedTick(uint32_t nowMs)
+{
+  if (g_evaluated && (uint32_t)(nowMs - g_lastEvalMs) < POWER_SCHED_EVAL_MS)
+    return;
+
+  evaluate(nowMs);
+}
+
+float powerSchedFactor()
+{
+  return g_factor;
+}
+
+uint32_t powerSchedCommIntervalMs(const ProfileConfig &profile)
+{
+  // Larmets heartbeat ändras aldrig.
+  if (isPirProfile(profile))
+    return profile.commIntervalMs;
+
+  return stretch(profile.commIntervalMs, POWER_SCHED_COMM_MAX_MS);
+}
+
+uint32_t powerSchedVictronIntervalMs(const ProfileConfig &profile)
+{
+  return stretch(profile.victronBleIntervalMs, POWER_SCHED_VICTRON_MAX_MS);
+}
+
+uint32_t powerSchedGnssNeedAtMs(uint32_t nextCommAtMs, const ProfileConfig &profile)
+{
+  if (isPirProfile(profile) || g_factor < POWER_SCHED_GNSS_SPARSE_FACTOR || !g_haveGnssFix)
+    return nextCommAtMs;
+
+  // Glesa fixar: vänta till POWER_SCHED_GNSS_SPARSE_MS efter senaste,
+  // men aldrig före nästa kommunikationsfönster.
+  const uint32_t sparseAtMs = g_lastGnssFixMs + POWER_SCHED_GNSS_SPARSE_MS;
+  return (int32_t)(sparseAtMs - nextCommAtMs) > 0 ? sparseAtMs : nextCommAtMs;
+}
+
+void powerSchedNoteGnssFix(uint32_t nowMs)
+{
+  g_lastGnssFixMs = nowMs;
+  g_haveGnssFix = true;
+}
+
+String powerSchedStatsJson()
+{
+  const ProfileConfig &profile = currentProfile();
+
+  // Drifttid ned till reserven vid nuvarande medelurladdning.
+  // null vid laddning/tomgång eller okänd SoC.
+  float runtimeH = NAN;
+  if (!isnan(g_socPct) && !isnan(g_currentAvgA) && g_currentAvgA < -0.05f)
+  {
+    const float usableAh = (g_socPct - POWER_SCHED_RESERVE_SOC) / 100.0f * HOUSE_BATTERY_CAPACITY_AH;
+    runtimeH = usableAh > 0.0f ? usableAh / -g_currentAvgA : 0.0f;
+  }
+
+  String json = "{";
+  json += "\"enabled\":" + String(POWER_SCHED_ENABLED ? "true" : "false") + ",";
+  json += "\"factor\":" + String(g_factor, 1) + ",";
+  json += "\"src\":\"" + String(sourceName(g_source)) + "\",";
+  json += "\"soc\":" + (isnan(g_socPct) ? String("null") : String(g_socPct, 1)) + ",";
+  json += "\"batt_v\":" + (isnan(g_voltageV) ? String("null") : String(g_voltageV, 2)) + ",";
+  json += "\"pmu_pct\":" + (g_pmuPct >= 0 ? String(g_pmuPct) : String("null")) + ",";
+  json += "\"comm_s\":" + String(powerSchedCommIntervalMs(profile) / 1000UL) + ",";
+  json += "\"victron_s\":" + String(powerSchedVictronIntervalMs(profile) / 1000UL) + ",";
+  json += "\"gnss_sparse\":" + String(!isPirProfile(profile) && g_factor >= POWER_SCHED_GNSS_SPARSE_FACTOR ? "true" : "false") + ",";
+  json += "\"i_avg_a\":" + (isnan(g_currentAvgA) ? String("null") : String(g_currentAvgA, 2)) + ",";
+  json += "\"runtime_h\":" + (isnan(runtimeH) ? String("null") : String(runtimeH, 0)) + ",";
+  json += "\"shunt_ttg_min\":" + (g_ttgMin != 0xFFFF ? String(g_ttgMin) : String("null"));
+  json += "}";
+  return json;
+}
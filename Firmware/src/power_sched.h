@@ -0,0 +1,38 @@
+#pragma once
+
+#include <Arduino.h>
+#include "profiles.h"
+
+// ============================================================
+// Batterianpassad schemaläggning
+// ------------------------------------------------------------
+// Lager ovanpå profiltabellen: profilen säger hur ofta i normalfallet,
+// powerSched* säger hur ofta just nu givet batterinivån.
+// - faktorn utvärderas var POWER_SCHED_EVAL_MS från SmartShunt
+//   (SoC, annars spänning) och PMU-batteriet
+// - comm/Victron-intervall = profilens intervall x faktor, med tak
+// - PIR-profiler får aldrig glesare comm eller GNSS
+// - prognos för drifttid publiceras i health
+// ============================================================
+
+// Anropas varje tick.
+void powerSchedTick(uint32_t nowMs);
+
+// Aktuell faktor (>= 1).
+float powerSchedFactor();
+
+// Effektivt kommunikationsintervall för profilen.
+uint32_t powerSchedCommIntervalMs(const ProfileConfig &profile);
+
+// Effektivt Victron-intervall (scan resp. publicering vid bakgrundsscan).
+uint32_t powerSchedVictronIntervalMs(const ProfileConfig &profile);
+
+// När nästa GNSS-fix behövs. Normalt nästa kommunikationsfönster,
+// vid låg nivå högst en fix per POWER_SCHED_GNSS_SPARSE_MS.
+uint32_t powerSchedGnssNeedAtMs(uint32_t nextCommAtMs, const ProfileConfig &profile);
+
+// Meddela att en GNSS-fix använts.
+void powerSchedNoteGnssFix(uint32_t nowMs);
+
+// JSON för health: faktor, källa, effektiva intervall och prognos.
+String powerSchedStatsJson();
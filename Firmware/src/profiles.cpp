@@ -14,6 +14,9 @@
 // - Körläge
 // - RF/MQTT hålls uppe
 // - single GPS + alive var 10:e sekund
+// - GPS-spår spelas in och skickas som batch (KR-022)
+// - Victron BLE scannas kontinuerligt i bakgrunden (låg duty-cycle,
+//   delar radion med WiFi) och publiceras högst en gång per minut
 //
 // ARMED:
 // - Larmad men lugnt läge
@@ -46,7 +49,9 @@ static const ProfileConfig profileTable[] = {
         true,                // victronBleEnabled
         10UL * 60UL * 1000UL,// victronBleIntervalMs = 10 min
         5UL,                 // victronBleScanSeconds - testscan med duplicate BLE callbacks
-        true                 // victronBleRequiresCommsOff
+        true,                // victronBleRequiresCommsOff
+        false,               // victronBleBackground
+        false                // gpsTrackEnabled
     },
 
     // TRAVEL
@@ -58,10 +63,12 @@ static const ProfileConfig profileTable[] = {
         false,         // pirBack
         true,          // keepConnected
         0,             // autoReturnMs
-        false,         // victronBleEnabled
-        0,             // victronBleIntervalMs
+        true,          // victronBleEnabled
+        60UL * 1000UL, // victronBleIntervalMs = publicering var 60:e s
         0,             // victronBleScanSeconds
-        false          // victronBleRequiresCommsOff
+        false,         // victronBleRequiresCommsOff
+        true,          // victronBleBackground
+        true           // gpsTrackEnabled
     },
 
     // ARMED
@@ -76,7 +83,9 @@ static const ProfileConfig profileTable[] = {
         false,                // victronBleEnabled - aktiveras senare när PARKED är testad
         10UL * 60UL * 1000UL, // victronBleIntervalMs
         5UL,                  // victronBleScanSeconds - testscan med duplicate BLE callbacks
-        true                  // victronBleRequiresCommsOff
+        true,                 // victronBleRequiresCommsOff
+        false,                // victronBleBackground
+        false                 // gpsTrackEnabled
     },
 
     // TRIGGERED
@@ -91,7 +100,9 @@ static const ProfileConfig profileTable[] = {
         false,               // victronBleEnabled
         0,                   // victronBleIntervalMs
         0,                   // victronBleScanSeconds
-        false                // victronBleRequiresCommsOff
+        false,               // victronBleRequiresCommsOff
+        false,               // victronBleBackground
+        false                // gpsTrackEnabled
     },
 
     // ALARM
@@ -106,7 +117,9 @@ static const ProfileConfig profileTable[] = {
         false,         // victronBleEnabled
         0,             // victronBleIntervalMs
         0,             // victronBleScanSeconds
-        false          // victronBleRequiresCommsOff
+        false,         // victronBleRequiresCommsOff
+        false,         // victronBleBackground
+        false          // gpsTrackEnabled
     },
 };
 
@@ -52,10 +52,17 @@ struct ProfileConfig
   // - intervalMs: hur ofta BLE-data ska uppdateras
   // - scanSeconds: hur lång varje scan ska vara
   // - requiresCommsOff: true = MQTT/WiFi/SIM ska vara nere innan scan
+  // - background: kontinuerlig passiv scan med låg duty-cycle medan
+  //   kommunikationen är uppe. intervalMs är då publiceringsintervall
+  //   och scanSeconds används inte.
   bool victronBleEnabled;
   uint32_t victronBleIntervalMs;
   uint32_t victronBleScanSeconds;
   bool victronBleRequiresCommsOff;
+  bool victronBleBackground;
+
+  // GPS-spår: samplas 1 Hz, förenklas och skickas som batch.
+  bool gpsTrackEnabled;
 };
 
 // Initierar aktiv profil vid uppstart.
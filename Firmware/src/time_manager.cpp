@@ -1,4 +1,7 @@
 #include "time_manager.h"
+#include "civil_time.h"
+#include "config.h"
+#include "ext_gnss.h"
 #include "logging.h"
 #include "modem.h"
 
@@ -12,6 +15,7 @@
 // 1. Systemtiden i ESP32 hålls i UTC.
 // 2. Lokal svensk tid fås genom att sätta rätt TZ-regel.
 // 3. Tid kan synkas från:
+//    - GNSS   (RMC/NAV-PVT, föredras när fix finns)
 //    - MODEM  (AT+CCLK?)
 //    - NTP    (via internet)
 // ============================================================
@@ -27,6 +31,42 @@ static constexpr const char *kTzPosix = "CET-1CEST,M3.5.0/2,M10.5.0/3";
 // Håller reda på senaste kända tidskälla.
 static TimeSource g_source = TimeSource::NONE;
 
+// GNSS-tid
+static bool g_gnssSynced = false;
+static uint32_t g_gnssSyncAtMs = 0;     // senaste gång klockan sattes från GNSS
+static uint32_t g_gnssVerifiedAtMs = 0; // senaste gång klockan jämförts mot GNSS
+static uint32_t g_gnssLastCheckMs = 0;
+static uint32_t g_gnssSyncCount = 0;
+static int32_t g_gnssLastDiffMs = 0; // system - GNSS vid senaste kontroll
+static float g_driftPpm = 0.0f;
+
+// Referens för att förutsäga GNSS-tid vid senare NTP-synk.
+static int64_t g_gnssRefEpochMs = 0;
+static uint32_t g_gnssRefAtMs = 0;
+
+static uint32_t estimatedErrorMs(uint32_t nowMs);
+
+// NTP jämfört med GNSS-tid vid senaste NTP-synk.
+static bool g_haveNtpVsGnss = false;
+static int32_t g_ntpVsGnssMs = 0;
+
+// Senaste lyckade synk oavsett källa (för synk-policyn).
+static bool g_haveSync = false;
+static uint32_t g_lastSyncAtMs = 0;
+static bool g_driftMeasured = false;
+
+// Asynkron NTP
+static volatile bool g_ntpPending = false;
+static volatile bool g_ntpStopPending = false;
+static uint32_t g_ntpStartedMs = 0;
+static volatile uint32_t g_ntpSyncCount = 0;
+static uint32_t g_ntpLatencyMs = 0;
+
+// Referens för driftmätning mellan två NTP-synkar.
+static bool g_haveNtpRef = false;
+static int64_t g_ntpRefEpochMs = 0;
+static uint32_t g_ntpRefAtMs = 0;
+
 // ------------------------------------------------------------
 // Sätter systemtid i UTC.
 // Returnerar false om epoch är orimligt låg.
@@ -45,36 +85,85 @@ static bool setSystemTimeUtc(time_t epochUtc)
   return settimeofday(&tv, nullptr) == 0;
 }
 
+// Nuvarande systemtid i ms sedan epoch.
+static int64_t systemEpochMs()
+{
+  timeval tv{};
+  gettimeofday(&tv, nullptr);
+  return (int64_t)tv.tv_sec * 1000LL + tv.tv_usec / 1000;
+}
+
+static bool setSystemTimeUtcMs(int64_t epochMs)
+{
+  if (epochMs / 1000 < kMinValidEpoch)
+  {
+    return false;
+  }
+
+  timeval tv{};
+  tv.tv_sec = (time_t)(epochMs / 1000);
+  tv.tv_usec = (suseconds_t)((epochMs % 1000) * 1000);
+
+  return settimeofday(&tv, nullptr) == 0;
+}
+
 // ------------------------------------------------------------
-// Kompatibilitetsfunktion för att tolka en tm-struktur som UTC.
-// Vanlig mktime() tolkar tm som lokal tid, vilket vi inte vill här.
-// Därför sätter vi temporärt TZ=UTC0, kör mktime(), och återställer.
+// Callback från SNTP när NTP-tid satts (körs i lwIP-tasken).
+// Jämför mot vad GNSS-tiden borde vara just nu.
 // ------------------------------------------------------------
-static time_t timegm_compat(tm *t)
+static void onSntpSync(timeval *tv)
 {
-  char *oldTz = getenv("TZ");
-  String old = oldTz ? String(oldTz) : String();
+  uint32_t nowMs = millis();
+  int64_t ntpMs = (int64_t)tv->tv_sec * 1000LL + tv->tv_usec / 1000;
 
-  setenv("TZ", "UTC0", 1);
-  tzset();
+  if (g_gnssSynced && (uint32_t)(nowMs - g_gnssRefAtMs) < TIME_GNSS_FRESH_MS)
+  {
+    int64_t gnssMs = g_gnssRefEpochMs + (int64_t)(uint32_t)(nowMs - g_gnssRefAtMs);
+
+    g_ntpVsGnssMs = (int32_t)(ntpMs - gnssMs);
+    g_haveNtpVsGnss = true;
 
-  // Säkerställ att vi inte råkar få DST-logik här.
-  t->tm_isdst = 0;
+    logSystemf("TIME: NTP sync, ntp-gnss=%ld ms", (long)g_ntpVsGnssMs);
+  }
+  else if (g_haveNtpRef)
+  {
+    // Drift mellan två NTP-synkar (GNSS mäter den annars).
+    uint32_t elapsed = nowMs - g_ntpRefAtMs;
+    if (elapsed >= 10UL * 60UL * 1000UL)
+    {
+      int64_t predictedMs = g_ntpRefEpochMs + elapsed;
+      g_driftPpm = (float)(ntpMs - predictedMs) * 1000000.0f / (float)elapsed;
+      g_driftMeasured = true;
+    }
+  }
 
-  time_t epoch = mktime(t);
+  g_haveNtpRef = true;
+  g_ntpRefEpochMs = ntpMs;
+  g_ntpRefAtMs = nowMs;
 
-  // Återställ tidigare tidszon
-  if (oldTz)
+  if (g_ntpPending)
   {
-    setenv("TZ", old.c_str(), 1);
+    g_ntpLatencyMs = nowMs - g_ntpStartedMs;
+    g_ntpPending = false;
   }
-  else
+  g_ntpSyncCount++;
+
+  // SNTP ska inte fortsätta synka i bakgrunden. lwIP schemalägger nästa
+  // fråga efter att callbacken returnerat, så stoppet görs i timeTickNtp().
+  g_ntpStopPending = true;
+
+  g_haveSync = true;
+  g_lastSyncAtMs = nowMs;
+
+  if (!timeGnssIsFresh(nowMs))
   {
-    unsetenv("TZ");
+    g_source = TimeSource::NTP;
   }
-  tzset();
 
-  return epoch;
+  logSystemf("TIME: synced from NTP, epoch=%lu, latency=%lu ms, drift=%.2f ppm",
+             (unsigned long)tv->tv_sec,
+             (unsigned long)g_ntpLatencyMs,
+             g_driftPpm);
 }
 
 // ------------------------------------------------------------
@@ -116,24 +205,8 @@ static bool parseCclkToEpochUtc(const String &cclk, time_t &outEpochUtc)
     return false;
   }
 
-  int year = 2000 + yy;
-
-  // Bygg upp tidstrukturen
-  tm t{};
-  t.tm_year = year - 1900;
-  t.tm_mon = MM - 1;
-  t.tm_mday = dd;
-  t.tm_hour = hh;
-  t.tm_min = mm;
-  t.tm_sec = ss;
-  t.tm_isdst = 0;
-
   // Tolka inläst tid som om den vore UTC
-  time_t epochAssumingUtc = timegm_compat(&t);
-  if (epochAssumingUtc <= 0)
-  {
-    return false;
-  }
+  time_t epochAssumingUtc = (time_t)civilToEpochUtc(2000 + yy, MM, dd, hh, mm, ss);
 
   // zz = kvartstimmar => minuter
   int offsetMinutes = tzq * 15;
@@ -163,6 +236,7 @@ void timeInit()
 
   // Direkt uppdatering i stället för "smooth"
   sntp_set_sync_mode(SNTP_SYNC_MODE_IMMED);
+  sntp_set_time_sync_notification_cb(onSntpSync);
 
   g_source = TimeSource::NONE;
 }
@@ -185,17 +259,16 @@ TimeSource timeGetSource()
 }
 
 // ------------------------------------------------------------
-// Synka tid från modemet via AT+CCLK?.
-// Kräver att modemGetCclk() fungerar.
+// Sätter systemtiden från en CCLK-sträng.
 // ------------------------------------------------------------
-bool timeSyncFromModem(uint32_t timeoutMs)
+static bool applyModemCclk(const String &cclk)
 {
-  String cclk;
-
-  if (!modemGetCclk(cclk, timeoutMs))
+  // Modemklockan har bara sekundupplösning och kan komma från nätet
+  // med okänd kvalitet. Färsk GNSS-tid skrivs inte över.
+  if (timeGnssIsFresh(millis()))
   {
-    logSystem("TIME: modem CCLK read failed");
-    return false;
+    logSystem("TIME: GNSS time fresh, modem CCLK ignored");
+    return true;
   }
 
   time_t epochUtc = 0;
@@ -212,39 +285,230 @@ bool timeSyncFromModem(uint32_t timeoutMs)
   }
 
   g_source = TimeSource::MODEM;
+  g_haveSync = true;
+  g_lastSyncAtMs = millis();
 
   logSystem("TIME: synced from MODEM, epoch=" + String((uint32_t)epochUtc) + ", CCLK=" + cclk);
   return true;
 }
 
 // ------------------------------------------------------------
-// Synka tid från NTP via internet.
-// Väntar tills systemtiden blivit giltig eller timeout nås.
+// Callback från modemets asynkrona CCLK-fråga.
 // ------------------------------------------------------------
-bool timeSyncFromNtp(uint32_t timeoutMs)
+static void onModemClock(bool ok, const char *cclk)
 {
-  // Starta NTP med svensk tidszon
+  if (!ok)
+  {
+    logSystem("TIME: modem CCLK read failed");
+    return;
+  }
+
+  applyModemCclk(String(cclk));
+}
+
+// ------------------------------------------------------------
+// Starta asynkron tidssynk från modemet.
+// ------------------------------------------------------------
+bool timeRequestSyncFromModem(uint32_t timeoutMs)
+{
+  if (!modemRequestClock(onModemClock, timeoutMs))
+  {
+    logSystem("TIME: modem busy, CCLK request not started");
+    return false;
+  }
+
+  return true;
+}
+
+// ------------------------------------------------------------
+// Följ GNSS-tiden.
+// Tiden i fixen gäller början av UTC-sekunden vid utcAtMs, så
+// aktuell GNSS-tid = utcEpoch + (nu - utcAtMs).
+// ------------------------------------------------------------
+void timeTickGnss(uint32_t nowMs)
+{
+  if (g_gnssSynced && (uint32_t)(nowMs - g_gnssLastCheckMs) < TIME_GNSS_CHECK_INTERVAL_MS)
+  {
+    return;
+  }
+
+  ExtGnssFix fx;
+  if (!extGnssGetLatest(fx) || !fx.valid || fx.utcEpoch < (uint32_t)kMinValidEpoch)
+  {
+    return;
+  }
+
+  uint32_t ageMs = nowMs - fx.utcAtMs;
+  if (ageMs > TIME_GNSS_MAX_FIX_AGE_MS)
+  {
+    return;
+  }
+
+  g_gnssLastCheckMs = nowMs;
+
+  int64_t gnssMs = (int64_t)fx.utcEpoch * 1000LL + ageMs;
+  int32_t diffMs = (int32_t)(systemEpochMs() - gnssMs);
+
+  g_gnssRefEpochMs = gnssMs;
+  g_gnssRefAtMs = nowMs;
+  g_gnssVerifiedAtMs = nowMs;
+  g_gnssLastDiffMs = diffMs;
+  g_haveSync = true;
+  g_lastSyncAtMs = nowMs;
+
+  bool needSet = !g_gnssSynced ||
+                 g_source != TimeSource::GNSS ||
+                 !timeIsValid() ||
+                 (uint32_t)abs(diffMs) > TIME_GNSS_MAX_DRIFT_MS;
+
+  // Drift sedan klockan senast sattes från GNSS.
+  uint32_t sinceSetMs = nowMs - g_gnssSyncAtMs;
+  if (g_gnssSynced && g_source == TimeSource::GNSS && sinceSetMs >= 60000UL)
+  {
+    g_driftPpm = (float)diffMs * 1000000.0f / (float)sinceSetMs;
+    g_driftMeasured = true;
+  }
+
+  if (!needSet)
+  {
+    return;
+  }
+
+  if (!setSystemTimeUtcMs(gnssMs))
+  {
+    logSystem("TIME: settimeofday failed (GNSS)");
+    return;
+  }
+
+  g_source = TimeSource::GNSS;
+  g_gnssSynced = true;
+  g_gnssSyncAtMs = nowMs;
+  g_gnssSyncCount++;
+
+  logSystemf("TIME: synced from GNSS, epoch=%lu, corr=%ld ms, drift=%.2f ppm",
+             (unsigned long)fx.utcEpoch,
+             (long)diffMs,
+             g_driftPpm);
+}
+
+bool timeGnssIsFresh(uint32_t nowMs)
+{
+  return g_gnssSynced &&
+         g_source == TimeSource::GNSS &&
+         (uint32_t)(nowMs - g_gnssVerifiedAtMs) < TIME_GNSS_FRESH_MS;
+}
+
+String timeStatusJson(uint32_t nowMs)
+{
+  String json = "{";
+  json += "\"gnss_syncs\":" + String(g_gnssSyncCount) + ",";
+  json += "\"gnss_fresh\":" + String(timeGnssIsFresh(nowMs) ? "true" : "false") + ",";
+
+  if (g_gnssSynced)
+  {
+    json += "\"gnss_age_s\":" + String((uint32_t)(nowMs - g_gnssVerifiedAtMs) / 1000UL) + ",";
+    json += "\"gnss_diff_ms\":" + String((long)g_gnssLastDiffMs) + ",";
+    json += "\"drift_ppm\":" + String(g_driftPpm, 1) + ",";
+  }
+
+  if (g_haveNtpVsGnss)
+  {
+    json += "\"ntp_vs_gnss_ms\":" + String((long)g_ntpVsGnssMs) + ",";
+  }
+
+  if (g_haveSync)
+  {
+    json += "\"sync_age_s\":" + String((uint32_t)(nowMs - g_lastSyncAtMs) / 1000UL) + ",";
+    json += "\"est_err_ms\":" + String(estimatedErrorMs(nowMs)) + ",";
+  }
+
+  json += "\"ntp_syncs\":" + String((uint32_t)g_ntpSyncCount) + ",";
+  if (g_ntpSyncCount > 0)
+  {
+    json += "\"ntp_latency_ms\":" + String(g_ntpLatencyMs) + ",";
+  }
+
+  json += "\"valid\":" + String(timeIsValid() ? "true" : "false");
+  json += "}";
+  return json;
+}
+
+// ------------------------------------------------------------
+// Starta NTP i bakgrunden. SNTP-klienten i lwIP skickar frågan och
+// anropar onSntpSync() när svaret kommit; pipelinen går vidare direkt.
+// ------------------------------------------------------------
+void timeStartNtp()
+{
+  uint32_t nowMs = millis();
+
+  if (g_ntpPending && (uint32_t)(nowMs - g_ntpStartedMs) < TIME_NTP_PENDING_MAX_MS)
+  {
+    return;
+  }
+
   configTzTime(kTzPosix, "pool.ntp.org", "time.google.com", "time.cloudflare.com");
 
-  uint32_t start = millis();
+  g_ntpPending = true;
+  g_ntpStopPending = false;
+  g_ntpStartedMs = nowMs;
 
-  while (millis() - start < timeoutMs)
+  logSystem("TIME: NTP started (async)");
+}
+
+void timeTickNtp(uint32_t nowMs)
+{
+  if (g_ntpStopPending)
   {
-    if (timeIsValid())
-    {
-      time_t now = time(nullptr);
+    g_ntpStopPending = false;
+    sntp_stop();
+    LOG_DEBUG(LogModule::TIME, "TIME: NTP stopped after sync");
+    return;
+  }
 
-      g_source = TimeSource::NTP;
+  if (g_ntpPending && (uint32_t)(nowMs - g_ntpStartedMs) >= TIME_NTP_PENDING_MAX_MS)
+  {
+    g_ntpPending = false;
+    sntp_stop();
+    logSystemf("TIME: NTP sync timeout (%lu ms), SNTP stopped",
+               (unsigned long)TIME_NTP_PENDING_MAX_MS);
+  }
+}
 
-      logSystem("TIME: synced from NTP, epoch=" + String((uint32_t)now));
-      return true;
-    }
+// ------------------------------------------------------------
+// Synk-policy
+// ------------------------------------------------------------
+static uint32_t estimatedErrorMs(uint32_t nowMs)
+{
+  float ppm = g_driftMeasured ? fabsf(g_driftPpm) : TIME_RTC_DRIFT_PPM_DEFAULT;
 
-    delay(200);
+  // Golv så att en tillfälligt perfekt mätning inte stänger av synken.
+  if (ppm < 5.0f)
+  {
+    ppm = 5.0f;
   }
 
-  logSystem("TIME: NTP sync timeout (" + String(timeoutMs) + " ms)");
-  return false;
+  uint32_t elapsed = nowMs - g_lastSyncAtMs;
+  return (uint32_t)((float)elapsed * ppm / 1000000.0f);
+}
+
+bool timeNeedsSync(uint32_t nowMs)
+{
+  if (!timeIsValid() || !g_haveSync)
+  {
+    return true;
+  }
+
+  if (timeGnssIsFresh(nowMs))
+  {
+    return false;
+  }
+
+  if ((uint32_t)(nowMs - g_lastSyncAtMs) >= TIME_SYNC_MAX_INTERVAL_MS)
+  {
+    return true;
+  }
+
+  return estimatedErrorMs(nowMs) > TIME_SYNC_MAX_ERROR_MS;
 }
 
 // ------------------------------------------------------------
@@ -256,58 +520,158 @@ uint32_t timeEpochUtc()
 }
 
 // ------------------------------------------------------------
-// Returnerar aktuell tid i UTC som ISO8601-sträng.
-// Exempel: 2026-03-06T12:34:56Z
+// Svensk lokaltid (CET/CEST)
 // ------------------------------------------------------------
-String timeIsoUtc()
+// EU-regel: sommartid från sista söndagen i mars 01:00 UTC till
+// sista söndagen i oktober 01:00 UTC. Övergångarna räknas ut en gång
+// per år i stället för att gå via TZ-miljön och localtime_r().
+//
+// Cachen läses både av loggtasken (tidsstämplar) och huvudloopen.
+// År och gränser läses och skrivs därför tillsammans under g_dstMux;
+// själva uträkningen görs utanför låset.
+// ------------------------------------------------------------
+static portMUX_TYPE g_dstMux = portMUX_INITIALIZER_UNLOCKED;
+static int16_t g_dstYear = -1;
+static uint32_t g_dstStartUtc = 0;
+static uint32_t g_dstEndUtc = 0;
+
+static uint32_t lastSundayUtc(int year, int month)
 {
-  time_t now = time(nullptr);
+  // Sista dagen i månaden = dagen före den 1:a i nästa månad.
+  int32_t lastDay = civilDaysFromDate(year, month + 1, 1) - 1;
+  int32_t sunday = lastDay - civilWeekday(lastDay);
+  return (uint32_t)sunday * 86400UL + 3600UL; // 01:00 UTC
+}
 
-  if (now < kMinValidEpoch)
+static int32_t localOffsetSec(uint32_t epochUtc, int year)
+{
+  portENTER_CRITICAL(&g_dstMux);
+  const bool cached = year == g_dstYear;
+  uint32_t startUtc = g_dstStartUtc;
+  uint32_t endUtc = g_dstEndUtc;
+  portEXIT_CRITICAL(&g_dstMux);
+
+  if (!cached)
   {
-    return "1970-01-01T00:00:00Z";
+    startUtc = lastSundayUtc(year, 3);
+    endUtc = lastSundayUtc(year, 10);
+
+    portENTER_CRITICAL(&g_dstMux);
+    g_dstYear = (int16_t)year;
+    g_dstStartUtc = startUtc;
+    g_dstEndUtc = endUtc;
+    portEXIT_CRITICAL(&g_dstMux);
   }
 
-  tm t{};
-  gmtime_r(&now, &t);
+  bool dst = epochUtc >= startUtc && epochUtc < endUtc;
+  return dst ? 7200 : 3600;
+}
+
+// ------------------------------------------------------------
+// Formatering utan snprintf
+// ------------------------------------------------------------
+static inline char *put2(char *p, uint32_t v)
+{
+  p[0] = (char)('0' + v / 10);
+  p[1] = (char)('0' + v % 10);
+  return p + 2;
+}
 
-  char buf[25];
-  snprintf(buf, sizeof(buf),
-           "%04d-%02d-%02dT%02d:%02d:%02dZ",
-           t.tm_year + 1900,
-           t.tm_mon + 1,
-           t.tm_mday,
-           t.tm_hour,
-           t.tm_min,
-           t.tm_sec);
+static inline char *put4(char *p, uint32_t v)
+{
+  p = put2(p, v / 100);
+  return put2(p, v % 100);
+}
 
-  return String(buf);
+static void formatDate(char *out, const CivilDate &d)
+{
+  char *p = put4(out, (uint32_t)d.year);
+  *p++ = '-';
+  p = put2(p, d.month);
+  *p++ = '-';
+  p = put2(p, d.day);
+  *p = 0;
+}
+
+static void formatClock(char *out, uint32_t secOfDay)
+{
+  char *p = put2(out, secOfDay / 3600);
+  *p++ = ':';
+  p = put2(p, (secOfDay / 60) % 60);
+  *p++ = ':';
+  p = put2(p, secOfDay % 60);
+  *p = 0;
+}
+
+void timeFormatStamp(uint32_t epochUtc, TimeStamp &out)
+{
+  out.epoch = epochUtc;
+  out.valid = epochUtc >= (uint32_t)kMinValidEpoch;
+
+  if (!out.valid)
+  {
+    memcpy(out.isoUtc, "1970-01-01T00:00:00Z", sizeof(out.isoUtc));
+    memcpy(out.dateLocal, "1970-01-01", sizeof(out.dateLocal));
+    memcpy(out.clockLocal, "00:00:00", sizeof(out.clockLocal));
+    return;
+  }
+
+  // UTC
+  int32_t days = (int32_t)(epochUtc / 86400UL);
+  uint32_t sec = epochUtc % 86400UL;
+  CivilDate d = civilDateFromDays(days);
+
+  formatDate(out.isoUtc, d);
+  out.isoUtc[10] = 'T';
+  formatClock(out.isoUtc + 11, sec);
+  out.isoUtc[19] = 'Z';
+  out.isoUtc[20] = 0;
+
+  // Lokal tid. Året för UTC räcker för övergångarna eftersom de
+  // aldrig ligger nära ett årsskifte.
+  uint32_t local = epochUtc + (uint32_t)localOffsetSec(epochUtc, d.year);
+  int32_t localDays = (int32_t)(local / 86400UL);
+  CivilDate ld = localDays == days ? d : civilDateFromDays(localDays);
+
+  formatDate(out.dateLocal, ld);
+  formatClock(out.clockLocal, local % 86400UL);
 }
 
 // ------------------------------------------------------------
-// Returnerar lokalt datum enligt svensk tidszon.
-// Exempel: 2026-03-06
+// Formaterad tid för aktuell sekund. Räknas bara om när sekunden
+// bytts, så alla meddelanden i samma publiceringscykel delar den.
 // ------------------------------------------------------------
-String timeDateLocal()
+const TimeStamp &timeNowStamp()
 {
-  time_t now = time(nullptr);
+  static TimeStamp cached = {};
+  static bool haveCached = false;
 
-  if (now < kMinValidEpoch)
+  uint32_t now = (uint32_t)time(nullptr);
+  if (!haveCached || now != cached.epoch)
   {
-    return "1970-01-01";
+    timeFormatStamp(now, cached);
+    haveCached = true;
   }
 
-  tm t{};
-  localtime_r(&now, &t);
+  return cached;
+}
 
-  char buf[11];
-  snprintf(buf, sizeof(buf),
-           "%04d-%02d-%02d",
-           t.tm_year + 1900,
-           t.tm_mon + 1,
-           t.tm_mday);
+// ------------------------------------------------------------
+// Returnerar aktuell tid i UTC som ISO8601-sträng.
+// Exempel: 2026-03-06T12:34:56Z
+// ------------------------------------------------------------
+String timeIsoUtc()
+{
+  return String(timeNowStamp().isoUtc);
+}
 
-  return String(buf);
+// ------------------------------------------------------------
+// Returnerar lokalt datum enligt svensk tidszon.
+// Exempel: 2026-03-06
+// ------------------------------------------------------------
+String timeDateLocal()
+{
+  return String(timeNowStamp().dateLocal);
 }
 
 // ------------------------------------------------------------
@@ -316,22 +680,5 @@ String timeDateLocal()
 // ------------------------------------------------------------
 String timeClockLocal()
 {
-  time_t now = time(nullptr);
-
-  if (now < kMinValidEpoch)
-  {
-    return "00:00:00";
-  }
-
-  tm t{};
-  localtime_r(&now, &t);
-
-  char buf[9];
-  snprintf(buf, sizeof(buf),
-           "%02d:%02d:%02d",
-           t.tm_hour,
-           t.tm_min,
-           t.tm_sec);
-
-  return String(buf);
+  return String(timeNowStamp().clockLocal);
 }
\ No newline at end of file
@@ -7,7 +7,8 @@ enum class TimeSource : uint8_t
 {
     NONE = 0,  // Ingen giltig synk ännu
     MODEM = 1, // Tid hämtad från modemet via AT+CCLK?
-    NTP = 2    // Tid hämtad från NTP över nätet
+    NTP = 2,   // Tid hämtad från NTP över nätet
+    GNSS = 3   // Tid från extern GNSS (RMC/NAV-PVT) med giltig fix
 };
 
 // Initierar tidsmodulen:
@@ -22,17 +23,57 @@ bool timeIsValid();
 // Returnerar vilken källa som senast lyckades synka tiden.
 TimeSource timeGetSource();
 
-// Synka tid från modemet via AT+CCLK?
-// timeoutMs anger hur länge vi väntar på svar från modemet.
-bool timeSyncFromModem(uint32_t timeoutMs = 1500);
+// Starta asynkron tidssynk från modemet. Systemtiden sätts från
+// modemets callback när svaret kommit; anroparen väntar inte.
+// Returnerar false om kommandot inte kunde startas.
+bool timeRequestSyncFromModem(uint32_t timeoutMs = 1500);
 
-// Synka tid från NTP via nätverket.
-// timeoutMs anger hur länge vi väntar på att systemtiden ska bli giltig.
-bool timeSyncFromNtp(uint32_t timeoutMs = 8000);
+// Följ GNSS-tiden. Anropas varje tick; kontrollerar högst var
+// TIME_GNSS_CHECK_INTERVAL_MS och sätter systemtiden från senaste
+// giltiga fix om ingen GNSS-synk gjorts eller klockan drivit.
+void timeTickGnss(uint32_t nowMs);
+
+// true när systemtiden nyligen bekräftats mot GNSS. Då behövs varken
+// NTP eller modemklocka vid uppkoppling.
+bool timeGnssIsFresh(uint32_t nowMs);
+
+// Kompakt JSON för health: källa, GNSS-korrektion, drift och NTP-avvikelse.
+String timeStatusJson(uint32_t nowMs);
+
+// Starta NTP-synk i bakgrunden (SNTP) och returnera direkt.
+// Systemtid och källa sätts i SNTP-callbacken när svaret kommit.
+void timeStartNtp();
+
+// Stoppar SNTP-klienten efter lyckad synk eller när frågan passerat
+// TIME_NTP_PENDING_MAX_MS, så att den inte synkar om i bakgrunden
+// förbi timeNeedsSync(). Anropas varje tick.
+void timeTickNtp(uint32_t nowMs);
+
+// true om klockan behöver synkas: ogiltig tid, ingen synk ännu, eller
+// uppskattat fel sedan senaste synk över TIME_SYNC_MAX_ERROR_MS.
+// Färsk GNSS-tid räcker alltid.
+bool timeNeedsSync(uint32_t nowMs);
 
 // Returnerar aktuell systemtid som UTC epoch (sekunder sedan 1970-01-01).
 uint32_t timeEpochUtc();
 
+// Formaterad tid för en given sekund. Fälten är nollterminerade
+// och kan skrivas direkt i JSON utan att bygga nya Strings.
+struct TimeStamp
+{
+    uint32_t epoch;     // UTC epoch
+    bool valid;         // false = klockan inte satt, fälten är platshållare
+    char isoUtc[21];    // "YYYY-MM-DDTHH:MM:SSZ"
+    char dateLocal[11]; // "YYYY-MM-DD" (Europe/Stockholm)
+    char clockLocal[9]; // "HH:MM:SS"   (Europe/Stockholm)
+};
+
+// Formatera epochUtc till out. Ren heltalsaritmetik, ingen TZ-miljö.
+void timeFormatStamp(uint32_t epochUtc, TimeStamp &out);
+
+// Formaterad tid för aktuell sekund (cachad tills sekunden byts).
+const TimeStamp &timeNowStamp();
+
 // Returnerar aktuell tid i UTC-format:
 // "YYYY-MM-DDTHH:MM:SSZ"
 String timeIsoUtc();
@@ -0,0 +1,491 @@
+#include "victron_agg.h"
+#include "logging.h"
+#include "time_manager.h"
+
+#include <math.h>
+
+// ============================================================
+// Victron-aggregat
+// ------------------------------------------------------------
+// Energi integreras med trapetsregeln mellan två paket från samma
+// källa. Segmentet räknas till hinken där det senare paketet
+// hamnar. Luckor längre än VICTRON_AGG_MAX_GAP_MS (t.ex. PIR-avbruten
+// scan eller BLE avstängt) integreras inte utan räknas som lucka.
+//
+// Laddning och urladdning hålls isär (in/ut) så HA kan mata
+// energipanelen direkt; ett segment som korsar noll delas vid
+// nollgenomgången.
+// ============================================================
+
+static constexpr uint8_t kMetrics = (uint8_t)VictronAggMetric::COUNT;
+
+struct AggBucket
+{
+    uint32_t seq;
+    uint32_t startMs;
+    uint32_t endMs;
+    uint16_t n[kMetrics];
+    float minV[kMetrics];
+    float maxV[kMetrics];
+    float sum[kMetrics];
+    float last[kMetrics];
+    float ahIn;
+    float ahOut;
+    float whIn;
+    float whOut;
+    float pvWh;
+};
+
+struct Integrator
+{
+    float value;
+    uint32_t ms;
+    bool have;
+};
+
+static portMUX_TYPE g_aggMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Ringbuffert (PSRAM om det finns)
+static AggBucket *g_buf = nullptr;
+static uint32_t g_cap = 0;
+static uint32_t g_head = 0; // nästa skrivposition
+static uint32_t g_count = 0;
+static bool g_inPsram = false;
+
+// Öppen hink (internt RAM)
+static AggBucket g_open;
+static bool g_openHasData = false;
+static uint32_t g_nextSeq = 1;
+static uint32_t g_batchLastSeq = 0; // sista hinken i senast byggda batch
+
+static Integrator g_intA = {0.0f, 0, false};
+static Integrator g_intW = {0.0f, 0, false};
+static Integrator g_intPv = {0.0f, 0, false};
+
+// Statistik sedan boot
+static uint32_t g_samples = 0;
+static uint32_t g_closed = 0;
+static uint32_t g_dropped = 0;
+static uint32_t g_uploaded = 0;
+static uint32_t g_batches = 0;
+static uint32_t g_bytesUp = 0;
+static uint32_t g_gaps = 0;
+
+// ============================================================
+// Helpers
+// ============================================================
+
+static inline uint32_t ringIndex(uint32_t i)
+{
+    // i = 0 är äldsta hinken
+    return (g_head + g_cap - g_count + i) % g_cap;
+}
+
+static void openBucket(uint32_t nowMs)
+{
+    memset(&g_open, 0, sizeof(g_open));
+    g_open.seq = g_nextSeq++;
+    g_open.startMs = nowMs;
+    g_open.endMs = nowMs;
+    g_openHasData = true;
+}
+
+// Under g_aggMux.
+static void closeBucket()
+{
+    if (!g_openHasData)
+        return;
+
+    g_openHasData = false;
+    g_closed++;
+
+    if (!g_buf)
+        return;
+
+    if (g_count == g_cap)
+    {
+        // Full buffert: äldsta hinken får ge plats.
+        g_count--;
+        g_dropped++;
+    }
+
+    g_buf[g_head] = g_open;
+    g_head = (g_head + 1) % g_cap;
+    g_count++;
+}
+
+// Under g_aggMux. Ser till att det finns en öppen hink för nowMs.
+static void touchBucket(uint32_t nowMs)
+{
+    if (g_openHasData && (uint32_t)(nowMs - g_open.startMs) >= VICTRON_AGG_BUCKET_MAX_MS)
+        closeBucket();
+    if (!g_openHasData)
+        openBucket(nowMs);
+    g_open.endMs = nowMs;
+}
+
+static void addSampleLocked(VictronAggMetric m, float value, uint32_t nowMs)
+{
+    const uint8_t i = (uint8_t)m;
+    if (i >= kMetrics || isnan(value) || isinf(value))
+        return;
+
+    touchBucket(nowMs);
+    g_samples++;
+
+    if (g_open.n[i] == 0)
+    {
+        g_open.minV[i] = value;
+        g_open.maxV[i] = value;
+    }
+    else
+    {
+        if (value < g_open.minV[i])
+            g_open.minV[i] = value;
+        if (value > g_open.maxV[i])
+            g_open.maxV[i] = value;
+    }
+
+    if (g_open.n[i] < UINT16_MAX)
+    {
+        g_open.sum[i] += value;
+        g_open.n[i]++;
+    }
+    g_open.last[i] = value;
+}
+
+// Trapetsintegral av x över segmentet, uppdelad i positiv och negativ
+// del. Returnerar false om segmentet inte ska räknas.
+static bool integrate(Integrator &it, float value, uint32_t nowMs, float &pos, float &neg)
+{
+    pos = 0.0f;
+    neg = 0.0f;
+
+    if (isnan(value) || isinf(value))
+        return false;
+
+    const bool had = it.have;
+    const float prev = it.value;
+    const uint32_t dtMs = nowMs - it.ms;
+
+    it.value = value;
+    it.ms = nowMs;
+    it.have = true;
+
+    if (!had || dtMs == 0)
+        return false;
+
+    if (dtMs > VICTRON_AGG_MAX_GAP_MS)
+    {
+        g_gaps++;
+        return false;
+    }
+
+    const float h = dtMs / 3600000.0f; // timmar
+
+    if ((prev >= 0.0f) == (value >= 0.0f))
+    {
+        const float area = (prev + value) * 0.5f * h;
+        if (area >= 0.0f)
+            pos = area;
+        else
+            neg = -area;
+        return true;
+    }
+
+    // Nollgenomgång: dela segmentet i två trianglar.
+    const float t = prev / (prev - value);
+    const float a1 = prev * 0.5f * h * t;
+    const float a2 = value * 0.5f * h * (1.0f - t);
+    pos = (a1 > 0.0f ? a1 : 0.0f) + (a2 > 0.0f ? a2 : 0.0f);
+    neg = (a1 < 0.0f ? -a1 : 0.0f) + (a2 < 0.0f ? -a2 : 0.0f);
+    return true;
+}
+
+static bool batchDueLocked(uint32_t nowMs)
+{
+    if (g_count > 0)
+        return true;
+    return g_openHasData && (uint32_t)(nowMs - g_open.startMs) >= VICTRON_AGG_BUCKET_MIN_MS;
+}
+
+static void appendFloat(String &out, float v, uint8_t decimals)
+{
+    if (isnan(v) || isinf(v))
+        out += "null";
+    else
+        out += String(v, (unsigned int)decimals);
+}
+
+static uint8_t metricDecimals(uint8_t i)
+{
+    switch ((VictronAggMetric)i)
+    {
+    case VictronAggMetric::BATTERY_V:
+    case VictronAggMetric::BATTERY_A:
+        return 2;
+    case VictronAggMetric::PV_W:
+        return 0;
+    default:
+        return 1;
+    }
+}
+
+// ============================================================
+// Public API
+// ============================================================
+
+void victronAggInit()
+{
+    if (g_buf)
+        return;
+
+    if (psramFound())
+    {
+        g_buf = (AggBucket *)ps_malloc(VICTRON_AGG_BUCKETS_PSRAM * sizeof(AggBucket));
+        if (g_buf)
+        {
+            g_cap = VICTRON_AGG_BUCKETS_PSRAM;
+            g_inPsram = true;
+        }
+    }
+
+    if (!g_buf)
+    {
+        g_buf = (AggBucket *)malloc(VICTRON_AGG_BUCKETS_HEAP * sizeof(AggBucket));
+        if (g_buf)
+            g_cap = VICTRON_AGG_BUCKETS_HEAP;
+    }
+
+    if (!g_buf)
+    {
+        logSystem("VICTRON: agg buffer alloc FAILED -> only open bucket");
+        return;
+    }
+
+    logSystemf("VICTRON: agg buffer %lu buckets (%lu bytes) in %s",
+               (unsigned long)g_cap,
+               (unsigned long)(g_cap * sizeof(AggBucket)),
+               g_inPsram ? "PSRAM" : "heap");
+}
+
+const char *victronAggMetricName(VictronAggMetric m)
+{
+    switch (m)
+    {
+    case VictronAggMetric::SOC:
+        return "soc";
+    case VictronAggMetric::BATTERY_V:
+        return "bv";
+    case VictronAggMetric::BATTERY_A:
+        return "ba";
+    case VictronAggMetric::PV_W:
+        return "pv";
+    case VictronAggMetric::SOLAR_A:
+        return "sa";
+    case VictronAggMetric::ORION_A:
+        return "oa";
+    default:
+        return "?";
+    }
+}
+
+void victronAggSample(VictronAggMetric m, float value, uint32_t nowMs)
+{
+    portENTER_CRITICAL(&g_aggMux);
+    addSampleLocked(m, value, nowMs);
+    portEXIT_CRITICAL(&g_aggMux);
+}
+
+void victronAggBattery(float voltageV, float currentA, uint32_t nowMs)
+{
+    float ahIn, ahOut, whIn, whOut;
+
+    portENTER_CRITICAL(&g_aggMux);
+    addSampleLocked(VictronAggMetric::BATTERY_V, voltageV, nowMs);
+    addSampleLocked(VictronAggMetric::BATTERY_A, currentA, nowMs);
+
+    if (integrate(g_intA, currentA, nowMs, ahIn, ahOut))
+    {
+        g_open.ahIn += ahIn;
+        g_open.ahOut += ahOut;
+    }
+    if (integrate(g_intW, voltageV * currentA, nowMs, whIn, whOut))
+    {
+        g_open.whIn += whIn;
+        g_open.whOut += whOut;
+    }
+    portEXIT_CRITICAL(&g_aggMux);
+}
+
+void victronAggPv(float powerW, uint32_t nowMs)
+{
+    float wh, unused;
+
+    portENTER_CRITICAL(&g_aggMux);
+    addSampleLocked(VictronAggMetric::PV_W, powerW, nowMs);
+    if (integrate(g_intPv, powerW, nowMs, wh, unused))
+        g_open.pvWh += wh;
+    portEXIT_CRITICAL(&g_aggMux);
+}
+
+bool victronAggBatchDue(uint32_t nowMs)
+{
+    portENTER_CRITICAL(&g_aggMux);
+    const bool due = batchDueLocked(nowMs);
+    portEXIT_CRITICAL(&g_aggMux);
+    return due;
+}
+
+String victronAggBuildBatchJson(uint32_t nowMs, uint16_t &outCount)
+{
+    outCount = 0;
+
+    if (!g_buf)
+        return "";
+
+    // Kopiera ut hinkarna under lås, formatera utan. Statisk: anropas
+    // bara från huvudloopen och är för stor för stacken.
+    static AggBucket batch[VICTRON_AGG_BATCH_MAX_BUCKETS];
+    uint16_t n = 0;
+
+    portENTER_CRITICAL(&g_aggMux);
+    if (g_openHasData && (uint32_t)(nowMs - g_open.startMs) >= VICTRON_AGG_BUCKET_MIN_MS)
+        closeBucket();
+    while (n < VICTRON_AGG_BATCH_MAX_BUCKETS && n < g_count)
+    {
+        batch[n] = g_buf[ringIndex(n)];
+        n++;
+    }
+    portEXIT_CRITICAL(&g_aggMux);
+
+    if (n == 0)
+        return "";
+
+    g_batchLastSeq = batch[n - 1].seq;
+
+    // Absolut starttid om klockan är giltig, annars 0.
+    const uint32_t firstMs = batch[0].startMs;
+    uint32_t t0 = 0;
+    if (timeIsValid())
+        t0 = timeEpochUtc() - (nowMs - firstMs) / 1000UL;
+
+    String json;
+    json.reserve(96 + n * 240);
+
+    json += "\"fmt\":\"agg_v1\",";
+    json += "\"fields\":[";
+    for (uint8_t i = 0; i < kMetrics; i++)
+    {
+        if (i > 0)
+            json += ",";
+        json += "\"" + String(victronAggMetricName((VictronAggMetric)i)) + "\"";
+    }
+    json += "],";
+    json += "\"t0\":" + String(t0) + ",";
+    json += "\"n\":" + String(n) + ",";
+    json += "\"seq\":" + String(batch[0].seq) + ",";
+
+    // Per hink: [start_s, dur_s, ah_in, ah_out, wh_in, wh_out, pv_wh,
+    //            [min,max,medel,senaste] eller null per fält]
+    json += "\"b\":[";
+    for (uint16_t b = 0; b < n; b++)
+    {
+        const AggBucket &k = batch[b];
+
+        if (b > 0)
+            json += ",";
+
+        json += "[" + String((k.startMs - firstMs + 500UL) / 1000UL) + ",";
+        json += String((k.endMs - k.startMs + 500UL) / 1000UL) + ",";
+        appendFloat(json, k.ahIn, 2);
+        json += ",";
+        appendFloat(json, k.ahOut, 2);
+        json += ",";
+        appendFloat(json, k.whIn, 1);
+        json += ",";
+        appendFloat(json, k.whOut, 1);
+        json += ",";
+        appendFloat(json, k.pvWh, 1);
+
+        for (uint8_t i = 0; i < kMetrics; i++)
+        {
+            json += ",";
+            if (k.n[i] == 0)
+            {
+                json += "null";
+                continue;
+            }
+
+            const uint8_t d = metricDecimals(i);
+            json += "[";
+            appendFloat(json, k.minV[i], d);
+            json += ",";
+            appendFloat(json, k.maxV[i], d);
+            json += ",";
+            appendFloat(json, k.sum[i] / k.n[i], d);
+            json += ",";
+            appendFloat(json, k.last[i], d);
+            json += "]";
+        }
+        json += "]";
+    }
+    json += "]";
+
+    outCount = n;
+    return json;
+}
+
+void victronAggCommitBatch(uint16_t count, uint32_t payloadBytes)
+{
+    if (!g_buf || count == 0)
+        return;
+
+    // Ta bort på sekvensnummer i stället för antal: har äldsta hinken
+    // tappats (full buffert) sedan batchen byggdes får inga osända
+    // hinkar försvinna.
+    uint32_t removed = 0;
+
+    portENTER_CRITICAL(&g_aggMux);
+    while (g_count > 0 && g_buf[ringIndex(0)].seq <= g_batchLastSeq)
+    {
+        g_count--;
+        removed++;
+    }
+    const uint32_t pending = g_count;
+    portEXIT_CRITICAL(&g_aggMux);
+
+    g_uploaded += removed;
+    g_batches++;
+    g_bytesUp += payloadBytes;
+
+    logSystemf("VICTRON: agg batch #%lu committed, %u/%lu buckets, %lu bytes, %lu pending",
+               (unsigned long)g_batches,
+               (unsigned)count,
+               (unsigned long)removed,
+               (unsigned long)payloadBytes,
+               (unsigned long)pending);
+}
+
+String victronAggStatsJson()
+{
+    portENTER_CRITICAL(&g_aggMux);
+    const uint32_t pending = g_count;
+    const bool open = g_openHasData;
+    portEXIT_CRITICAL(&g_aggMux);
+
+    String json = "{";
+    json += "\"cap\":" + String(g_cap) + ",";
+    json += "\"psram\":" + String(g_inPsram ? "true" : "false") + ",";
+    json += "\"pending\":" + String(pending) + ",";
+    json += "\"open\":" + String(open ? "true" : "false") + ",";
+    json += "\"samples\":" + String(g_samples) + ",";
+    json += "\"closed\":" + String(g_closed) + ",";
+    json += "\"dropped\":" + String(g_dropped) + ",";
+    json += "\"uploaded\":" + String(g_uploaded) + ",";
+    json += "\"batches\":" + String(g_batches) + ",";
+    json += "\"gaps\":" + String(g_gaps) + ",";
+    json += "\"bytes_up\":" + String(g_bytesUp);
+    json += "}";
+    return json;
+}
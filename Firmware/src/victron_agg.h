@@ -0,0 +1,64 @@
+#pragma once
+
+#include <Arduino.h>
+#include "config.h"
+
+// ============================================================
+// Victron-aggregat
+// ------------------------------------------------------------
+// Varje Victron-paket matas in här i stället för att bara senaste
+// värdet sparas:
+// - min/max/medel/senaste per mätvärde i en öppen hink
+// - Ah och Wh in/ut för batteriet och Wh från solpanelen
+//   integreras (trapets) mellan paketen
+// - hinken stängs vid publicering (minst VICTRON_AGG_BUCKET_MIN_MS)
+//   eller efter VICTRON_AGG_BUCKET_MAX_MS och läggs i en ringbuffert
+//   i PSRAM
+//
+// Hinkar tas bort ur bufferten först när batchen publicerats,
+// så inget försvinner vid täckningsluckor (men vid reboot).
+// ============================================================
+
+enum class VictronAggMetric : uint8_t
+{
+    SOC,       // %
+    BATTERY_V, // V (shunt)
+    BATTERY_A, // A (shunt, + = laddning)
+    PV_W,      // W (laddare)
+    SOLAR_A,   // A (laddarens utgång)
+    ORION_A,   // A (DC-DC utgång)
+    COUNT
+};
+
+// Allokerar ringbufferten. Anropas från victronManagerInit().
+void victronAggInit();
+
+// Kort namn som används i batchens "fields".
+const char *victronAggMetricName(VictronAggMetric m);
+
+// Inmatningen anropas från BLE-callbacken (BT-tasken) och skyddas
+// därför med spinlock mot batchbygget i huvudloopen.
+//
+// Ett mätvärde. NaN ignoreras.
+void victronAggSample(VictronAggMetric m, float value, uint32_t nowMs);
+
+// Shuntens spänning och ström: samplas och integreras till Ah/Wh in/ut.
+void victronAggBattery(float voltageV, float currentA, uint32_t nowMs);
+
+// Solpanelens effekt: samplas och integreras till Wh.
+void victronAggPv(float powerW, uint32_t nowMs);
+
+// true när det finns stängda hinkar, eller när den öppna hinken har
+// data och är minst VICTRON_AGG_BUCKET_MIN_MS gammal.
+bool victronAggBatchDue(uint32_t nowMs);
+
+// Bygger batch-fälten (utan kuvert) för de äldsta hinkarna. Stänger
+// först den öppna hinken om batchen är mogen.
+// outCount sätts till antal hinkar i batchen (0 = inget att skicka).
+String victronAggBuildBatchJson(uint32_t nowMs, uint16_t &outCount);
+
+// Kvittera att count hinkar publicerats med payloadBytes byte.
+void victronAggCommitBatch(uint16_t count, uint32_t payloadBytes);
+
+// JSON för Victron-state: buffert och uppladdning.
+String victronAggStatsJson();
@@ -2,10 +2,44 @@
 
 #include "config.h"
 #include "logging.h"
+#include "power_sched.h"
 #include "VictronBLE.h"
 #include "time_manager.h"
+#include "victron_agg.h"
 
 #include <math.h>
+#include <Preferences.h>
+#include "esp_coexist.h"
+
+const char *victronRegistryStatusName(VictronRegistryStatus s)
+{
+  switch (s)
+  {
+  case VictronRegistryStatus::OK:
+    return "OK";
+  case VictronRegistryStatus::DUPLICATE_IGNORED:
+    return "DUPLICATE_IGNORED";
+  case VictronRegistryStatus::MISSING_CHANGE_ID:
+    return "MISSING_CHANGE_ID";
+  case VictronRegistryStatus::BAD_OP:
+    return "BAD_OP";
+  case VictronRegistryStatus::BAD_MAC:
+    return "BAD_MAC";
+  case VictronRegistryStatus::BAD_KEY:
+    return "BAD_KEY";
+  case VictronRegistryStatus::EXISTS:
+    return "EXISTS";
+  case VictronRegistryStatus::NOT_FOUND:
+    return "NOT_FOUND";
+  case VictronRegistryStatus::FULL:
+    return "FULL";
+  case VictronRegistryStatus::NVS_FAILED:
+    return "NVS_FAILED";
+  case VictronRegistryStatus::DISABLED:
+    return "DISABLED";
+  }
+  return "UNKNOWN";
+}
 
 #if VICTRON_BLE_ENABLED
 
@@ -21,6 +55,49 @@ static uint32_t g_scanSmartshuntUpdates = 0;
 static uint32_t g_scanSmartsolarUpdates = 0;
 static uint32_t g_scanOrionUpdates = 0;
 
+// Asynkron scan
+static bool g_scanActive = false;
+static bool g_scanOk = false;
+static uint32_t g_scanBudgetMs = 0;
+
+// Tidsvinst med tidigt avslut: budget (scanSeconds) minus faktisk tid.
+static uint32_t g_lastScanMs = 0;
+static uint32_t g_lastScanSavedMs = 0;
+static uint32_t g_scanEarlyCountBoot = 0;
+static uint32_t g_scanCompleteCountBoot = 0;
+
+// BLE-livscykel (VICTRON_BLE_PERSISTENT): init-tid, scanstart-latens och
+// heap, för att jämföra vilande stack mot init/deinit per scan.
+static uint32_t g_bleInitCountBoot = 0;
+static uint32_t g_bleInitMsLast = 0;
+static uint32_t g_bleInitMsMax = 0;
+// Heap som BLE-stacken tog vid senaste init (fri heap före - efter).
+// Jämförelsetal mellan NimBLE och Bluedroid (VICTRON_BLE_BACKEND_NIMBLE).
+static uint32_t g_bleHeapBytes = 0;
+static uint32_t g_scanStartMsLast = 0;
+static uint32_t g_scanStartMsMax = 0;
+static uint32_t g_heapAfterScanMin = UINT32_MAX;
+static uint64_t g_scanSavedMsBoot = 0;
+static uint64_t g_scanMsBoot = 0;
+
+// Bakgrundsscan (profilens victronBleBackground). BLE går kontinuerligt
+// med låg duty-cycle; callbacken körs i BLE-hosttasken på core 0 medan
+// pipeline/MQTT går på core 1.
+static bool g_bgActive = false;
+static uint32_t g_bgStartedMs = 0;
+static uint32_t g_bgRetryAtMs = 0;
+static uint32_t g_bgPublishIntervalMs = 0;
+static uint32_t g_bgChunkCountBoot = 0;
+static uint64_t g_bgMsBoot = 0;
+static uint32_t g_lastPublishMs = 0;
+
+// Publiceringscykelns längd i keepConnected-profiler med resp. utan
+// bakgrundsscan. Mått på hur mycket BLE påverkar MQTT-latensen.
+static uint64_t g_pubCycleMsBg = 0;
+static uint32_t g_pubCycleCountBg = 0;
+static uint64_t g_pubCycleMsNoBg = 0;
+static uint32_t g_pubCycleCountNoBg = 0;
+
 struct VictronLatestData
 {
   bool smartshunt_valid = false;
@@ -45,7 +122,7 @@ struct VictronLatestData
   float solar_battery_current_a = NAN;
   float solar_pv_power_w = NAN;
   float solar_yield_today_kwh = NAN;
-  uint16_t solar_yield_today_wh = 0;
+  uint32_t solar_yield_today_wh = 0;
   uint8_t solar_state_code = 255;
   uint8_t solar_error_code = 255;
 
@@ -56,8 +133,139 @@ struct VictronLatestData
   uint8_t orion_error_code = 255;
 };
 
+// Skrivs i BLE-hosttasken, läses i huvudloopen. Läsare kopierar
+// hela strukturen under g_victronMux (se victronSnapshot()).
+static portMUX_TYPE g_victronMux = portMUX_INITIALIZER_UNLOCKED;
 static VictronLatestData g_victron;
 
+static void victronSnapshot(VictronLatestData &out)
+{
+  portENTER_CRITICAL(&g_victronMux);
+  out = g_victron;
+  portEXIT_CRITICAL(&g_victronMux);
+}
+
+// Senaste avkodade record per enhet, oavsett recordtyp. Publiceras
+// som "devices" i state-JSON. Skyddas av g_victronMux.
+struct VictronDeviceRecord
+{
+  char name[VICTRON_NAME_LEN];
+  char mac[VICTRON_MAC_LEN];
+  int8_t rssi;
+  uint32_t lastSeenMs;
+  uint32_t count;
+  VictronRecord record;
+};
+
+static VictronDeviceRecord g_deviceRecords[VICTRON_MAX_DEVICES];
+static uint8_t g_deviceRecordCount = 0;
+
+// Anropas under g_victronMux. Returnerar antal record från enheten
+// hittills (1 = första), 0 om tabellen är full.
+static uint32_t noteDeviceRecordLocked(const VictronDevice *device, uint32_t nowMs)
+{
+  VictronDeviceRecord *slot = nullptr;
+  for (uint8_t i = 0; i < g_deviceRecordCount; i++)
+  {
+    if (strcmp(g_deviceRecords[i].mac, device->mac) == 0)
+    {
+      slot = &g_deviceRecords[i];
+      break;
+    }
+  }
+
+  if (!slot)
+  {
+    if (g_deviceRecordCount >= VICTRON_MAX_DEVICES)
+      return 0;
+    slot = &g_deviceRecords[g_deviceRecordCount++];
+    memset(slot, 0, sizeof(*slot));
+    strncpy(slot->mac, device->mac, VICTRON_MAC_LEN - 1);
+    strncpy(slot->name, device->name, VICTRON_NAME_LEN - 1);
+  }
+
+  slot->rssi = device->rssi;
+  slot->lastSeenMs = nowMs;
+  slot->count++;
+  slot->record = device->record;
+  return slot->count;
+}
+
+static void clearDeviceRecords()
+{
+  portENTER_CRITICAL(&g_victronMux);
+  g_deviceRecordCount = 0;
+  portEXIT_CRITICAL(&g_victronMux);
+}
+
+// Skalat värde med decimaler efter tabellens upplösning; heltal
+// för enum/bitfält (skala 1, offset 0).
+static void appendRecordField(String &out, const VictronFieldSpec &f, int32_t raw)
+{
+  out += "\"";
+  out += victronFieldName(f.field);
+  out += "\":";
+
+  if (f.scale == 1.0f && f.offset == 0.0f)
+  {
+    out += String((long)raw);
+    return;
+  }
+
+  uint8_t decimals = 0;
+  if (f.scale < 0.01f)
+    decimals = 3;
+  else if (f.scale < 0.1f)
+    decimals = 2;
+  else if (f.scale < 1.0f)
+    decimals = 1;
+  out += String((float)raw * f.scale + f.offset, (unsigned int)decimals);
+}
+
+static String deviceRecordsJson(uint32_t nowMs)
+{
+  VictronDeviceRecord recs[VICTRON_MAX_DEVICES];
+  uint8_t count;
+
+  portENTER_CRITICAL(&g_victronMux);
+  count = g_deviceRecordCount;
+  for (uint8_t i = 0; i < count; i++)
+    recs[i] = g_deviceRecords[i];
+  portEXIT_CRITICAL(&g_victronMux);
+
+  String out = "[";
+  for (uint8_t i = 0; i < count; i++)
+  {
+    const VictronDeviceRecord &d = recs[i];
+    if (i > 0)
+      out += ",";
+    out += "{\"name\":\"" + String(d.name) + "\"";
+    out += ",\"mac\":\"" + String(d.mac) + "\"";
+    out += ",\"record\":\"" + String(d.record.spec ? d.record.spec->name : "unknown") + "\"";
+    out += ",\"rssi\":" + String(d.rssi);
+    out += ",\"count\":" + String(d.count);
+    out += ",\"age_s\":" + String((nowMs - d.lastSeenMs) / 1000);
+    out += ",\"fields\":{";
+
+    bool first = true;
+    if (d.record.spec)
+    {
+      for (uint8_t f = 0; f < d.record.spec->fieldCount; f++)
+      {
+        if (!(d.record.presentMask & (1u << f)))
+          continue;
+        if (!first)
+          out += ",";
+        first = false;
+        appendRecordField(out, d.record.spec->fields[f], d.record.raw[f]);
+      }
+    }
+    out += "}}";
+  }
+  out += "]";
+  return out;
+}
+
 static String chargerStateToText(uint8_t state)
 {
   switch (state)
@@ -89,6 +297,13 @@ static String chargerStateToText(uint8_t state)
   }
 }
 
+// Varje dekodad uppdatering loggas på INFO vid schemalagd scan. Vid
+// bakgrundsscan kommer de löpande, då bara på DEBUG.
+static LogLevel updateLogLevel()
+{
+  return g_bgActive ? LogLevel::DEBUG : LogLevel::INFO;
+}
+
 static bool isFresh(bool valid, uint32_t lastSeenMs, uint32_t nowMs)
 {
   return valid && lastSeenMs != 0 && (uint32_t)(nowMs - lastSeenMs) < VICTRON_FRESH_TIMEOUT_MS;
@@ -112,22 +327,29 @@ static void appendFloatOrNull(String &payload, const char *key, float value, uin
   }
 }
 
+// Körs i BLE-hosttasken (core 0). g_victron och räknarna skrivs under
+// g_victronMux; loggning och agg (eget lås) görs utanför.
 static void onVictronData(const VictronDevice *device)
 {
   if (!device)
     return;
 
   const uint32_t nowMs = millis();
-  g_deviceUpdateCountBoot++;
-  g_publishPending = true;
+
+  portENTER_CRITICAL(&g_victronMux);
+  const uint32_t recordCount = noteDeviceRecordLocked(device, nowMs);
+  portEXIT_CRITICAL(&g_victronMux);
 
   switch (device->deviceType)
   {
   case DEVICE_TYPE_SOLAR_CHARGER:
   {
-    g_scanSmartsolarUpdates++;
     const VictronSolarData &s = device->solar;
 
+    portENTER_CRITICAL(&g_victronMux);
+    g_deviceUpdateCountBoot++;
+    g_publishPending = true;
+    g_scanSmartsolarUpdates++;
     g_victron.smartsolar_valid = true;
     g_victron.smartsolar_last_seen_ms = nowMs;
     g_victron.smartsolar_rssi = device->rssi;
@@ -138,22 +360,30 @@ static void onVictronData(const VictronDevice *device)
     g_victron.solar_yield_today_kwh = ((float)s.yieldToday) / 1000.0f;
     g_victron.solar_state_code = s.chargeState;
     g_victron.solar_error_code = s.errorCode;
+    portEXIT_CRITICAL(&g_victronMux);
 
-    logSystemf("VICTRON: SmartSolar %.2fV %.2fA PV=%.0fW yield=%.2fkWh state=%s rssi=%d",
-               g_victron.solar_battery_voltage_v,
-               g_victron.solar_battery_current_a,
-               g_victron.solar_pv_power_w,
-               g_victron.solar_yield_today_kwh,
-               chargerStateToText(g_victron.solar_state_code).c_str(),
-               g_victron.smartsolar_rssi);
+    victronAggPv(s.panelPower, nowMs);
+    victronAggSample(VictronAggMetric::SOLAR_A, s.batteryCurrent, nowMs);
+
+    LOG_AT(updateLogLevel(), LogModule::VICTRON,
+           "VICTRON: SmartSolar %.2fV %.2fA PV=%.0fW yield=%.2fkWh state=%s rssi=%d",
+           s.batteryVoltage,
+           s.batteryCurrent,
+           s.panelPower,
+           ((float)s.yieldToday) / 1000.0f,
+           chargerStateToText(s.chargeState).c_str(),
+           device->rssi);
     break;
   }
 
   case DEVICE_TYPE_BATTERY_MONITOR:
   {
-    g_scanSmartshuntUpdates++;
     const VictronBatteryData &b = device->battery;
 
+    portENTER_CRITICAL(&g_victronMux);
+    g_deviceUpdateCountBoot++;
+    g_publishPending = true;
+    g_scanSmartshuntUpdates++;
     g_victron.smartshunt_valid = true;
     g_victron.smartshunt_last_seen_ms = nowMs;
     g_victron.smartshunt_rssi = device->rssi;
@@ -162,21 +392,29 @@ static void onVictronData(const VictronDevice *device)
     g_victron.soc_pct = b.soc;
     g_victron.consumed_ah = b.consumedAh;
     g_victron.time_to_go_min = b.remainingMinutes;
+    portEXIT_CRITICAL(&g_victronMux);
+
+    victronAggBattery(b.voltage, b.current, nowMs);
+    victronAggSample(VictronAggMetric::SOC, b.soc, nowMs);
 
-    logSystemf("VICTRON: SmartShunt %.2fV %.3fA SOC=%.1f%% consumed=%.1fAh rssi=%d",
-               g_victron.battery_voltage_v,
-               g_victron.battery_current_a,
-               g_victron.soc_pct,
-               g_victron.consumed_ah,
-               g_victron.smartshunt_rssi);
+    LOG_AT(updateLogLevel(), LogModule::VICTRON,
+           "VICTRON: SmartShunt %.2fV %.3fA SOC=%.1f%% consumed=%.1fAh rssi=%d",
+           b.voltage,
+           b.current,
+           b.soc,
+           b.consumedAh,
+           device->rssi);
     break;
   }
 
   case DEVICE_TYPE_DCDC_CONVERTER:
   {
-    g_scanOrionUpdates++;
     const VictronDCDCData &d = device->dcdc;
 
+    portENTER_CRITICAL(&g_victronMux);
+    g_deviceUpdateCountBoot++;
+    g_publishPending = true;
+    g_scanOrionUpdates++;
     g_victron.orion_valid = true;
     g_victron.orion_last_seen_ms = nowMs;
     g_victron.orion_rssi = device->rssi;
@@ -185,73 +423,413 @@ static void onVictronData(const VictronDevice *device)
     g_victron.orion_output_current_a = d.outputCurrent;
     g_victron.orion_state_code = d.chargeState;
     g_victron.orion_error_code = d.errorCode;
+    portEXIT_CRITICAL(&g_victronMux);
+
+    victronAggSample(VictronAggMetric::ORION_A, d.outputCurrent, nowMs);
 
-    logSystemf("VICTRON: Orion XS in=%.2fV out=%.2fV current=%.2fA state=%u rssi=%d",
-               g_victron.orion_input_voltage_v,
-               g_victron.orion_output_voltage_v,
-               g_victron.orion_output_current_a,
-               (unsigned)g_victron.orion_state_code,
-               g_victron.orion_rssi);
+    LOG_AT(updateLogLevel(), LogModule::VICTRON,
+           "VICTRON: Orion XS in=%.2fV out=%.2fV current=%.2fA state=%u rssi=%d",
+           d.inputVoltage,
+           d.outputVoltage,
+           d.outputCurrent,
+           (unsigned)d.chargeState,
+           device->rssi);
     break;
   }
 
   default:
+  {
+    // Övriga recordtyper (SmartLithium, Lynx, AC-laddare, ...) har inga
+    // egna fält i g_victron; värdena publiceras via "devices". Första
+    // recordet från en enhet loggas på INFO så en registertillagd enhet
+    // syns i journalen även utan DEBUG.
+    portENTER_CRITICAL(&g_victronMux);
+    g_deviceUpdateCountBoot++;
+    g_publishPending = true;
+    portEXIT_CRITICAL(&g_victronMux);
+
+    const VictronRecord &r = device->record;
+    uint8_t fields = 0;
+    for (uint16_t m = r.presentMask; m; m &= (uint16_t)(m - 1))
+      fields++;
+
+    LOG_AT(recordCount == 1 ? LogLevel::INFO : updateLogLevel(), LogModule::VICTRON,
+           "VICTRON: %s %s %s fields=%u V=%.2f I=%.2f SOC=%.1f rssi=%d%s",
+           device->name,
+           device->mac,
+           victronRecordTypeName(device->recordType),
+           (unsigned)fields,
+           victronRecordValueOr(r, VictronField::BATTERY_VOLTAGE, NAN),
+           victronRecordValueOr(r, VictronField::BATTERY_CURRENT, NAN),
+           victronRecordValueOr(r, VictronField::SOC, NAN),
+           device->rssi,
+           recordCount == 1 ? " first" : "");
     break;
   }
+  }
 }
 
-void victronManagerInit()
+// ------------------------------------------------------------
+// Enhetsregister i NVS (namespace "victron")
+// ------------------------------------------------------------
+// Hela registret sparas som en blob. BLE-listan byggs om från
+// registret först när ingen scan pågår, så BT-tasken aldrig läser
+// en lista som håller på att ändras.
+
+static constexpr uint8_t VICTRON_REGISTRY_VERSION = 1;
+static constexpr int VICTRON_KEY_HEX_LEN = 33; // 32 hex + null
+
+struct VictronRegistryEntry
 {
-  g_nextScanAtMs = millis() + 60000UL; // första testscan efter boot, inte direkt under uppstart
-  g_publishPending = false;
-  logSystem("VICTRON: manager init");
-}
+  char name[VICTRON_NAME_LEN];
+  char mac[VICTRON_MAC_LEN]; // 12 hex, gemener, utan kolon
+  char key[VICTRON_KEY_HEX_LEN];
+};
 
-static bool configureVictronBle(uint32_t scanSeconds)
+struct VictronRegistryBlob
 {
-  g_victronBle.setDebug(false);
-  g_victronBle.setCallback(onVictronData);
-  g_victronBle.setMinInterval(1000);
+  uint8_t version;
+  uint8_t count;
+  VictronRegistryEntry entries[VICTRON_MAX_DEVICES];
+};
+
+static Preferences g_registryPrefs;
+static VictronRegistryBlob g_registry;
+static bool g_registryLoaded = false;
+static bool g_registryNvsOk = false;
+static bool g_registrySyncPending = true;
+static uint32_t g_registryChangeId = 0;
+
+static bool isHexChar(char c)
+{
+  return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
 
-  if (!g_victronBle.begin(scanSeconds))
+// "E3:72:AB:6D:90:00" / "e372ab6d9000" -> "e372ab6d9000".
+static bool normalizeRegistryMac(const char *in, char *out)
+{
+  size_t n = 0;
+  for (const char *p = in; p && *p; p++)
   {
-    logSystem("VICTRON: BLE begin failed");
+    if (*p == ':' || *p == '-' || *p == ' ')
+      continue;
+    if (!isHexChar(*p) || n >= 12)
+      return false;
+    out[n++] = (char)tolower((unsigned char)*p);
+  }
+  out[n] = '\0';
+  return n == 12;
+}
+
+static bool isValidRegistryKey(const char *key)
+{
+  if (!key || strlen(key) != 32)
     return false;
+  for (const char *p = key; *p; p++)
+  {
+    if (!isHexChar(*p))
+      return false;
   }
+  return true;
+}
 
-  // Enhetslistan ligger kvar i VictronBLE-objektet även efter end().
-  // Lägg därför bara till enheter första gången.
-  if (g_victronConfigured)
+// Namnet hamnar i JSON utan escaping; byt ut tecken som skulle bryta den.
+static void copyRegistryName(const char *in, char *out)
+{
+  size_t n = 0;
+  for (const char *p = in; p && *p && n < VICTRON_NAME_LEN - 1; p++)
+    out[n++] = (*p == '"' || *p == '\\' || (uint8_t)*p < 0x20) ? '_' : *p;
+  out[n] = '\0';
+}
+
+static int registryFind(const char *mac)
+{
+  for (uint8_t i = 0; i < g_registry.count; i++)
   {
-    return g_victronBle.getDeviceCount() > 0;
+    if (strcmp(g_registry.entries[i].mac, mac) == 0)
+      return i;
   }
+  return -1;
+}
+
+static bool registryAdd(const char *name, const char *mac, const char *key)
+{
+  if (g_registry.count >= VICTRON_MAX_DEVICES)
+    return false;
+
+  VictronRegistryEntry &e = g_registry.entries[g_registry.count];
+  memset(&e, 0, sizeof(e));
+  copyRegistryName(name, e.name);
+  strncpy(e.mac, mac, VICTRON_MAC_LEN - 1);
+  strncpy(e.key, key, VICTRON_KEY_HEX_LEN - 1);
+  g_registry.count++;
+  return true;
+}
 
-  bool any = false;
+static void registrySeedFromSecrets()
+{
+  const char *names[] = {VICTRON_NAME_1, VICTRON_NAME_2, VICTRON_NAME_3};
+  const char *macs[] = {VICTRON_MAC_1, VICTRON_MAC_2, VICTRON_MAC_3};
+  const char *keys[] = {VICTRON_KEY_1, VICTRON_KEY_2, VICTRON_KEY_3};
 
-  if (strlen(VICTRON_MAC_1) > 0 && strlen(VICTRON_KEY_1) == 32)
+  for (size_t i = 0; i < 3; i++)
   {
-    bool ok = g_victronBle.addDevice(VICTRON_NAME_1, VICTRON_MAC_1, VICTRON_KEY_1, DEVICE_TYPE_DCDC_CONVERTER);
-    logSystem(String("VICTRON: add ") + VICTRON_NAME_1 + " " + (ok ? "OK" : "FAILED"));
-    any = any || ok;
+    char mac[VICTRON_MAC_LEN];
+    if (!normalizeRegistryMac(macs[i], mac) || !isValidRegistryKey(keys[i]))
+      continue;
+    if (registryFind(mac) >= 0)
+      continue;
+    registryAdd(names[i], mac, keys[i]);
   }
+}
+
+static bool registrySave()
+{
+  if (!g_registryNvsOk)
+    return false;
 
-  if (strlen(VICTRON_MAC_2) > 0 && strlen(VICTRON_KEY_2) == 32)
+  size_t written = g_registryPrefs.putBytes("devices", &g_registry, sizeof(g_registry));
+  g_registryPrefs.putUInt("change_id", g_registryChangeId);
+  return written == sizeof(g_registry);
+}
+
+static void registryLoad()
+{
+  if (g_registryLoaded)
+    return;
+
+  g_registryLoaded = true;
+  memset(&g_registry, 0, sizeof(g_registry));
+  g_registry.version = VICTRON_REGISTRY_VERSION;
+
+  g_registryNvsOk = g_registryPrefs.begin("victron", false);
+  if (!g_registryNvsOk)
   {
-    bool ok = g_victronBle.addDevice(VICTRON_NAME_2, VICTRON_MAC_2, VICTRON_KEY_2, DEVICE_TYPE_SOLAR_CHARGER);
-    logSystem(String("VICTRON: add ") + VICTRON_NAME_2 + " " + (ok ? "OK" : "FAILED"));
-    any = any || ok;
+    logSystem("VICTRON: registry NVS open failed, using secrets.h");
+    registrySeedFromSecrets();
+    return;
   }
 
-  if (strlen(VICTRON_MAC_3) > 0 && strlen(VICTRON_KEY_3) == 32)
+  g_registryChangeId = g_registryPrefs.getUInt("change_id", 0);
+
+  VictronRegistryBlob stored;
+  if (g_registryPrefs.getBytesLength("devices") == sizeof(stored) &&
+      g_registryPrefs.getBytes("devices", &stored, sizeof(stored)) == sizeof(stored) &&
+      stored.version == VICTRON_REGISTRY_VERSION &&
+      stored.count <= VICTRON_MAX_DEVICES)
+  {
+    g_registry = stored;
+    logSystemf("VICTRON: registry loaded devices=%u change_id=%lu",
+               (unsigned)g_registry.count,
+               (unsigned long)g_registryChangeId);
+    return;
+  }
+
+  registrySeedFromSecrets();
+  bool saved = registrySave();
+  logSystemf("VICTRON: registry seeded from secrets devices=%u saved=%d",
+             (unsigned)g_registry.count,
+             saved ? 1 : 0);
+}
+
+// Bygger om VictronBLE:s enhetslista. Får bara anropas när ingen scan pågår.
+static void syncRegistryToBle()
+{
+  g_victronBle.clearDevices();
+  g_victronBle.clearUnknown();
+  clearDeviceRecords();
+
+  for (uint8_t i = 0; i < g_registry.count; i++)
   {
-    bool ok = g_victronBle.addDevice(VICTRON_NAME_3, VICTRON_MAC_3, VICTRON_KEY_3, DEVICE_TYPE_BATTERY_MONITOR);
-    logSystem(String("VICTRON: add ") + VICTRON_NAME_3 + " " + (ok ? "OK" : "FAILED"));
-    any = any || ok;
+    const VictronRegistryEntry &e = g_registry.entries[i];
+    // Typen sätts av recordtypen i första paketet.
+    bool ok = g_victronBle.addDevice(e.name, e.mac, e.key, DEVICE_TYPE_UNKNOWN);
+    logSystem(String("VICTRON: add ") + e.name + " " + e.mac + " " + (ok ? "OK" : "FAILED"));
   }
 
-  g_victronConfigured = any;
+  g_registrySyncPending = false;
+  g_victronConfigured = true;
   logSystemf("VICTRON: configured devices=%u", (unsigned)g_victronBle.getDeviceCount());
-  return any;
+}
+
+VictronRegistryStatus victronRegistryApply(uint32_t changeId,
+                                           const String &op,
+                                           const String &name,
+                                           const String &mac,
+                                           const String &key)
+{
+  registryLoad();
+
+  if (changeId == 0)
+    return VictronRegistryStatus::MISSING_CHANGE_ID;
+  if (changeId == g_registryChangeId)
+    return VictronRegistryStatus::DUPLICATE_IGNORED;
+
+  String o = op;
+  o.toLowerCase();
+  if (o != "add" && o != "remove" && o != "rekey")
+    return VictronRegistryStatus::BAD_OP;
+
+  char macNorm[VICTRON_MAC_LEN];
+  if (!normalizeRegistryMac(mac.c_str(), macNorm))
+    return VictronRegistryStatus::BAD_MAC;
+
+  if (o != "remove" && !isValidRegistryKey(key.c_str()))
+    return VictronRegistryStatus::BAD_KEY;
+
+  // Spara undan så att minnet och NVS inte glider isär om
+  // skrivningen misslyckas.
+  const VictronRegistryBlob before = g_registry;
+  const int idx = registryFind(macNorm);
+
+  if (o == "add")
+  {
+    if (idx >= 0)
+      return VictronRegistryStatus::EXISTS;
+    if (!registryAdd(name.length() ? name.c_str() : macNorm, macNorm, key.c_str()))
+      return VictronRegistryStatus::FULL;
+  }
+  else if (idx < 0)
+  {
+    return VictronRegistryStatus::NOT_FOUND;
+  }
+  else if (o == "remove")
+  {
+    for (uint8_t i = idx; i + 1 < g_registry.count; i++)
+      g_registry.entries[i] = g_registry.entries[i + 1];
+    g_registry.count--;
+    memset(&g_registry.entries[g_registry.count], 0, sizeof(VictronRegistryEntry));
+  }
+  else
+  {
+    memset(g_registry.entries[idx].key, 0, VICTRON_KEY_HEX_LEN);
+    strncpy(g_registry.entries[idx].key, key.c_str(), VICTRON_KEY_HEX_LEN - 1);
+  }
+
+  const uint32_t prevChangeId = g_registryChangeId;
+  g_registryChangeId = changeId;
+  if (!registrySave())
+  {
+    g_registry = before;
+    g_registryChangeId = prevChangeId;
+    return VictronRegistryStatus::NVS_FAILED;
+  }
+
+  g_registrySyncPending = true;
+  g_publishPending = true;
+  logSystemf("VICTRON: registry %s %s change_id=%lu devices=%u",
+             o.c_str(), macNorm,
+             (unsigned long)changeId,
+             (unsigned)g_registry.count);
+  return VictronRegistryStatus::OK;
+}
+
+String victronRegistryJson()
+{
+  registryLoad();
+
+  String out = "[";
+  for (uint8_t i = 0; i < g_registry.count; i++)
+  {
+    if (i > 0)
+      out += ",";
+    out += "{\"name\":\"";
+    out += g_registry.entries[i].name;
+    out += "\",\"mac\":\"";
+    out += g_registry.entries[i].mac;
+    out += "\"}";
+  }
+  out += "]";
+  return out;
+}
+
+// Okända Victron-enheter som hörts under vanliga scans (discovery).
+static String unknownDevicesJson(uint32_t nowMs)
+{
+  String out = "[";
+  VictronUnknownDevice u;
+  for (size_t i = 0; i < g_victronBle.getUnknownCount(); i++)
+  {
+    if (!g_victronBle.getUnknown(i, u))
+      continue;
+    if (i > 0)
+      out += ",";
+    out += "{\"mac\":\"" + String(u.mac) + "\"";
+    out += ",\"rssi\":" + String(u.rssi);
+    out += ",\"record\":\"" + String(victronRecordTypeName(u.recordType)) + "\"";
+    out += ",\"count\":" + String(u.count);
+    out += ",\"age_s\":" + String((nowMs - u.lastSeenMs) / 1000) + "}";
+  }
+  out += "]";
+  return out;
+}
+
+void victronManagerInit()
+{
+  g_nextScanAtMs = millis() + 60000UL; // första testscan efter boot, inte direkt under uppstart
+  g_publishPending = false;
+  victronAggInit();
+  logSystem("VICTRON: manager init");
+}
+
+static bool configureVictronBle(uint32_t scanSeconds)
+{
+  g_victronBle.setDebug(false);
+  g_victronBle.setCallback(onVictronData);
+  g_victronBle.setMinInterval(1000);
+
+  if (!g_victronBle.isInitialized())
+  {
+    uint32_t t0 = millis();
+    uint32_t heapBefore = ESP.getFreeHeap();
+    if (!g_victronBle.begin(scanSeconds))
+    {
+      logSystem("VICTRON: BLE begin failed");
+      return false;
+    }
+
+    g_bleInitCountBoot++;
+    g_bleInitMsLast = millis() - t0;
+    uint32_t heapAfter = ESP.getFreeHeap();
+    g_bleHeapBytes = heapBefore > heapAfter ? heapBefore - heapAfter : 0;
+    if (g_bleInitMsLast > g_bleInitMsMax)
+      g_bleInitMsMax = g_bleInitMsLast;
+
+    logSystemf("VICTRON: BLE init %s %lu ms heap=%lu count=%lu persistent=%d",
+               VICTRON_BLE_BACKEND_NIMBLE ? "nimble" : "bluedroid",
+               (unsigned long)g_bleInitMsLast,
+               (unsigned long)g_bleHeapBytes,
+               (unsigned long)g_bleInitCountBoot,
+               VICTRON_BLE_PERSISTENT);
+  }
+
+  // Enhetslistan ligger kvar i VictronBLE-objektet även efter end().
+  // Byggs bara om när registret ändrats. Tomt register är ok: då
+  // används scanningen enbart för discovery av okända enheter.
+  registryLoad();
+  if (g_registrySyncPending)
+    syncRegistryToBle();
+
+  return true;
+}
+
+bool victronManagerBattery(float &socPct, float &voltageV, float &currentA,
+                           uint16_t &ttgMin, uint32_t &lastSeenMs,
+                           uint32_t maxAgeMs)
+{
+  VictronLatestData v;
+  victronSnapshot(v);
+
+  if (!v.smartshunt_valid || v.smartshunt_last_seen_ms == 0 ||
+      (uint32_t)(millis() - v.smartshunt_last_seen_ms) >= maxAgeMs)
+    return false;
+
+  socPct = v.soc_pct;
+  voltageV = v.battery_voltage_v;
+  currentA = v.battery_current_a;
+  ttgMin = v.time_to_go_min;
+  lastSeenMs = v.smartshunt_last_seen_ms;
+  return true;
 }
 
 bool victronManagerDue(uint32_t nowMs, const ProfileConfig &profile)
@@ -259,41 +837,105 @@ bool victronManagerDue(uint32_t nowMs, const ProfileConfig &profile)
   if (!profile.victronBleEnabled || profile.victronBleIntervalMs == 0 || profile.victronBleScanSeconds == 0)
     return false;
 
+  // Bakgrundsprofiler scannar redan kontinuerligt.
+  if (profile.victronBleBackground)
+    return false;
+
   return (int32_t)(nowMs - g_nextScanAtMs) >= 0;
 }
 
-bool victronManagerRunScanOnce(uint32_t nowMs, uint32_t scanSeconds)
+static void finishScan(uint32_t nowMs, bool complete);
+
+bool victronManagerScanStart(uint32_t nowMs, uint32_t scanSeconds)
 {
   g_lastScanStartMs = nowMs;
   g_lastScanEndMs = 0;
   g_scanCountBoot++;
+  g_scanBudgetMs = scanSeconds * 1000UL;
+  portENTER_CRITICAL(&g_victronMux);
   g_scanSmartshuntUpdates = 0;
   g_scanSmartsolarUpdates = 0;
   g_scanOrionUpdates = 0;
   g_publishPending = true; // publicera även scanstatus om inget hittades
+  portEXIT_CRITICAL(&g_victronMux);
 
   logSystemf("VICTRON: scan start seconds=%lu heap_free=%lu",
              (unsigned long)scanSeconds,
              (unsigned long)ESP.getFreeHeap());
 
-  bool ok = configureVictronBle(scanSeconds);
-  if (ok && g_victronConfigured)
+  g_scanOk = configureVictronBle(scanSeconds);
+  if (g_scanOk && g_victronConfigured)
   {
     g_victronBle.resetScanStats();
-    ok = g_victronBle.scanOnce(scanSeconds);
+
+    uint32_t t0 = millis();
+    g_scanOk = g_victronBle.scanStart(scanSeconds);
+    g_scanStartMsLast = millis() - t0;
+    if (g_scanStartMsLast > g_scanStartMsMax)
+      g_scanStartMsMax = g_scanStartMsLast;
+  }
+  else
+  {
+    g_scanOk = false;
+  }
+
+  if (!g_scanOk)
+  {
+    finishScan(millis(), false);
+    return false;
   }
 
+  g_scanActive = true;
+  return true;
+}
+
+// Stäng BLE och logga sammanfattning. complete = scanningen fick
+// gå klart (alla hörda eller tiden ute).
+static void finishScan(uint32_t nowMs, bool complete)
+{
+  g_scanActive = false;
+
+  const bool allReported = g_victronBle.scanAllReported();
   const uint32_t advSeen = g_victronBle.getScanAdvSeen();
   const uint32_t knownSeen = g_victronBle.getScanKnownSeen();
   const uint32_t unknownSeen = g_victronBle.getScanUnknownSeen();
   const uint32_t parseFailSeen = g_victronBle.getScanParseFailSeen();
   const uint32_t parseSuccessSeen = g_victronBle.getScanParseSuccessSeen();
 
+  // Time-to-first-packet per enhet
+  String ttfp;
+  for (size_t i = 0; i < g_victronBle.getDeviceCount(); i++)
+  {
+    uint32_t ms = 0;
+    ttfp += String(i > 0 ? " " : "") + g_victronBle.getDeviceName(i) + "=";
+    ttfp += g_victronBle.getScanFirstPacketMs(i, ms) ? String(ms) : String("-");
+  }
+
+  g_victronBle.scanStop();
+#if !VICTRON_BLE_PERSISTENT
   g_victronBle.end();
+#endif
+
+  const uint32_t heapFree = ESP.getFreeHeap();
+  if (heapFree < g_heapAfterScanMin)
+    g_heapAfterScanMin = heapFree;
 
   const uint32_t doneMs = millis();
+  const uint32_t durationMs = doneMs - g_lastScanStartMs;
   g_lastScanEndMs = doneMs;
-  g_nextScanAtMs = doneMs + currentProfile().victronBleIntervalMs;
+  g_nextScanAtMs = doneMs + powerSchedVictronIntervalMs(currentProfile());
+
+  g_lastScanMs = durationMs;
+  g_lastScanSavedMs = 0;
+  if (complete)
+  {
+    g_lastScanSavedMs = durationMs < g_scanBudgetMs ? g_scanBudgetMs - durationMs : 0;
+    g_scanMsBoot += durationMs;
+    g_scanSavedMsBoot += g_lastScanSavedMs;
+    g_scanCompleteCountBoot++;
+    if (allReported)
+      g_scanEarlyCountBoot++;
+  }
 
   logSystemf("VICTRON: scan summary configured=%u adv=%lu known=%lu unknown=%lu parse_ok=%lu parse_fail=%lu shunt=%lu solar=%lu orion=%lu",
              (unsigned)g_victronBle.getDeviceCount(),
@@ -306,79 +948,285 @@ bool victronManagerRunScanOnce(uint32_t nowMs, uint32_t scanSeconds)
              (unsigned long)g_scanSmartsolarUpdates,
              (unsigned long)g_scanOrionUpdates);
 
-  logSystemf("VICTRON: scan done ok=%d duration_ms=%lu updates_boot=%lu heap_free=%lu",
-             ok ? 1 : 0,
-             (unsigned long)(doneMs - nowMs),
+  logSystem("VICTRON: ttfp_ms " + ttfp);
+
+  logSystemf("VICTRON: scan done ok=%d all=%d aborted=%d duration_ms=%lu saved_ms=%lu start_ms=%lu updates_boot=%lu heap_free=%lu heap_min=%lu",
+             g_scanOk ? 1 : 0,
+             allReported ? 1 : 0,
+             complete ? 0 : 1,
+             (unsigned long)durationMs,
+             (unsigned long)g_lastScanSavedMs,
+             (unsigned long)g_scanStartMsLast,
+             (unsigned long)g_deviceUpdateCountBoot,
+             (unsigned long)heapFree,
+             (unsigned long)ESP.getMinFreeHeap());
+}
+
+bool victronManagerScanTick(uint32_t nowMs)
+{
+  if (!g_scanActive)
+    return true;
+
+  if (g_victronBle.scanRunning() && !g_victronBle.scanAllReported())
+    return false;
+
+  finishScan(nowMs, true);
+  return true;
+}
+
+void victronManagerScanAbort(uint32_t nowMs)
+{
+  if (!g_scanActive)
+    return;
+
+  finishScan(nowMs, false);
+}
+
+// Sparad scantid per timme drift (s/h).
+static float scanSavedSecondsPerHour(uint32_t nowMs)
+{
+  if (nowMs < 60000UL)
+    return 0.0f;
+  return (float)((double)g_scanSavedMsBoot / 1000.0 * 3600000.0 / (double)nowMs);
+}
+
+static void stopBackground(uint32_t nowMs)
+{
+  g_victronBle.scanStop();
+#if !VICTRON_BLE_PERSISTENT
+  g_victronBle.end();
+#endif
+  g_victronBle.setScanTiming(VICTRON_BLE_SCAN_INTERVAL, VICTRON_BLE_SCAN_WINDOW);
+#if VICTRON_BLE_BG_COEX_PREFER_WIFI
+  esp_coex_preference_set(ESP_COEX_PREFER_BALANCE);
+#endif
+
+  const uint32_t ranMs = nowMs - g_bgStartedMs;
+  g_bgMsBoot += ranMs;
+  g_bgActive = false;
+  g_publishPending = true; // publicera bg_active=false
+
+  logSystemf("VICTRON: background scan stop ran_ms=%lu chunks_boot=%lu updates_boot=%lu heap_free=%lu",
+             (unsigned long)ranMs,
+             (unsigned long)g_bgChunkCountBoot,
              (unsigned long)g_deviceUpdateCountBoot,
              (unsigned long)ESP.getFreeHeap());
+}
+
+static bool startBackground(uint32_t nowMs, const ProfileConfig &profile)
+{
+  g_victronBle.setScanTiming(VICTRON_BLE_BG_SCAN_INTERVAL, VICTRON_BLE_BG_SCAN_WINDOW);
+  if (!configureVictronBle(VICTRON_BLE_BG_CHUNK_SECONDS) || !g_victronConfigured)
+  {
+    g_victronBle.setScanTiming(VICTRON_BLE_SCAN_INTERVAL, VICTRON_BLE_SCAN_WINDOW);
+    g_bgRetryAtMs = nowMs + VICTRON_BLE_BG_RETRY_MS;
+    return false;
+  }
+
+#if VICTRON_BLE_BG_COEX_PREFER_WIFI
+  // WiFi och BLE delar radion. MQTT ska inte vänta på scanfönster.
+  esp_coex_preference_set(ESP_COEX_PREFER_WIFI);
+#endif
+
+  g_victronBle.resetScanStats();
+  g_bgActive = true;
+  g_bgStartedMs = nowMs;
+  g_bgPublishIntervalMs = powerSchedVictronIntervalMs(profile);
+  g_bgChunkCountBoot++;
+  if (!g_victronBle.scanStart(VICTRON_BLE_BG_CHUNK_SECONDS))
+  {
+    logSystem("VICTRON: background scan start failed");
+    stopBackground(nowMs);
+    g_bgRetryAtMs = nowMs + VICTRON_BLE_BG_RETRY_MS;
+    return false;
+  }
+
+  logSystemf("VICTRON: background scan start interval=%u window=%u chunk_s=%u publish_ms=%lu",
+             (unsigned)VICTRON_BLE_BG_SCAN_INTERVAL,
+             (unsigned)VICTRON_BLE_BG_SCAN_WINDOW,
+             (unsigned)VICTRON_BLE_BG_CHUNK_SECONDS,
+             (unsigned long)g_bgPublishIntervalMs);
+  return true;
+}
+
+void victronManagerBackgroundTick(uint32_t nowMs, const ProfileConfig &profile)
+{
+  const bool wanted = profile.victronBleEnabled && profile.victronBleBackground;
+
+  if (!wanted)
+  {
+    if (g_bgActive)
+      stopBackground(nowMs);
+    return;
+  }
 
-  return ok;
+  // En schemalagd scan äger BLE tills den är klar.
+  if (g_scanActive)
+    return;
+
+  if (!g_bgActive)
+  {
+    if (g_bgRetryAtMs == 0 || (int32_t)(nowMs - g_bgRetryAtMs) >= 0)
+    {
+      g_bgRetryAtMs = 0;
+      startBackground(nowMs, profile);
+    }
+    return;
+  }
+
+  g_bgPublishIntervalMs = powerSchedVictronIntervalMs(profile);
+
+  // Bitvis scan: starta nästa bit direkt när föregående tagit slut.
+  // Registerändringar tas in mellan två bitar.
+  if (!g_victronBle.scanRunning())
+  {
+    if (g_registrySyncPending)
+      syncRegistryToBle();
+    g_bgChunkCountBoot++;
+    g_victronBle.resetScanStats();
+    if (!g_victronBle.scanStart(VICTRON_BLE_BG_CHUNK_SECONDS))
+    {
+      logSystem("VICTRON: background chunk start failed, backing off");
+      stopBackground(nowMs);
+      g_bgRetryAtMs = nowMs + VICTRON_BLE_BG_RETRY_MS;
+    }
+  }
+}
+
+bool victronManagerBackgroundActive()
+{
+  return g_bgActive;
+}
+
+void victronManagerNotePublishCycle(uint32_t cycleMs)
+{
+  if (g_bgActive)
+  {
+    g_pubCycleMsBg += cycleMs;
+    g_pubCycleCountBg++;
+  }
+  else
+  {
+    g_pubCycleMsNoBg += cycleMs;
+    g_pubCycleCountNoBg++;
+  }
 }
 
 bool victronManagerPublishPending()
 {
-  return g_publishPending;
+  if (!g_publishPending)
+    return false;
+
+  // Vid bakgrundsscan kommer nya värden hela tiden; publicera högst
+  // en gång per profilens intervall.
+  if (g_bgActive && g_lastPublishMs != 0 &&
+      (uint32_t)(millis() - g_lastPublishMs) < g_bgPublishIntervalMs)
+    return false;
+
+  return true;
 }
 
 void victronManagerClearPublishPending()
 {
+  portENTER_CRITICAL(&g_victronMux);
   g_publishPending = false;
+  portEXIT_CRITICAL(&g_victronMux);
+  g_lastPublishMs = millis();
 }
 
 String victronManagerBuildStateJson()
 {
   const uint32_t nowMs = millis();
-  const bool smartshuntFresh = isFresh(g_victron.smartshunt_valid, g_victron.smartshunt_last_seen_ms, nowMs);
-  const bool smartsolarFresh = isFresh(g_victron.smartsolar_valid, g_victron.smartsolar_last_seen_ms, nowMs);
-  const bool orionFresh = isFresh(g_victron.orion_valid, g_victron.orion_last_seen_ms, nowMs);
+
+  VictronLatestData v;
+  victronSnapshot(v);
+
+  const bool smartshuntFresh = isFresh(v.smartshunt_valid, v.smartshunt_last_seen_ms, nowMs);
+  const bool smartsolarFresh = isFresh(v.smartsolar_valid, v.smartsolar_last_seen_ms, nowMs);
+  const bool orionFresh = isFresh(v.orion_valid, v.orion_last_seen_ms, nowMs);
+
+  const TimeStamp &ts = timeNowStamp();
 
   String payload = "{";
   payload += "\"device_id\":\"" + String(DEVICE_ID) + "\",";
   payload += "\"type\":\"VICTRON\",";
-  payload += "\"timestamp\":\"" + timeIsoUtc() + "\",";
-  payload += "\"epoch_utc\":" + String(timeEpochUtc()) + ",";
-  payload += "\"time_valid\":" + String(timeIsValid() ? "true" : "false") + ",";
+  payload += "\"timestamp\":\"";
+  payload += ts.isoUtc;
+  payload += "\",\"epoch_utc\":" + String(ts.epoch) + ",";
+  payload += "\"time_valid\":" + String(ts.valid ? "true" : "false") + ",";
   payload += "\"profile\":\"" + String(currentProfile().name) + "\",";
   payload += "\"uptime_s\":" + String(nowMs / 1000) + ",";
   payload += "\"scan_count_boot\":" + String(g_scanCountBoot) + ",";
   payload += "\"device_update_count_boot\":" + String(g_deviceUpdateCountBoot) + ",";
   payload += "\"last_scan_age_s\":" + String(g_lastScanEndMs ? (int)((nowMs - g_lastScanEndMs) / 1000) : -1) + ",";
+  payload += "\"last_scan_ms\":" + String(g_lastScanMs) + ",";
+  payload += "\"last_scan_saved_ms\":" + String(g_lastScanSavedMs) + ",";
+  payload += "\"scan_early_count_boot\":" + String(g_scanEarlyCountBoot) + ",";
+  payload += "\"scan_avg_ms\":" + String(g_scanCompleteCountBoot ? (uint32_t)(g_scanMsBoot / g_scanCompleteCountBoot) : 0) + ",";
+  payload += "\"scan_saved_s_per_h\":" + String(scanSavedSecondsPerHour(nowMs), 1) + ",";
+  payload += "\"ble_backend\":\"" + String(VICTRON_BLE_BACKEND_NIMBLE ? "nimble" : "bluedroid") + "\",";
+  payload += "\"ble_heap_bytes\":" + String(g_bleHeapBytes) + ",";
+  payload += "\"ble_persistent\":" + String(VICTRON_BLE_PERSISTENT ? "true" : "false") + ",";
+  payload += "\"ble_init_count_boot\":" + String(g_bleInitCountBoot) + ",";
+  payload += "\"ble_init_ms\":" + String(g_bleInitMsLast) + ",";
+  payload += "\"ble_init_ms_max\":" + String(g_bleInitMsMax) + ",";
+  payload += "\"scan_start_ms\":" + String(g_scanStartMsLast) + ",";
+  payload += "\"scan_start_ms_max\":" + String(g_scanStartMsMax) + ",";
+  payload += "\"heap_after_scan_min\":" + String(g_heapAfterScanMin == UINT32_MAX ? 0 : g_heapAfterScanMin) + ",";
+  payload += "\"heap_min\":" + String(ESP.getMinFreeHeap()) + ",";
+  payload += "\"bg_active\":" + String(g_bgActive ? "true" : "false") + ",";
+  payload += "\"bg_chunk_count_boot\":" + String(g_bgChunkCountBoot) + ",";
+  payload += "\"bg_scan_s_boot\":" + String((uint32_t)((g_bgMsBoot + (g_bgActive ? nowMs - g_bgStartedMs : 0)) / 1000)) + ",";
+  payload += "\"pub_cycle_ms_avg_bg\":" + String(g_pubCycleCountBg ? (uint32_t)(g_pubCycleMsBg / g_pubCycleCountBg) : 0) + ",";
+  payload += "\"pub_cycle_ms_avg_nobg\":" + String(g_pubCycleCountNoBg ? (uint32_t)(g_pubCycleMsNoBg / g_pubCycleCountNoBg) : 0) + ",";
+
+  uint32_t decodeCount = 0, decodeUsAvg = 0, decodeUsMax = 0;
+  g_victronBle.getDecodeStats(decodeCount, decodeUsAvg, decodeUsMax);
+  payload += "\"decode_count_boot\":" + String(decodeCount) + ",";
+  payload += "\"decode_us_avg\":" + String(decodeUsAvg) + ",";
+  payload += "\"decode_us_max\":" + String(decodeUsMax) + ",";
 
-  payload += "\"smartshunt_valid\":" + String(g_victron.smartshunt_valid ? "true" : "false") + ",";
+  payload += "\"smartshunt_valid\":" + String(v.smartshunt_valid ? "true" : "false") + ",";
   payload += "\"smartshunt_fresh\":" + String(smartshuntFresh ? "true" : "false") + ",";
-  payload += "\"smartshunt_seen_s_ago\":" + String(g_victron.smartshunt_valid ? (int)((nowMs - g_victron.smartshunt_last_seen_ms) / 1000) : -1) + ",";
-  payload += "\"smartshunt_rssi\":" + String(g_victron.smartshunt_rssi) + ",";
+  payload += "\"smartshunt_seen_s_ago\":" + String(v.smartshunt_valid ? (int)((nowMs - v.smartshunt_last_seen_ms) / 1000) : -1) + ",";
+  payload += "\"smartshunt_rssi\":" + String(v.smartshunt_rssi) + ",";
 
-  payload += "\"smartsolar_valid\":" + String(g_victron.smartsolar_valid ? "true" : "false") + ",";
+  payload += "\"smartsolar_valid\":" + String(v.smartsolar_valid ? "true" : "false") + ",";
   payload += "\"smartsolar_fresh\":" + String(smartsolarFresh ? "true" : "false") + ",";
-  payload += "\"smartsolar_seen_s_ago\":" + String(g_victron.smartsolar_valid ? (int)((nowMs - g_victron.smartsolar_last_seen_ms) / 1000) : -1) + ",";
-  payload += "\"smartsolar_rssi\":" + String(g_victron.smartsolar_rssi) + ",";
+  payload += "\"smartsolar_seen_s_ago\":" + String(v.smartsolar_valid ? (int)((nowMs - v.smartsolar_last_seen_ms) / 1000) : -1) + ",";
+  payload += "\"smartsolar_rssi\":" + String(v.smartsolar_rssi) + ",";
 
-  payload += "\"orion_valid\":" + String(g_victron.orion_valid ? "true" : "false") + ",";
+  payload += "\"orion_valid\":" + String(v.orion_valid ? "true" : "false") + ",";
   payload += "\"orion_fresh\":" + String(orionFresh ? "true" : "false") + ",";
-  payload += "\"orion_seen_s_ago\":" + String(g_victron.orion_valid ? (int)((nowMs - g_victron.orion_last_seen_ms) / 1000) : -1) + ",";
-  payload += "\"orion_rssi\":" + String(g_victron.orion_rssi);
-
-  appendFloatOrNull(payload, "soc_pct", g_victron.soc_pct, 1);
-  appendFloatOrNull(payload, "battery_voltage_v", g_victron.battery_voltage_v, 2);
-  appendFloatOrNull(payload, "battery_current_a", g_victron.battery_current_a, 3);
-  appendFloatOrNull(payload, "consumed_ah", g_victron.consumed_ah, 1);
-  payload += ",\"time_to_go_min\":" + String(g_victron.time_to_go_min);
-
-  appendFloatOrNull(payload, "solar_battery_voltage_v", g_victron.solar_battery_voltage_v, 2);
-  appendFloatOrNull(payload, "solar_battery_current_a", g_victron.solar_battery_current_a, 2);
-  appendFloatOrNull(payload, "solar_pv_power_w", g_victron.solar_pv_power_w, 0);
-  payload += ",\"solar_yield_today_wh\":" + String(g_victron.solar_yield_today_wh);
-  appendFloatOrNull(payload, "solar_yield_today_kwh", g_victron.solar_yield_today_kwh, 3);
-  payload += ",\"solar_state_code\":" + String(g_victron.solar_state_code);
-  payload += ",\"solar_state\":\"" + chargerStateToText(g_victron.solar_state_code) + "\"";
-  payload += ",\"solar_error_code\":" + String(g_victron.solar_error_code);
-
-  appendFloatOrNull(payload, "orion_input_voltage_v", g_victron.orion_input_voltage_v, 2);
-  appendFloatOrNull(payload, "orion_output_voltage_v", g_victron.orion_output_voltage_v, 2);
-  appendFloatOrNull(payload, "orion_output_current_a", g_victron.orion_output_current_a, 2);
-  payload += ",\"orion_state_code\":" + String(g_victron.orion_state_code);
-  payload += ",\"orion_error_code\":" + String(g_victron.orion_error_code);
+  payload += "\"orion_seen_s_ago\":" + String(v.orion_valid ? (int)((nowMs - v.orion_last_seen_ms) / 1000) : -1) + ",";
+  payload += "\"orion_rssi\":" + String(v.orion_rssi);
+
+  appendFloatOrNull(payload, "soc_pct", v.soc_pct, 1);
+  appendFloatOrNull(payload, "battery_voltage_v", v.battery_voltage_v, 2);
+  appendFloatOrNull(payload, "battery_current_a", v.battery_current_a, 3);
+  appendFloatOrNull(payload, "consumed_ah", v.consumed_ah, 1);
+  payload += ",\"time_to_go_min\":" + String(v.time_to_go_min);
+
+  appendFloatOrNull(payload, "solar_battery_voltage_v", v.solar_battery_voltage_v, 2);
+  appendFloatOrNull(payload, "solar_battery_current_a", v.solar_battery_current_a, 2);
+  appendFloatOrNull(payload, "solar_pv_power_w", v.solar_pv_power_w, 0);
+  payload += ",\"solar_yield_today_wh\":" + String(v.solar_yield_today_wh);
+  appendFloatOrNull(payload, "solar_yield_today_kwh", v.solar_yield_today_kwh, 3);
+  payload += ",\"solar_state_code\":" + String(v.solar_state_code);
+  payload += ",\"solar_state\":\"" + chargerStateToText(v.solar_state_code) + "\"";
+  payload += ",\"solar_error_code\":" + String(v.solar_error_code);
+
+  appendFloatOrNull(payload, "orion_input_voltage_v", v.orion_input_voltage_v, 2);
+  appendFloatOrNull(payload, "orion_output_voltage_v", v.orion_output_voltage_v, 2);
+  appendFloatOrNull(payload, "orion_output_current_a", v.orion_output_current_a, 2);
+  payload += ",\"orion_state_code\":" + String(v.orion_state_code);
+  payload += ",\"orion_error_code\":" + String(v.orion_error_code);
+
+  payload += ",\"agg\":" + victronAggStatsJson();
+  payload += ",\"registry_change_id\":" + String(g_registryChangeId);
+  payload += ",\"registry\":" + victronRegistryJson();
+  payload += ",\"unknown\":" + unknownDevicesJson(nowMs);
+  payload += ",\"devices\":" + deviceRecordsJson(nowMs);
 
   payload += "}";
   return payload;
@@ -388,9 +1236,20 @@ String victronManagerBuildStateJson()
 
 void victronManagerInit() {}
 bool victronManagerDue(uint32_t, const ProfileConfig &) { return false; }
-bool victronManagerRunScanOnce(uint32_t, uint32_t) { return false; }
+bool victronManagerScanStart(uint32_t, uint32_t) { return false; }
+bool victronManagerScanTick(uint32_t) { return true; }
+void victronManagerScanAbort(uint32_t) {}
+void victronManagerBackgroundTick(uint32_t, const ProfileConfig &) {}
+bool victronManagerBackgroundActive() { return false; }
+void victronManagerNotePublishCycle(uint32_t) {}
 bool victronManagerPublishPending() { return false; }
 void victronManagerClearPublishPending() {}
 String victronManagerBuildStateJson() { return "{}"; }
+VictronRegistryStatus victronRegistryApply(uint32_t, const String &, const String &, const String &, const String &)
+{
+  return VictronRegistryStatus::DISABLED;
+}
+String victronRegistryJson() { return "[]"; }
+bool victronManagerBattery(float &, float &, float &, uint16_t &, uint32_t &, uint32_t) { return false; }
 
 #endif
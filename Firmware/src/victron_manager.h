@@ -11,7 +11,13 @@
 //
 // Viktig design:
 // - Ingen WiFi eller MQTT här.
-// - BLE körs bara som kort, schemalagd scan.
+// - BLE körs normalt som kort, schemalagd scan. Scanningen är asynkron
+//   och avslutas så fort alla konfigurerade enheter hörts, annars
+//   vid profilens scanSeconds.
+// - Profiler med victronBleBackground (TRAVEL) scannar i stället
+//   kontinuerligt med låg duty-cycle samtidigt som WiFi/MQTT är uppe.
+// - Med VICTRON_BLE_PERSISTENT ligger BLE-stacken initierad men
+//   vilande mellan scans, annars init/deinit runt varje scan.
 // - MQTT-publicering görs av mqtt.cpp.
 // ============================================================
 
@@ -20,13 +26,75 @@ void victronManagerInit();
 // Returnerar true när aktuell profil får köra Victron BLE och intervallet är nått.
 bool victronManagerDue(uint32_t nowMs, const ProfileConfig &profile);
 
-// Kör en blockande BLE-scan. Ska bara anropas när pipeline har sett till
-// att kommunikation/radio är avstängd enligt profilen.
-bool victronManagerRunScanOnce(uint32_t nowMs, uint32_t scanSeconds);
+// Startar en asynkron BLE-scan. Ska bara anropas när pipeline har sett
+// till att kommunikation/radio är avstängd enligt profilen.
+// false = scanningen kunde inte startas (redan avslutad, inget att ticka).
+bool victronManagerScanStart(uint32_t nowMs, uint32_t scanSeconds);
+
+// Tickas medan scanningen pågår. Returnerar true när den är klar
+// (alla enheter hörda eller tiden ute) och BLE är avstängt.
+bool victronManagerScanTick(uint32_t nowMs);
+
+// Avbryt pågående scan direkt (t.ex. PIR). Ofullständig scan räknas inte
+// in i statistiken för sparad scantid.
+void victronManagerScanAbort(uint32_t nowMs);
+
+// Startar/stoppar bakgrundsscan efter aktuell profil och startar om
+// scanbitarna. Anropas varje pipelinetick.
+void victronManagerBackgroundTick(uint32_t nowMs, const ProfileConfig &profile);
+bool victronManagerBackgroundActive();
+
+// Publiceringscykelns längd (ms) i keepConnected-profiler. Delas upp
+// på med/utan bakgrundsscan i state-payloaden.
+void victronManagerNotePublishCycle(uint32_t cycleMs);
 
 // Returnerar true om ny Victron-data eller ny scanstatus bör publiceras.
+// Vid bakgrundsscan begränsat till profilens victronBleIntervalMs.
 bool victronManagerPublishPending();
 void victronManagerClearPublishPending();
 
 // Bygger payload kompatibel med befintlig HA victron.yaml.
 String victronManagerBuildStateJson();
+
+// Senaste husbatterivärden från SmartShunten (NaN om fältet saknas).
+// ttgMin = 0xFFFF när shunten inte räknat fram någon tid.
+// false = ingen shuntdata yngre än maxAgeMs.
+bool victronManagerBattery(float &socPct, float &voltageV, float &currentA,
+                           uint16_t &ttgMin, uint32_t &lastSeenMs,
+                           uint32_t maxAgeMs);
+
+// ------------------------------------------------------------
+// Enhetsregister
+// ------------------------------------------------------------
+// Enheterna (namn, MAC, nyckel) ligger i NVS och ändras via MQTT.
+// Utan sparat register fylls det från secrets.h vid första boot.
+// Ändringar slår igenom vid nästa scan eller bakgrundsbit, utan
+// omstart och utan extra scantid.
+
+enum class VictronRegistryStatus : uint8_t
+{
+  OK,
+  DUPLICATE_IGNORED,
+  MISSING_CHANGE_ID,
+  BAD_OP,
+  BAD_MAC,
+  BAD_KEY,
+  EXISTS,
+  NOT_FOUND,
+  FULL,
+  NVS_FAILED,
+  DISABLED
+};
+
+const char *victronRegistryStatusName(VictronRegistryStatus s);
+
+// op: "add" (name, mac, key), "remove" (mac) eller "rekey" (mac, key).
+// changeId dedupliceras mot senast genomförda ändring (sparas i NVS).
+VictronRegistryStatus victronRegistryApply(uint32_t changeId,
+                                           const String &op,
+                                           const String &name,
+                                           const String &mac,
+                                           const String &key);
+
+// JSON-array med name/mac per registrerad enhet. Nycklar tas aldrig med.
+String victronRegistryJson();